@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "alloc_count.h"
+
+/* dlsym() may allocate before the real functions are known.  Those
+ * requests are served from here and never given back.
+ */
+#define BOOT_HEAP_SIZE 8192
+
+static char boot_heap[BOOT_HEAP_SIZE] __attribute__((aligned(16)));
+static size_t boot_used;
+
+static void *(*real_malloc)(size_t size);
+static void *(*real_calloc)(size_t nmemb, size_t size);
+static void *(*real_realloc)(void *ptr, size_t size);
+static void (*real_free)(void *ptr);
+
+static __thread bool resolving;
+
+static uint64_t allocs;
+static uint64_t alloc_bytes;
+
+static void resolve(void)
+{
+        resolving = true;
+
+        real_malloc = dlsym(RTLD_NEXT, "malloc");
+        real_calloc = dlsym(RTLD_NEXT, "calloc");
+        real_realloc = dlsym(RTLD_NEXT, "realloc");
+        real_free = dlsym(RTLD_NEXT, "free");
+
+        resolving = false;
+
+        if ((real_malloc == NULL) || (real_calloc == NULL) ||
+            (real_realloc == NULL) || (real_free == NULL))
+                abort();
+}
+
+static void *boot_alloc(size_t size)
+{
+        size_t off;
+
+        size = (size + 15) & ~(size_t)15;
+
+        off = __sync_fetch_and_add(&boot_used, size);
+        if (off + size > BOOT_HEAP_SIZE)
+                return NULL;
+
+        return boot_heap + off;
+}
+
+static bool in_boot_heap(const void *ptr)
+{
+        return ((const char *)ptr >= boot_heap) &&
+                ((const char *)ptr < boot_heap + BOOT_HEAP_SIZE);
+}
+
+static void count_alloc(size_t size)
+{
+        __sync_fetch_and_add(&allocs, 1);
+        __sync_fetch_and_add(&alloc_bytes, size);
+}
+
+void alloc_count_get(uint64_t *count, uint64_t *bytes)
+{
+        *count = __sync_fetch_and_add(&allocs, 0);
+        *bytes = __sync_fetch_and_add(&alloc_bytes, 0);
+}
+
+void *malloc(size_t size)
+{
+        if (real_malloc == NULL) {
+                if (resolving)
+                        return boot_alloc(size);
+                resolve();
+        }
+
+        count_alloc(size);
+
+        return real_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+        if (real_calloc == NULL) {
+                if (resolving) {
+                        if ((size != 0) && (nmemb > SIZE_MAX / size))
+                                return NULL;
+                        return boot_alloc(nmemb * size);
+                }
+                resolve();
+        }
+
+        count_alloc(nmemb * size);
+
+        return real_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+        void *new;
+        size_t len;
+
+        if ((ptr != NULL) && in_boot_heap(ptr)) {
+                new = malloc(size);
+                if (new != NULL) {
+                        len = boot_heap + BOOT_HEAP_SIZE - (char *)ptr;
+                        memcpy(new, ptr, len < size ? len : size);
+                }
+                return new;
+        }
+
+        if (real_realloc == NULL)
+                resolve();
+
+        count_alloc(size);
+
+        return real_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+        if ((ptr == NULL) || in_boot_heap(ptr))
+                return;
+
+        if (real_free == NULL)
+                resolve();
+
+        real_free(ptr);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ALLOC_COUNT_H
+#define __ALLOC_COUNT_H
+
+#include <stdint.h>
+
+/*
+ * Heap accounting for the benchmark programs.  Linking alloc_count.c
+ * into a program interposes the malloc family for the program and the
+ * libraries it loads, libxml2 and the providers included.  The real
+ * functions are looked up with dlsym(RTLD_NEXT).  It must never be
+ * linked into a library.
+ */
+void alloc_count_get(uint64_t *allocs, uint64_t *bytes);
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
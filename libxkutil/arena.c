@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+
+/* A parsed small domain fits in the first block */
+#define ARENA_FIRST_BLOCK (8 * 1024)
+
+#define ALIGN_UP(x) (((x) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+
+struct arena_block {
+        struct arena_block *next;
+        size_t size;
+        size_t used;
+        char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+struct arena {
+        struct arena_block *head;
+        void *last;
+        size_t used;
+};
+
+static struct arena_block *block_new(size_t size)
+{
+        struct arena_block *block;
+
+        block = malloc(sizeof(*block) + size);
+        if (block == NULL)
+                return NULL;
+
+        block->next = NULL;
+        block->size = size;
+        block->used = 0;
+
+        return block;
+}
+
+struct arena *arena_new(void)
+{
+        struct arena *arena;
+
+        arena = calloc(1, sizeof(*arena));
+        if (arena == NULL)
+                return NULL;
+
+        arena->head = block_new(ARENA_FIRST_BLOCK);
+        if (arena->head == NULL) {
+                free(arena);
+                return NULL;
+        }
+
+        return arena;
+}
+
+void arena_free(struct arena *arena)
+{
+        struct arena_block *block;
+        struct arena_block *next;
+
+        if (arena == NULL)
+                return;
+
+        for (block = arena->head; block != NULL; block = next) {
+                next = block->next;
+                free(block);
+        }
+
+        free(arena);
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+        struct arena_block *block = arena->head;
+        size_t need = ALIGN_UP(size == 0 ? 1 : size);
+        void *ptr;
+
+        if (block->size - block->used < need) {
+                size_t bsize = block->size * 2;
+
+                if (bsize < need)
+                        bsize = ALIGN_UP(need);
+
+                block = block_new(bsize);
+                if (block == NULL)
+                        return NULL;
+
+                block->next = arena->head;
+                arena->head = block;
+        }
+
+        ptr = block->data + block->used;
+        block->used += need;
+        arena->used += need;
+        arena->last = ptr;
+
+        memset(ptr, 0, size);
+
+        return ptr;
+}
+
+void *arena_realloc(struct arena *arena, void *ptr,
+                    size_t old_size, size_t size)
+{
+        struct arena_block *block = arena->head;
+        void *new;
+
+        if (ptr == NULL)
+                return arena_alloc(arena, size);
+
+        if (size <= old_size)
+                return ptr;
+
+        if (ptr == arena->last) {
+                size_t offset = (char *)ptr - block->data;
+                size_t need = ALIGN_UP(size);
+
+                if (offset + need <= block->size) {
+                        arena->used += need - (block->used - offset);
+                        block->used = offset + need;
+                        memset((char *)ptr + old_size, 0, size - old_size);
+
+                        return ptr;
+                }
+        }
+
+        new = arena_alloc(arena, size);
+        if (new != NULL)
+                memcpy(new, ptr, old_size);
+
+        return new;
+}
+
+char *arena_strdup(struct arena *arena, const char *str)
+{
+        size_t len = strlen(str) + 1;
+        char *copy;
+
+        copy = arena_alloc(arena, len);
+        if (copy != NULL)
+                memcpy(copy, str, len);
+
+        return copy;
+}
+
+int arena_vasprintf(struct arena *arena, char **strp,
+                    const char *fmt, va_list ap)
+{
+        va_list aq;
+        int len;
+
+        *strp = NULL;
+
+        va_copy(aq, ap);
+        len = vsnprintf(NULL, 0, fmt, aq);
+        va_end(aq);
+
+        if (len < 0)
+                return -1;
+
+        *strp = arena_alloc(arena, len + 1);
+        if (*strp == NULL)
+                return -1;
+
+        vsnprintf(*strp, len + 1, fmt, ap);
+
+        return len;
+}
+
+size_t arena_used(struct arena *arena)
+{
+        return arena->used;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
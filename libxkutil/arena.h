@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef __ARENA_H
+#define __ARENA_H
+
+#include <stddef.h>
+#include <stdarg.h>
+
+/*
+ * Bump allocator for data with a single owner and lifetime, such as a
+ * parsed domain.  Memory comes from a few large blocks and is only
+ * released, all at once, by arena_free().  An arena must not be used
+ * by more than one thread at a time.
+ */
+struct arena;
+
+struct arena *arena_new(void);
+void arena_free(struct arena *arena);
+
+/* Returns zeroed memory, or NULL if out of memory */
+void *arena_alloc(struct arena *arena, size_t size);
+
+/* Grows ptr, which must have been returned by arena_alloc() or
+ * arena_realloc() with old_size bytes, in place if it was the last
+ * allocation.  ptr may be NULL, like realloc().
+ */
+void *arena_realloc(struct arena *arena, void *ptr,
+                    size_t old_size, size_t size);
+
+char *arena_strdup(struct arena *arena, const char *str);
+
+/* Same as vasprintf(), returns -1 and sets *strp to NULL on failure */
+int arena_vasprintf(struct arena *arena, char **strp,
+                    const char *fmt, va_list ap);
+
+/* Bytes handed out so far */
+size_t arena_used(struct arena *arena);
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
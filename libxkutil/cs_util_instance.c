@@ -31,6 +31,7 @@
 #include <cmpimacs.h>
 
 #include "cs_util.h"
+#include "misc_util.h"
 #include <libcmpiutil/libcmpiutil.h>
 
 #define USE_VIR_CONNECT_LIST_ALL_DOMAINS 0
@@ -155,7 +156,7 @@ void set_instances_class_name(CMPIInstance **list,
         const char *type;
         char *prefix;
 
-        type = virConnectGetType(conn);
+        type = type_from_conn(conn);
         if (!type)
                 prefix = "ERROR";
         else if (strstr(type, "Xen") == type)
@@ -25,6 +25,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <inttypes.h>
 #include <sys/stat.h>
 
@@ -62,7 +63,67 @@
         } while (0);
 
 /* Device parse function */
-typedef int (*dev_parse_func_t)(xmlNode *, struct virt_device **);
+typedef int (*dev_parse_func_t)(xmlNode *, struct virt_device *);
+
+/* True if a device node could have the given id, checked without
+ * parsing the device
+ */
+typedef bool (*dev_match_func_t)(xmlNode *, const char *);
+
+/*
+ * Set while this thread parses into an arena.  Everything the parser
+ * allocates then comes from it, and the dp_free() calls on its error
+ * and cleanup paths do nothing.
+ */
+static __thread struct arena *parse_arena = NULL;
+
+static void *dp_calloc(size_t nmemb, size_t size)
+{
+        if (parse_arena != NULL)
+                return arena_alloc(parse_arena, nmemb * size);
+
+        return calloc(nmemb, size);
+}
+
+static void *dp_realloc(void *ptr, size_t old_size, size_t size)
+{
+        if (parse_arena != NULL)
+                return arena_realloc(parse_arena, ptr, old_size, size);
+
+        return realloc(ptr, size);
+}
+
+static char *dp_strdup(const char *str)
+{
+        if (parse_arena != NULL)
+                return arena_strdup(parse_arena, str);
+
+        return strdup(str);
+}
+
+static int dp_asprintf(char **strp, const char *fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+
+static int dp_asprintf(char **strp, const char *fmt, ...)
+{
+        va_list ap;
+        int ret;
+
+        va_start(ap, fmt);
+        if (parse_arena != NULL)
+                ret = arena_vasprintf(parse_arena, strp, fmt, ap);
+        else
+                ret = vasprintf(strp, fmt, ap);
+        va_end(ap);
+
+        return ret;
+}
+
+static void dp_free(void *ptr)
+{
+        if (parse_arena == NULL)
+                free(ptr);
+}
 
 static void cleanup_device_address(struct device_address *addr)
 {
@@ -72,12 +133,12 @@ static void cleanup_device_address(struct device_address *addr)
 
         CU_DEBUG("Cleanup %d addresses", addr->ct);
         for (i = 0; i < addr->ct; i++) {
-                free(addr->key[i]);
-                free(addr->value[i]);
+                dp_free(addr->key[i]);
+                dp_free(addr->value[i]);
         }
 
-        free(addr->key);
-        free(addr->value);
+        dp_free(addr->key);
+        dp_free(addr->value);
         addr->ct = 0;
 }
 
@@ -87,17 +148,17 @@ static void cleanup_disk_device(struct disk_device *dev)
                 return;
 
         CU_DEBUG("Clean Disk type %s", dev->type);
-        free(dev->type);
-        free(dev->device);
-        free(dev->driver);
-        free(dev->driver_type);
-        free(dev->cache);
-        free(dev->source);
-        free(dev->virtual_dev);
-        free(dev->bus_type);
-        free(dev->rawio);
-        free(dev->sgio);
-        free(dev->access_mode);
+        dp_free(dev->type);
+        dp_free(dev->device);
+        dp_free(dev->driver);
+        dp_free(dev->driver_type);
+        dp_free(dev->cache);
+        dp_free(dev->source);
+        dp_free(dev->virtual_dev);
+        dp_free(dev->bus_type);
+        dp_free(dev->rawio);
+        dp_free(dev->sgio);
+        dp_free(dev->access_mode);
         cleanup_device_address(&dev->address);
 }
 
@@ -107,13 +168,13 @@ static void cleanup_vsi_device(struct vsi_device *dev)
                 return;
 
         CU_DEBUG("Clean VSI type %s", dev->vsi_type);
-        free(dev->vsi_type);
-        free(dev->manager_id);
-        free(dev->type_id);
-        free(dev->type_id_version);
-        free(dev->instance_id);
-        free(dev->filter_ref);
-        free(dev->profile_id);
+        dp_free(dev->vsi_type);
+        dp_free(dev->manager_id);
+        dp_free(dev->type_id);
+        dp_free(dev->type_id_version);
+        dp_free(dev->instance_id);
+        dp_free(dev->filter_ref);
+        dp_free(dev->profile_id);
 }
 
 static void cleanup_net_device(struct net_device *dev)
@@ -122,14 +183,14 @@ static void cleanup_net_device(struct net_device *dev)
                 return;
 
         CU_DEBUG("Clean net type %s", dev->type);
-        free(dev->type);
-        free(dev->mac);
-        free(dev->source);
-        free(dev->model);
-        free(dev->device);
-        free(dev->net_mode);
-        free(dev->filter_ref);
-        free(dev->poolid);
+        dp_free(dev->type);
+        dp_free(dev->mac);
+        dp_free(dev->source);
+        dp_free(dev->model);
+        dp_free(dev->device);
+        dp_free(dev->net_mode);
+        dp_free(dev->filter_ref);
+        dp_free(dev->poolid);
         cleanup_vsi_device(&dev->vsi);
         cleanup_device_address(&dev->address);
 }
@@ -140,22 +201,22 @@ static void cleanup_emu_device(struct emu_device *dev)
                 return;
 
         CU_DEBUG("Clean emu %s", dev->path);
-        free(dev->path);
+        dp_free(dev->path);
 }
 
 static void cleanup_vnc_device(struct graphics_device *dev)
 {
-        free(dev->dev.vnc.port);
-        free(dev->dev.vnc.host);
-        free(dev->dev.vnc.keymap);
-        free(dev->dev.vnc.passwd);
+        dp_free(dev->dev.vnc.port);
+        dp_free(dev->dev.vnc.host);
+        dp_free(dev->dev.vnc.keymap);
+        dp_free(dev->dev.vnc.passwd);
 }
 
 static void cleanup_sdl_device(struct graphics_device *dev)
 {
-        free(dev->dev.sdl.display);
-        free(dev->dev.sdl.xauth);
-        free(dev->dev.sdl.fullscreen);
+        dp_free(dev->dev.sdl.display);
+        dp_free(dev->dev.sdl.xauth);
+        dp_free(dev->dev.sdl.fullscreen);
 }
 
 static void cleanup_graphics_device(struct graphics_device *dev)
@@ -169,7 +230,7 @@ static void cleanup_graphics_device(struct graphics_device *dev)
         else
                 cleanup_vnc_device(dev);
 
-        free(dev->type);
+        dp_free(dev->type);
 }
 
 static void cleanup_path_device(struct path_device *dev)
@@ -178,7 +239,7 @@ static void cleanup_path_device(struct path_device *dev)
             return;
 
         CU_DEBUG("Clean path device %s", dev->path);
-        free(dev->path);
+        dp_free(dev->path);
 
 }
 
@@ -188,8 +249,8 @@ static void cleanup_unixsock_device(struct unixsock_device *dev)
             return;
 
         CU_DEBUG("Clean unixsock device");
-        free(dev->path);
-        free(dev->mode);
+        dp_free(dev->path);
+        dp_free(dev->mode);
 
 }
 
@@ -199,10 +260,10 @@ static void cleanup_tcp_device(struct tcp_device *dev)
             return;
 
         CU_DEBUG("Clean tcp device");
-        free(dev->mode);
-        free(dev->protocol);
-        free(dev->host);
-        free(dev->service);
+        dp_free(dev->mode);
+        dp_free(dev->protocol);
+        dp_free(dev->host);
+        dp_free(dev->service);
 
 }
 
@@ -212,10 +273,10 @@ static void cleanup_udp_device(struct udp_device *dev)
             return;
 
         CU_DEBUG("Clean udb bind device");
-        free(dev->bind_host);
-        free(dev->bind_service);
-        free(dev->connect_host);
-        free(dev->connect_service);
+        dp_free(dev->bind_host);
+        dp_free(dev->bind_service);
+        dp_free(dev->connect_host);
+        dp_free(dev->connect_service);
 };
 
 static void cleanup_console_device(struct console_device *dev)
@@ -258,7 +319,7 @@ static void cleanup_console_device(struct console_device *dev)
         }
 
         dev->source_type = 0;
-        free(dev->target_type);
+        dp_free(dev->target_type);
         memset(&dev->source_dev, 0, sizeof(dev->source_dev));
 };
 
@@ -317,8 +378,8 @@ static void cleanup_input_device(struct input_device *dev)
                 return;
 
         CU_DEBUG("Clean input device %s", dev->type);
-        free(dev->type);
-        free(dev->bus);
+        dp_free(dev->type);
+        dp_free(dev->bus);
 }
 
 static void cleanup_controller_device(struct controller_device *dev)
@@ -327,17 +388,17 @@ static void cleanup_controller_device(struct controller_device *dev)
                 return;
 
         CU_DEBUG("Clean controller device %d", dev->type);
-        free(dev->model);
-        free(dev->queues);
-        free(dev->ports);
-        free(dev->vectors);
+        dp_free(dev->model);
+        dp_free(dev->queues);
+        dp_free(dev->ports);
+        dp_free(dev->vectors);
         cleanup_device_address(&dev->address);
 }
 
 void cleanup_virt_device(struct virt_device *dev)
 {
         if (dev == NULL)
-                return; /* free()-like semantics */
+                return; /* dp_free()-like semantics */
 
         if (dev->type == CIM_RES_TYPE_DISK)
                 cleanup_disk_device(&dev->dev.disk);
@@ -354,7 +415,7 @@ void cleanup_virt_device(struct virt_device *dev)
         else if (dev->type == CIM_RES_TYPE_CONTROLLER)
                 cleanup_controller_device(&dev->dev.controller);
 
-        free(dev->id);
+        dp_free(dev->id);
 
         memset(dev, 0, sizeof(*dev));
 }
@@ -368,7 +429,7 @@ void cleanup_virt_devices(struct virt_device **_devs, int count)
                 cleanup_virt_device(&devs[i]);
 
         CU_DEBUG("All devices cleaned");
-        free(devs);
+        dp_free(devs);
         *_devs = NULL;
 }
 
@@ -379,7 +440,7 @@ char *get_attr_value(xmlNode *node, char *attrname)
 
         buf = (char *)xmlGetProp(node, (xmlChar *)attrname);
         if (buf) {
-                ret = strdup(buf);
+                ret = dp_strdup(buf);
                 xmlFree(buf);
         }
 
@@ -393,7 +454,7 @@ char *get_node_content(xmlNode *node)
 
         ret = xmlNodeGetContent(node);
         if (ret) {
-                buf = strdup((char *)ret);
+                buf = dp_strdup((char *)ret);
                 xmlFree(ret);
         }
 
@@ -409,17 +470,21 @@ int add_device_address_property(struct device_address *devaddr,
         char **list = NULL;
 
         if (key != NULL && value != NULL) {
-                k = strdup(key);
-                v = strdup(value);
+                k = dp_strdup(key);
+                v = dp_strdup(value);
                 if (k == NULL || v == NULL)
                         goto err;
 
-                list = realloc(devaddr->key, sizeof(char*) * (devaddr->ct+1));
+                list = dp_realloc(devaddr->key,
+                                  sizeof(char*) * devaddr->ct,
+                                  sizeof(char*) * (devaddr->ct+1));
                 if (list == NULL)
                         goto err;
                 devaddr->key = list;
 
-                list = realloc(devaddr->value, sizeof(char*) * (devaddr->ct+1));
+                list = dp_realloc(devaddr->value,
+                                  sizeof(char*) * devaddr->ct,
+                                  sizeof(char*) * (devaddr->ct+1));
                 if (list == NULL)
                         goto err;
                 devaddr->value = list;
@@ -431,9 +496,9 @@ int add_device_address_property(struct device_address *devaddr,
         }
 
  err:
-        free(k);
-        free(v);
-        free(list);
+        dp_free(k);
+        dp_free(v);
+        dp_free(list);
         return 0;
 }
 
@@ -449,28 +514,23 @@ static int parse_device_address(xmlNode *anode, struct device_address *devaddr)
                 value = get_attr_value(anode, name);
                 if (!add_device_address_property(devaddr, name, value))
                         goto err;
-                free(value);
+                dp_free(value);
         }
 
         return 1;
 
  err:
         cleanup_device_address(devaddr);
-        free(value);
+        dp_free(value);
 
         return 0;
 }
 
-static int parse_fs_device(xmlNode *dnode, struct virt_device **vdevs)
+static int parse_fs_device(xmlNode *dnode, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct disk_device *ddev = NULL;
         xmlNode *child = NULL;
 
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
-
         ddev = (&vdev->dev.disk);
 
         ddev->type = get_attr_value(dnode, "type");
@@ -509,30 +569,22 @@ static int parse_fs_device(xmlNode *dnode, struct virt_device **vdevs)
         ddev->disk_type = DISK_FS;
 
         vdev->type = CIM_RES_TYPE_DISK;
-        vdev->id = strdup(ddev->virtual_dev);
-
-        *vdevs = vdev;
+        vdev->id = dp_strdup(ddev->virtual_dev);
 
         return 1;
 
  err:
         CU_DEBUG("Error parsing fs");
         cleanup_disk_device(ddev);
-        free(vdev);
 
         return 0;
 }
 
-static int parse_block_device(xmlNode *dnode, struct virt_device **vdevs)
+static int parse_block_device(xmlNode *dnode, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct disk_device *ddev = NULL;
         xmlNode * child = NULL;
 
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
-
         ddev = &(vdev->dev.disk);
 
         ddev->type = get_attr_value(dnode, "type");
@@ -582,7 +634,7 @@ static int parse_block_device(xmlNode *dnode, struct virt_device **vdevs)
 
         /* handle the situation that a cdrom device have no disk in it, no ISO file */
         if ((XSTREQ(ddev->device, "cdrom")) && (ddev->source == NULL)) {
-                ddev->source = strdup("");
+                ddev->source = dp_strdup("");
                 ddev->disk_type = DISK_FILE;
         }
 
@@ -590,27 +642,24 @@ static int parse_block_device(xmlNode *dnode, struct virt_device **vdevs)
                 goto err;
 
         vdev->type = CIM_RES_TYPE_DISK;
-        vdev->id = strdup(ddev->virtual_dev);
-
-        *vdevs = vdev;
+        vdev->id = dp_strdup(ddev->virtual_dev);
 
         return 1;
 
  err:
         cleanup_disk_device(ddev);
-        free(vdev);
 
         return 0;
 }
 
-static int parse_disk_device(xmlNode *dnode, struct virt_device **vdevs)
+static int parse_disk_device(xmlNode *dnode, struct virt_device *vdev)
 {
         CU_DEBUG("Disk node: %s", dnode->name);
 
         if (XSTREQ(dnode->name, "disk"))
-                return parse_block_device(dnode, vdevs);
+                return parse_block_device(dnode, vdev);
         else if (XSTREQ(dnode->name, "filesystem"))
-                return parse_fs_device(dnode, vdevs);
+                return parse_fs_device(dnode, vdev);
         else {
                 CU_DEBUG("Unknown disk device: %s", dnode->name);
                 return 0;
@@ -622,7 +671,7 @@ static int parse_vsi_device(xmlNode *dnode, struct net_device *vdevs)
         struct vsi_device *vsi_dev = NULL;
         xmlNode * child = NULL;
 
-        vsi_dev = calloc(1, sizeof(*vsi_dev));
+        vsi_dev = dp_calloc(1, sizeof(*vsi_dev));
         if (vsi_dev == NULL)
                 goto err;
 
@@ -654,25 +703,20 @@ static int parse_vsi_device(xmlNode *dnode, struct net_device *vdevs)
         }
 
         memcpy(&(vdevs->vsi), vsi_dev, sizeof(*vsi_dev));
-        free(vsi_dev);
+        dp_free(vsi_dev);
         return 1;
 
 err:
         cleanup_vsi_device(vsi_dev);
-        free(vsi_dev);
+        dp_free(vsi_dev);
         return 0;
 }
 
-static int parse_net_device(xmlNode *inode, struct virt_device **vdevs)
+static int parse_net_device(xmlNode *inode, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct net_device *ndev = NULL;
         xmlNode *child = NULL;
 
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
-
         ndev = &(vdev->dev.net);
 
         ndev->type = get_attr_value(inode, "type");
@@ -690,7 +734,7 @@ static int parse_net_device(xmlNode *inode, struct virt_device **vdevs)
                                 continue;
                         ndev->source = get_attr_value(child, "network");
                         if (ndev->source != NULL) {
-                                int ret = asprintf(&ndev->poolid, 
+                                int ret = dp_asprintf(&ndev->poolid, 
                                                    "NetworkPool/%s",
                                                    ndev->source);
                                 if (ret == -1) {
@@ -734,7 +778,7 @@ static int parse_net_device(xmlNode *inode, struct virt_device **vdevs)
                                           if (val != NULL) {
                                                   sscanf(val, "%" PRIu64,
                                                      &ndev->reservation);
-                                                  free(val);
+                                                  dp_free(val);
                                           } else
                                                   ndev->reservation = 0;
 
@@ -743,7 +787,7 @@ static int parse_net_device(xmlNode *inode, struct virt_device **vdevs)
                                           if (val != NULL) {
                                                   sscanf(val, "%" PRIu64,
                                                      &ndev->limit);
-                                                  free(val);
+                                                  dp_free(val);
                                           } else
                                                   ndev->limit = 0;
                                           break;
@@ -758,21 +802,17 @@ static int parse_net_device(xmlNode *inode, struct virt_device **vdevs)
                 CU_DEBUG("No network source defined, leaving blank\n");
 
         vdev->type = CIM_RES_TYPE_NET;
-        vdev->id = strdup(ndev->mac);
-
-        *vdevs = vdev;
+        vdev->id = dp_strdup(ndev->mac);
 
         return 1;
   err:
         cleanup_net_device(ndev);
-        free(vdev);
 
         return 0;
 }
 
-static int parse_vcpu_device(xmlNode *node, struct virt_device **vdevs)
+static int parse_vcpu_device(xmlNode *node, struct virt_device *vdev)
 {
-        struct virt_device *list = NULL;
         char *count_str;
         int count;
 
@@ -782,35 +822,20 @@ static int parse_vcpu_device(xmlNode *node, struct virt_device **vdevs)
         else if (sscanf(count_str, "%i", &count) != 1)
                 count = 1; /* Default to 1 VCPU if garbage */
 
-        free(count_str);
-
-        list = calloc(1, sizeof(*list));
-        if (list == NULL)
-                goto err;
-        
-        list->dev.vcpu.quantity = count;
+        dp_free(count_str);
 
-        list->type = CIM_RES_TYPE_PROC;
-        list->id = strdup("proc");
+        vdev->dev.vcpu.quantity = count;
 
-        *vdevs = list;
+        vdev->type = CIM_RES_TYPE_PROC;
+        vdev->id = dp_strdup("proc");
 
         return 1;
- err:
-        free(list);
-
-        return 0;
 }
 
-static int parse_emu_device(xmlNode *node, struct virt_device **vdevs)
+static int parse_emu_device(xmlNode *node, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct emu_device *edev = NULL;
 
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
-
         edev = &(vdev->dev.emu);
 
         edev->path = get_node_content(node);
@@ -819,27 +844,18 @@ static int parse_emu_device(xmlNode *node, struct virt_device **vdevs)
 
         vdev->type = CIM_RES_TYPE_EMU;
 
-        *vdevs = vdev;
-
         return 1;
  err:
         cleanup_emu_device(edev);
-        free(vdev);
 
         return 0;
 }
 
-static int parse_mem_device(xmlNode *node, struct virt_device **vdevs)
+static int parse_mem_device(xmlNode *node, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct mem_device *mdev = NULL;
         char *content = NULL;
         char *tmpval = NULL;
-        int ret = 0;
-
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
 
         mdev = &(vdev->dev.mem);
 
@@ -859,16 +875,10 @@ static int parse_mem_device(xmlNode *node, struct virt_device **vdevs)
                 }
         }
 
-        *vdevs = vdev;
-        vdev = NULL;
-        ret = 1;
+        dp_free(content);
+        dp_free(tmpval);
 
- err:
-        free(content);
-        free(tmpval);
-        free(vdev);
-
-        return ret;
+        return 1;
 }
 
 static char *get_attr_value_default(xmlNode *node, char *attrname,
@@ -877,24 +887,19 @@ static char *get_attr_value_default(xmlNode *node, char *attrname,
         char *ret = get_attr_value(node, attrname);
 
         if (ret == NULL && default_value != NULL)
-                ret = strdup(default_value);
+                ret = dp_strdup(default_value);
 
         return ret;
 }
 
-static int parse_console_device(xmlNode *node, struct virt_device **vdevs)
+static int parse_console_device(xmlNode *node, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct console_device *cdev = NULL;
         char *source_type_str = NULL;
         char *target_port_ID = NULL;
 
         xmlNode *child = NULL;
 
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
-
         cdev = &(vdev->dev.console);
 
         source_type_str = get_attr_value(node, "type");
@@ -962,10 +967,10 @@ static int parse_console_device(xmlNode *node, struct virt_device **vdevs)
                                 } else {
                                         CU_DEBUG("unknown udp mode: %s",
                                                  udp_source_mode);
-                                        free(udp_source_mode);
+                                        dp_free(udp_source_mode);
                                         goto err;
                                 }
-                                free(udp_source_mode);
+                                dp_free(udp_source_mode);
                                 break;
                         }
                         case CIM_CHARDEV_SOURCE_TYPE_TCP:
@@ -996,37 +1001,30 @@ static int parse_console_device(xmlNode *node, struct virt_device **vdevs)
 
         vdev->type = CIM_RES_TYPE_CONSOLE;
 
-        if (asprintf(&vdev->id, "charconsole:%s", target_port_ID) == -1) {
+        if (dp_asprintf(&vdev->id, "charconsole:%s", target_port_ID) == -1) {
                 CU_DEBUG("Failed to create charconsole id string");
                 goto err;
         }
 
-        *vdevs = vdev;
-        free(source_type_str);
-        free(target_port_ID);
+        dp_free(source_type_str);
+        dp_free(target_port_ID);
 
         return 1;
 
  err:
-        free(source_type_str);
-        free(target_port_ID);
+        dp_free(source_type_str);
+        dp_free(target_port_ID);
         cleanup_console_device(cdev);
-        free(vdev);
 
         return 0;
 }
 
-static int parse_graphics_device(xmlNode *node, struct virt_device **vdevs)
+static int parse_graphics_device(xmlNode *node, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct graphics_device *gdev = NULL;
         xmlNode *child = NULL;
         int ret;
 
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
-
         gdev = &(vdev->dev.graphics);
 
         gdev->type = get_attr_value(node, "type");
@@ -1060,8 +1058,8 @@ static int parse_graphics_device(xmlNode *node, struct virt_device **vdevs)
 
                 /* Change type to serial, console, etc. It will be converted 
                  * back in xmlgen.c */
-                free(gdev->type);
-                gdev->type = strdup((char *)node->name);
+                dp_free(gdev->type);
+                gdev->type = dp_strdup((char *)node->name);
 
                 for (child = node->children; child != NULL; 
                         child = child->next) {
@@ -1081,35 +1079,27 @@ static int parse_graphics_device(xmlNode *node, struct virt_device **vdevs)
         vdev->type = CIM_RES_TYPE_GRAPHICS;
         
         if (STREQC(gdev->type, "vnc")) 
-                ret = asprintf(&vdev->id, "%s", gdev->type);
+                ret = dp_asprintf(&vdev->id, "%s", gdev->type);
         else
-                ret = asprintf(&vdev->id, "%s:%s", gdev->type, gdev->dev.vnc.port);
+                ret = dp_asprintf(&vdev->id, "%s:%s", gdev->type, gdev->dev.vnc.port);
 
         if (ret == -1) {
                 CU_DEBUG("Failed to create graphics is string");
                 goto err;
         }
 
-        *vdevs = vdev;
-
         return 1;
  err:
         cleanup_graphics_device(gdev);
-        free(vdev);
 
         return 0;
 }
 
-static int parse_input_device(xmlNode *node, struct virt_device **vdevs)
+static int parse_input_device(xmlNode *node, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct input_device *idev = NULL;
         int ret;
 
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
-
         idev = &(vdev->dev.input);
 
         idev->type = get_attr_value(node, "type");
@@ -1120,35 +1110,27 @@ static int parse_input_device(xmlNode *node, struct virt_device **vdevs)
 
         vdev->type = CIM_RES_TYPE_INPUT;
 
-        ret = asprintf(&vdev->id, "%s:%s", idev->type, idev->bus);
+        ret = dp_asprintf(&vdev->id, "%s:%s", idev->type, idev->bus);
         if (ret == -1) {
                 CU_DEBUG("Failed to create input id string");
                 goto err;
         }
 
-        *vdevs = vdev;
-
         return 1;
  err:
         cleanup_input_device(idev);
-        free(vdev);
 
         return 0;
 }
 
-static int parse_controller_device(xmlNode *cnode, struct virt_device **vdevs)
+static int parse_controller_device(xmlNode *cnode, struct virt_device *vdev)
 {
-        struct virt_device *vdev = NULL;
         struct controller_device *cdev = NULL;
         char *type_str = NULL;
         xmlNode *child = NULL;
         char *index = NULL;
         int ret;
 
-        vdev = calloc(1, sizeof(*vdev));
-        if (vdev == NULL)
-                goto err;
-
         cdev = &(vdev->dev.controller);
 
         type_str = get_attr_value(cnode, "type");
@@ -1166,7 +1148,7 @@ static int parse_controller_device(xmlNode *cnode, struct virt_device **vdevs)
         index = get_attr_value(cnode, "index");
         if (index != NULL) {
                 sscanf(index, "%" PRIu64, &cdev->index);
-                free(index);
+                dp_free(index);
         } else {
                 CU_DEBUG("No index");
                 goto err;
@@ -1185,40 +1167,125 @@ static int parse_controller_device(xmlNode *cnode, struct virt_device **vdevs)
         }
         vdev->type = CIM_RES_TYPE_CONTROLLER;
 
-        ret = asprintf(&vdev->id, "controller:%s:%" PRIu64,
+        ret = dp_asprintf(&vdev->id, "controller:%s:%" PRIu64,
                        type_str, cdev->index);
         if (ret == -1) {
                 CU_DEBUG("Failed to create controller id string");
                 goto err;
         }
         CU_DEBUG("Controller id is %s", vdev->id);
-        free(type_str);
-
-        *vdevs = vdev;
+        dp_free(type_str);
 
         return 1;
  err:
-        free(type_str);
+        dp_free(type_str);
         cleanup_controller_device(cdev);
-        free(vdev);
 
         return 0;
 }
 
-static bool resize_devlist(struct virt_device **list, int newsize)
+static bool attr_matches(xmlNode *node, const char *attrname,
+                         const char *value, size_t len)
+{
+        xmlChar *buf;
+        bool ret = false;
+
+        buf = xmlGetProp(node, (xmlChar *)attrname);
+        if (buf != NULL) {
+                ret = (strlen((char *)buf) == len) &&
+                        (strncasecmp((char *)buf, value, len) == 0);
+                xmlFree(buf);
+        }
+
+        return ret;
+}
+
+static bool child_attr_matches(xmlNode *node, const char *childname,
+                               const char *attrname, const char *value)
+{
+        xmlNode *child;
+
+        for (child = node->children; child != NULL; child = child->next) {
+                if (XSTREQ(child->name, childname))
+                        return attr_matches(child, attrname,
+                                            value, strlen(value));
+        }
+
+        return false;
+}
+
+static bool match_disk_device(xmlNode *node, const char *id)
 {
-        struct virt_device *_list;
+        if (XSTREQ(node->name, "filesystem"))
+                return child_attr_matches(node, "target", "dir", id);
 
-        _list = realloc(*list, newsize * sizeof(struct virt_device));
-        if (_list == NULL)
+        return child_attr_matches(node, "target", "dev", id);
+}
+
+static bool match_net_device(xmlNode *node, const char *id)
+{
+        return child_attr_matches(node, "mac", "address", id);
+}
+
+static bool match_console_device(xmlNode *node, const char *id)
+{
+        const char *prefix = "charconsole:";
+
+        if (strncmp(id, prefix, strlen(prefix)) != 0)
                 return false;
 
-        *list = _list;
+        return child_attr_matches(node, "target", "port",
+                                  id + strlen(prefix));
+}
+
+/* Input ids are "<type>:<bus>" */
+static bool match_input_device(xmlNode *node, const char *id)
+{
+        const char *sep;
+
+        sep = strchr(id, ':');
+        if (sep == NULL)
+                return false;
 
-        return true;
+        return attr_matches(node, "type", id, sep - id) &&
+                attr_matches(node, "bus", sep + 1, strlen(sep + 1));
 }
 
+/* Controller ids are "controller:<type>:<index>" */
+static bool match_controller_device(xmlNode *node, const char *id)
+{
+        const char *prefix = "controller:";
+        const char *type;
+        const char *sep;
+        xmlChar *index;
+        bool ret = false;
+
+        if (strncmp(id, prefix, strlen(prefix)) != 0)
+                return false;
 
+        type = id + strlen(prefix);
+        sep = strrchr(type, ':');
+        if (sep == NULL)
+                return false;
+
+        if (!attr_matches(node, "type", type, sep - type))
+                return false;
+
+        index = xmlGetProp(node, (xmlChar *)"index");
+        if (index != NULL) {
+                ret = strtoull((char *)index, NULL, 10) ==
+                        strtoull(sep + 1, NULL, 10);
+                xmlFree(index);
+        }
+
+        return ret;
+}
+
+/*
+ * Parses each node straight into its slot of a list sized from the
+ * node count.  A node that fails to parse leaves its slot zeroed for
+ * the next one, so the list may end up with a few unused slots.
+ */
 static int do_parse(xmlNodeSet *nsv, dev_parse_func_t do_real_parse,
                     struct virt_device **l)
 {
@@ -1237,48 +1304,93 @@ static int do_parse(xmlNodeSet *nsv, dev_parse_func_t do_real_parse,
         if (count <= 0)
                 goto out;
 
+        list = dp_calloc(count, sizeof(*list));
+        if (list == NULL) {
+                CU_DEBUG("Failed to allocate %d devices", count);
+                goto out;
+        }
+
         /* walk thru the array, do real parsing on each node */
         for (devidx = 0; devidx < count; devidx++) {
-                struct virt_device *tmp_list = NULL;
-                int devices = 0;
-
-                devices = do_real_parse(dev_nodes[devidx], &tmp_list);
-                if (devices <= 0)
+                if (do_real_parse(dev_nodes[devidx], &list[lstidx]) <= 0) {
+                        memset(&list[lstidx], 0, sizeof(*list));
                         continue;
-
-                if (!resize_devlist(&list, lstidx + devices)) {
-                        /* Skip these devices and try again for the
-                         * next cycle, which will probably fail, but
-                         * what else can you do?
-                         */
-                        goto end;
                 }
 
-                memcpy(&list[lstidx], tmp_list, devices * sizeof(*tmp_list));
-                lstidx += devices;
-        end:
-                free(tmp_list);
+                lstidx++;
+        }
+
+        if (lstidx == 0) {
+                dp_free(list);
+                list = NULL;
         }
 
   out:
         if (list) {
-                free(*l);
+                dp_free(*l);
                 *l = list;
         }
         return lstidx;
 }
 
+/*
+ * Parses only the node of the device with the given id.  Nodes are
+ * skipped on their identifying attributes when the type has a match
+ * function, and parsed one at a time until the id matches otherwise.
+ */
+static int do_parse_id(xmlNodeSet *nsv, dev_parse_func_t do_real_parse,
+                       dev_match_func_t match, const char *id,
+                       struct virt_device **l)
+{
+        int devidx;
+        struct virt_device *dev = NULL;
+
+        if (nsv == NULL || nsv->nodeNr <= 0)
+                return 0;
+
+        dev = dp_calloc(1, sizeof(*dev));
+        if (dev == NULL)
+                return 0;
+
+        for (devidx = 0; devidx < nsv->nodeNr; devidx++) {
+                xmlNode *node = nsv->nodeTab[devidx];
+
+                if (match != NULL && !match(node, id))
+                        continue;
+
+                if (do_real_parse(node, dev) <= 0) {
+                        memset(dev, 0, sizeof(*dev));
+                        continue;
+                }
+
+                if (dev->id != NULL && STREQC(dev->id, id)) {
+                        dp_free(*l);
+                        *l = dev;
+                        return 1;
+                }
+
+                cleanup_virt_device(dev);
+        }
+
+        dp_free(dev);
+
+        return 0;
+}
+
 /* Dummy function to suppress error message from libxml2 */
 static void swallow_err_msg(void *ctx, const char *msg, ...)
 {
         /* do nothing, just swallow the message. */
 }
 
-static int parse_devices(const char *xml, struct virt_device **_list, int type)
+/* Parses every device of type, or only the one with id if it is set */
+static int _parse_devices(const char *xml, struct virt_device **_list,
+                          int type, const char *id)
 {
         int len = 0;
         int count = 0;
         dev_parse_func_t func = NULL;
+        dev_match_func_t match = NULL;
 
         xmlDoc *xmldoc;
         xmlXPathContext *xpathCtx;
@@ -1291,11 +1403,13 @@ static int parse_devices(const char *xml, struct virt_device **_list, int type)
         case CIM_RES_TYPE_NET:
                 xpathstr = NET_XPATH;
                 func = &parse_net_device;
+                match = &match_net_device;
                 break;
 
         case CIM_RES_TYPE_DISK:
                 xpathstr = DISK_XPATH;
                 func = &parse_disk_device;
+                match = &match_disk_device;
                 break;
 
         case CIM_RES_TYPE_PROC:
@@ -1321,16 +1435,19 @@ static int parse_devices(const char *xml, struct virt_device **_list, int type)
         case CIM_RES_TYPE_CONSOLE:
                 xpathstr = CONSOLE_XPATH;
                 func = &parse_console_device;
+                match = &match_console_device;
                 break;
 
         case CIM_RES_TYPE_INPUT:
                 xpathstr = INPUT_XPATH;
                 func = &parse_input_device;
+                match = &match_input_device;
                 break;
 
         case CIM_RES_TYPE_CONTROLLER:
                 xpathstr = CONTROLLER_XPATH;
                 func = &parse_controller_device;
+                match = &match_controller_device;
                 break;
 
         default:
@@ -1351,7 +1468,11 @@ static int parse_devices(const char *xml, struct virt_device **_list, int type)
                         == NULL)
                 goto err3;
 
-        count = do_parse(xpathObj->nodesetval, func, _list);
+        if (id != NULL)
+                count = do_parse_id(xpathObj->nodesetval, func, match,
+                                    id, _list);
+        else
+                count = do_parse(xpathObj->nodesetval, func, _list);
 
         xmlSetGenericErrorFunc(NULL, NULL);
         xmlXPathFreeObject(xpathObj);
@@ -1363,6 +1484,11 @@ static int parse_devices(const char *xml, struct virt_device **_list, int type)
         return count;
 }
 
+static int parse_devices(const char *xml, struct virt_device **_list, int type)
+{
+        return _parse_devices(xml, _list, type, NULL);
+}
+
 static void duplicate_device_address(struct device_address *to, const struct device_address *from)
 {
         int i;
@@ -1441,6 +1567,8 @@ struct virt_device *virt_device_dup(struct virt_device *_dev)
                 dev->dev.mem.dumpCore = _dev->dev.mem.dumpCore;
         } else if (dev->type == CIM_RES_TYPE_PROC) {
                 dev->dev.vcpu.quantity = _dev->dev.vcpu.quantity;
+                dev->dev.vcpu.weight = _dev->dev.vcpu.weight;
+                dev->dev.vcpu.limit = _dev->dev.vcpu.limit;
         } else if (dev->type == CIM_RES_TYPE_EMU) {
                 DUP_FIELD(dev, _dev, dev.emu.path);
         } else if (dev->type == CIM_RES_TYPE_GRAPHICS) {
@@ -1469,6 +1597,46 @@ struct virt_device *virt_device_dup(struct virt_device *_dev)
         return dev;
 }
 
+bool virt_device_equal(struct virt_device *a, struct virt_device *b)
+{
+        char *xml_a = NULL;
+        char *xml_b = NULL;
+        bool equal = false;
+
+        if (a->type != b->type)
+                return false;
+
+        /* Memory and processor settings are not fully described by
+         * their device XML (and scheduler values live in the infostore),
+         * so compare those directly.
+         */
+        if (a->type == CIM_RES_TYPE_MEM)
+                return (a->dev.mem.size == b->dev.mem.size) &&
+                        (a->dev.mem.maxsize == b->dev.mem.maxsize) &&
+                        (a->dev.mem.dumpCore == b->dev.mem.dumpCore);
+
+        if (a->type == CIM_RES_TYPE_PROC)
+                return (a->dev.vcpu.quantity == b->dev.vcpu.quantity) &&
+                        (a->dev.vcpu.weight == b->dev.vcpu.weight) &&
+                        (a->dev.vcpu.limit == b->dev.vcpu.limit);
+
+        if ((a->type == CIM_RES_TYPE_NET) &&
+            ((a->dev.net.reservation != b->dev.net.reservation) ||
+             (a->dev.net.limit != b->dev.net.limit)))
+                return false;
+
+        xml_a = device_to_xml(a);
+        xml_b = device_to_xml(b);
+
+        if ((xml_a != NULL) && (xml_b != NULL))
+                equal = STREQ(xml_a, xml_b);
+
+        free(xml_a);
+        free(xml_b);
+
+        return equal;
+}
+
 static int _get_mem_device(const char *xml, struct virt_device **list)
 {
         struct virt_device *mdevs = NULL;
@@ -1480,7 +1648,7 @@ static int _get_mem_device(const char *xml, struct virt_device **list)
         if (ret <= 0)
                 return ret;
 
-        mdev = calloc(1, sizeof(*mdev));
+        mdev = dp_calloc(1, sizeof(*mdev));
         if (mdev == NULL)
                 return 0;
 
@@ -1517,7 +1685,7 @@ static int _get_mem_device(const char *xml, struct virt_device **list)
         }
 
         mdev->type = CIM_RES_TYPE_MEM;
-        mdev->id = strdup("mem");
+        mdev->id = dp_strdup("mem");
         *list = mdev;
 
         cleanup_virt_devices(&mdevs, ret);
@@ -1535,12 +1703,12 @@ static int _get_proc_device(const char *xml, struct virt_device **list)
         if (ret <= 0)
                 return ret;
 
-        proc_dev = calloc(1, sizeof(*proc_dev));
+        proc_dev = dp_calloc(1, sizeof(*proc_dev));
         if (proc_dev == NULL)
                 return 0;
 
         proc_dev->type = CIM_RES_TYPE_PROC;
-        proc_dev->id = strdup("proc");
+        proc_dev->id = dp_strdup("proc");
         proc_dev->dev.vcpu.quantity = proc_devs[0].dev.vcpu.quantity;
         *list = proc_dev;
 
@@ -1549,8 +1717,13 @@ static int _get_proc_device(const char *xml, struct virt_device **list)
         return 1;
 };
 
-int get_devices(virDomainPtr dom, struct virt_device **list, int type,
-                                                    unsigned int flags)
+/* Memory and processors are parsed whole, whatever the id */
+static int devices_from_dom(virDomainPtr dom,
+                            struct arena *arena,
+                            struct virt_device **list,
+                            int type,
+                            const char *id,
+                            unsigned int flags)
 {
         char *xml;
         int ret;
@@ -1559,18 +1732,110 @@ int get_devices(virDomainPtr dom, struct virt_device **list, int type,
         if (xml == NULL)
                 return 0;
 
+        parse_arena = arena;
+
         if (type == CIM_RES_TYPE_MEM)
                 ret = _get_mem_device(xml, list);
         else if (type == CIM_RES_TYPE_PROC)
                 ret = _get_proc_device(xml, list);
         else
-                ret = parse_devices(xml, list, type);
+                ret = _parse_devices(xml, list, type, id);
+
+        parse_arena = NULL;
 
         free(xml);
 
         return ret;
 }
 
+int get_devices(virDomainPtr dom, struct virt_device **list, int type,
+                                                    unsigned int flags)
+{
+        return devices_from_dom(dom, NULL, list, type, NULL, flags);
+}
+
+int get_devices_arena(virDomainPtr dom, struct arena *arena,
+                      struct virt_device **list, int type,
+                      unsigned int flags)
+{
+        return devices_from_dom(dom, arena, list, type, NULL, flags);
+}
+
+static struct devlist *devlist_from_dom(virDomainPtr dom,
+                                        int type,
+                                        const char *id,
+                                        unsigned int flags)
+{
+        struct arena *arena;
+        struct devlist *devs;
+
+        arena = arena_new();
+        if (arena == NULL)
+                return NULL;
+
+        devs = arena_alloc(arena, sizeof(*devs));
+        if (devs == NULL)
+                goto err;
+
+        devs->arena = arena;
+        devs->refs = 1;
+        devs->count = devices_from_dom(dom, arena, &devs->list,
+                                       type, id, flags);
+        if (devs->count < 0)
+                goto err;
+
+        return devs;
+ err:
+        arena_free(arena);
+
+        return NULL;
+}
+
+struct devlist *get_devlist(virDomainPtr dom, int type, unsigned int flags)
+{
+        return devlist_from_dom(dom, type, NULL, flags);
+}
+
+struct devlist *get_devlist_by_id(virDomainPtr dom,
+                                  int type,
+                                  const char *id,
+                                  unsigned int flags)
+{
+        return devlist_from_dom(dom, type, id, flags);
+}
+
+struct devlist *devlist_ref(struct devlist *devs)
+{
+        if (devs != NULL)
+                __sync_fetch_and_add(&devs->refs, 1);
+
+        return devs;
+}
+
+void devlist_unref(struct devlist *devs)
+{
+        if (devs == NULL)
+                return;
+
+        /* The list lives in its own arena */
+        if (__sync_sub_and_fetch(&devs->refs, 1) == 0)
+                arena_free(devs->arena);
+}
+
+struct virt_device *devlist_find(struct devlist *devs, const char *id)
+{
+        int i;
+
+        for (i = 0; i < devs->count; i++) {
+                struct virt_device *dev = &devs->list[i];
+
+                if (dev->id != NULL && STREQ(dev->id, id))
+                        return dev;
+        }
+
+        return NULL;
+}
+
 char *get_fq_devid(char *host, char *_devid)
 {
         char *devid;
@@ -1602,9 +1867,9 @@ int parse_fq_devid(const char *devid, char **host, char **device)
 static void cleanup_bootlist(char **blist, unsigned blist_ct)
 {
         while (blist_ct > 0) {
-                free(blist[--blist_ct]);
+                dp_free(blist[--blist_ct]);
         }
-        free(blist);
+        dp_free(blist);
 }
 
 static int parse_os(struct domain *dominfo, xmlNode *os)
@@ -1639,9 +1904,11 @@ static int parse_os(struct domain *dominfo, xmlNode *os)
                 else if (XSTREQ(child->name, "boot") && boot == NULL) {
                         char **tmp_list = NULL;
 
-                        tmp_list = (char **)realloc(blist,
-                                                    (bl_size + 1) *
-                                                    sizeof(char *));
+                        tmp_list = (char **)dp_realloc(blist,
+                                                       bl_size *
+                                                       sizeof(char *),
+                                                       (bl_size + 1) *
+                                                       sizeof(char *));
                         if (tmp_list == NULL) {
                                 // Nothing you can do. Just go on.
                                 CU_DEBUG("Could not alloc space for "
@@ -1701,14 +1968,14 @@ static int parse_os(struct domain *dominfo, xmlNode *os)
                 break;
         }
 
-        free(arch);
-        free(machine);
-        free(kernel);
-        free(initrd);
-        free(cmdline);
-        free(loader);
-        free(boot);
-        free(init);
+        dp_free(arch);
+        dp_free(machine);
+        dp_free(kernel);
+        dp_free(initrd);
+        dp_free(cmdline);
+        dp_free(loader);
+        dp_free(boot);
+        dp_free(init);
         cleanup_bootlist(blist, bl_size);
         return 1;
 }
@@ -1817,7 +2084,7 @@ int get_dominfo_from_xml(const char *xml, struct domain **dominfo)
         int ret;
 
         CU_DEBUG("In get_dominfo_from_xml");
-        *dominfo = calloc(1, sizeof(**dominfo));
+        *dominfo = dp_calloc(1, sizeof(**dominfo));
         if (*dominfo == NULL)
                 return 0;
 
@@ -1852,13 +2119,28 @@ int get_dominfo_from_xml(const char *xml, struct domain **dominfo)
         return ret;
 
  err:
-        free(*dominfo);
+        dp_free(*dominfo);
         *dominfo = NULL;
 
         return 0;
 }
 
-int get_dominfo(virDomainPtr dom, struct domain **dominfo)
+int get_dominfo_from_xml_arena(const char *xml,
+                               struct arena *arena,
+                               struct domain **dominfo)
+{
+        int ret;
+
+        parse_arena = arena;
+        ret = get_dominfo_from_xml(xml, dominfo);
+        parse_arena = NULL;
+
+        return ret;
+}
+
+static int dominfo_from_dom(virDomainPtr dom,
+                            struct arena *arena,
+                            struct domain **dominfo)
 {
         char *xml;
         int ret = 0;
@@ -1875,7 +2157,7 @@ int get_dominfo(virDomainPtr dom, struct domain **dominfo)
                 return 0;
         }
 
-        if (get_dominfo_from_xml(xml, dominfo) == 0) {
+        if (get_dominfo_from_xml_arena(xml, arena, dominfo) == 0) {
                 CU_DEBUG("Failed to translate xml into struct domain");
                 goto out;
         }
@@ -1893,6 +2175,18 @@ int get_dominfo(virDomainPtr dom, struct domain **dominfo)
         return ret;
 }
 
+int get_dominfo(virDomainPtr dom, struct domain **dominfo)
+{
+        return dominfo_from_dom(dom, NULL, dominfo);
+}
+
+int get_dominfo_arena(virDomainPtr dom,
+                      struct arena *arena,
+                      struct domain **dominfo)
+{
+        return dominfo_from_dom(dom, arena, dominfo);
+}
+
 void cleanup_dominfo(struct domain **dominfo)
 {
         struct domain *dom;
@@ -32,6 +32,7 @@
 #include <libxml/xpath.h>
 
 #include "../src/svpc_types.h"
+#include "arena.h"
 
 struct device_address {
         uint32_t ct;
@@ -268,6 +269,9 @@ struct domain {
 
 struct virt_device *virt_device_dup(struct virt_device *dev);
 
+/* True if a and b would produce the same guest configuration */
+bool virt_device_equal(struct virt_device *a, struct virt_device *b);
+
 int disk_type_from_file(const char *path);
 
 int get_dominfo(virDomainPtr dom, struct domain **dominfo);
@@ -279,6 +283,51 @@ void cleanup_dominfo(struct domain **dominfo);
 int get_devices(virDomainPtr dom, struct virt_device **list, int type,
                                                     unsigned int flags);
 
+/*
+ * Same as above, but the domain or device list and everything it points
+ * to is allocated from arena and released only by arena_free().  The
+ * result is read-only: do not pass it to cleanup_dominfo() or
+ * cleanup_virt_devices(), nor free or replace any of its fields.
+ */
+int get_dominfo_arena(virDomainPtr dom,
+                      struct arena *arena,
+                      struct domain **dominfo);
+int get_dominfo_from_xml_arena(const char *xml,
+                               struct arena *arena,
+                               struct domain **dominfo);
+int get_devices_arena(virDomainPtr dom, struct arena *arena,
+                      struct virt_device **list, int type,
+                      unsigned int flags);
+
+/*
+ * A reference counted device list, parsed into its own arena.  Devices
+ * returned by devlist_find() are borrowed from the list: they are valid
+ * and read-only until the last devlist_unref().
+ */
+struct devlist {
+        struct arena *arena;
+        struct virt_device *list;
+        int count;
+        int refs;
+};
+
+/* Returns a list holding one reference, or NULL on failure */
+struct devlist *get_devlist(virDomainPtr dom, int type, unsigned int flags);
+
+/*
+ * Same as above, but only the device with the given id, compared
+ * without regard to case, is parsed.  Memory and processors are
+ * always parsed whole.
+ */
+struct devlist *get_devlist_by_id(virDomainPtr dom,
+                                  int type,
+                                  const char *id,
+                                  unsigned int flags);
+
+struct devlist *devlist_ref(struct devlist *devs);
+void devlist_unref(struct devlist *devs);
+struct virt_device *devlist_find(struct devlist *devs, const char *id);
+
 void cleanup_virt_device(struct virt_device *dev);
 void cleanup_virt_devices(struct virt_device **devs, int count);
 
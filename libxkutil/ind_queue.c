@@ -0,0 +1,380 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "cmpidt.h"
+#include "cmpift.h"
+#include "cmpimacs.h"
+
+#include <libcmpiutil/libcmpiutil.h>
+
+#include "misc_util.h"
+#include "stats.h"
+#include "ind_queue.h"
+
+enum ind_policy {
+        IND_POLICY_BLOCK,
+        IND_POLICY_DROP_OLDEST,
+        IND_POLICY_DROP_NEWEST,
+};
+
+struct ind_entry {
+        struct ind_entry *next;
+        CMPIInstance *ind;
+        struct std_indication_ctx *_ctx;
+        uint64_t queued;
+        char ns[];
+};
+
+static enum ind_policy ind_policy(void)
+{
+        const char *policy = get_indication_queue_policy();
+
+        if (policy == NULL)
+                return IND_POLICY_BLOCK;
+        else if (STREQC(policy, "drop_oldest"))
+                return IND_POLICY_DROP_OLDEST;
+        else if (STREQC(policy, "drop_newest"))
+                return IND_POLICY_DROP_NEWEST;
+
+        return IND_POLICY_BLOCK;
+}
+
+static CMPIStatus ind_deliver(const CMPIBroker *broker,
+                              const CMPIContext *context,
+                              const char *ns,
+                              struct std_indication_ctx *_ctx,
+                              CMPIInstance *ind)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIObjectPath *op;
+        struct ind_args args;
+
+        op = CMGetObjectPath(ind, &s);
+        if ((op == NULL) || (s.rc != CMPI_RC_OK)) {
+                cu_statusf(broker, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Got a null object path");
+                return s;
+        }
+
+        args.context = (CMPIContext *)context;
+        args.ns = (char *)ns;
+        args.classname = (char *)CLASSNAME(op);
+        args._ctx = _ctx;
+
+        s = stdi_deliver(broker, context, &args, ind);
+        if (s.rc == CMPI_RC_OK) {
+                CU_DEBUG("Indication delivered");
+        } else {
+                CU_DEBUG("Not delivered: %s",
+                         s.msg != NULL ? CMGetCharPtr(s.msg) : "");
+        }
+
+        return s;
+}
+
+static void ind_entry_free(struct ind_entry *entry)
+{
+        if (entry == NULL)
+                return;
+
+        if (entry->ind != NULL)
+                CMRelease(entry->ind);
+
+        free(entry);
+}
+
+static struct ind_entry *ind_entry_new(const CMPIBroker *broker,
+                                       const struct ind_args *args,
+                                       const CMPIInstance *ind,
+                                       CMPIStatus *s)
+{
+        struct ind_entry *entry;
+        size_t len = strlen(args->ns) + 1;
+
+        entry = calloc(1, sizeof(*entry) + len);
+        if (entry == NULL) {
+                cu_statusf(broker, s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to allocate indication entry");
+                return NULL;
+        }
+
+        /* The indication outlives the call that raised it */
+        entry->ind = CMClone(ind, s);
+        if ((entry->ind == NULL) || (s->rc != CMPI_RC_OK)) {
+                CU_DEBUG("Failed to copy indication");
+                entry->ind = NULL;
+                ind_entry_free(entry);
+                return NULL;
+        }
+
+        memcpy(entry->ns, args->ns, len);
+        entry->_ctx = args->_ctx;
+        entry->queued = stats_enabled ? stats_now() : 0;
+
+        return entry;
+}
+
+static void ind_queue_deliver(struct ind_queue *queue,
+                              const CMPIBroker *broker,
+                              const CMPIContext *context,
+                              struct ind_entry *entry)
+{
+        uint64_t start = 0;
+        CMPIStatus s;
+
+        if (stats_enabled)
+                start = stats_now();
+
+        s = ind_deliver(broker, context, entry->ns, entry->_ctx, entry->ind);
+        if (s.rc == CMPI_RC_OK)
+                __sync_add_and_fetch(&queue->stats.delivered, 1);
+        else
+                __sync_add_and_fetch(&queue->stats.failed, 1);
+
+        stats_record(queue->name, "IndicationDeliver", start);
+        stats_record(queue->name, "IndicationLatency", entry->queued);
+
+        ind_entry_free(entry);
+}
+
+/* Takes the next entry, waiting for one while the queue is empty.
+ * Returns NULL once the queue is stopped and empty.  Call with lock
+ * held.
+ */
+static struct ind_entry *ind_queue_pop(struct ind_queue *queue)
+{
+        struct ind_entry *entry;
+
+        queue->busy = false;
+
+        while ((queue->head == NULL) && !queue->stopped) {
+                pthread_cond_broadcast(&queue->idle);
+                pthread_cond_wait(&queue->work, &queue->lock);
+        }
+
+        entry = queue->head;
+        if (entry == NULL) {
+                pthread_cond_broadcast(&queue->idle);
+                return NULL;
+        }
+
+        queue->head = entry->next;
+        if (queue->head == NULL)
+                queue->tail = NULL;
+        entry->next = NULL;
+        queue->depth--;
+        queue->busy = true;
+        pthread_cond_signal(&queue->space);
+
+        return entry;
+}
+
+/* Lives as long as the queue, sleeping while it is empty */
+static CMPI_THREAD_RETURN ind_thread(void *arg)
+{
+        struct ind_queue *queue = arg;
+        const CMPIBroker *broker = queue->broker;
+        CMPIContext *context = queue->context;
+        struct ind_queue_stats stats;
+        struct ind_entry *entry;
+
+        CBAttachThread(broker, context);
+
+        CU_DEBUG("%s delivery thread started", queue->name);
+
+        pthread_mutex_lock(&queue->lock);
+
+        while ((entry = ind_queue_pop(queue)) != NULL) {
+                pthread_mutex_unlock(&queue->lock);
+                ind_queue_deliver(queue, broker, context, entry);
+                pthread_mutex_lock(&queue->lock);
+        }
+
+        pthread_mutex_unlock(&queue->lock);
+
+        ind_queue_get_stats(queue, &stats);
+        CU_DEBUG("%s delivery thread exiting: %llu queued, %llu delivered, "
+                 "%llu failed, %llu dropped, max depth %u",
+                 queue->name,
+                 (unsigned long long)stats.queued,
+                 (unsigned long long)stats.delivered,
+                 (unsigned long long)stats.failed,
+                 (unsigned long long)stats.dropped,
+                 stats.max_depth);
+
+        CBDetachThread(broker, context);
+
+        return NULL;
+}
+
+/* Starts the delivery thread on first use.  Call with lock held. */
+static bool ind_queue_start(struct ind_queue *queue,
+                            const CMPIBroker *broker,
+                            const CMPIContext *context)
+{
+        if (queue->started)
+                return true;
+
+        queue->broker = broker;
+        queue->context = CBPrepareAttachThread(broker, context);
+        queue->thread = broker->xft->newThread(ind_thread, queue, 0);
+        if (queue->thread == 0) {
+                CU_DEBUG("Unable to start %s delivery thread",
+                         queue->name);
+                CMRelease(queue->context);
+                queue->context = NULL;
+                return false;
+        }
+
+        queue->started = true;
+
+        return true;
+}
+
+CMPIStatus ind_queue_push(struct ind_queue *queue,
+                          const CMPIBroker *broker,
+                          const CMPIContext *context,
+                          const struct ind_args *args,
+                          const CMPIInstance *ind)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        struct ind_entry *entry;
+        struct ind_entry *old;
+        enum ind_policy policy;
+        int size;
+
+        size = get_indication_queue_size();
+        if (size <= 0)
+                return ind_deliver(broker, context, args->ns, args->_ctx,
+                                   (CMPIInstance *)ind);
+
+        entry = ind_entry_new(broker, args, ind, &s);
+        if (entry == NULL)
+                return s;
+
+        policy = ind_policy();
+
+        pthread_mutex_lock(&queue->lock);
+
+        /* Without a delivery thread nothing is ever queued */
+        if (queue->stopped || !ind_queue_start(queue, broker, context)) {
+                pthread_mutex_unlock(&queue->lock);
+                ind_entry_free(entry);
+
+                return ind_deliver(broker, context, args->ns, args->_ctx,
+                                   (CMPIInstance *)ind);
+        }
+
+        while (queue->depth >= (unsigned int)size) {
+                if (policy == IND_POLICY_DROP_NEWEST) {
+                        queue->stats.dropped++;
+                        pthread_mutex_unlock(&queue->lock);
+
+                        CU_DEBUG("%s queue full, dropping new indication",
+                                 queue->name);
+                        ind_entry_free(entry);
+
+                        return s;
+                } else if (policy == IND_POLICY_DROP_OLDEST) {
+                        old = queue->head;
+                        queue->head = old->next;
+                        if (queue->head == NULL)
+                                queue->tail = NULL;
+                        queue->depth--;
+                        queue->stats.dropped++;
+
+                        CU_DEBUG("%s queue full, dropping oldest indication",
+                                 queue->name);
+                        ind_entry_free(old);
+                } else {
+                        pthread_cond_wait(&queue->space, &queue->lock);
+                }
+        }
+
+        if (queue->tail != NULL)
+                queue->tail->next = entry;
+        else
+                queue->head = entry;
+        queue->tail = entry;
+
+        queue->depth++;
+        queue->stats.queued++;
+        if (queue->depth > queue->stats.max_depth)
+                queue->stats.max_depth = queue->depth;
+
+        pthread_cond_signal(&queue->work);
+
+        pthread_mutex_unlock(&queue->lock);
+
+        return s;
+}
+
+void ind_queue_flush(struct ind_queue *queue)
+{
+        pthread_mutex_lock(&queue->lock);
+
+        while (queue->started && ((queue->head != NULL) || queue->busy))
+                pthread_cond_wait(&queue->idle, &queue->lock);
+
+        pthread_mutex_unlock(&queue->lock);
+}
+
+void ind_queue_stop(struct ind_queue *queue)
+{
+        bool started;
+
+        pthread_mutex_lock(&queue->lock);
+
+        queue->stopped = true;
+        pthread_cond_signal(&queue->work);
+
+        started = queue->started;
+        queue->started = false;
+
+        pthread_mutex_unlock(&queue->lock);
+
+        /* The thread delivers what is left before it exits */
+        if (started)
+                queue->broker->xft->joinThread(queue->thread, NULL);
+
+        CU_DEBUG("%s queue stopped", queue->name);
+}
+
+void ind_queue_get_stats(struct ind_queue *queue,
+                         struct ind_queue_stats *stats)
+{
+        pthread_mutex_lock(&queue->lock);
+        *stats = queue->stats;
+        pthread_mutex_unlock(&queue->lock);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef __IND_QUEUE_H
+#define __IND_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <cmpidt.h>
+#include <cmpift.h>
+
+#include <libcmpiutil/std_indication.h>
+
+/*
+ * Asynchronous indication delivery.  Each indication provider owns one
+ * queue; raising an indication copies it onto the queue and the queue's delivery
+ * thread, started on first use and idle while the queue is empty, hands
+ * it to the CIMOM in order.  The queue
+ * holds at most "indication_queue_size" indications, and what happens
+ * to a producer when it is full is set by "indication_queue_policy" in
+ * libvirt-cim.conf.
+ */
+struct ind_entry;
+
+struct ind_queue_stats {
+        uint64_t queued;
+        uint64_t delivered;
+        uint64_t failed;
+        uint64_t dropped;
+        unsigned int max_depth;
+};
+
+struct ind_queue {
+        const char *name;
+
+        pthread_mutex_t lock;
+        pthread_cond_t space;
+        pthread_cond_t idle;
+        pthread_cond_t work;
+        struct ind_entry *head;
+        struct ind_entry *tail;
+        unsigned int depth;
+        bool busy;
+        bool started;
+        bool stopped;
+
+        const CMPIBroker *broker;
+        CMPIContext *context;
+        CMPI_THREAD_TYPE thread;
+
+        struct ind_queue_stats stats;
+};
+
+#define IND_QUEUE_INITIALIZER(name)                                     \
+        {name, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,     \
+         PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,            \
+         NULL, NULL, 0, false, false, false, NULL, NULL, 0,             \
+         {0, 0, 0, 0, 0}}
+
+/* Queues a copy of ind for stdi_deliver() with args.  Only args->ns and
+ * args->_ctx are used; the class name is taken from the indication.
+ * With a queue size of 0, or once the queue is stopped, the indication
+ * is delivered right away, as it is when no delivery thread can be
+ * started.
+ */
+CMPIStatus ind_queue_push(struct ind_queue *queue,
+                          const CMPIBroker *broker,
+                          const CMPIContext *context,
+                          const struct ind_args *args,
+                          const CMPIInstance *ind);
+
+/* Waits until every queued indication has been delivered */
+void ind_queue_flush(struct ind_queue *queue);
+
+/* Stops the delivery thread once it has delivered what is queued and
+ * joins it.  For the provider's cleanup, as the thread must not
+ * outlive the provider.
+ */
+void ind_queue_stop(struct ind_queue *queue);
+
+void ind_queue_get_stats(struct ind_queue *queue,
+                         struct ind_queue_stats *stats);
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
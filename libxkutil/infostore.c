@@ -38,6 +38,7 @@
 #include <config.h>
 
 #include "infostore.h"
+#include "misc_util.h"
 
 struct infostore_ctx {
         xmlDocPtr doc;
@@ -85,7 +86,7 @@ static char *make_filename(virDomainPtr dom)
                 goto out;
         }
 
-        path = _make_filename(virConnectGetType(conn),
+        path = _make_filename(type_from_conn(conn),
                               virDomainGetName(dom));
 
         CU_DEBUG("Path is %s", path);
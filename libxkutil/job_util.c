@@ -0,0 +1,486 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <uuid.h>
+
+#include "cmpidt.h"
+#include "cmpift.h"
+#include "cmpimacs.h"
+
+#include <libcmpiutil/libcmpiutil.h>
+
+#include "misc_util.h"
+#include "job_util.h"
+
+struct job {
+        const CMPIBroker *broker;
+        CMPIContext *context;
+        CMPIObjectPath *ref;
+        char id[VIR_UUID_STRING_BUFLEN];
+        char *ns;
+        char *classname;
+        char *desc;
+
+        /* Set once a worker has attached to context, which is then
+         * released by the CIMOM when the worker detaches
+         */
+        bool attached;
+
+        job_run_t run;
+        void *data;
+        void (*free_data)(void *);
+
+        struct job *next;
+};
+
+struct job_worker {
+        virConnectPtr conn;
+        char *conn_pfx;
+};
+
+struct job *job_new(const CMPIBroker *broker,
+                    const CMPIContext *context,
+                    const CMPIObjectPath *ref,
+                    const char *classname,
+                    const char *name,
+                    const char *desc,
+                    CMPIObjectPath **job_op,
+                    CMPIStatus *s)
+{
+        struct job *job;
+        CMPIObjectPath *op;
+        CMPIInstance *inst;
+        uuid_t uuid;
+        uint16_t state = CIM_JOBSTATE_NEW;
+        uint16_t percent = 0;
+
+        *job_op = NULL;
+
+        job = calloc(1, sizeof(*job));
+        if (job == NULL) {
+                cu_statusf(broker, s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to allocate job");
+                return NULL;
+        }
+
+        job->broker = broker;
+
+        uuid_generate(uuid);
+        uuid_unparse(uuid, job->id);
+
+        job->ns = strdup(NAMESPACE(ref));
+        job->classname = strdup(classname != NULL ?
+                                classname : "CIM_ConcreteJob");
+        job->desc = strdup(desc);
+        if ((job->ns == NULL) || (job->classname == NULL) ||
+            (job->desc == NULL)) {
+                cu_statusf(broker, s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to allocate job");
+                goto err;
+        }
+
+        job->ref = CMClone(ref, s);
+        if ((job->ref == NULL) || (s->rc != CMPI_RC_OK)) {
+                CU_DEBUG("Failed to copy job reference");
+                goto err;
+        }
+
+        op = CMNewObjectPath(broker, job->ns, job->classname, s);
+        if ((s->rc != CMPI_RC_OK) || (op == NULL)) {
+                CU_DEBUG("Failed to create job path");
+                goto err;
+        }
+
+        inst = CMNewInstance(broker, op, s);
+        if ((s->rc != CMPI_RC_OK) || (inst == NULL)) {
+                CU_DEBUG("Failed to create job instance");
+                goto err;
+        }
+
+        CMSetProperty(inst, "InstanceID",
+                      (CMPIValue *)job->id, CMPI_chars);
+        CMSetProperty(inst, "Name",
+                      (CMPIValue *)name, CMPI_chars);
+        CMSetProperty(inst, "Description",
+                      (CMPIValue *)job->desc, CMPI_chars);
+        CMSetProperty(inst, "JobState",
+                      (CMPIValue *)&state, CMPI_uint16);
+        CMSetProperty(inst, "Status",
+                      (CMPIValue *)"Queued", CMPI_chars);
+        CMSetProperty(inst, "PercentComplete",
+                      (CMPIValue *)&percent, CMPI_uint16);
+
+        op = CMGetObjectPath(inst, s);
+        if ((op == NULL) || (s->rc != CMPI_RC_OK)) {
+                CU_DEBUG("Failed to get path of job instance");
+                goto err;
+        }
+
+        CMSetNameSpace(op, job->ns);
+
+        *job_op = CBCreateInstance(broker, context, op, inst, s);
+        if ((*job_op == NULL) || (s->rc != CMPI_RC_OK)) {
+                CU_DEBUG("Failed to create job");
+                *job_op = NULL;
+                goto err;
+        }
+
+        job->context = CBPrepareAttachThread(broker, context);
+
+        CU_DEBUG("Created job %s: %s", job->id, job->desc);
+
+        return job;
+ err:
+        job_free(job);
+
+        return NULL;
+}
+
+void job_free(struct job *job)
+{
+        if (job == NULL)
+                return;
+
+        if ((job->free_data != NULL) && (job->data != NULL))
+                job->free_data(job->data);
+
+        if (job->ref != NULL)
+                CMRelease(job->ref);
+
+        if ((job->context != NULL) && !job->attached)
+                CMRelease(job->context);
+
+        free(job->ns);
+        free(job->classname);
+        free(job->desc);
+        free(job);
+}
+
+const char *job_id(struct job *job)
+{
+        return job->id;
+}
+
+const CMPIContext *job_context(struct job *job)
+{
+        return job->context;
+}
+
+const CMPIObjectPath *job_ref(struct job *job)
+{
+        return job->ref;
+}
+
+static CMPIInstance *job_instance(struct job *job,
+                                  const CMPIContext *context,
+                                  CMPIObjectPath **op)
+{
+        CMPIInstance *inst;
+        CMPIStatus s;
+
+        *op = CMNewObjectPath(job->broker, job->ns, job->classname, &s);
+        if ((*op == NULL) || (s.rc != CMPI_RC_OK)) {
+                CU_DEBUG("Failed to create job path for update");
+                return NULL;
+        }
+
+        CMAddKey(*op, "InstanceID", (CMPIValue *)job->id, CMPI_chars);
+
+        inst = CBGetInstance(job->broker, context, *op, NULL, &s);
+        if ((inst == NULL) || (s.rc != CMPI_RC_OK)) {
+                CU_DEBUG("Failed to get job instance for update of %s",
+                         job->id);
+                return NULL;
+        }
+
+        return inst;
+}
+
+static void job_update(struct job *job,
+                       const CMPIContext *context,
+                       CMPIObjectPath *op,
+                       CMPIInstance *inst)
+{
+        CMPIStatus s;
+
+        s = CBModifyInstance(job->broker, context, op, inst, NULL);
+        if (s.rc != CMPI_RC_OK)
+                CU_DEBUG("Failed to update job instance %s: %s",
+                         job->id,
+                         CMGetCharPtr(s.msg));
+}
+
+static void _job_set_status(struct job *job,
+                            const CMPIContext *context,
+                            uint16_t state,
+                            const char *status,
+                            uint16_t errcode,
+                            const char *errdesc)
+{
+        CMPIInstance *inst;
+        CMPIObjectPath *op;
+
+        inst = job_instance(job, context, &op);
+        if (inst == NULL)
+                return;
+
+        CMSetProperty(inst, "JobState",
+                      (CMPIValue *)&state, CMPI_uint16);
+        CMSetProperty(inst, "Status",
+                      (CMPIValue *)status, CMPI_chars);
+
+        if ((errcode != 0) && (errdesc != NULL)) {
+                CMSetProperty(inst, "ErrorCode",
+                              (CMPIValue *)&errcode, CMPI_uint16);
+                CMSetProperty(inst, "ErrorDescription",
+                              (CMPIValue *)errdesc, CMPI_chars);
+
+                CU_DEBUG("Set error properties to %i:%s",
+                         errcode,
+                         errdesc);
+        }
+
+        job_update(job, context, op, inst);
+
+        CU_DEBUG("Set %s status to %i:%s", job->id, state, status);
+}
+
+void job_set_status(struct job *job, uint16_t state, const char *status)
+{
+        _job_set_status(job, job->context, state, status, 0, NULL);
+}
+
+void job_set_percent(struct job *job, uint16_t percent)
+{
+        CMPIInstance *inst;
+        CMPIObjectPath *op;
+
+        inst = job_instance(job, job->context, &op);
+        if (inst == NULL)
+                return;
+
+        CMSetProperty(inst, "PercentComplete",
+                      (CMPIValue *)&percent, CMPI_uint16);
+
+        job_update(job, job->context, op, inst);
+
+        CU_DEBUG("Set %s progress to %hu%%", job->id, percent);
+}
+
+void job_set_output(struct job *job,
+                    const char *name,
+                    const CMPIValue *value,
+                    CMPIType type)
+{
+        CMPIInstance *inst;
+        CMPIObjectPath *op;
+
+        inst = job_instance(job, job->context, &op);
+        if (inst == NULL)
+                return;
+
+        CMSetProperty(inst, name, value, type);
+
+        job_update(job, job->context, op, inst);
+
+        CU_DEBUG("Set %s output %s", job->id, name);
+}
+
+void job_set_failed(struct job *job, uint16_t errcode, const char *errdesc)
+{
+        _job_set_status(job, job->context, CIM_JOBSTATE_COMPLETE, "Failed",
+                        errcode, errdesc);
+}
+
+void job_set_complete(struct job *job, const char *status)
+{
+        job_set_percent(job, 100);
+        job_set_status(job, CIM_JOBSTATE_COMPLETE, status);
+}
+
+/* Workers only reconnect when a job targets a different hypervisor */
+virConnectPtr job_connect(struct job *job,
+                          struct job_worker *worker,
+                          CMPIStatus *s)
+{
+        char *pfx;
+
+        CMSetStatus(s, CMPI_RC_OK);
+
+        pfx = class_prefix_name(CLASSNAME(job->ref));
+        if ((worker->conn != NULL) &&
+            (pfx != NULL) && (worker->conn_pfx != NULL) &&
+            STREQ(pfx, worker->conn_pfx)) {
+                free(pfx);
+                return worker->conn;
+        }
+
+        virConnectClose(worker->conn);
+        free(worker->conn_pfx);
+
+        worker->conn = connect_by_classname(job->broker,
+                                            CLASSNAME(job->ref),
+                                            s);
+        worker->conn_pfx = pfx;
+
+        return worker->conn;
+}
+
+static struct job *job_queue_pop(struct job_queue *queue)
+{
+        struct job *job;
+
+        pthread_mutex_lock(&queue->lock);
+
+        job = queue->head;
+        if (job != NULL) {
+                queue->head = job->next;
+                if (queue->head == NULL)
+                        queue->tail = NULL;
+                job->next = NULL;
+        } else {
+                queue->workers--;
+        }
+
+        pthread_mutex_unlock(&queue->lock);
+
+        return job;
+}
+
+static CMPI_THREAD_RETURN job_thread(void *arg)
+{
+        struct job_queue *queue = arg;
+        struct job_worker worker = {NULL, NULL};
+        struct job *job;
+
+        CU_DEBUG("%s worker alive", queue->name);
+
+        while ((job = job_queue_pop(queue)) != NULL) {
+                CU_DEBUG("%s job %s started", queue->name, job->id);
+
+                CBAttachThread(job->broker, job->context);
+                job->attached = true;
+
+                job_set_status(job, CIM_JOBSTATE_RUNNING, "Running");
+                job->run(job, &worker, job->data);
+
+                CBDetachThread(job->broker, job->context);
+
+                job_free(job);
+        }
+
+        virConnectClose(worker.conn);
+        free(worker.conn_pfx);
+
+        CU_DEBUG("%s worker exiting, queue is empty", queue->name);
+
+        return NULL;
+}
+
+int job_queue_push(struct job_queue *queue,
+                   const CMPIContext *context,
+                   struct job *job,
+                   job_run_t run,
+                   void *data,
+                   void (*free_data)(void *))
+{
+        const CMPIBroker *broker = job->broker;
+        struct job **prev;
+        struct job *last = NULL;
+        unsigned int max = 1;
+        bool spawn = false;
+        bool orphaned = false;
+
+        job->run = run;
+        job->data = data;
+        job->free_data = free_data;
+        job->next = NULL;
+
+        if ((queue->max_workers != NULL) && (queue->max_workers() > 1))
+                max = queue->max_workers();
+
+        pthread_mutex_lock(&queue->lock);
+
+        if (queue->tail != NULL)
+                queue->tail->next = job;
+        else
+                queue->head = job;
+        queue->tail = job;
+
+        if (queue->workers < max) {
+                queue->workers++;
+                spawn = true;
+        }
+
+        pthread_mutex_unlock(&queue->lock);
+
+        if (!spawn || (broker->xft->newThread(job_thread, queue, 0) != 0))
+                return 0;
+
+        CU_DEBUG("Unable to start a %s worker", queue->name);
+
+        pthread_mutex_lock(&queue->lock);
+
+        queue->workers--;
+
+        /* With no worker left nobody would ever run the job */
+        if (queue->workers == 0) {
+                for (prev = &queue->head; *prev != NULL;
+                     prev = &(*prev)->next) {
+                        if (*prev == job) {
+                                *prev = job->next;
+                                if (queue->tail == job)
+                                        queue->tail = last;
+                                orphaned = true;
+                                break;
+                        }
+                        last = *prev;
+                }
+        }
+
+        pthread_mutex_unlock(&queue->lock);
+
+        if (!orphaned)
+                return 0;
+
+        /* The prepared context was never attached to a thread, so the
+         * job is failed from the caller's request instead
+         */
+        job->next = NULL;
+        _job_set_status(job, context, CIM_JOBSTATE_COMPLETE, "Failed",
+                        CMPI_RC_ERR_FAILED, "Unable to start a worker thread");
+        job_free(job);
+
+        return -1;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
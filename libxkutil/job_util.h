@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef __JOB_UTIL_H
+#define __JOB_UTIL_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <libvirt/libvirt.h>
+
+#include <cmpidt.h>
+#include <cmpift.h>
+
+/* CIM_ConcreteJob JobState values */
+#define CIM_JOBSTATE_NEW 2
+#define CIM_JOBSTATE_STARTING 3
+#define CIM_JOBSTATE_RUNNING 4
+#define CIM_JOBSTATE_COMPLETE 7
+
+/*
+ * Asynchronous methods.  A method creates a CIM_ConcreteJob with
+ * job_new(), returns its path to the client and queues the work with
+ * job_queue_push().  A queue runs its jobs on at most max_workers()
+ * threads, which are started on demand and exit once the queue is
+ * empty.  A worker keeps its libvirt connection across the jobs it
+ * runs, see job_connect().
+ */
+struct job;
+struct job_worker;
+
+typedef void (*job_run_t)(struct job *job,
+                          struct job_worker *worker,
+                          void *data);
+
+struct job_queue {
+        const char *name;
+        int (*max_workers)(void);
+
+        pthread_mutex_t lock;
+        struct job *head;
+        struct job *tail;
+        unsigned int workers;
+};
+
+#define JOB_QUEUE_INITIALIZER(name, max_workers)                        \
+        {name, max_workers, PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0}
+
+/* Creates the job instance, in state "Queued", and sets *job_op to
+ * its path.  The instance is of classname, or of CIM_ConcreteJob if
+ * it is NULL.  name and desc become the Name and Description of the
+ * job.
+ */
+struct job *job_new(const CMPIBroker *broker,
+                    const CMPIContext *context,
+                    const CMPIObjectPath *ref,
+                    const char *classname,
+                    const char *name,
+                    const char *desc,
+                    CMPIObjectPath **job_op,
+                    CMPIStatus *s);
+
+/* Queues a job returned by job_new(), free_data(data) is called once
+ * it has run.  The job belongs to the queue from now on.  Returns -1
+ * if no worker could be started to run it, in which case the job has
+ * been marked failed through the caller's context and freed already.
+ */
+int job_queue_push(struct job_queue *queue,
+                   const CMPIContext *context,
+                   struct job *job,
+                   job_run_t run,
+                   void *data,
+                   void (*free_data)(void *));
+
+/* Drops a job that was not queued */
+void job_free(struct job *job);
+
+const char *job_id(struct job *job);
+
+/* The context the job runs in, attached to the worker thread */
+const CMPIContext *job_context(struct job *job);
+
+/* A copy of the reference the method was invoked on */
+const CMPIObjectPath *job_ref(struct job *job);
+
+/* Connection for the hypervisor of job_ref(), owned by the worker */
+virConnectPtr job_connect(struct job *job,
+                          struct job_worker *worker,
+                          CMPIStatus *s);
+
+void job_set_status(struct job *job, uint16_t state, const char *status);
+void job_set_percent(struct job *job, uint16_t percent);
+void job_set_failed(struct job *job, uint16_t errcode, const char *errdesc);
+
+/* Records an output of the method in property name of the job, which
+ * must be defined by its class.  Set outputs before the final state,
+ * so that a client seeing the job complete can read them.
+ */
+void job_set_output(struct job *job,
+                    const char *name,
+                    const CMPIValue *value,
+                    CMPIType type);
+
+/* Sets PercentComplete to 100 and the state to complete */
+void job_set_complete(struct job *job, const char *status);
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
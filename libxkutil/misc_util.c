@@ -31,6 +31,8 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <libvirt/libvirt.h>
 #include <libvirt/virterror.h>
 
@@ -107,159 +109,253 @@ static const char *cn_to_uri(const char *classname)
 }
 
 /* config support */
-typedef enum LibvirtcimConfigType {
-        CONFIG_BOOL,
-        CONFIG_STRING,
-} LibvirtcimConfigType;
+#ifdef HAVE_LIBCONFIG
 
-typedef struct LibvirtcimConfigProperty {
-        const char *name;
-        LibvirtcimConfigType value_type;
-        union {
-                int value_bool;
-                char *value_string;
-        };
-        int have_read;
-} LibvirtcimConfigProperty;
+/* Seconds between checks of the config file for changes */
+#define CONFIG_CHECK_INTERVAL 1
+
+static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-#ifdef HAVE_LIBCONFIG
 /*
- * @prop must be initialized with zeros, except default value, return 0 means
- * OK. prop->value_string will be automatically freed if not NULL, caller must
- * never set it to const char*.
+ * Strings handed out by the accessors below are kept for the life of
+ * the process, so callers may hold on to them across a reload.  Each
+ * distinct value is kept once.
  */
-static int libvirt_cim_config_get(LibvirtcimConfigProperty *prop)
+struct config_string {
+        struct config_string *next;
+        char value[];
+};
+
+static struct config_string *config_strings;
+
+/* Call with config_mutex held */
+static const char *config_intern(const char *value)
 {
-        int error = 0;
-        config_t conf;
-        int ret = 0;
-        const char *value_string = NULL;
+        struct config_string *str;
 
-        /* try only once */
-        if (prop->have_read == 1) {
-                return 0;
+        for (str = config_strings; str != NULL; str = str->next) {
+                if (STREQ(str->value, value))
+                        return str->value;
         }
-        prop->have_read = 1;
-
-        config_init(&conf);
 
-        ret = config_read_file(&conf, LIBVIRTCIM_CONF);
-        if (ret == CONFIG_FALSE) {
-                CU_DEBUG("Error reading config file at line %d: '%s'\n",
-                         conf.error_line, conf.error_text);
-                error = -1;
-                goto out;
+        str = malloc(sizeof(*str) + strlen(value) + 1);
+        if (str == NULL) {
+                CU_DEBUG("Failed in duplicate value '%s'", value);
+                return NULL;
         }
 
-        switch (prop->value_type) {
-        case CONFIG_BOOL:
-                ret = config_lookup_bool(&conf,
-                                         prop->name, &prop->value_bool);
-                if (ret == CONFIG_FALSE) {
-                        CU_DEBUG("Bool property '%s' in config file '%s' "
-                                 "not found.",
-                                 prop->name, LIBVIRTCIM_CONF);
-                        error = -1;
-                        goto out;
-                }
+        strcpy(str->value, value);
+        str->next = config_strings;
+        config_strings = str;
 
-                CU_DEBUG("Bool property '%s' in config file '%s' is '%d'.",
-                         prop->name, LIBVIRTCIM_CONF, prop->value_bool);
-                break;
-        case CONFIG_STRING:
-                ret = config_lookup_string(&conf,
-                                           prop->name, &value_string);
-                if (ret == CONFIG_FALSE) {
-                        CU_DEBUG("String property '%s' in config file '%s' "
-                                 "not found.",
-                                 prop->name, LIBVIRTCIM_CONF);
-                        error = -1;
-                        goto out;
-                }
+        return str->value;
+}
+
+/*
+ * The parsed config file.  It is replaced as a whole once a changed
+ * file has been parsed successfully, so a lookup sees either the old
+ * or the new settings, never a mix of the two.
+ */
+static config_t *config_current;
+static time_t config_checked;
+static struct stat config_stat;
 
-                CU_DEBUG("String property '%s' in config file '%s' is '%s'.",
-                         prop->name, LIBVIRTCIM_CONF, value_string);
+static bool config_file_changed(struct stat *st)
+{
+        return (st->st_ino != config_stat.st_ino) ||
+                (st->st_size != config_stat.st_size) ||
+                (st->st_mtim.tv_sec != config_stat.st_mtim.tv_sec) ||
+                (st->st_mtim.tv_nsec != config_stat.st_mtim.tv_nsec);
+}
 
-                if (prop->value_string) {
-                        CU_DEBUG("String property '%s' have value '%s', will "
-                                 "be overwritten.",
-                                 prop->name, prop->value_string);
-                        free(prop->value_string);
-                }
-                prop->value_string = strdup(value_string);
-                if (!prop->value_string) {
-                        CU_DEBUG("Failed in duplicate value '%s'",
-                                 value_string);
-                        error = -1;
-                        goto out;
+/* Call with config_mutex held */
+static void config_refresh(void)
+{
+        struct stat st;
+        config_t *conf;
+        time_t now = time(NULL);
+
+        if ((config_checked != 0) &&
+            (now - config_checked < CONFIG_CHECK_INTERVAL))
+                return;
+        config_checked = now;
+
+        if (stat(LIBVIRTCIM_CONF, &st) != 0) {
+                if (config_current != NULL) {
+                        CU_DEBUG("Config file '%s' is gone, using defaults",
+                                 LIBVIRTCIM_CONF);
+                        config_destroy(config_current);
+                        free(config_current);
+                        config_current = NULL;
                 }
-                break;
-        default:
-                CU_DEBUG("Got invalid property type request %d.",
-                         prop->value_type);
-                error = -1;
-                break;
+                memset(&config_stat, 0, sizeof(config_stat));
+                return;
         }
 
-out:
-        config_destroy(&conf);
-        return error;
+        if (!config_file_changed(&st))
+                return;
+        config_stat = st;
+
+        conf = malloc(sizeof(*conf));
+        if (conf == NULL)
+                return;
+
+        config_init(conf);
+
+        if (config_read_file(conf, LIBVIRTCIM_CONF) == CONFIG_FALSE) {
+                CU_DEBUG("Error reading config file at line %d: '%s', "
+                         "keeping previous settings\n",
+                         conf->error_line, conf->error_text);
+                config_destroy(conf);
+                free(conf);
+                return;
+        }
+
+        CU_DEBUG("Loaded config file '%s'", LIBVIRTCIM_CONF);
+
+        if (config_current != NULL) {
+                config_destroy(config_current);
+                free(config_current);
+        }
+        config_current = conf;
+}
+
+static bool config_get_bool(const char *name, bool def)
+{
+        int value;
+
+        pthread_mutex_lock(&config_mutex);
+        config_refresh();
+        if ((config_current == NULL) ||
+            (config_lookup_bool(config_current, name, &value) == CONFIG_FALSE))
+                value = def;
+        pthread_mutex_unlock(&config_mutex);
+
+        return value;
+}
+
+static int config_get_int(const char *name, int def)
+{
+        config_setting_t *setting = NULL;
+        int value = def;
+
+        pthread_mutex_lock(&config_mutex);
+        config_refresh();
+        if (config_current != NULL)
+                setting = config_lookup(config_current, name);
+        if (setting != NULL)
+                value = config_setting_get_int(setting);
+        pthread_mutex_unlock(&config_mutex);
+
+        return value;
+}
+
+static const char *config_get_string(const char *name, const char *def)
+{
+        const char *value = NULL;
+
+        pthread_mutex_lock(&config_mutex);
+        config_refresh();
+        if ((config_current == NULL) ||
+            (config_lookup_string(config_current,
+                                  name, &value) == CONFIG_FALSE))
+                value = def;
+        else
+                value = config_intern(value);
+        pthread_mutex_unlock(&config_mutex);
+
+        return value;
 }
 #else
-static int libvirt_cim_config_get(LibvirtcimConfigProperty *prop)
+static bool config_get_bool(const char *name, bool def)
 {
-        /* try only once */
-        if (prop->have_read == 1) {
-                return 0;
-        }
-        prop->have_read = 1;
+        return def;
+}
 
-        CU_DEBUG("Built without libconfig, can't read '%s'.", prop->name);
-        return -2;
+static int config_get_int(const char *name, int def)
+{
+        return def;
+}
+
+static const char *config_get_string(const char *name, const char *def)
+{
+        return def;
 }
 #endif
 
 int is_read_only(void)
 {
-        static LibvirtcimConfigProperty prop = {
-                                       "readonly", CONFIG_BOOL, {0}, 0};
-        libvirt_cim_config_get(&prop);
-        return prop.value_bool;
+        return config_get_bool("readonly", false);
 }
 
 bool get_disable_kvm(void)
 {
-        static LibvirtcimConfigProperty prop = {
-                                       "disable_kvm", CONFIG_BOOL, {0}, 0};
-        libvirt_cim_config_get(&prop);
-        return prop.value_bool;
+        return config_get_bool("disable_kvm", false);
 }
 
 const char *get_mig_ssh_tmp_key(void)
 {
-        static LibvirtcimConfigProperty prop = {
-                          "migrate_ssh_temp_key", CONFIG_STRING, {0}, 0};
-
-        libvirt_cim_config_get(&prop);
-        return prop.value_string;
+        return config_get_string("migrate_ssh_temp_key", NULL);
 }
 
 const char *get_lldptool_query_options(void)
 {
-        static LibvirtcimConfigProperty prop = {
-                          "lldptool_query_options", CONFIG_STRING, {0}, 0};
-
-        libvirt_cim_config_get(&prop);
-        return prop.value_string;
+        return config_get_string("lldptool_query_options", NULL);
 }
 
 const char *get_vsi_support_key_string(void)
 {
-        static LibvirtcimConfigProperty prop = {
-                          "vsi_support_key_string", CONFIG_STRING, {0}, 0};;
+        return config_get_string("vsi_support_key_string", NULL);
+}
+
+int get_vsi_cache_ttl(void)
+{
+        return config_get_int("vsi_cache_ttl", 60);
+}
+
+int get_csi_coalesce_ms(void)
+{
+        return config_get_int("csi_coalesce_ms", 100);
+}
+
+const char *get_stats_file(void)
+{
+        return config_get_string("stats_file", NULL);
+}
+
+int get_stats_interval(void)
+{
+        return config_get_int("stats_interval", 60);
+}
+
+int get_snapshot_workers(void)
+{
+        return config_get_int("snapshot_workers", 2);
+}
+
+int get_host_refresh_interval(void)
+{
+        return config_get_int("host_refresh_interval", 300);
+}
+
+int get_batch_workers(void)
+{
+        return config_get_int("batch_workers", 4);
+}
+
+bool get_rasd_indication_aggregate(void)
+{
+        return config_get_bool("rasd_indication_aggregate", false);
+}
+
+int get_indication_queue_size(void)
+{
+        return config_get_int("indication_queue_size", 256);
+}
 
-        libvirt_cim_config_get(&prop);
-        return prop.value_string;
+const char *get_indication_queue_policy(void)
+{
+        return config_get_string("indication_queue_policy", NULL);
 }
 
 virConnectPtr connect_by_classname(const CMPIBroker *broker,
@@ -302,6 +398,8 @@ virConnectPtr connect_by_classname(const CMPIBroker *broker,
                 return NULL;
         }
 
+        conn_info_register(conn);
+
         return conn;
 }
 
@@ -412,29 +510,191 @@ uint64_t allocated_memory(virConnectPtr conn)
         return memory;
 }
 
-const char *pfx_from_conn(virConnectPtr conn)
+/* Hypervisor details shared by every connection to the same URI.  These
+ * are never freed, so strings handed out from them stay valid.
+ */
+struct conn_meta {
+        char *uri;
+        const char *pfx;
+        char *type;
+        int max_vcpus;
+        bool have_node;
+        virNodeInfo node;
+        struct conn_meta *next;
+};
+
+/* Direct-mapped connection -> metadata cache.  libvirt gives us no way
+ * to hang data off a connection or to hear about it closing, so every
+ * connection the providers open goes through conn_info_register(),
+ * which replaces whatever was cached for an earlier connection at the
+ * same address.
+ */
+#define CONN_SLOTS 64
+
+struct conn_slot {
+        virConnectPtr conn;
+        struct conn_meta *meta;
+};
+
+static pthread_mutex_t conn_meta_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct conn_meta *conn_metas = NULL;
+static struct conn_slot conn_slots[CONN_SLOTS];
+
+static struct conn_slot *conn_slot(virConnectPtr conn)
 {
+        uintptr_t key = (uintptr_t)conn;
+
+        return &conn_slots[(key >> 4) % CONN_SLOTS];
+}
+
+/* Call with conn_meta_lock held */
+static struct conn_meta *conn_meta_register(virConnectPtr conn)
+{
+        struct conn_meta *meta;
         char *uri;
-        const char *pfx = "Xen";
 
         uri = virConnectGetURI(conn);
         if (uri == NULL)
-                return pfx; /* Default/Error case */
+                return NULL;
+
+        for (meta = conn_metas; meta != NULL; meta = meta->next) {
+                if (STREQ(meta->uri, uri))
+                        break;
+        }
+
+        if (meta == NULL) {
+                meta = calloc(1, sizeof(*meta));
+                if (meta == NULL) {
+                        free(uri);
+                        return NULL;
+                }
+
+                CU_DEBUG("URI of connection is: %s", uri);
+
+                if (STARTS_WITH(uri, "qemu"))
+                        meta->pfx = "KVM";
+                else if (STARTS_WITH(uri, "lxc"))
+                        meta->pfx = "LXC";
+                else
+                        meta->pfx = "Xen";
+
+                meta->uri = uri;
+                meta->next = conn_metas;
+                conn_metas = meta;
+        } else
+                free(uri);
+
+        conn_slot(conn)->conn = conn;
+        conn_slot(conn)->meta = meta;
+
+        return meta;
+}
+
+/* Call with conn_meta_lock held */
+static struct conn_meta *conn_meta(virConnectPtr conn)
+{
+        struct conn_slot *slot = conn_slot(conn);
+
+        if (slot->conn == conn)
+                return slot->meta;
+
+        return conn_meta_register(conn);
+}
 
-        CU_DEBUG("URI of connection is: %s", uri);
+void conn_info_register(virConnectPtr conn)
+{
+        if (conn == NULL)
+                return;
+
+        pthread_mutex_lock(&conn_meta_lock);
+        conn_meta_register(conn);
+        pthread_mutex_unlock(&conn_meta_lock);
+}
 
-        if (STARTS_WITH(uri, "xen"))
-                pfx = "Xen";
-        else if (STARTS_WITH(uri, "qemu"))
-                pfx = "KVM";
-        else if (STARTS_WITH(uri, "lxc"))
-                pfx = "LXC";
+const char *pfx_from_conn(virConnectPtr conn)
+{
+        struct conn_meta *meta;
+        const char *pfx = "Xen"; /* Default/Error case */
 
-        free(uri);
+        pthread_mutex_lock(&conn_meta_lock);
+        meta = conn_meta(conn);
+        if (meta != NULL)
+                pfx = meta->pfx;
+        pthread_mutex_unlock(&conn_meta_lock);
 
         return pfx;
 }
 
+const char *type_from_conn(virConnectPtr conn)
+{
+        struct conn_meta *meta;
+        const char *type;
+
+        pthread_mutex_lock(&conn_meta_lock);
+        meta = conn_meta(conn);
+        if ((meta != NULL) && (meta->type != NULL)) {
+                type = meta->type;
+                goto out;
+        }
+
+        type = virConnectGetType(conn);
+        if ((meta != NULL) && (type != NULL)) {
+                meta->type = strdup(type);
+                if (meta->type != NULL)
+                        type = meta->type;
+        }
+ out:
+        pthread_mutex_unlock(&conn_meta_lock);
+
+        return type;
+}
+
+int max_vcpus_from_conn(virConnectPtr conn)
+{
+        struct conn_meta *meta;
+        const char *type;
+        int max;
+
+        pthread_mutex_lock(&conn_meta_lock);
+        meta = conn_meta(conn);
+        if ((meta != NULL) && (meta->max_vcpus > 0)) {
+                max = meta->max_vcpus;
+                goto out;
+        }
+
+        type = virConnectGetType(conn);
+        max = virConnectGetMaxVcpus(conn, type);
+        if ((meta != NULL) && (max > 0))
+                meta->max_vcpus = max;
+ out:
+        pthread_mutex_unlock(&conn_meta_lock);
+
+        return max;
+}
+
+int node_info_from_conn(virConnectPtr conn, virNodeInfoPtr info)
+{
+        struct conn_meta *meta;
+        int ret = 0;
+
+        pthread_mutex_lock(&conn_meta_lock);
+        meta = conn_meta(conn);
+        if ((meta != NULL) && meta->have_node) {
+                *info = meta->node;
+                goto out;
+        }
+
+        ret = virNodeGetInfo(conn, info);
+        if ((meta != NULL) && (ret == 0)) {
+                meta->node = *info;
+                meta->have_node = true;
+        }
+ out:
+        pthread_mutex_unlock(&conn_meta_lock);
+
+        return ret;
+}
+
 char *get_typed_class(const char *refcn, const char *new_base)
 {
         char *class = NULL;
@@ -515,8 +775,10 @@ virConnectPtr lv_connect(const CMPIBroker *broker, CMPIStatus *s)
                 cu_statusf(broker, s,
                            CMPI_RC_ERR_FAILED,
                            "Unable to connect to xen");
-        else
+        else {
+                conn_info_register(conn);
                 CMSetStatus(s, CMPI_RC_OK);
+        }
 
         return conn;
 }
@@ -625,18 +887,18 @@ bool domain_online(virDomainPtr dom)
         if (conn == NULL) {
                 CU_DEBUG("Unknown connection type, assuming RUNNING,BLOCKED");
                 compare_flags = 2;
-        } else if (STREQC(virConnectGetType(conn), "Xen")) {
+        } else if (STREQC(type_from_conn(conn), "Xen")) {
                 CU_DEBUG("Type is Xen");
                 compare_flags = 3;
-        } else if (STREQC(virConnectGetType(conn), "QEMU")) {
+        } else if (STREQC(type_from_conn(conn), "QEMU")) {
                 CU_DEBUG("Type is KVM");
                 compare_flags = 2;
-        } else if (STREQC(virConnectGetType(conn), "LXC")) {
+        } else if (STREQC(type_from_conn(conn), "LXC")) {
                 CU_DEBUG("Type is LXC");
                 compare_flags = 2;
         } else {
                 CU_DEBUG("Unknown type `%s', assuming RUNNING,BLOCKED",
-                         virConnectGetType(conn));
+                         type_from_conn(conn));
                 compare_flags = 2;
         }
 
@@ -807,7 +1069,7 @@ int domain_vcpu_count(virDomainPtr dom)
                 return -1;
         }
 
-        max = virConnectGetMaxVcpus(conn, virConnectGetType(conn));
+        max = max_vcpus_from_conn(conn);
         if (max <= 0) {
                 CU_DEBUG("Failed to get max vcpu count");
                 return -1;
@@ -900,6 +1162,83 @@ int virt_set_status(const CMPIBroker *broker,
         return ret;
 }
 
+bool property_requested(const char **properties, ...)
+{
+        va_list ap;
+        const char *name;
+        bool found = false;
+        int i;
+
+        if (properties == NULL)
+                return true;
+
+        va_start(ap, properties);
+
+        while (!found && ((name = va_arg(ap, const char *)) != NULL)) {
+                for (i = 0; properties[i] != NULL; i++) {
+                        if (STREQC(properties[i], name)) {
+                                found = true;
+                                break;
+                        }
+                }
+        }
+
+        va_end(ap);
+
+        return found;
+}
+
+CMPIStatus inst_list_handler(CMPIInstance *inst, void *data)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+
+        inst_list_add((struct inst_list *)data, inst);
+
+        return s;
+}
+
+CMPIStatus inst_result_handler(CMPIInstance *inst, void *data)
+{
+        struct inst_result *res = data;
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIObjectPath *op;
+
+        if (res->names_only) {
+                op = CMGetObjectPath(inst, &s);
+                if ((op == NULL) || (s.rc != CMPI_RC_OK)) {
+                        cu_statusf(res->broker, &s,
+                                   CMPI_RC_ERR_FAILED,
+                                   "Unable to get instance path");
+                        return s;
+                }
+
+                CMReturnObjectPath(res->results, op);
+        } else {
+                CMReturnInstance(res->results, inst);
+        }
+
+        /* The CIMOM has its own copy now */
+        CMRelease(inst);
+
+        return s;
+}
+
+CMPIStatus inst_list_emit(struct inst_list *list,
+                          inst_handler_t handler,
+                          void *data)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        int i;
+
+        for (i = 0; i < list->cur; i++) {
+                s = handler(list->list[i], data);
+                if (s.rc != CMPI_RC_OK)
+                        break;
+        }
+
+        return s;
+}
+
 
 /*
  * Local Variables:
@@ -34,6 +34,8 @@
 #include <libcmpiutil/libcmpiutil.h>
 #include <libcmpiutil/std_association.h>
 
+#include "stats.h"
+
 #undef CMSetObjectPath
 #define CMSetObjectPath(i,p) do { \
         if (i->ft->setObjectPath != NULL)  \
@@ -77,9 +79,24 @@ void free_domain_list(virDomainPtr *list, int count);
 char *class_prefix_name(const char *classname);
 char *class_base_name(const char *classname);
 
+/* Hypervisor details of a connection, looked up once per URI and
+ * cached.  Connections opened other than by connect_by_classname() or
+ * lv_connect() must be passed to conn_info_register() before use.
+ */
+void conn_info_register(virConnectPtr conn);
+
 /* Returns a class prefix based on the URI reported by conn */
 const char *pfx_from_conn(virConnectPtr conn);
 
+/* Returns the hypervisor type, as virConnectGetType() */
+const char *type_from_conn(virConnectPtr conn);
+
+/* Returns the host's maximum VCPUs per guest, or -1 on error */
+int max_vcpus_from_conn(virConnectPtr conn);
+
+/* Fills info with the host's node info, as virNodeGetInfo() */
+int node_info_from_conn(virConnectPtr conn, virNodeInfoPtr info);
+
 /* Returns "%s_%s" % (prefix($refcn), new_base) */
 char *get_typed_class(const char *refcn, const char *new_base);
 CMPIInstance *get_typed_instance(const CMPIBroker *broker,
@@ -111,6 +128,36 @@ bool libvirt_cim_init(void);
                 return (CMPIStatus){CMPI_RC_OK, NULL}; \
         }
 
+/* True if any of the NULL terminated property names is in the property
+ * list of the request.  A NULL list asks for every property, so
+ * builders can skip the lookups behind properties nobody asked for.
+ */
+bool property_requested(const char **properties, ...)
+        __attribute__((sentinel));
+
+/*
+ * Streamed enumeration.  Enumeration functions taking an inst_handler_t
+ * hand each instance to it as soon as it is built instead of keeping
+ * the whole result set.  inst_result_handler() returns the instance to
+ * the CIMOM and releases it, inst_list_handler() collects it into the
+ * struct inst_list passed as data.
+ */
+typedef CMPIStatus (*inst_handler_t)(CMPIInstance *inst, void *data);
+
+struct inst_result {
+        const CMPIBroker *broker;
+        const CMPIResult *results;
+        bool names_only;
+};
+
+CMPIStatus inst_result_handler(CMPIInstance *inst, void *data);
+CMPIStatus inst_list_handler(CMPIInstance *inst, void *data);
+
+/* Hands every instance of list to handler */
+CMPIStatus inst_list_emit(struct inst_list *list,
+                          inst_handler_t handler,
+                          void *data);
+
 #endif
 
 bool match_hypervisor_prefix(const CMPIObjectPath *reference,
@@ -152,12 +199,28 @@ int virt_set_status(const CMPIBroker *broker,
 
 #define REF2STR(r) CMGetCharPtr(CMObjectPathToString(r, NULL))
 
-/* get libvirt-cim config */
+/*
+ * get libvirt-cim config
+ *
+ * The config file is parsed once and reparsed when it changes, so each
+ * call returns the current setting.  Strings returned stay valid for
+ * the life of the process.
+ */
 int is_read_only(void);
 const char *get_mig_ssh_tmp_key(void);
 bool get_disable_kvm(void);
 const char *get_lldptool_query_options(void);
 const char *get_vsi_support_key_string(void);
+int get_vsi_cache_ttl(void);
+int get_csi_coalesce_ms(void);
+const char *get_stats_file(void);
+int get_stats_interval(void);
+int get_snapshot_workers(void);
+int get_host_refresh_interval(void);
+int get_batch_workers(void);
+bool get_rasd_indication_aggregate(void);
+int get_indication_queue_size(void);
+const char *get_indication_queue_policy(void);
 
 /*
  * Local Variables:
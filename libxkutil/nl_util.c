@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+#include <libcmpiutil/libcmpiutil.h>
+
+#include "nl_util.h"
+
+#define NL_RECV_SIZE 32768
+
+int nl_open(struct nl_sock *sock, uint32_t groups)
+{
+        struct sockaddr_nl addr;
+
+        sock->seq = 0;
+        sock->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+        if (sock->fd < 0) {
+                CU_DEBUG("Unable to open rtnetlink socket: %s",
+                         strerror(errno));
+                return -1;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+        addr.nl_groups = groups;
+
+        if (bind(sock->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                CU_DEBUG("Unable to bind rtnetlink socket: %s",
+                         strerror(errno));
+                close(sock->fd);
+                sock->fd = -1;
+                return -1;
+        }
+
+        return 0;
+}
+
+void nl_close(struct nl_sock *sock)
+{
+        if (sock->fd >= 0)
+                close(sock->fd);
+
+        sock->fd = -1;
+}
+
+int nl_send(struct nl_sock *sock, struct nlmsghdr *n)
+{
+        struct sockaddr_nl addr;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.nl_family = AF_NETLINK;
+
+        n->nlmsg_seq = ++sock->seq;
+
+        if (sendto(sock->fd, n, n->nlmsg_len, 0,
+                   (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                CU_DEBUG("Unable to send netlink request: %s",
+                         strerror(errno));
+                return -1;
+        }
+
+        return 0;
+}
+
+int nl_recv(struct nl_sock *sock, nl_msg_t handler, void *data)
+{
+        struct nlmsghdr *n;
+        struct nlmsgerr *err;
+        char *buf;
+        int len;
+        int ret = -1;
+
+        buf = malloc(NL_RECV_SIZE);
+        if (buf == NULL)
+                return -1;
+
+        while (1) {
+                len = recv(sock->fd, buf, NL_RECV_SIZE, 0);
+                if (len < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        goto out;
+                } else if (len == 0) {
+                        errno = ECONNRESET;
+                        goto out;
+                }
+
+                for (n = (struct nlmsghdr *)buf;
+                     NLMSG_OK(n, len);
+                     n = NLMSG_NEXT(n, len)) {
+                        if (n->nlmsg_seq != sock->seq)
+                                continue;
+
+                        if (n->nlmsg_type == NLMSG_DONE) {
+                                ret = 0;
+                                goto out;
+                        } else if (n->nlmsg_type == NLMSG_ERROR) {
+                                err = NLMSG_DATA(n);
+                                if (err->error == 0)
+                                        ret = 0;
+                                else
+                                        errno = -err->error;
+                                goto out;
+                        }
+
+                        if ((handler != NULL) && (handler(n, data) != 0))
+                                goto out;
+                }
+        }
+
+ out:
+        free(buf);
+
+        return ret;
+}
+
+int nl_talk(struct nl_sock *sock, struct nlmsghdr *n)
+{
+        n->nlmsg_flags |= NLM_F_ACK;
+
+        if (nl_send(sock, n) < 0)
+                return -1;
+
+        return nl_recv(sock, NULL, NULL);
+}
+
+struct rtattr *nl_attr(struct nlmsghdr *n,
+                       size_t size,
+                       int type,
+                       const void *data,
+                       size_t len)
+{
+        struct rtattr *rta;
+        size_t rta_len = RTA_LENGTH(len);
+
+        if (NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(rta_len) > size) {
+                CU_DEBUG("Netlink request too long");
+                return NULL;
+        }
+
+        rta = (struct rtattr *)((char *)n + NLMSG_ALIGN(n->nlmsg_len));
+        rta->rta_type = type;
+        rta->rta_len = rta_len;
+        if (data != NULL)
+                memcpy(RTA_DATA(rta), data, len);
+
+        n->nlmsg_len = NLMSG_ALIGN(n->nlmsg_len) + RTA_ALIGN(rta_len);
+
+        return rta;
+}
+
+void nl_nest_end(struct nlmsghdr *n, struct rtattr *nest)
+{
+        nest->rta_len = (char *)n + n->nlmsg_len - (char *)nest;
+}
+
+void nl_parse(struct rtattr **tb, int max, struct rtattr *rta, int len)
+{
+        memset(tb, 0, sizeof(*tb) * (max + 1));
+
+        for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+                if (rta->rta_type <= max)
+                        tb[rta->rta_type] = rta;
+}
+
+struct nl_link_dump {
+        struct nl_link *links;
+        int count;
+};
+
+static int nl_link_msg(struct nlmsghdr *n, void *data)
+{
+        struct nl_link_dump *dump = data;
+        struct ifinfomsg *ifi = NLMSG_DATA(n);
+        struct rtattr *tb[IFLA_MAX + 1];
+        struct rtattr *info[IFLA_INFO_MAX + 1];
+        struct nl_link *tmp;
+        struct nl_link *link;
+        size_t len;
+
+        if ((n->nlmsg_type != RTM_NEWLINK) ||
+            (n->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi))))
+                return 0;
+
+        nl_parse(tb, IFLA_MAX, IFLA_RTA(ifi), IFLA_PAYLOAD(n));
+        if (tb[IFLA_IFNAME] == NULL)
+                return 0;
+
+        tmp = realloc(dump->links, (dump->count + 1) * sizeof(*dump->links));
+        if (tmp == NULL) {
+                errno = ENOMEM;
+                return -1;
+        }
+
+        dump->links = tmp;
+        link = &dump->links[dump->count++];
+        memset(link, 0, sizeof(*link));
+
+        link->ifindex = ifi->ifi_index;
+        link->type = ifi->ifi_type;
+
+        len = RTA_PAYLOAD(tb[IFLA_IFNAME]);
+        if (len > sizeof(link->name) - 1)
+                len = sizeof(link->name) - 1;
+        strncpy(link->name, RTA_DATA(tb[IFLA_IFNAME]), len);
+
+        if ((tb[IFLA_MASTER] != NULL) &&
+            (RTA_PAYLOAD(tb[IFLA_MASTER]) >= sizeof(uint32_t)))
+                memcpy(&link->master, RTA_DATA(tb[IFLA_MASTER]),
+                       sizeof(uint32_t));
+
+        if (tb[IFLA_LINKINFO] == NULL)
+                return 0;
+
+        nl_parse(info, IFLA_INFO_MAX,
+                 RTA_DATA(tb[IFLA_LINKINFO]), RTA_PAYLOAD(tb[IFLA_LINKINFO]));
+        if (info[IFLA_INFO_KIND] != NULL) {
+                len = RTA_PAYLOAD(info[IFLA_INFO_KIND]);
+                if (len > sizeof(link->kind) - 1)
+                        len = sizeof(link->kind) - 1;
+                strncpy(link->kind, RTA_DATA(info[IFLA_INFO_KIND]), len);
+        }
+
+        return 0;
+}
+
+int nl_link_list(struct nl_link **links)
+{
+        struct {
+                struct nlmsghdr n;
+                struct ifinfomsg ifi;
+        } req;
+        struct nl_sock sock;
+        struct nl_link_dump dump = {NULL, 0};
+        int ret = -1;
+
+        *links = NULL;
+
+        if (nl_open(&sock, 0) < 0)
+                return -1;
+
+        memset(&req, 0, sizeof(req));
+        req.n.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifi));
+        req.n.nlmsg_type = RTM_GETLINK;
+        req.n.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+        req.ifi.ifi_family = AF_UNSPEC;
+
+        if ((nl_send(&sock, &req.n) < 0) ||
+            (nl_recv(&sock, nl_link_msg, &dump) < 0)) {
+                CU_DEBUG("Unable to list links: %s", strerror(errno));
+                free(dump.links);
+                goto out;
+        }
+
+        *links = dump.links;
+        ret = dump.count;
+ out:
+        nl_close(&sock);
+
+        return ret;
+}
+
+bool nl_links_changed(struct nl_watch *watch)
+{
+        char buf[4096];
+        bool changed = false;
+        int len;
+
+        if (!watch->open) {
+                if (nl_open(&watch->sock, RTMGRP_LINK) < 0)
+                        return true;
+
+                watch->open = true;
+
+                return true;
+        }
+
+        while (1) {
+                len = recv(watch->sock.fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (len > 0) {
+                        changed = true;
+                        continue;
+                }
+
+                if ((len < 0) && (errno == EINTR))
+                        continue;
+
+                /* Some notifications were lost, which is a change too */
+                if ((len < 0) && (errno == ENOBUFS)) {
+                        changed = true;
+                        continue;
+                }
+
+                if ((len < 0) && ((errno == EAGAIN) ||
+                                  (errno == EWOULDBLOCK)))
+                        break;
+
+                /* The socket broke, start over with a new one */
+                CU_DEBUG("Link watch reset: %s",
+                         len < 0 ? strerror(errno) : "closed");
+                nl_close(&watch->sock);
+                watch->open = false;
+
+                return true;
+        }
+
+        if (changed)
+                CU_DEBUG("Links changed");
+
+        return changed;
+}
+
+void nl_watch_close(struct nl_watch *watch)
+{
+        if (!watch->open)
+                return;
+
+        nl_close(&watch->sock);
+        watch->open = false;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
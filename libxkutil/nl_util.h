@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef __NL_UTIL_H
+#define __NL_UTIL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <net/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+/*
+ * Minimal rtnetlink client shared by the host network code.  Requests
+ * are built in a caller supplied buffer that starts with the netlink
+ * header; the functions return 0 on success, or -1 with errno set.
+ */
+struct nl_sock {
+        int fd;
+        uint32_t seq;
+};
+
+typedef int (*nl_msg_t)(struct nlmsghdr *n, void *data);
+
+/* Opens a route socket, subscribed to the RTMGRP_* bits in groups */
+int nl_open(struct nl_sock *sock, uint32_t groups);
+void nl_close(struct nl_sock *sock);
+
+int nl_send(struct nl_sock *sock, struct nlmsghdr *n);
+
+/* Reads the replies to the last request until the dump is done or the
+ * request is acknowledged, handing every other message to handler.  A
+ * non-zero return from handler stops the read.
+ */
+int nl_recv(struct nl_sock *sock, nl_msg_t handler, void *data);
+
+/* Sends a request and waits for its acknowledgement */
+int nl_talk(struct nl_sock *sock, struct nlmsghdr *n);
+
+/* Appends an attribute to n, whose buffer holds size bytes.  A NULL
+ * data starts a nested attribute, closed with nl_nest_end().
+ */
+struct rtattr *nl_attr(struct nlmsghdr *n,
+                       size_t size,
+                       int type,
+                       const void *data,
+                       size_t len);
+void nl_nest_end(struct nlmsghdr *n, struct rtattr *nest);
+
+void nl_parse(struct rtattr **tb, int max, struct rtattr *rta, int len);
+
+/* The network links of the host, in ifindex order */
+struct nl_link {
+        int ifindex;
+        int master;
+        unsigned short type;
+        char name[IFNAMSIZ];
+        char kind[16];
+};
+
+/* Sets *links to the links of the host and returns how many there are,
+ * or -1 on error.  kind is the IFLA_INFO_KIND of the link, e.g.
+ * "bridge", and empty for physical devices; master is the ifindex of
+ * the bridge or bond the link is enslaved to.
+ */
+int nl_link_list(struct nl_link **links);
+
+/*
+ * Tells when the links of the host change, for callers that cache what
+ * they learned from them.  The watch listens to link notifications and
+ * is only read when asked, so no thread is involved.
+ */
+struct nl_watch {
+        struct nl_sock sock;
+        bool open;
+};
+
+#define NL_WATCH_INITIALIZER {{-1, 0}, false}
+
+/* True if a link was added, removed or changed since the last call, or
+ * if the watch cannot tell, as on the first call.
+ */
+bool nl_links_changed(struct nl_watch *watch);
+
+void nl_watch_close(struct nl_watch *watch);
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,733 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include <cmpidt.h>
+#include <cmpift.h>
+
+#include <libcmpiutil/libcmpiutil.h>
+
+#include "misc_util.h"
+#include "stats.h"
+
+/* Bucket 0 counts calls under 1us, bucket N those under 2^N us */
+#define STATS_BUCKETS 24
+
+#define STATS_DEFAULT_INTERVAL 60
+
+struct stats_entry {
+        char *provider;
+        char *op;
+        uint64_t count;
+        uint64_t total_ns;
+        uint64_t max_ns;
+        uint64_t buckets[STATS_BUCKETS];
+        struct stats_entry *next;
+};
+
+/*
+ * A provider's MI, handed to the CIMOM in place of the real one.  It
+ * points into the provider's module, so it is dropped when the
+ * provider is cleaned up.
+ */
+struct stats_mi {
+        union {
+                CMPIInstanceMI inst;
+                CMPIAssociationMI assoc;
+                CMPIMethodMI meth;
+        } mi;
+        union {
+                CMPIInstanceMIFT inst;
+                CMPIAssociationMIFT assoc;
+                CMPIMethodMIFT meth;
+        } ft;
+        void *real;
+        const char *provider;
+        struct stats_mi *next;
+};
+
+int stats_enabled = 0;
+uint64_t stats_lv_calls[STATS_LV_MAX];
+
+#define STATS_LV_NAME(name) #name,
+static const char *lv_call_names[STATS_LV_MAX] = {
+        STATS_LV_CALLS(STATS_LV_NAME)
+};
+#undef STATS_LV_NAME
+
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct stats_entry *entries = NULL;
+static struct stats_mi *wrapped = NULL;
+static char *stats_path = NULL;
+static int stats_interval = STATS_DEFAULT_INTERVAL;
+
+/*
+ * The writer runs while at least one wrapped provider is loaded.
+ * writer_ctl serializes starting and stopping it; writer_lock guards
+ * writer_stop, which the writer waits on between writes.
+ */
+static pthread_mutex_t writer_ctl = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static bool writer_running = false;
+static bool writer_stop = false;
+static pthread_t writer;
+
+uint64_t stats_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+static int bucket_of(uint64_t ns)
+{
+        uint64_t us = ns / 1000;
+        int i = 0;
+
+        while ((us != 0) && (i < STATS_BUCKETS - 1)) {
+                us >>= 1;
+                i++;
+        }
+
+        return i;
+}
+
+/* Must be called with stats_mutex held */
+static struct stats_entry *get_entry(const char *provider, const char *op)
+{
+        struct stats_entry *e;
+
+        for (e = entries; e != NULL; e = e->next) {
+                if (STREQ(e->provider, provider) && STREQ(e->op, op))
+                        return e;
+        }
+
+        e = calloc(1, sizeof(*e));
+        if (e == NULL)
+                return NULL;
+
+        /* Both names may live in a provider that is unloaded later */
+        e->provider = strdup(provider);
+        e->op = strdup(op);
+        if ((e->provider == NULL) || (e->op == NULL)) {
+                free(e->provider);
+                free(e->op);
+                free(e);
+                return NULL;
+        }
+
+        e->next = entries;
+        entries = e;
+
+        return e;
+}
+
+void stats_record(const char *provider, const char *op, uint64_t start)
+{
+        struct stats_entry *e;
+        uint64_t ns;
+
+        if (!stats_enabled)
+                return;
+
+        ns = stats_now() - start;
+
+        pthread_mutex_lock(&stats_mutex);
+
+        e = get_entry(provider, op);
+        if (e != NULL) {
+                e->count++;
+                e->total_ns += ns;
+                if (ns > e->max_ns)
+                        e->max_ns = ns;
+                e->buckets[bucket_of(ns)]++;
+        }
+
+        pthread_mutex_unlock(&stats_mutex);
+}
+
+/* Upper bound, in us, of the bucket holding the pct-th percentile */
+static uint64_t percentile(struct stats_entry *e, int pct)
+{
+        uint64_t want = ((e->count * pct) + 99) / 100;
+        uint64_t seen = 0;
+        int i;
+
+        for (i = 0; i < STATS_BUCKETS; i++) {
+                seen += e->buckets[i];
+                if (seen >= want)
+                        break;
+        }
+
+        return 1ULL << (i < STATS_BUCKETS ? i : STATS_BUCKETS - 1);
+}
+
+static void write_entry(FILE *f, struct stats_entry *e)
+{
+        fprintf(f, "%s %s %llu %llu %llu %llu %llu %llu\n",
+                e->provider,
+                e->op,
+                (unsigned long long)e->count,
+                (unsigned long long)(e->total_ns / 1000),
+                (unsigned long long)(e->max_ns / 1000),
+                (unsigned long long)percentile(e, 50),
+                (unsigned long long)percentile(e, 90),
+                (unsigned long long)percentile(e, 99));
+}
+
+static void write_histogram(FILE *f, struct stats_entry *e)
+{
+        int last;
+        int i;
+
+        for (last = STATS_BUCKETS - 1; last > 0; last--) {
+                if (e->buckets[last] != 0)
+                        break;
+        }
+
+        fprintf(f, "%s %s", e->provider, e->op);
+        for (i = 0; i <= last; i++)
+                fprintf(f, " %llu", (unsigned long long)e->buckets[i]);
+        fprintf(f, "\n");
+}
+
+int stats_write(void)
+{
+        struct stats_entry *snapshot = NULL;
+        struct stats_entry *e;
+        unsigned int count = 0;
+        unsigned int i;
+        char *tmp = NULL;
+        FILE *f = NULL;
+        int ret = 0;
+
+        if (!stats_enabled)
+                return 0;
+
+        pthread_mutex_lock(&stats_mutex);
+
+        for (e = entries; e != NULL; e = e->next)
+                count++;
+
+        snapshot = calloc(count + 1, sizeof(*snapshot));
+        if (snapshot != NULL) {
+                for (e = entries, i = 0; e != NULL; e = e->next, i++)
+                        snapshot[i] = *e;
+        }
+
+        pthread_mutex_unlock(&stats_mutex);
+
+        if (snapshot == NULL)
+                goto out;
+
+        if (asprintf(&tmp, "%s.tmp", stats_path) == -1) {
+                tmp = NULL;
+                goto out;
+        }
+
+        f = fopen(tmp, "w");
+        if (f == NULL) {
+                CU_DEBUG("Unable to open %s", tmp);
+                goto out;
+        }
+
+        fprintf(f, "# libvirt-cim provider statistics, pid %i, time %lld\n",
+                getpid(),
+                (long long)time(NULL));
+
+        fprintf(f, "# provider operation calls total_us max_us "
+                "p50_us p90_us p99_us\n");
+        for (i = 0; i < count; i++)
+                write_entry(f, &snapshot[i]);
+
+        fprintf(f, "# provider operation histogram: calls under "
+                "1us, 2us, 4us, ...\n");
+        for (i = 0; i < count; i++)
+                write_histogram(f, &snapshot[i]);
+
+        fprintf(f, "# libvirt function calls\n");
+        for (i = 0; i < STATS_LV_MAX; i++)
+                fprintf(f, "%s %llu\n",
+                        lv_call_names[i],
+                        (unsigned long long)
+                        __sync_fetch_and_add(&stats_lv_calls[i], 0));
+
+        if (fclose(f) != 0) {
+                f = NULL;
+                goto out;
+        }
+        f = NULL;
+
+        if (rename(tmp, stats_path) != 0) {
+                CU_DEBUG("Unable to rename %s to %s", tmp, stats_path);
+                goto out;
+        }
+
+        ret = 1;
+ out:
+        if (f != NULL)
+                fclose(f);
+        free(snapshot);
+        free(tmp);
+
+        return ret;
+}
+
+static void *stats_writer(void *data)
+{
+        struct timespec deadline;
+        int ret;
+
+        pthread_mutex_lock(&writer_lock);
+
+        while (!writer_stop) {
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += stats_interval;
+
+                ret = 0;
+                while (!writer_stop && (ret != ETIMEDOUT))
+                        ret = pthread_cond_timedwait(&writer_cond,
+                                                     &writer_lock,
+                                                     &deadline);
+
+                if (writer_stop)
+                        break;
+
+                pthread_mutex_unlock(&writer_lock);
+
+                stats_write();
+
+                /* Follow changes to the config file */
+                if (get_stats_interval() > 0)
+                        stats_interval = get_stats_interval();
+
+                pthread_mutex_lock(&writer_lock);
+        }
+
+        pthread_mutex_unlock(&writer_lock);
+
+        /* Keep what was gathered since the last interval */
+        stats_write();
+
+        return NULL;
+}
+
+static void writer_start(void)
+{
+        pthread_mutex_lock(&writer_ctl);
+
+        if (writer_running)
+                goto out;
+
+        writer_stop = false;
+
+        if (pthread_create(&writer, NULL, stats_writer, NULL) != 0) {
+                CU_DEBUG("Unable to start the statistics writer");
+                goto out;
+        }
+
+        CU_DEBUG("Writing statistics to %s every %is",
+                 stats_path, stats_interval);
+        writer_running = true;
+ out:
+        pthread_mutex_unlock(&writer_ctl);
+}
+
+/* Called when the last wrapped provider is cleaned up, as the module
+ * holding the writer may be unloaded with it.
+ */
+static void writer_join(void)
+{
+        pthread_mutex_lock(&writer_ctl);
+
+        if (!writer_running)
+                goto out;
+
+        pthread_mutex_lock(&writer_lock);
+        writer_stop = true;
+        pthread_cond_signal(&writer_cond);
+        pthread_mutex_unlock(&writer_lock);
+
+        pthread_join(writer, NULL);
+        writer_running = false;
+
+        CU_DEBUG("Statistics writer stopped");
+ out:
+        pthread_mutex_unlock(&writer_ctl);
+}
+
+static void stats_setup(void)
+{
+        const char *file;
+
+        file = get_stats_file();
+        if ((file == NULL) || (*file == '\0'))
+                return;
+
+        if (asprintf(&stats_path, "%s.%i", file, getpid()) == -1) {
+                stats_path = NULL;
+                return;
+        }
+
+        if (get_stats_interval() > 0)
+                stats_interval = get_stats_interval();
+
+        stats_enabled = 1;
+}
+
+int stats_init(void)
+{
+        pthread_once(&stats_once, stats_setup);
+
+        if (stats_enabled)
+                writer_start();
+
+        return stats_enabled;
+}
+
+static struct stats_mi *get_wrapper(const char *provider, void *real)
+{
+        struct stats_mi *smi;
+
+        pthread_mutex_lock(&stats_mutex);
+
+        for (smi = wrapped; smi != NULL; smi = smi->next) {
+                if (smi->real == real)
+                        goto out;
+        }
+
+        smi = calloc(1, sizeof(*smi));
+        if (smi == NULL)
+                goto out;
+
+        smi->real = real;
+        smi->provider = provider;
+        smi->next = wrapped;
+        wrapped = smi;
+ out:
+        pthread_mutex_unlock(&stats_mutex);
+
+        return smi;
+}
+
+static void drop_wrapper(void *self)
+{
+        struct stats_mi **prev;
+        struct stats_mi *smi;
+        bool last;
+
+        pthread_mutex_lock(&stats_mutex);
+
+        for (prev = &wrapped; *prev != NULL; prev = &(*prev)->next) {
+                smi = *prev;
+                if ((void *)&smi->mi == self) {
+                        *prev = smi->next;
+                        free(smi);
+                        break;
+                }
+        }
+
+        last = (wrapped == NULL);
+
+        pthread_mutex_unlock(&stats_mutex);
+
+        if (last)
+                writer_join();
+}
+
+#define STATS_REAL(self, type) ((type *)((struct stats_mi *)(self))->real)
+#define STATS_PROVIDER(self) (((struct stats_mi *)(self))->provider)
+
+static CMPIStatus inst_enum_names(CMPIInstanceMI *self,
+                                  const CMPIContext *context,
+                                  const CMPIResult *results,
+                                  const CMPIObjectPath *ref)
+{
+        CMPIInstanceMI *mi = STATS_REAL(self, CMPIInstanceMI);
+        uint64_t start = stats_now();
+        CMPIStatus s;
+
+        s = mi->ft->enumerateInstanceNames(mi, context, results, ref);
+        stats_record(STATS_PROVIDER(self), "EnumInstanceNames", start);
+
+        return s;
+}
+
+static CMPIStatus inst_enum(CMPIInstanceMI *self,
+                            const CMPIContext *context,
+                            const CMPIResult *results,
+                            const CMPIObjectPath *ref,
+                            const char **properties)
+{
+        CMPIInstanceMI *mi = STATS_REAL(self, CMPIInstanceMI);
+        uint64_t start = stats_now();
+        CMPIStatus s;
+
+        s = mi->ft->enumerateInstances(mi, context, results, ref,
+                                       properties);
+        stats_record(STATS_PROVIDER(self), "EnumInstances", start);
+
+        return s;
+}
+
+static CMPIStatus inst_get(CMPIInstanceMI *self,
+                           const CMPIContext *context,
+                           const CMPIResult *results,
+                           const CMPIObjectPath *ref,
+                           const char **properties)
+{
+        CMPIInstanceMI *mi = STATS_REAL(self, CMPIInstanceMI);
+        uint64_t start = stats_now();
+        CMPIStatus s;
+
+        s = mi->ft->getInstance(mi, context, results, ref, properties);
+        stats_record(STATS_PROVIDER(self), "GetInstance", start);
+
+        return s;
+}
+
+static CMPIStatus inst_cleanup(CMPIInstanceMI *self,
+                               const CMPIContext *context,
+                               CMPIBoolean terminating)
+{
+        CMPIInstanceMI *mi = STATS_REAL(self, CMPIInstanceMI);
+        CMPIStatus s;
+
+        s = mi->ft->cleanup(mi, context, terminating);
+        if (s.rc == CMPI_RC_OK)
+                drop_wrapper(self);
+
+        return s;
+}
+
+CMPIInstanceMI *stats_instance_mi(const char *provider, CMPIInstanceMI *mi)
+{
+        struct stats_mi *smi;
+
+        if ((mi == NULL) || !stats_init())
+                return mi;
+
+        smi = get_wrapper(provider, mi);
+        if (smi == NULL)
+                return mi;
+
+        smi->ft.inst = *mi->ft;
+        smi->ft.inst.enumerateInstanceNames = inst_enum_names;
+        smi->ft.inst.enumerateInstances = inst_enum;
+        smi->ft.inst.getInstance = inst_get;
+        smi->ft.inst.cleanup = inst_cleanup;
+
+        smi->mi.inst.hdl = mi->hdl;
+        smi->mi.inst.ft = &smi->ft.inst;
+
+        return &smi->mi.inst;
+}
+
+static CMPIStatus assoc_associators(CMPIAssociationMI *self,
+                                    const CMPIContext *context,
+                                    const CMPIResult *results,
+                                    const CMPIObjectPath *ref,
+                                    const char *assoc_class,
+                                    const char *result_class,
+                                    const char *role,
+                                    const char *result_role,
+                                    const char **properties)
+{
+        CMPIAssociationMI *mi = STATS_REAL(self, CMPIAssociationMI);
+        uint64_t start = stats_now();
+        CMPIStatus s;
+
+        s = mi->ft->associators(mi, context, results, ref,
+                                assoc_class, result_class,
+                                role, result_role, properties);
+        stats_record(STATS_PROVIDER(self), "Associators", start);
+
+        return s;
+}
+
+static CMPIStatus assoc_associator_names(CMPIAssociationMI *self,
+                                         const CMPIContext *context,
+                                         const CMPIResult *results,
+                                         const CMPIObjectPath *ref,
+                                         const char *assoc_class,
+                                         const char *result_class,
+                                         const char *role,
+                                         const char *result_role)
+{
+        CMPIAssociationMI *mi = STATS_REAL(self, CMPIAssociationMI);
+        uint64_t start = stats_now();
+        CMPIStatus s;
+
+        s = mi->ft->associatorNames(mi, context, results, ref,
+                                    assoc_class, result_class,
+                                    role, result_role);
+        stats_record(STATS_PROVIDER(self), "AssociatorNames", start);
+
+        return s;
+}
+
+static CMPIStatus assoc_references(CMPIAssociationMI *self,
+                                   const CMPIContext *context,
+                                   const CMPIResult *results,
+                                   const CMPIObjectPath *ref,
+                                   const char *result_class,
+                                   const char *role,
+                                   const char **properties)
+{
+        CMPIAssociationMI *mi = STATS_REAL(self, CMPIAssociationMI);
+        uint64_t start = stats_now();
+        CMPIStatus s;
+
+        s = mi->ft->references(mi, context, results, ref,
+                               result_class, role, properties);
+        stats_record(STATS_PROVIDER(self), "References", start);
+
+        return s;
+}
+
+static CMPIStatus assoc_reference_names(CMPIAssociationMI *self,
+                                        const CMPIContext *context,
+                                        const CMPIResult *results,
+                                        const CMPIObjectPath *ref,
+                                        const char *result_class,
+                                        const char *role)
+{
+        CMPIAssociationMI *mi = STATS_REAL(self, CMPIAssociationMI);
+        uint64_t start = stats_now();
+        CMPIStatus s;
+
+        s = mi->ft->referenceNames(mi, context, results, ref,
+                                   result_class, role);
+        stats_record(STATS_PROVIDER(self), "ReferenceNames", start);
+
+        return s;
+}
+
+static CMPIStatus assoc_cleanup(CMPIAssociationMI *self,
+                                const CMPIContext *context,
+                                CMPIBoolean terminating)
+{
+        CMPIAssociationMI *mi = STATS_REAL(self, CMPIAssociationMI);
+        CMPIStatus s;
+
+        s = mi->ft->cleanup(mi, context, terminating);
+        if (s.rc == CMPI_RC_OK)
+                drop_wrapper(self);
+
+        return s;
+}
+
+CMPIAssociationMI *stats_association_mi(const char *provider,
+                                        CMPIAssociationMI *mi)
+{
+        struct stats_mi *smi;
+
+        if ((mi == NULL) || !stats_init())
+                return mi;
+
+        smi = get_wrapper(provider, mi);
+        if (smi == NULL)
+                return mi;
+
+        smi->ft.assoc = *mi->ft;
+        smi->ft.assoc.associators = assoc_associators;
+        smi->ft.assoc.associatorNames = assoc_associator_names;
+        smi->ft.assoc.references = assoc_references;
+        smi->ft.assoc.referenceNames = assoc_reference_names;
+        smi->ft.assoc.cleanup = assoc_cleanup;
+
+        smi->mi.assoc.hdl = mi->hdl;
+        smi->mi.assoc.ft = &smi->ft.assoc;
+
+        return &smi->mi.assoc;
+}
+
+static CMPIStatus meth_invoke(CMPIMethodMI *self,
+                              const CMPIContext *context,
+                              const CMPIResult *results,
+                              const CMPIObjectPath *ref,
+                              const char *method,
+                              const CMPIArgs *argsin,
+                              CMPIArgs *argsout)
+{
+        CMPIMethodMI *mi = STATS_REAL(self, CMPIMethodMI);
+        uint64_t start = stats_now();
+        CMPIStatus s;
+
+        s = mi->ft->invokeMethod(mi, context, results, ref,
+                                 method, argsin, argsout);
+        stats_record(STATS_PROVIDER(self), method, start);
+
+        return s;
+}
+
+static CMPIStatus meth_cleanup(CMPIMethodMI *self,
+                               const CMPIContext *context,
+                               CMPIBoolean terminating)
+{
+        CMPIMethodMI *mi = STATS_REAL(self, CMPIMethodMI);
+        CMPIStatus s;
+
+        s = mi->ft->cleanup(mi, context, terminating);
+        if (s.rc == CMPI_RC_OK)
+                drop_wrapper(self);
+
+        return s;
+}
+
+CMPIMethodMI *stats_method_mi(const char *provider, CMPIMethodMI *mi)
+{
+        struct stats_mi *smi;
+
+        if ((mi == NULL) || !stats_init())
+                return mi;
+
+        smi = get_wrapper(provider, mi);
+        if (smi == NULL)
+                return mi;
+
+        smi->ft.meth = *mi->ft;
+        smi->ft.meth.invokeMethod = meth_invoke;
+        smi->ft.meth.cleanup = meth_cleanup;
+
+        smi->mi.meth.hdl = mi->hdl;
+        smi->mi.meth.ft = &smi->ft.meth;
+
+        return &smi->mi.meth;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
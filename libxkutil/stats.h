@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef __STATS_H
+#define __STATS_H
+
+#include <stdint.h>
+
+#include <cmpidt.h>
+#include <cmpift.h>
+
+/*
+ * Provider statistics.
+ *
+ * When "stats_file" is set in libvirt-cim.conf, every provider built
+ * with the STATS_*MIStub() macros below records a latency histogram
+ * per operation, and the libvirt calls listed in STATS_LV_CALLS are
+ * counted.  Everything is written to "<stats_file>.<pid>" every
+ * "stats_interval" seconds, and once more when the last of those
+ * providers is cleaned up.
+ *
+ * When it is not set, the stubs hand the CIMOM the provider's own
+ * function table and the libvirt counters cost a single branch.
+ */
+
+/* Returns nonzero if statistics are being collected */
+int stats_init(void);
+
+extern int stats_enabled;
+
+/* Monotonic clock, in nanoseconds */
+uint64_t stats_now(void);
+
+/* Adds one sample, taken since start, for operation op of provider */
+void stats_record(const char *provider, const char *op, uint64_t start);
+
+/* Writes the current statistics to the stats file now */
+int stats_write(void);
+
+CMPIInstanceMI *stats_instance_mi(const char *provider, CMPIInstanceMI *mi);
+CMPIAssociationMI *stats_association_mi(const char *provider,
+                                        CMPIAssociationMI *mi);
+CMPIMethodMI *stats_method_mi(const char *provider, CMPIMethodMI *mi);
+
+/*
+ * Drop-in replacements for the libcmpiutil stubs.  The libcmpiutil
+ * stub is built under "<pn>_Stats" and the real entry point wraps the
+ * function table it returns.
+ */
+#define STATS_InstanceMIStub(pfx, pn, broker, hook)                     \
+        STD_InstanceMIStub(pfx, pn##_Stats, broker, hook)               \
+        CMPIInstanceMI *pn##_Create_InstanceMI(const CMPIBroker *,      \
+                                               const CMPIContext *,     \
+                                               CMPIStatus *);           \
+        CMPIInstanceMI *pn##_Create_InstanceMI(const CMPIBroker *brkr,  \
+                                               const CMPIContext *ctx,  \
+                                               CMPIStatus *rc)          \
+        {                                                               \
+                return stats_instance_mi(#pn,                           \
+                        pn##_Stats_Create_InstanceMI(brkr, ctx, rc));   \
+        }
+
+#define STATS_AssocMIStub(pfx, pn, broker, hook, handlers)              \
+        STDA_AssocMIStub(pfx, pn##_Stats, broker, hook, handlers)       \
+        CMPIAssociationMI *pn##_Create_AssociationMI(const CMPIBroker *, \
+                                                     const CMPIContext *, \
+                                                     CMPIStatus *);     \
+        CMPIAssociationMI *pn##_Create_AssociationMI(const CMPIBroker *brkr, \
+                                                     const CMPIContext *ctx, \
+                                                     CMPIStatus *rc)    \
+        {                                                               \
+                return stats_association_mi(#pn,                        \
+                        pn##_Stats_Create_AssociationMI(brkr, ctx, rc)); \
+        }
+
+#define STATS_MethodMIStub(pfx, pn, broker, hook, handlers)             \
+        STDIM_MethodMIStub(pfx, pn##_Stats, broker, hook, handlers)     \
+        CMPIMethodMI *pn##_Create_MethodMI(const CMPIBroker *,          \
+                                           const CMPIContext *,         \
+                                           CMPIStatus *);               \
+        CMPIMethodMI *pn##_Create_MethodMI(const CMPIBroker *brkr,      \
+                                           const CMPIContext *ctx,      \
+                                           CMPIStatus *rc)              \
+        {                                                               \
+                return stats_method_mi(#pn,                             \
+                        pn##_Stats_Create_MethodMI(brkr, ctx, rc));     \
+        }
+
+/*
+ * libvirt entry points whose calls are counted.  Each maps to an RPC
+ * on a remote connection.
+ */
+#define STATS_LV_CALLS(X)                       \
+        X(virConnectOpen)                       \
+        X(virConnectOpenReadOnly)               \
+        X(virConnectGetCapabilities)            \
+        X(virConnectListAllDomains)             \
+        X(virConnectListDomains)                \
+        X(virConnectListDefinedDomains)         \
+        X(virDomainLookupByName)                \
+        X(virDomainLookupByID)                  \
+        X(virDomainLookupByUUID)                \
+        X(virDomainLookupByUUIDString)          \
+        X(virDomainGetXMLDesc)                  \
+        X(virDomainGetInfo)                     \
+        X(virDomainDefineXML)                   \
+        X(virStoragePoolLookupByName)           \
+        X(virStoragePoolGetXMLDesc)             \
+        X(virStorageVolLookupByPath)            \
+        X(virNetworkLookupByName)               \
+        X(virNetworkGetXMLDesc)
+
+#define STATS_LV_ENUM(name) STATS_LV_##name,
+enum stats_lv_call {
+        STATS_LV_CALLS(STATS_LV_ENUM)
+        STATS_LV_MAX
+};
+#undef STATS_LV_ENUM
+
+extern uint64_t stats_lv_calls[STATS_LV_MAX];
+
+static inline void stats_lv_count(enum stats_lv_call call)
+{
+        if (stats_enabled)
+                __sync_fetch_and_add(&stats_lv_calls[call], 1);
+}
+
+/*
+ * Every source that includes this header after <libvirt/libvirt.h>
+ * counts its calls: a macro is not expanded again within its own
+ * replacement, so the inner name still refers to the libvirt function.
+ */
+#define STATS_LV_CALL(name, call) (stats_lv_count(STATS_LV_##name), call)
+
+#define virConnectOpen(...)                                             \
+        STATS_LV_CALL(virConnectOpen, virConnectOpen(__VA_ARGS__))
+#define virConnectOpenReadOnly(...)                                     \
+        STATS_LV_CALL(virConnectOpenReadOnly,                           \
+                      virConnectOpenReadOnly(__VA_ARGS__))
+#define virConnectGetCapabilities(...)                                  \
+        STATS_LV_CALL(virConnectGetCapabilities,                        \
+                      virConnectGetCapabilities(__VA_ARGS__))
+#define virConnectListAllDomains(...)                                   \
+        STATS_LV_CALL(virConnectListAllDomains,                         \
+                      virConnectListAllDomains(__VA_ARGS__))
+#define virConnectListDomains(...)                                      \
+        STATS_LV_CALL(virConnectListDomains,                            \
+                      virConnectListDomains(__VA_ARGS__))
+#define virConnectListDefinedDomains(...)                               \
+        STATS_LV_CALL(virConnectListDefinedDomains,                     \
+                      virConnectListDefinedDomains(__VA_ARGS__))
+#define virDomainLookupByName(...)                                      \
+        STATS_LV_CALL(virDomainLookupByName,                            \
+                      virDomainLookupByName(__VA_ARGS__))
+#define virDomainLookupByID(...)                                        \
+        STATS_LV_CALL(virDomainLookupByID,                              \
+                      virDomainLookupByID(__VA_ARGS__))
+#define virDomainLookupByUUID(...)                                      \
+        STATS_LV_CALL(virDomainLookupByUUID,                            \
+                      virDomainLookupByUUID(__VA_ARGS__))
+#define virDomainLookupByUUIDString(...)                                \
+        STATS_LV_CALL(virDomainLookupByUUIDString,                      \
+                      virDomainLookupByUUIDString(__VA_ARGS__))
+#define virDomainGetXMLDesc(...)                                        \
+        STATS_LV_CALL(virDomainGetXMLDesc,                              \
+                      virDomainGetXMLDesc(__VA_ARGS__))
+#define virDomainGetInfo(...)                                           \
+        STATS_LV_CALL(virDomainGetInfo, virDomainGetInfo(__VA_ARGS__))
+#define virDomainDefineXML(...)                                         \
+        STATS_LV_CALL(virDomainDefineXML, virDomainDefineXML(__VA_ARGS__))
+#define virStoragePoolLookupByName(...)                                 \
+        STATS_LV_CALL(virStoragePoolLookupByName,                       \
+                      virStoragePoolLookupByName(__VA_ARGS__))
+#define virStoragePoolGetXMLDesc(...)                                   \
+        STATS_LV_CALL(virStoragePoolGetXMLDesc,                         \
+                      virStoragePoolGetXMLDesc(__VA_ARGS__))
+#define virStorageVolLookupByPath(...)                                  \
+        STATS_LV_CALL(virStorageVolLookupByPath,                        \
+                      virStorageVolLookupByPath(__VA_ARGS__))
+#define virNetworkLookupByName(...)                                     \
+        STATS_LV_CALL(virNetworkLookupByName,                           \
+                      virNetworkLookupByName(__VA_ARGS__))
+#define virNetworkGetXMLDesc(...)                                       \
+        STATS_LV_CALL(virNetworkGetXMLDesc,                             \
+                      virNetworkGetXMLDesc(__VA_ARGS__))
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,423 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <getopt.h>
+#include <arpa/inet.h>
+#include <linux/pkt_sched.h>
+#include <linux/pkt_cls.h>
+#include <linux/if_ether.h>
+
+#include "nl_util.h"
+#include "tc_util.h"
+
+#define CHECK_MAC "52:54:00:ab:cd:ef"
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line)
+{
+        if (ok)
+                return;
+
+        printf("FAIL line %i: %s\n", line, what);
+        failures++;
+}
+
+union check_msg {
+        struct nlmsghdr n;
+        char buf[8192];
+};
+
+/* Parses the options of a filter request built by tc_mac_filter_msg() */
+static struct tcmsg *check_parse(union check_msg *msg,
+                                 int len,
+                                 struct rtattr **opts)
+{
+        struct tcmsg *t = NLMSG_DATA(&msg->n);
+        struct rtattr *tb[TCA_MAX + 1];
+
+        CHECK(len > 0);
+        CHECK(msg->n.nlmsg_len == (unsigned int)len);
+        CHECK(msg->n.nlmsg_type == RTM_NEWTFILTER);
+        CHECK(msg->n.nlmsg_flags ==
+              (NLM_F_REQUEST | NLM_F_CREATE | NLM_F_EXCL));
+
+        nl_parse(tb, TCA_MAX, TCA_RTA(t),
+                 msg->n.nlmsg_len - NLMSG_LENGTH(sizeof(*t)));
+
+        CHECK(tb[TCA_KIND] != NULL);
+        if (tb[TCA_KIND] != NULL)
+                CHECK(strcmp(RTA_DATA(tb[TCA_KIND]), "u32") == 0);
+
+        memset(opts, 0, sizeof(*opts) * (TCA_U32_MAX + 1));
+        CHECK(tb[TCA_OPTIONS] != NULL);
+        if (tb[TCA_OPTIONS] != NULL)
+                nl_parse(opts, TCA_U32_MAX, RTA_DATA(tb[TCA_OPTIONS]),
+                         RTA_PAYLOAD(tb[TCA_OPTIONS]));
+
+        return t;
+}
+
+/* Rebuilds the 16 bytes before the network header the selector
+ * matches, and checks that exactly the MAC at pos and the IP ethertype
+ * are matched.
+ */
+static void check_sel(struct rtattr *rta, int nkeys, int pos)
+{
+        const unsigned char mac[6] = {0x52, 0x54, 0x00, 0xab, 0xcd, 0xef};
+        unsigned char val[16];
+        unsigned char mask[16];
+        const unsigned char *kval;
+        const unsigned char *kmask;
+        struct tc_u32_sel *sel;
+        int off;
+        int i;
+        int j;
+
+        CHECK(rta != NULL);
+        if (rta == NULL)
+                return;
+
+        sel = RTA_DATA(rta);
+        CHECK(sel->flags == TC_U32_TERMINAL);
+        CHECK(sel->nkeys == nkeys);
+        CHECK(RTA_PAYLOAD(rta) ==
+              sizeof(*sel) + sel->nkeys * sizeof(sel->keys[0]));
+
+        memset(val, 0, sizeof(val));
+        memset(mask, 0, sizeof(mask));
+
+        for (i = 0; i < sel->nkeys; i++) {
+                off = sel->keys[i].off + 16;
+                CHECK(sel->keys[i].offmask == 0);
+                CHECK((off >= 0) && (off + 4 <= 16) && ((off & 3) == 0));
+                if ((off < 0) || (off + 4 > 16))
+                        continue;
+
+                kval = (const unsigned char *)&sel->keys[i].val;
+                kmask = (const unsigned char *)&sel->keys[i].mask;
+                for (j = 0; j < 4; j++) {
+                        CHECK((kval[j] & ~kmask[j]) == 0);
+                        val[off + j] = kval[j];
+                        mask[off + j] = kmask[j];
+                }
+        }
+
+        for (i = 0; i < 16; i++) {
+                if ((i >= pos) && (i < pos + 6)) {
+                        CHECK(mask[i] == 0xff);
+                        CHECK(val[i] == mac[i - pos]);
+                } else if (i >= 14) {
+                        CHECK(mask[i] == 0xff);
+                        CHECK(val[i] == (i == 14 ? 0x08 : 0x00));
+                } else {
+                        CHECK(mask[i] == 0);
+                }
+        }
+}
+
+/* Egress filters match the source MAC and point at the class */
+static void check_egress(void)
+{
+        union check_msg msg;
+        struct rtattr *opts[TCA_U32_MAX + 1];
+        struct tcmsg *t;
+        int len;
+
+        len = tc_mac_filter_msg(CHECK_MAC, 7, false, 0x00010010, 0,
+                                &msg, sizeof(msg));
+        t = check_parse(&msg, len, opts);
+
+        CHECK(t->tcm_ifindex == 7);
+        CHECK(t->tcm_parent == 0x00010000);
+        CHECK(TC_H_MAJ(t->tcm_info) >> 16 == 1);
+        CHECK(TC_H_MIN(t->tcm_info) == htons(ETH_P_IP));
+
+        CHECK(opts[TCA_U32_CLASSID] != NULL);
+        if (opts[TCA_U32_CLASSID] != NULL)
+                CHECK(*(uint32_t *)RTA_DATA(opts[TCA_U32_CLASSID]) ==
+                      0x00010010);
+        CHECK(opts[TCA_U32_POLICE] == NULL);
+
+        /* u32 at -8 and u16 at -4 merged with the ethertype at -2 */
+        check_sel(opts[TCA_U32_SEL], 2, 8);
+}
+
+/* What tc computes from /proc/net/psched */
+static double check_tick(void)
+{
+        unsigned int t2us;
+        unsigned int us2t;
+        unsigned int clock_res;
+        double tick = 1;
+        FILE *f;
+
+        f = fopen("/proc/net/psched", "r");
+        if (f == NULL)
+                return tick;
+
+        if ((fscanf(f, "%08x%08x%08x", &t2us, &us2t, &clock_res) == 3) &&
+            (us2t != 0)) {
+                if (clock_res == 1000000000)
+                        t2us = us2t;
+                tick = (double)t2us / us2t * clock_res / 1000000;
+        }
+
+        fclose(f);
+
+        return tick;
+}
+
+/* Ingress policers match the destination MAC and carry the rate table
+ * of "police rate <rate>Kbit burst 15k drop"
+ */
+static void check_ingress(uint64_t rate)
+{
+        union check_msg msg;
+        struct rtattr *opts[TCA_U32_MAX + 1];
+        struct rtattr *police[TCA_POLICE_MAX + 1];
+        struct tc_police *p;
+        uint32_t *rtab;
+        uint32_t bps = rate * 1000 / 8;
+        double tick = check_tick();
+        struct tcmsg *t;
+        int len;
+        int i;
+
+        len = tc_mac_filter_msg(CHECK_MAC, 7, true, 0, rate,
+                                &msg, sizeof(msg));
+        t = check_parse(&msg, len, opts);
+
+        CHECK(t->tcm_parent == 0xFFFF0000);
+        CHECK(TC_H_MAJ(t->tcm_info) >> 16 == 50);
+        CHECK(opts[TCA_U32_CLASSID] == NULL);
+
+        /* u16 at -14, u32 at -12 and the ethertype at -2 */
+        check_sel(opts[TCA_U32_SEL], 3, 2);
+
+        CHECK(opts[TCA_U32_POLICE] != NULL);
+        if (opts[TCA_U32_POLICE] == NULL)
+                return;
+
+        nl_parse(police, TCA_POLICE_MAX, RTA_DATA(opts[TCA_U32_POLICE]),
+                 RTA_PAYLOAD(opts[TCA_U32_POLICE]));
+
+        CHECK((police[TCA_POLICE_TBF] != NULL) &&
+              (RTA_PAYLOAD(police[TCA_POLICE_TBF]) == sizeof(*p)));
+        CHECK((police[TCA_POLICE_RATE] != NULL) &&
+              (RTA_PAYLOAD(police[TCA_POLICE_RATE]) ==
+               256 * sizeof(uint32_t)));
+        if ((police[TCA_POLICE_TBF] == NULL) ||
+            (police[TCA_POLICE_RATE] == NULL))
+                return;
+
+        p = RTA_DATA(police[TCA_POLICE_TBF]);
+        CHECK(p->action == TC_POLICE_SHOT);
+        CHECK(p->rate.rate == bps);
+        CHECK(p->rate.cell_log == 3);
+        CHECK(p->burst == (uint32_t)(tick * 1000000 * (15 * 1024) / bps));
+
+        /* Slot i holds the time to send (i + 1) << cell_log bytes */
+        rtab = RTA_DATA(police[TCA_POLICE_RATE]);
+        for (i = 0; i < 256; i++)
+                CHECK(rtab[i] ==
+                      (uint32_t)(tick * 1000000 * ((i + 1) << 3) / bps));
+}
+
+static void check_errors(void)
+{
+        union check_msg msg;
+
+        CHECK(tc_mac_filter_msg("52:54:00", 7, false, 0x00010010, 0,
+                                &msg, sizeof(msg)) == -1);
+        CHECK(tc_mac_filter_msg(CHECK_MAC, 7, true, 0, 0,
+                                &msg, sizeof(msg)) == -1);
+        CHECK(tc_mac_filter_msg(CHECK_MAC, 7, true, 0, 40000000000ULL,
+                                &msg, sizeof(msg)) == -1);
+        CHECK(tc_mac_filter_msg(CHECK_MAC, 7, false, 0x00010010, 0,
+                                &msg, 16) == -1);
+}
+
+/* Checks the requests tc_add_mac() sends, without sending them */
+static int run_checks(void)
+{
+        check_egress();
+        check_ingress(1000);
+        check_ingress(2048);
+        check_ingress(100000);
+        check_errors();
+
+        printf("%s: %i failures\n", failures ? "FAIL" : "PASS", failures);
+
+        return failures != 0;
+}
+
+static void print_table(const struct tc_table *table)
+{
+        char id[16];
+        char parent[16];
+        int i;
+
+        tc_handle_str(table->root, id, sizeof(id));
+        printf("%s (ifindex %i), root class %s\n",
+               table->dev, table->ifindex, table->root ? id : "none");
+
+        for (i = 0; i < table->class_ct; i++) {
+                tc_handle_str(table->classes[i].handle, id, sizeof(id));
+                tc_handle_str(table->classes[i].parent,
+                              parent, sizeof(parent));
+                printf("class  %-8s parent %-8s rate %" PRIu64 "Kbit\n",
+                       id, parent, table->classes[i].rate);
+        }
+
+        for (i = 0; i < table->filter_ct; i++) {
+                const unsigned char *m = table->filters[i].mac;
+
+                tc_handle_str(table->filters[i].classid, id, sizeof(id));
+                printf("filter %08x prio %hu "
+                       "%02x:%02x:%02x:%02x:%02x:%02x flowid %s\n",
+                       table->filters[i].handle, table->filters[i].prio,
+                       m[0], m[1], m[2], m[3], m[4], m[5], id);
+        }
+
+        for (i = 0; i < table->policer_ct; i++) {
+                const unsigned char *m = table->policers[i].mac;
+
+                printf("police %08x prio %hu "
+                       "%02x:%02x:%02x:%02x:%02x:%02x\n",
+                       table->policers[i].handle, table->policers[i].prio,
+                       m[0], m[1], m[2], m[3], m[4], m[5]);
+        }
+}
+
+static void usage(void)
+{
+        printf("tc_qos_test -i DEV [--add MAC --rate KBIT | --remove MAC |"
+               " --lookup MAC]\n"
+               "tc_qos_test --check\n"
+               "\n"
+               "-c,--check        Check the filter requests, needs no root\n"
+               "-i,--dev DEV      Show the QoS classes and filters of DEV\n"
+               "-a,--add MAC      Put MAC in the class with rate KBIT\n"
+               "-r,--rate KBIT    Rate for --add\n"
+               "-d,--remove MAC   Remove the filters for MAC\n"
+               "-l,--lookup MAC   Print the rate MAC is filtered to\n"
+               "\n"
+               "Meant to be run in a network namespace, e.g. on a dummy\n"
+               "interface carrying an htb qdisc 1: and an ingress qdisc.\n");
+}
+
+int main(int argc, char **argv)
+{
+        int c;
+        char *dev = NULL;
+        char *add = NULL;
+        char *remove = NULL;
+        char *lookup = NULL;
+        uint64_t rate = 0;
+        struct tc_table table;
+        int ret;
+
+        static struct option lopts[] = {
+                {"dev",    1, 0, 'i'},
+                {"add",    1, 0, 'a'},
+                {"rate",   1, 0, 'r'},
+                {"remove", 1, 0, 'd'},
+                {"lookup", 1, 0, 'l'},
+                {"check",  0, 0, 'c'},
+                {"help",   0, 0, 'h'},
+                {0,        0, 0, 0}};
+
+        while (1) {
+                int optidx = 0;
+
+                c = getopt_long(argc, argv, "i:a:r:d:l:ch", lopts, &optidx);
+                if (c == -1)
+                        break;
+
+                switch (c) {
+                case 'i':
+                        dev = optarg;
+                        break;
+
+                case 'a':
+                        add = optarg;
+                        break;
+
+                case 'r':
+                        rate = strtoull(optarg, NULL, 10);
+                        break;
+
+                case 'd':
+                        remove = optarg;
+                        break;
+
+                case 'l':
+                        lookup = optarg;
+                        break;
+
+                case 'c':
+                        return run_checks();
+
+                case '?':
+                case 'h':
+                        usage();
+                        return c == '?';
+                };
+        }
+
+        if (dev == NULL) {
+                usage();
+                return 1;
+        }
+
+        if (remove != NULL) {
+                ret = tc_remove_mac(dev, remove);
+                if (ret < 0) {
+                        printf("Failed to remove %s\n", remove);
+                        return 2;
+                }
+                printf("Removed %i entries for %s\n", ret, remove);
+        }
+
+        if (add != NULL) {
+                if (tc_add_mac(dev, add, rate) != 0) {
+                        printf("Failed to add %s at %" PRIu64 "Kbit\n",
+                               add, rate);
+                        return 2;
+                }
+        }
+
+        if (lookup != NULL) {
+                if (!tc_mac_rate(dev, lookup, &rate)) {
+                        printf("No rate for %s\n", lookup);
+                        return 3;
+                }
+                printf("%s: %" PRIu64 "Kbit\n", lookup, rate);
+                return 0;
+        }
+
+        if (tc_table_read(dev, &table) != 0) {
+                printf("Unable to read tc tables of %s\n", dev);
+                return 2;
+        }
+
+        print_table(&table);
+        tc_table_free(&table);
+
+        return 0;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,934 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <linux/pkt_sched.h>
+#include <linux/pkt_cls.h>
+#include <linux/if_ether.h>
+
+#include <libcmpiutil/libcmpiutil.h>
+
+#include "nl_util.h"
+#include "tc_util.h"
+
+#define TC_MSG_SIZE 4096
+
+/* Where the filters hang and the priority they are added with */
+#define TC_EGRESS_PARENT 0x00010000
+#define TC_EGRESS_PRIO 1
+#define TC_INGRESS_PARENT 0xFFFF0000
+#define TC_INGRESS_PRIO 50
+
+/* The offset of the MAC a filter matches, relative to the network
+ * header: the source address on egress, the destination on ingress.
+ */
+#define TC_EGRESS_MAC (-8)
+#define TC_INGRESS_MAC (-14)
+#define TC_ETH_HLEN 16
+
+/* "police ... burst 15k drop" and the default mtu of tc */
+#define TC_POLICE_BURST (15 * 1024)
+#define TC_POLICE_MTU 2047
+
+#define TC_SEL_KEYS 4
+
+struct tc_req {
+        struct nlmsghdr n;
+        struct tcmsg t;
+        char buf[TC_MSG_SIZE];
+};
+
+union tc_sel {
+        struct tc_u32_sel sel;
+        char buf[sizeof(struct tc_u32_sel) +
+                 TC_SEL_KEYS * sizeof(struct tc_u32_key)];
+};
+
+struct tc_filter_list {
+        struct tc_filter **filters;
+        int *count;
+        int mac_off;
+};
+
+static void tc_req_init(struct tc_req *req,
+                        int type,
+                        int flags,
+                        int ifindex,
+                        uint32_t parent,
+                        uint32_t handle,
+                        uint32_t info)
+{
+        memset(req, 0, sizeof(*req));
+
+        req->n.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+        req->n.nlmsg_type = type;
+        req->n.nlmsg_flags = NLM_F_REQUEST | flags;
+
+        req->t.tcm_family = AF_UNSPEC;
+        req->t.tcm_ifindex = ifindex;
+        req->t.tcm_parent = parent;
+        req->t.tcm_handle = handle;
+        req->t.tcm_info = info;
+}
+
+static bool tc_kind_is(struct rtattr **tb, const char *kind)
+{
+        size_t len = strlen(kind) + 1;
+
+        if (tb[TCA_KIND] == NULL)
+                return false;
+
+        return (RTA_PAYLOAD(tb[TCA_KIND]) == len) &&
+                (memcmp(RTA_DATA(tb[TCA_KIND]), kind, len) == 0);
+}
+
+static int tc_dump(struct nl_sock *sock,
+                   int type,
+                   int ifindex,
+                   uint32_t parent,
+                   nl_msg_t handler,
+                   void *data)
+{
+        struct tc_req req;
+
+        tc_req_init(&req, type, NLM_F_DUMP, ifindex, parent, 0, 0);
+
+        if (nl_send(sock, &req.n) < 0)
+                return -1;
+
+        return nl_recv(sock, handler, data);
+}
+
+static int tc_class_msg(struct nlmsghdr *n, void *data)
+{
+        struct tc_table *table = data;
+        struct tcmsg *t = NLMSG_DATA(n);
+        struct rtattr *tb[TCA_MAX + 1];
+        struct rtattr *opt[TCA_HTB_MAX + 1];
+        struct tc_htb_opt *parms;
+        struct tc_class *tmp;
+        struct tc_class *class;
+
+        if ((n->nlmsg_type != RTM_NEWTCLASS) ||
+            (n->nlmsg_len < NLMSG_LENGTH(sizeof(*t))))
+                return 0;
+
+        nl_parse(tb, TCA_MAX, TCA_RTA(t), TCA_PAYLOAD(n));
+        if (!tc_kind_is(tb, "htb") || (tb[TCA_OPTIONS] == NULL))
+                return 0;
+
+        nl_parse(opt, TCA_HTB_MAX,
+                 RTA_DATA(tb[TCA_OPTIONS]), RTA_PAYLOAD(tb[TCA_OPTIONS]));
+        if ((opt[TCA_HTB_PARMS] == NULL) ||
+            (RTA_PAYLOAD(opt[TCA_HTB_PARMS]) < sizeof(*parms)))
+                return 0;
+
+        parms = RTA_DATA(opt[TCA_HTB_PARMS]);
+
+        tmp = realloc(table->classes,
+                      (table->class_ct + 1) * sizeof(*table->classes));
+        if (tmp == NULL) {
+                errno = ENOMEM;
+                return -1;
+        }
+
+        table->classes = tmp;
+        class = &table->classes[table->class_ct++];
+
+        class->handle = t->tcm_handle;
+        class->parent = t->tcm_parent;
+        class->rate = (uint64_t)parms->rate.rate * 8 / 1000;
+
+        if ((class->parent == TC_H_ROOT) && (table->root == 0))
+                table->root = class->handle;
+
+        return 0;
+}
+
+/* Rebuilds the ethernet header a u32 selector matches and takes the
+ * MAC at off from it, if the selector matches all of it.
+ */
+static bool tc_sel_get_mac(const struct tc_u32_sel *sel,
+                           size_t len,
+                           int off,
+                           unsigned char *mac)
+{
+        unsigned char val[TC_ETH_HLEN];
+        unsigned char mask[TC_ETH_HLEN];
+        const unsigned char *kval;
+        const unsigned char *kmask;
+        int pos;
+        int i;
+        int j;
+
+        if ((len < sizeof(*sel)) ||
+            (len < sizeof(*sel) + sel->nkeys * sizeof(sel->keys[0])))
+                return false;
+
+        memset(val, 0, sizeof(val));
+        memset(mask, 0, sizeof(mask));
+
+        for (i = 0; i < sel->nkeys; i++) {
+                pos = sel->keys[i].off + TC_ETH_HLEN;
+                if ((sel->keys[i].offmask != 0) ||
+                    (pos < 0) || (pos + 4 > TC_ETH_HLEN))
+                        continue;
+
+                kval = (const unsigned char *)&sel->keys[i].val;
+                kmask = (const unsigned char *)&sel->keys[i].mask;
+
+                for (j = 0; j < 4; j++) {
+                        val[pos + j] = (val[pos + j] & ~kmask[j]) |
+                                (kval[j] & kmask[j]);
+                        mask[pos + j] |= kmask[j];
+                }
+        }
+
+        pos = off + TC_ETH_HLEN;
+        for (i = 0; i < 6; i++) {
+                if (mask[pos + i] != 0xff)
+                        return false;
+                mac[i] = val[pos + i];
+        }
+
+        return true;
+}
+
+static int tc_filter_msg(struct nlmsghdr *n, void *data)
+{
+        struct tc_filter_list *list = data;
+        struct tcmsg *t = NLMSG_DATA(n);
+        struct rtattr *tb[TCA_MAX + 1];
+        struct rtattr *opt[TCA_U32_MAX + 1];
+        struct tc_filter filter;
+        struct tc_filter *tmp;
+
+        if ((n->nlmsg_type != RTM_NEWTFILTER) ||
+            (n->nlmsg_len < NLMSG_LENGTH(sizeof(*t))))
+                return 0;
+
+        nl_parse(tb, TCA_MAX, TCA_RTA(t), TCA_PAYLOAD(n));
+        if (!tc_kind_is(tb, "u32") || (tb[TCA_OPTIONS] == NULL))
+                return 0;
+
+        nl_parse(opt, TCA_U32_MAX,
+                 RTA_DATA(tb[TCA_OPTIONS]), RTA_PAYLOAD(tb[TCA_OPTIONS]));
+
+        /* Hash tables and links carry no selector */
+        if (opt[TCA_U32_SEL] == NULL)
+                return 0;
+
+        memset(&filter, 0, sizeof(filter));
+
+        if (!tc_sel_get_mac(RTA_DATA(opt[TCA_U32_SEL]),
+                            RTA_PAYLOAD(opt[TCA_U32_SEL]),
+                            list->mac_off,
+                            filter.mac))
+                return 0;
+
+        filter.handle = t->tcm_handle;
+        filter.prio = TC_H_MAJ(t->tcm_info) >> 16;
+
+        if ((opt[TCA_U32_CLASSID] != NULL) &&
+            (RTA_PAYLOAD(opt[TCA_U32_CLASSID]) >= sizeof(uint32_t)))
+                memcpy(&filter.classid,
+                       RTA_DATA(opt[TCA_U32_CLASSID]),
+                       sizeof(uint32_t));
+
+        tmp = realloc(*list->filters, (*list->count + 1) * sizeof(filter));
+        if (tmp == NULL) {
+                errno = ENOMEM;
+                return -1;
+        }
+
+        *list->filters = tmp;
+        tmp[(*list->count)++] = filter;
+
+        return 0;
+}
+
+int tc_table_read(const char *dev, struct tc_table *table)
+{
+        struct nl_sock sock;
+        struct tc_filter_list list;
+        int ret = -1;
+        int err;
+
+        memset(table, 0, sizeof(*table));
+        strncpy(table->dev, dev, sizeof(table->dev) - 1);
+
+        table->ifindex = if_nametoindex(dev);
+        if (table->ifindex == 0) {
+                CU_DEBUG("No such interface `%s'", dev);
+                return -1;
+        }
+
+        if (nl_open(&sock, 0) < 0)
+                return -1;
+
+        if (tc_dump(&sock, RTM_GETTCLASS, table->ifindex, 0,
+                    tc_class_msg, table) < 0)
+                goto out;
+
+        list.filters = &table->filters;
+        list.count = &table->filter_ct;
+        list.mac_off = TC_EGRESS_MAC;
+
+        if (tc_dump(&sock, RTM_GETTFILTER, table->ifindex, TC_EGRESS_PARENT,
+                    tc_filter_msg, &list) < 0)
+                goto out;
+
+        list.filters = &table->policers;
+        list.count = &table->policer_ct;
+        list.mac_off = TC_INGRESS_MAC;
+
+        if (tc_dump(&sock, RTM_GETTFILTER, table->ifindex, TC_INGRESS_PARENT,
+                    tc_filter_msg, &list) < 0)
+                goto out;
+
+        CU_DEBUG("%s: %i classes, %i filters, %i policers",
+                 dev, table->class_ct, table->filter_ct, table->policer_ct);
+
+        ret = 0;
+ out:
+        err = errno;
+        nl_close(&sock);
+
+        if (ret != 0) {
+                CU_DEBUG("Unable to read tc tables of %s: %s",
+                         dev, strerror(err));
+                tc_table_free(table);
+        }
+
+        errno = err;
+
+        return ret;
+}
+
+void tc_table_free(struct tc_table *table)
+{
+        free(table->classes);
+        free(table->filters);
+        free(table->policers);
+
+        table->classes = NULL;
+        table->class_ct = 0;
+        table->filters = NULL;
+        table->filter_ct = 0;
+        table->policers = NULL;
+        table->policer_ct = 0;
+}
+
+static bool tc_parse_mac(const char *str, unsigned char *mac)
+{
+        unsigned int b[6];
+        int i;
+
+        if (sscanf(str, "%x:%x:%x:%x:%x:%x",
+                   &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6) {
+                CU_DEBUG("Invalid MAC `%s'", str);
+                return false;
+        }
+
+        for (i = 0; i < 6; i++)
+                mac[i] = b[i] & 0xff;
+
+        return true;
+}
+
+bool tc_table_mac_rate(const struct tc_table *table,
+                       const char *mac,
+                       uint64_t *rate)
+{
+        unsigned char addr[6];
+        int i;
+        int j;
+
+        if ((table->root == 0) || !tc_parse_mac(mac, addr))
+                return false;
+
+        for (i = 0; i < table->filter_ct; i++) {
+                if (memcmp(table->filters[i].mac, addr, sizeof(addr)) != 0)
+                        continue;
+
+                for (j = 0; j < table->class_ct; j++) {
+                        if ((table->classes[j].parent == table->root) &&
+                            (table->classes[j].handle ==
+                             table->filters[i].classid)) {
+                                *rate = table->classes[j].rate;
+                                return true;
+                        }
+                }
+        }
+
+        return false;
+}
+
+bool tc_table_rate_class(const struct tc_table *table,
+                         uint64_t rate,
+                         uint32_t *classid)
+{
+        int i;
+
+        if (table->root == 0)
+                return false;
+
+        for (i = 0; i < table->class_ct; i++) {
+                if ((table->classes[i].parent == table->root) &&
+                    (table->classes[i].rate == rate)) {
+                        *classid = table->classes[i].handle;
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+struct tc_cache {
+        struct tc_table table;
+        uint64_t read;
+        bool valid;
+        struct tc_cache *next;
+};
+
+static pthread_mutex_t tc_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct tc_cache *tc_cache_list = NULL;
+
+static uint64_t tc_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Called with tc_cache_lock held */
+static struct tc_table *tc_cached_table(const char *dev)
+{
+        struct tc_cache *entry;
+        uint64_t now = tc_now();
+
+        for (entry = tc_cache_list; entry != NULL; entry = entry->next)
+                if (STREQ(entry->table.dev, dev))
+                        break;
+
+        if (entry == NULL) {
+                entry = calloc(1, sizeof(*entry));
+                if (entry == NULL)
+                        return NULL;
+
+                entry->next = tc_cache_list;
+                tc_cache_list = entry;
+        } else if (entry->valid && (now - entry->read < TC_CACHE_TTL)) {
+                return &entry->table;
+        }
+
+        tc_table_free(&entry->table);
+        entry->valid = false;
+
+        /* On failure the entry keeps its name and is read again */
+        if (tc_table_read(dev, &entry->table) != 0)
+                return NULL;
+
+        entry->read = now;
+        entry->valid = true;
+
+        return &entry->table;
+}
+
+static void tc_cache_drop(const char *dev)
+{
+        struct tc_cache *entry;
+
+        pthread_mutex_lock(&tc_cache_lock);
+
+        for (entry = tc_cache_list; entry != NULL; entry = entry->next)
+                if (STREQ(entry->table.dev, dev))
+                        entry->valid = false;
+
+        pthread_mutex_unlock(&tc_cache_lock);
+}
+
+bool tc_mac_rate(const char *dev, const char *mac, uint64_t *rate)
+{
+        struct tc_table *table;
+        bool ret = false;
+
+        pthread_mutex_lock(&tc_cache_lock);
+
+        table = tc_cached_table(dev);
+        if (table != NULL)
+                ret = tc_table_mac_rate(table, mac, rate);
+
+        pthread_mutex_unlock(&tc_cache_lock);
+
+        return ret;
+}
+
+int tc_leaf_classes(const char *dev, struct tc_class **classes)
+{
+        struct tc_table *table;
+        int count = -1;
+        int i;
+
+        *classes = NULL;
+
+        pthread_mutex_lock(&tc_cache_lock);
+
+        table = tc_cached_table(dev);
+        if (table == NULL)
+                goto out;
+
+        count = 0;
+        if ((table->root == 0) || (table->class_ct == 0))
+                goto out;
+
+        *classes = calloc(table->class_ct, sizeof(**classes));
+        if (*classes == NULL) {
+                count = -1;
+                goto out;
+        }
+
+        for (i = 0; i < table->class_ct; i++)
+                if (table->classes[i].parent == table->root)
+                        (*classes)[count++] = table->classes[i];
+ out:
+        pthread_mutex_unlock(&tc_cache_lock);
+
+        return count;
+}
+
+/* Kernel clock ticks per microsecond, the unit of tc rate tables */
+static double tc_tick(void)
+{
+        static double tick = 0;
+        unsigned int t2us;
+        unsigned int us2t;
+        unsigned int clock_res;
+        double val = 1;
+        FILE *f;
+
+        if (tick > 0)
+                return tick;
+
+        f = fopen("/proc/net/psched", "r");
+        if (f != NULL) {
+                if ((fscanf(f, "%08x%08x%08x",
+                            &t2us, &us2t, &clock_res) == 3) &&
+                    (us2t != 0)) {
+                        if (clock_res == 1000000000)
+                                t2us = us2t;
+                        val = (double)t2us / us2t * clock_res / 1000000;
+                }
+                fclose(f);
+        }
+
+        tick = val;
+
+        return tick;
+}
+
+static uint32_t tc_xmittime(uint32_t rate, unsigned int size)
+{
+        return tc_tick() * 1000000 * size / rate;
+}
+
+/* What "police rate <rate>Kbit burst 15k drop" sends */
+static int tc_police_attrs(struct tc_req *req, uint64_t rate)
+{
+        struct tc_police p;
+        uint32_t rtab[256];
+        int cell_log = 0;
+        int i;
+
+        if ((rate == 0) || (rate * 1000 / 8 > UINT32_MAX)) {
+                CU_DEBUG("Unable to police at %llu Kbit",
+                         (unsigned long long)rate);
+                return -1;
+        }
+
+        memset(&p, 0, sizeof(p));
+        p.action = TC_POLICE_SHOT;
+        p.rate.rate = rate * 1000 / 8;
+
+        while ((TC_POLICE_MTU >> cell_log) > 255)
+                cell_log++;
+
+        for (i = 0; i < 256; i++)
+                rtab[i] = tc_xmittime(p.rate.rate, (i + 1) << cell_log);
+
+        p.rate.cell_log = cell_log;
+        p.rate.cell_align = -1;
+#ifdef TC_LINKLAYER_MASK
+        p.rate.linklayer = TC_LINKLAYER_ETHERNET;
+#endif
+        p.burst = tc_xmittime(p.rate.rate, TC_POLICE_BURST);
+
+        if ((nl_attr(&req->n, sizeof(*req),
+                     TCA_POLICE_TBF, &p, sizeof(p)) == NULL) ||
+            (nl_attr(&req->n, sizeof(*req),
+                     TCA_POLICE_RATE, rtab, sizeof(rtab)) == NULL))
+                return -1;
+
+        return 0;
+}
+
+/* Adds a key the way tc does, merging keys at the same offset */
+static int tc_sel_key(struct tc_u32_sel *sel,
+                      uint32_t val,
+                      uint32_t mask,
+                      int off)
+{
+        struct tc_u32_key *key;
+        int i;
+
+        val &= mask;
+
+        for (i = 0; i < sel->nkeys; i++) {
+                key = &sel->keys[i];
+                if ((key->off != off) || (key->offmask != 0))
+                        continue;
+
+                if ((key->val ^ val) & key->mask & mask)
+                        return -1;
+
+                key->val |= val;
+                key->mask |= mask;
+
+                return 0;
+        }
+
+        if (sel->nkeys >= TC_SEL_KEYS)
+                return -1;
+
+        key = &sel->keys[sel->nkeys++];
+        key->val = val;
+        key->mask = mask;
+        key->off = off;
+        key->offmask = 0;
+
+        return 0;
+}
+
+static int tc_sel_u16(struct tc_u32_sel *sel, uint16_t val, int off)
+{
+        uint32_t key = val;
+        uint32_t mask = 0xffff;
+
+        if ((off & 3) == 0) {
+                key <<= 16;
+                mask <<= 16;
+        }
+
+        return tc_sel_key(sel, htonl(key), htonl(mask), off & ~3);
+}
+
+static int tc_sel_u32(struct tc_u32_sel *sel, uint32_t val, int off)
+{
+        return tc_sel_key(sel, htonl(val), 0xffffffff, off);
+}
+
+/* "match u16 0x0800 0xFFFF at -2" and the MAC at off, which is either
+ * word aligned or two bytes into a word.
+ */
+static int tc_sel_mac(union tc_sel *u, const unsigned char *mac, int off)
+{
+        struct tc_u32_sel *sel = &u->sel;
+        uint32_t hi;
+        uint32_t lo;
+
+        memset(u, 0, sizeof(*u));
+        sel->flags = TC_U32_TERMINAL;
+
+        if (tc_sel_u16(sel, ETH_P_IP, -2) != 0)
+                return -1;
+
+        if ((off & 3) == 0) {
+                hi = (mac[0] << 24) | (mac[1] << 16) | (mac[2] << 8) | mac[3];
+                lo = (mac[4] << 8) | mac[5];
+
+                if ((tc_sel_u16(sel, lo, off + 4) != 0) ||
+                    (tc_sel_u32(sel, hi, off) != 0))
+                        return -1;
+        } else {
+                hi = (mac[0] << 8) | mac[1];
+                lo = (mac[2] << 24) | (mac[3] << 16) | (mac[4] << 8) | mac[5];
+
+                if ((tc_sel_u32(sel, lo, off + 2) != 0) ||
+                    (tc_sel_u16(sel, hi, off) != 0))
+                        return -1;
+        }
+
+        return 0;
+}
+
+static int tc_filter_req(struct tc_req *req,
+                         int ifindex,
+                         uint32_t parent,
+                         uint16_t prio,
+                         union tc_sel *u,
+                         uint32_t classid,
+                         uint64_t rate)
+{
+        struct rtattr *opt;
+        struct rtattr *police;
+        size_t len;
+
+        tc_req_init(req, RTM_NEWTFILTER, NLM_F_CREATE | NLM_F_EXCL,
+                    ifindex, parent, 0,
+                    TC_H_MAKE((uint32_t)prio << 16, htons(ETH_P_IP)));
+
+        if (nl_attr(&req->n, sizeof(*req), TCA_KIND, "u32", 4) == NULL)
+                return -1;
+
+        opt = nl_attr(&req->n, sizeof(*req), TCA_OPTIONS, NULL, 0);
+        if (opt == NULL)
+                return -1;
+
+        if ((classid != 0) &&
+            (nl_attr(&req->n, sizeof(*req), TCA_U32_CLASSID,
+                     &classid, sizeof(classid)) == NULL))
+                return -1;
+
+        if (rate != 0) {
+                police = nl_attr(&req->n, sizeof(*req),
+                                 TCA_U32_POLICE, NULL, 0);
+                if ((police == NULL) || (tc_police_attrs(req, rate) != 0))
+                        return -1;
+                nl_nest_end(&req->n, police);
+        }
+
+        len = sizeof(u->sel) + u->sel.nkeys * sizeof(u->sel.keys[0]);
+        if (nl_attr(&req->n, sizeof(*req),
+                    TCA_U32_SEL, &u->sel, len) == NULL)
+                return -1;
+
+        nl_nest_end(&req->n, opt);
+
+        return 0;
+}
+
+static int tc_add_filter(struct nl_sock *sock,
+                         int ifindex,
+                         uint32_t parent,
+                         uint16_t prio,
+                         union tc_sel *u,
+                         uint32_t classid,
+                         uint64_t rate)
+{
+        struct tc_req req;
+
+        if (tc_filter_req(&req, ifindex, parent, prio, u, classid, rate) != 0)
+                return -1;
+
+        return nl_talk(sock, &req.n);
+}
+
+int tc_mac_filter_msg(const char *mac,
+                      int ifindex,
+                      bool ingress,
+                      uint32_t classid,
+                      uint64_t rate,
+                      void *buf,
+                      size_t size)
+{
+        struct tc_req req;
+        union tc_sel sel;
+        unsigned char addr[6];
+        int ret;
+
+        if (!tc_parse_mac(mac, addr) || (ingress && (rate == 0)))
+                return -1;
+
+        if (tc_sel_mac(&sel, addr,
+                       ingress ? TC_INGRESS_MAC : TC_EGRESS_MAC) != 0)
+                return -1;
+
+        if (ingress)
+                ret = tc_filter_req(&req, ifindex, TC_INGRESS_PARENT,
+                                    TC_INGRESS_PRIO, &sel, 0, rate);
+        else
+                ret = tc_filter_req(&req, ifindex, TC_EGRESS_PARENT,
+                                    TC_EGRESS_PRIO, &sel, classid, 0);
+
+        if ((ret != 0) || (req.n.nlmsg_len > size))
+                return -1;
+
+        memcpy(buf, &req, req.n.nlmsg_len);
+
+        return req.n.nlmsg_len;
+}
+
+static int tc_del_filter(struct nl_sock *sock,
+                         int ifindex,
+                         uint32_t parent,
+                         const struct tc_filter *filter)
+{
+        struct tc_req req;
+
+        tc_req_init(&req, RTM_DELTFILTER, 0,
+                    ifindex, parent, filter->handle,
+                    TC_H_MAKE((uint32_t)filter->prio << 16, 0));
+
+        if (nl_attr(&req.n, sizeof(req), TCA_KIND, "u32", 4) == NULL)
+                return -1;
+
+        return nl_talk(sock, &req.n);
+}
+
+int tc_add_mac(const char *dev, const char *mac, uint64_t rate)
+{
+        struct tc_table *table;
+        struct nl_sock sock;
+        union tc_sel sel;
+        unsigned char addr[6];
+        uint32_t classid = 0;
+        int ifindex = 0;
+        int ret = -1;
+        char id[16];
+
+        if (!tc_parse_mac(mac, addr))
+                return -1;
+
+        pthread_mutex_lock(&tc_cache_lock);
+
+        table = tc_cached_table(dev);
+        if ((table != NULL) && tc_table_rate_class(table, rate, &classid))
+                ifindex = table->ifindex;
+
+        pthread_mutex_unlock(&tc_cache_lock);
+
+        if (ifindex == 0) {
+                CU_DEBUG("No class with rate %llu Kbit on %s",
+                         (unsigned long long)rate, dev);
+                return -1;
+        }
+
+        tc_handle_str(classid, id, sizeof(id));
+        CU_DEBUG("Adding %s on %s to class %s", mac, dev, id);
+
+        if (nl_open(&sock, 0) < 0)
+                return -1;
+
+        if (tc_sel_mac(&sel, addr, TC_EGRESS_MAC) != 0)
+                goto out;
+
+        if (tc_add_filter(&sock, ifindex, TC_EGRESS_PARENT, TC_EGRESS_PRIO,
+                          &sel, classid, 0) != 0) {
+                CU_DEBUG("Unable to add egress filter: %s", strerror(errno));
+                goto out;
+        }
+
+        if (tc_sel_mac(&sel, addr, TC_INGRESS_MAC) != 0)
+                goto out;
+
+        if (tc_add_filter(&sock, ifindex, TC_INGRESS_PARENT, TC_INGRESS_PRIO,
+                          &sel, 0, rate) != 0) {
+                CU_DEBUG("Unable to add ingress policer: %s",
+                         strerror(errno));
+                goto out;
+        }
+
+        ret = 0;
+ out:
+        nl_close(&sock);
+        tc_cache_drop(dev);
+
+        return ret;
+}
+
+int tc_remove_mac(const char *dev, const char *mac)
+{
+        struct tc_table table;
+        struct nl_sock sock;
+        unsigned char addr[6];
+        int count = 0;
+        int i;
+
+        if (!tc_parse_mac(mac, addr))
+                return -1;
+
+        /* Deletes go by handle, so work on the current tables */
+        if (tc_table_read(dev, &table) != 0)
+                return -1;
+
+        if (nl_open(&sock, 0) < 0) {
+                tc_table_free(&table);
+                return -1;
+        }
+
+        for (i = 0; i < table.filter_ct; i++) {
+                if (memcmp(table.filters[i].mac, addr, sizeof(addr)) != 0)
+                        continue;
+
+                if (tc_del_filter(&sock, table.ifindex, TC_EGRESS_PARENT,
+                                  &table.filters[i]) == 0)
+                        count++;
+                else
+                        CU_DEBUG("Unable to remove egress filter: %s",
+                                 strerror(errno));
+        }
+
+        for (i = 0; i < table.policer_ct; i++) {
+                if (memcmp(table.policers[i].mac, addr, sizeof(addr)) != 0)
+                        continue;
+
+                if (tc_del_filter(&sock, table.ifindex, TC_INGRESS_PARENT,
+                                  &table.policers[i]) == 0)
+                        count++;
+                else
+                        CU_DEBUG("Unable to remove ingress policer: %s",
+                                 strerror(errno));
+        }
+
+        nl_close(&sock);
+        tc_table_free(&table);
+        tc_cache_drop(dev);
+
+        CU_DEBUG("Removed %i tc entries for %s on %s", count, mac, dev);
+
+        return count;
+}
+
+void tc_handle_str(uint32_t handle, char *buf, size_t size)
+{
+        if (handle == TC_H_ROOT)
+                snprintf(buf, size, "root");
+        else if (TC_H_MIN(handle) == 0)
+                snprintf(buf, size, "%x:", TC_H_MAJ(handle) >> 16);
+        else
+                snprintf(buf, size, "%x:%x",
+                         TC_H_MAJ(handle) >> 16, TC_H_MIN(handle));
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef __TC_UTIL_H
+#define __TC_UTIL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <net/if.h>
+
+/*
+ * Network QoS for libvirt versions without bandwidth support.  The host
+ * bridge carries an htb qdisc whose classes under the root class are the
+ * bandwidth levels on offer.  A guest NIC is put in a level by a u32
+ * filter on the egress qdisc (1:, prio 1) that matches its MAC and
+ * points at the class, plus a u32 policer with the same rate on the
+ * ingress qdisc (ffff:, prio 50).
+ *
+ * The tables are read from the kernel over rtnetlink.  All rates are in
+ * Kbit/s.
+ */
+struct tc_class {
+        uint32_t handle;
+        uint32_t parent;
+        uint64_t rate;
+};
+
+struct tc_filter {
+        uint32_t handle;
+        uint16_t prio;
+        uint32_t classid;
+        unsigned char mac[6];
+};
+
+struct tc_table {
+        char dev[IFNAMSIZ];
+        int ifindex;
+
+        uint32_t root;
+        struct tc_class *classes;
+        int class_ct;
+
+        /* The egress filters and ingress policers that match a MAC */
+        struct tc_filter *filters;
+        int filter_ct;
+        struct tc_filter *policers;
+        int policer_ct;
+};
+
+/* Reads the classes and filters of dev in one pass.  Returns 0 on
+ * success, or -1 with errno set.
+ */
+int tc_table_read(const char *dev, struct tc_table *table);
+void tc_table_free(struct tc_table *table);
+
+/* The rate of the class the egress filter for mac points at */
+bool tc_table_mac_rate(const struct tc_table *table,
+                       const char *mac,
+                       uint64_t *rate);
+
+/* The class under the root class with the given rate */
+bool tc_table_rate_class(const struct tc_table *table,
+                         uint64_t rate,
+                         uint32_t *classid);
+
+/*
+ * The functions below work on a copy of the tables of dev that is read
+ * at most once per TC_CACHE_TTL milliseconds, so that a request looking
+ * at many NICs on one bridge only asks the kernel once.  Changes made
+ * with tc_add_mac() and tc_remove_mac() drop the copy.
+ */
+#define TC_CACHE_TTL 1000
+
+bool tc_mac_rate(const char *dev, const char *mac, uint64_t *rate);
+
+/* Sets *classes to a copy of the classes under the root class and
+ * returns how many there are, or -1 on error.
+ */
+int tc_leaf_classes(const char *dev, struct tc_class **classes);
+
+/* Filters mac into the class with the given rate and polices its
+ * ingress traffic to that rate.  Returns 0 on success, or -1.
+ */
+int tc_add_mac(const char *dev, const char *mac, uint64_t rate);
+
+/* Removes the filters and policers for mac.  Returns the number of
+ * entries removed, or -1 on error.
+ */
+int tc_remove_mac(const char *dev, const char *mac);
+
+/* Builds, without sending it, the RTM_NEWTFILTER request tc_add_mac()
+ * makes for mac: the egress filter into classid, or with ingress set
+ * the policer at rate.  Copies it to buf and returns its length, or -1
+ * if it does not fit.
+ */
+int tc_mac_filter_msg(const char *mac,
+                      int ifindex,
+                      bool ingress,
+                      uint32_t classid,
+                      uint64_t rate,
+                      void *buf,
+                      size_t size);
+
+/* Formats a handle the way tc does, e.g. "1:10" */
+void tc_handle_str(uint32_t handle, char *buf, size_t size);
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
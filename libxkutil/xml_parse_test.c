@@ -1,5 +1,8 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include <getopt.h>
 
@@ -7,7 +10,9 @@
 
 #include "device_parsing.h"
 #include "capability_parsing.h"
+#include "acl_parsing.h"
 #include "xmlgen.h"
+#include "alloc_count.h"
 
 static void print_value(FILE *d, const char *name, const char *val)
 {
@@ -195,6 +200,96 @@ static void print_domxml(struct domain *dominfo,
         free(xml);
 }
 
+static int compare_xml(const char *what, char *stream, char *tree)
+{
+        int ret = 0;
+
+        if ((stream == NULL) && (tree == NULL))
+                ret = 1;
+        else if ((stream == NULL) || (tree == NULL))
+                printf("%s: generated by only one of stream and tree\n",
+                       what);
+        else if (!STREQ(stream, tree))
+                printf("%s: stream and tree XML differ\n"
+                       "-- stream --\n%s\n-- tree --\n%s\n",
+                       what, stream, tree);
+        else
+                ret = 1;
+
+        free(stream);
+        free(tree);
+
+        return ret;
+}
+
+static int compare_devices(const char *what,
+                           struct virt_device *list,
+                           int count)
+{
+        int i;
+        int ret = 1;
+
+        for (i = 0; i < count; i++) {
+                if (list[i].id == NULL)
+                        continue;
+
+                ret &= compare_xml(what,
+                                   device_to_xml(&list[i]),
+                                   device_to_xml_tree(&list[i]));
+        }
+
+        return ret;
+}
+
+/* Check the streaming generator against the libxml2 tree builder, both
+ * for the parsed domain and for what its own output parses back into.
+ */
+static int roundtrip_domxml(struct domain *dominfo)
+{
+        struct domain *copy = NULL;
+        char *xml;
+        int ret;
+
+        ret = compare_xml("domain",
+                          system_to_xml(dominfo),
+                          system_to_xml_tree(dominfo));
+
+        ret &= compare_devices("disk",
+                               dominfo->dev_disk,
+                               dominfo->dev_disk_ct);
+        ret &= compare_devices("net",
+                               dominfo->dev_net,
+                               dominfo->dev_net_ct);
+        ret &= compare_devices("graphics",
+                               dominfo->dev_graphics,
+                               dominfo->dev_graphics_ct);
+        ret &= compare_devices("console",
+                               dominfo->dev_console,
+                               dominfo->dev_console_ct);
+        ret &= compare_devices("input",
+                               dominfo->dev_input,
+                               dominfo->dev_input_ct);
+        ret &= compare_devices("controller",
+                               dominfo->dev_controller,
+                               dominfo->dev_controller_ct);
+
+        xml = system_to_xml(dominfo);
+        if ((xml == NULL) || (get_dominfo_from_xml(xml, &copy) == 0)) {
+                printf("domain: unable to parse generated XML\n");
+                ret = 0;
+        } else
+                ret &= compare_xml("reparsed domain",
+                                   system_to_xml(copy),
+                                   system_to_xml_tree(copy));
+
+        free(xml);
+        cleanup_dominfo(&copy);
+
+        printf("Round trip %s\n", ret ? "passed" : "FAILED");
+
+        return ret;
+}
+
 static char *read_from_file(FILE *file)
 {
         char *xml = NULL;
@@ -367,16 +462,599 @@ static int dominfo_from_file(const char *fname, struct domain **d)
         return ret;
 }
 
+/*
+ * Benchmark mode: times the parsers and generators over generated
+ * corpora.  Heap allocations, libxml2's included, are counted by
+ * alloc_count.c.
+ */
+
+struct bench_corpus {
+        const char *name;
+        int disks;
+        int nics;
+        int consoles;
+        int controllers;
+};
+
+static const struct bench_corpus corpora[] = {
+        {"small",     1,  1,  1,  1},
+        {"disk64",   64,  1,  1,  1},
+        {"net32",     1, 32,  1,  1},
+        {"chardev",   1,  1, 32, 16},
+        {NULL,        0,  0,  0,  0}
+};
+
+static const char *controller_types[] = {
+        "virtio-serial", "scsi", "usb", "sata"
+};
+
+static void disk_target(char *buf, size_t size, int index)
+{
+        char letters[8];
+        int i = sizeof(letters) - 1;
+
+        letters[i] = '\0';
+        do {
+                letters[--i] = 'a' + (index % 26);
+                index = (index / 26) - 1;
+        } while ((index >= 0) && (i > 0));
+
+        snprintf(buf, size, "vd%s", &letters[i]);
+}
+
+static char *gen_domain(const struct bench_corpus *corpus)
+{
+        char *xml = NULL;
+        size_t size = 0;
+        char target[16];
+        FILE *out;
+        int i;
+
+        out = open_memstream(&xml, &size);
+        if (out == NULL)
+                return NULL;
+
+        fprintf(out,
+                "<domain type='kvm'>\n"
+                "  <name>bench-%s</name>\n"
+                "  <uuid>6c5b7a4e-0d6f-4e0a-9b43-5d1e0c2a%04x</uuid>\n"
+                "  <memory>1048576</memory>\n"
+                "  <currentMemory>1048576</currentMemory>\n"
+                "  <vcpu>2</vcpu>\n"
+                "  <os>\n"
+                "    <type arch='x86_64' machine='pc'>hvm</type>\n"
+                "    <boot dev='hd'/>\n"
+                "  </os>\n"
+                "  <features><acpi/><apic/><pae/></features>\n"
+                "  <clock offset='utc'/>\n"
+                "  <on_poweroff>destroy</on_poweroff>\n"
+                "  <on_reboot>restart</on_reboot>\n"
+                "  <on_crash>destroy</on_crash>\n"
+                "  <devices>\n"
+                "    <emulator>/usr/bin/qemu-kvm</emulator>\n",
+                corpus->name,
+                corpus->disks);
+
+        for (i = 0; i < corpus->disks; i++) {
+                disk_target(target, sizeof(target), i);
+                fprintf(out,
+                        "    <disk type='file' device='disk'>\n"
+                        "      <driver name='qemu' type='qcow2'/>\n"
+                        "      <source file='/var/lib/libvirt/images/"
+                        "bench-%s-%d.qcow2'/>\n"
+                        "      <target dev='%s' bus='virtio'/>\n"
+                        "    </disk>\n",
+                        corpus->name, i, target);
+        }
+
+        for (i = 0; i < corpus->nics; i++)
+                fprintf(out,
+                        "    <interface type='network'>\n"
+                        "      <mac address='52:54:00:00:%02x:%02x'/>\n"
+                        "      <source network='default'/>\n"
+                        "      <model type='virtio'/>\n"
+                        "    </interface>\n",
+                        (i >> 8) & 0xff, i & 0xff);
+
+        for (i = 0; i < corpus->controllers; i++)
+                fprintf(out,
+                        "    <controller type='%s' index='%d'/>\n",
+                        controller_types[i % 4], i / 4);
+
+        for (i = 0; i < corpus->consoles; i++)
+                fprintf(out,
+                        "    <console type='pty'>\n"
+                        "      <target type='%s' port='%d'/>\n"
+                        "    </console>\n",
+                        i == 0 ? "serial" : "virtio", i);
+
+        fprintf(out,
+                "    <input type='tablet' bus='usb'/>\n"
+                "    <input type='mouse' bus='ps2'/>\n"
+                "    <graphics type='vnc' port='-1' autoport='yes' "
+                "listen='127.0.0.1' keymap='en-us'/>\n"
+                "  </devices>\n"
+                "</domain>\n");
+
+        if (fclose(out) != 0) {
+                free(xml);
+                return NULL;
+        }
+
+        return xml;
+}
+
+static char *gen_filter(int rules)
+{
+        const char *protocols[] = {"tcp", "udp", "icmp", "all"};
+        char *xml = NULL;
+        size_t size = 0;
+        FILE *out;
+        int i;
+
+        out = open_memstream(&xml, &size);
+        if (out == NULL)
+                return NULL;
+
+        fprintf(out,
+                "<filter name='bench-filter' chain='ipv4' priority='-700'>\n"
+                "  <uuid>0f0e0d0c-0b0a-0908-0706-050403020100</uuid>\n");
+
+        for (i = 0; i < rules; i++) {
+                const char *proto = protocols[i % 4];
+
+                fprintf(out,
+                        "  <rule action='%s' direction='inout' "
+                        "priority='%d'>\n",
+                        i % 2 ? "drop" : "accept", 100 + i);
+
+                if (STREQ(proto, "tcp") || STREQ(proto, "udp"))
+                        fprintf(out,
+                                "    <%s srcipaddr='10.0.%d.%d' "
+                                "srcipmask='24' dstportstart='%d' "
+                                "dstportend='%d'/>\n",
+                                proto, i / 256, i % 256,
+                                1024 + i, 2048 + i);
+                else
+                        fprintf(out,
+                                "    <%s srcipaddr='10.1.%d.%d' "
+                                "state='NEW'/>\n",
+                                proto, i / 256, i % 256);
+
+                fprintf(out, "  </rule>\n");
+        }
+
+        fprintf(out,
+                "  <filterref filter='clean-traffic'/>\n"
+                "</filter>\n");
+
+        if (fclose(out) != 0) {
+                free(xml);
+                return NULL;
+        }
+
+        return xml;
+}
+
+static char *gen_caps(int machines)
+{
+        const struct {
+                const char *name;
+                int wordsize;
+        } arches[] = {
+                {"i686", 32},
+                {"x86_64", 64},
+                {"aarch64", 64},
+                {"ppc64", 64},
+        };
+        char *xml = NULL;
+        size_t size = 0;
+        FILE *out;
+        int i;
+        int j;
+
+        out = open_memstream(&xml, &size);
+        if (out == NULL)
+                return NULL;
+
+        fprintf(out,
+                "<capabilities>\n"
+                "  <host>\n"
+                "    <cpu><arch>x86_64</arch></cpu>\n"
+                "  </host>\n");
+
+        for (i = 0; i < 4; i++) {
+                fprintf(out,
+                        "  <guest>\n"
+                        "    <os_type>hvm</os_type>\n"
+                        "    <arch name='%s'>\n"
+                        "      <wordsize>%d</wordsize>\n"
+                        "      <emulator>/usr/bin/qemu-system-%s</emulator>\n",
+                        arches[i].name, arches[i].wordsize, arches[i].name);
+
+                for (j = 0; j < machines; j++)
+                        fprintf(out,
+                                "      <machine canonical='pc-1.%d'>"
+                                "pc-%d</machine>\n",
+                                j, j);
+
+                fprintf(out, "      <domain type='qemu'/>\n");
+
+                if (i == 1) {
+                        fprintf(out,
+                                "      <domain type='kvm'>\n"
+                                "        <emulator>/usr/bin/qemu-kvm"
+                                "</emulator>\n");
+                        for (j = 0; j < machines; j++)
+                                fprintf(out,
+                                        "        <machine>pc-%d</machine>\n",
+                                        j);
+                        fprintf(out, "      </domain>\n");
+                }
+
+                fprintf(out,
+                        "    </arch>\n"
+                        "    <features><acpi default='on' toggle='yes'/>"
+                        "</features>\n"
+                        "  </guest>\n");
+        }
+
+        fprintf(out, "</capabilities>\n");
+
+        if (fclose(out) != 0) {
+                free(xml);
+                return NULL;
+        }
+
+        return xml;
+}
+
+static int bench_parse_domain(void *arg)
+{
+        struct domain *dominfo = NULL;
+        int ret;
+
+        ret = get_dominfo_from_xml(arg, &dominfo);
+        cleanup_dominfo(&dominfo);
+
+        return ret;
+}
+
+static int bench_parse_domain_arena(void *arg)
+{
+        struct domain *dominfo = NULL;
+        struct arena *arena;
+        int ret;
+
+        arena = arena_new();
+        if (arena == NULL)
+                return 0;
+
+        ret = get_dominfo_from_xml_arena(arg, arena, &dominfo);
+        arena_free(arena);
+
+        return ret;
+}
+
+static int bench_system_xml(void *arg)
+{
+        char *xml;
+
+        xml = system_to_xml(arg);
+        free(xml);
+
+        return xml != NULL;
+}
+
+/* Returns the total length of the device XML, or 0 if none was built */
+static size_t bench_device_xml_len(struct domain *dominfo)
+{
+        struct {
+                struct virt_device *list;
+                int count;
+        } lists[] = {
+                {dominfo->dev_disk, dominfo->dev_disk_ct},
+                {dominfo->dev_net, dominfo->dev_net_ct},
+                {dominfo->dev_graphics, dominfo->dev_graphics_ct},
+                {dominfo->dev_console, dominfo->dev_console_ct},
+                {dominfo->dev_input, dominfo->dev_input_ct},
+                {dominfo->dev_controller, dominfo->dev_controller_ct},
+        };
+        size_t len = 0;
+        unsigned int l;
+        int i;
+
+        for (l = 0; l < sizeof(lists) / sizeof(lists[0]); l++) {
+                for (i = 0; i < lists[l].count; i++) {
+                        char *xml;
+
+                        if (lists[l].list[i].id == NULL)
+                                continue;
+
+                        xml = device_to_xml(&lists[l].list[i]);
+                        if (xml != NULL)
+                                len += strlen(xml);
+                        free(xml);
+                }
+        }
+
+        return len;
+}
+
+static int bench_device_xml(void *arg)
+{
+        return bench_device_xml_len(arg) > 0;
+}
+
+static int bench_parse_filter(void *arg)
+{
+        struct acl_filter *filter = NULL;
+        int ret;
+
+        ret = get_filter_from_xml(arg, &filter);
+        cleanup_filter(filter);
+        free(filter);
+
+        return ret;
+}
+
+static int bench_parse_caps(void *arg)
+{
+        struct capabilities *caps = NULL;
+        int ret;
+
+        ret = get_caps_from_xml(arg, &caps);
+        cleanup_capabilities(&caps);
+
+        return ret;
+}
+
+static double bench_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int bench_run(const char *corpus,
+                     const char *op,
+                     int (*func)(void *arg),
+                     void *arg,
+                     size_t bytes,
+                     int iterations)
+{
+        uint64_t allocs_start;
+        uint64_t bytes_start;
+        uint64_t allocs;
+        uint64_t alloc_bytes;
+        double start;
+        double elapsed;
+        int i;
+
+        /* Also warms up libxml2 */
+        if (!func(arg)) {
+                printf("%-8s %-14s FAILED\n", corpus, op);
+                return 0;
+        }
+
+        alloc_count_get(&allocs_start, &bytes_start);
+        start = bench_now();
+
+        for (i = 0; i < iterations; i++)
+                func(arg);
+
+        elapsed = bench_now() - start;
+        alloc_count_get(&allocs, &alloc_bytes);
+        allocs -= allocs_start;
+        alloc_bytes -= bytes_start;
+
+        printf("%-8s %-14s %9zu %10.2f %9.1f %10.1f %12.1f\n",
+               corpus,
+               op,
+               bytes,
+               (elapsed * 1e6) / iterations,
+               ((double)bytes * iterations) / elapsed / (1024 * 1024),
+               (double)allocs / iterations,
+               (double)alloc_bytes / iterations);
+
+        return 1;
+}
+
+/* Graphics are left out: the parser also reports each pty console as a
+ * graphics device, which is never generated back as such.
+ */
+static int bench_same_devices(struct domain *a, struct domain *b)
+{
+        return (a->dev_disk_ct == b->dev_disk_ct) &&
+                (a->dev_net_ct == b->dev_net_ct) &&
+                (a->dev_input_ct == b->dev_input_ct) &&
+                (a->dev_controller_ct == b->dev_controller_ct) &&
+                (a->dev_mem_ct == b->dev_mem_ct) &&
+                (a->dev_vcpu_ct == b->dev_vcpu_ct);
+}
+
+/* parse -> generate -> parse -> generate must be stable, and the first
+ * parse must find every generated device.  Consoles are only checked on
+ * the first parse: xmlgen leaves the target port to libvirt, and the
+ * parser skips consoles without one.
+ */
+static int bench_roundtrip(const struct bench_corpus *corpus, const char *xml)
+{
+        struct domain *first = NULL;
+        struct domain *second = NULL;
+        char *gen1 = NULL;
+        char *gen2 = NULL;
+        int ret = 0;
+
+        if (!get_dominfo_from_xml(xml, &first))
+                goto out;
+
+        if ((first->dev_disk_ct != corpus->disks) ||
+            (first->dev_net_ct != corpus->nics) ||
+            (first->dev_console_ct != corpus->consoles) ||
+            (first->dev_controller_ct != corpus->controllers)) {
+                printf("%-8s parsed %d disks, %d nics, %d consoles, "
+                       "%d controllers\n",
+                       corpus->name,
+                       first->dev_disk_ct,
+                       first->dev_net_ct,
+                       first->dev_console_ct,
+                       first->dev_controller_ct);
+                goto out;
+        }
+
+        cleanup_virt_devices(&first->dev_console, first->dev_console_ct);
+        first->dev_console_ct = 0;
+
+        gen1 = system_to_xml(first);
+        if ((gen1 == NULL) || !get_dominfo_from_xml(gen1, &second))
+                goto out;
+
+        gen2 = system_to_xml(second);
+        if (gen2 == NULL)
+                goto out;
+
+        if (!STREQ(gen1, gen2)) {
+                printf("%-8s regenerated XML differs\n"
+                       "-- first --\n%s\n-- second --\n%s\n",
+                       corpus->name, gen1, gen2);
+                goto out;
+        }
+
+        ret = bench_same_devices(first, second);
+ out:
+        printf("%-8s round trip %s\n", corpus->name, ret ? "ok" : "FAILED");
+
+        free(gen1);
+        free(gen2);
+        cleanup_dominfo(&first);
+        cleanup_dominfo(&second);
+
+        return ret;
+}
+
+/* A domain parsed into an arena must generate the same XML */
+static int bench_arena_check(const struct bench_corpus *corpus,
+                             const char *xml,
+                             const char *expected)
+{
+        struct domain *dominfo = NULL;
+        struct arena *arena;
+        char *gen = NULL;
+        int ret = 0;
+
+        arena = arena_new();
+        if (arena == NULL)
+                goto out;
+
+        if (!get_dominfo_from_xml_arena(xml, arena, &dominfo))
+                goto out;
+
+        gen = system_to_xml(dominfo);
+        ret = (gen != NULL) && (expected != NULL) && STREQ(gen, expected);
+
+        printf("%-8s arena parse %s, %zu bytes\n",
+               corpus->name,
+               ret ? "ok" : "FAILED",
+               arena_used(arena));
+ out:
+        free(gen);
+        arena_free(arena);
+
+        return ret;
+}
+
+static int bench_domain(const struct bench_corpus *corpus, int iterations)
+{
+        struct domain *dominfo = NULL;
+        char *xml;
+        char *gen;
+        size_t gen_len;
+        int ret = 0;
+
+        xml = gen_domain(corpus);
+        if ((xml == NULL) || !get_dominfo_from_xml(xml, &dominfo)) {
+                printf("%-8s unable to parse generated XML\n", corpus->name);
+                goto out;
+        }
+
+        gen = system_to_xml(dominfo);
+        gen_len = gen != NULL ? strlen(gen) : 0;
+
+        ret = bench_run(corpus->name, "parse",
+                        bench_parse_domain, xml, strlen(xml),
+                        iterations);
+        ret &= bench_run(corpus->name, "parse (arena)",
+                         bench_parse_domain_arena, xml, strlen(xml),
+                         iterations);
+        ret &= bench_run(corpus->name, "system_to_xml",
+                         bench_system_xml, dominfo, gen_len,
+                         iterations);
+        ret &= bench_run(corpus->name, "device_to_xml",
+                         bench_device_xml, dominfo,
+                         bench_device_xml_len(dominfo),
+                         iterations);
+        ret &= bench_roundtrip(corpus, xml);
+        ret &= bench_arena_check(corpus, xml, gen);
+
+        free(gen);
+ out:
+        cleanup_dominfo(&dominfo);
+        free(xml);
+
+        return ret;
+}
+
+static int bench_all(int iterations)
+{
+        char *xml;
+        int ret = 1;
+        int i;
+
+        printf("%-8s %-14s %9s %10s %9s %10s %12s\n",
+               "corpus", "operation", "bytes", "us/op", "MB/s",
+               "allocs/op", "alloc B/op");
+
+        for (i = 0; corpora[i].name != NULL; i++)
+                ret &= bench_domain(&corpora[i], iterations);
+
+        xml = gen_filter(64);
+        if (xml != NULL)
+                ret &= bench_run("filter64", "parse",
+                                 bench_parse_filter, xml, strlen(xml),
+                                 iterations);
+        else
+                ret = 0;
+        free(xml);
+
+        xml = gen_caps(16);
+        if (xml != NULL)
+                ret &= bench_run("caps", "parse",
+                                 bench_parse_caps, xml, strlen(xml),
+                                 iterations);
+        else
+                ret = 0;
+        free(xml);
+
+        return ret;
+}
+
 static void usage(void)
 {
-        printf("xml_parse_test -f [FILE | -] [--xml]\n"
+        printf("xml_parse_test -f [FILE | -] [--xml | --roundtrip]\n"
                "xml_parse_test -d domain [--uri URI] [--xml] [--cap]\n"
+               "xml_parse_test --bench [--iterations N]\n"
                "\n"
                "-f,--file FILE    Parse domain XML from file (or stdin if -)\n"
                "-d,--domain DOM   Display dominfo for a domain from libvirt\n"
                "-u,--uri URI      Connect to libvirt with URI\n"
                "-x,--xml          Dump generated XML instead of summary\n"
+               "-r,--roundtrip    Check streamed XML against the tree builder\n"
                "-c,--cap          Display the libvirt default capability values for the specified domain\n"
+               "-b,--bench        Time the parsers and generators on generated XML\n"
+               "-n,--iterations N Iterations per benchmark (default 1000)\n"
                "-h,--help         Display this help message\n");
 }
 
@@ -388,6 +1066,9 @@ int main(int argc, char **argv)
         char *file = NULL;
         bool xml = false;
         bool cap = false;
+        bool roundtrip = false;
+        bool bench = false;
+        int iterations = 1000;
         struct domain *dominfo = NULL;
         struct capabilities *capsinfo = NULL;
         struct cap_domain_info *capgdinfo = NULL;
@@ -399,13 +1080,16 @@ int main(int argc, char **argv)
                 {"xml",    0, 0, 'x'},
                 {"file",   1, 0, 'f'},
                 {"cap",    0, 0, 'c'},
+                {"roundtrip", 0, 0, 'r'},
+                {"bench",  0, 0, 'b'},
+                {"iterations", 1, 0, 'n'},
                 {"help",   0, 0, 'h'},
                 {0,        0, 0, 0}};
 
         while (1) {
                 int optidx = 0;
 
-                c = getopt_long(argc, argv, "d:u:f:xch", lopts, &optidx);
+                c = getopt_long(argc, argv, "d:u:f:xcrbn:h", lopts, &optidx);
                 if (c == -1)
                         break;
 
@@ -430,6 +1114,18 @@ int main(int argc, char **argv)
                         cap = true;
                         break;
 
+                case 'r':
+                        roundtrip = true;
+                        break;
+
+                case 'b':
+                        bench = true;
+                        break;
+
+                case 'n':
+                        iterations = atoi(optarg);
+                        break;
+
                 case '?':
                 case 'h':
                         usage();
@@ -437,6 +1133,15 @@ int main(int argc, char **argv)
                 };
         }
 
+        if (bench) {
+                if (iterations <= 0) {
+                        usage();
+                        return 1;
+                }
+
+                return bench_all(iterations) ? 0 : 4;
+        }
+
         if (file != NULL)
                 ret = dominfo_from_file(file, &dominfo);
         else if (domain != NULL)
@@ -451,7 +1156,10 @@ int main(int argc, char **argv)
                 return 2;
         }
 
-        if (xml)
+        if (roundtrip) {
+                if (!roundtrip_domxml(dominfo))
+                        return 4;
+        } else if (xml)
                 print_domxml(dominfo, stdout);
         else {
                 print_dominfo(dominfo, stdout);
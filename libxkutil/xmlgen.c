@@ -38,15 +38,402 @@
 
 #define XML_ERROR "Failed to allocate XML memory"
 
-typedef const char *(*devfn_t)(xmlNodePtr node, struct domain *dominfo);
+/* Domain and device XML is built through xml_child() and xml_prop(),
+ * which either append to a libxml2 tree (serialized by tree_to_xml(),
+ * the reference path) or stream escaped, already formatted text into a
+ * single growable buffer that is handed back to the caller as-is.  The
+ * stream reproduces the XML_SAVE_FORMAT output byte for byte.  Anything
+ * it cannot express in one pass (an attribute added after a child,
+ * mixed content, text that libxml2 would entity-parse or re-encode)
+ * marks the writer failed, and generate_xml() starts over on the tree.
+ */
+#define XML_STREAM_DEPTH 16
+#define XML_STREAM_SIZE 4096
+#define XML_NODE_CHUNK 32
+
+struct xml_writer;
+
+struct xml_node {
+        struct xml_writer *w;
+        xmlNodePtr node;
+        int depth;
+        unsigned int serial;
+};
+
+struct xml_node_chunk {
+        struct xml_node_chunk *next;
+        int used;
+        struct xml_node nodes[XML_NODE_CHUNK];
+};
+
+struct xml_writer {
+        bool stream;
+        bool failed;
+        struct xml_node *doc;
+        struct xml_node_chunk *chunks;
+        unsigned int serial;
+
+        /* Stream state; the bottom of the element stack is the document */
+        char *buf;
+        size_t len;
+        size_t size;
+        char *text;
+        size_t text_len;
+        size_t text_size;
+        bool tag_open;
+        int roots;
+        int depth;
+        const char *names[XML_STREAM_DEPTH];
+        unsigned int serials[XML_STREAM_DEPTH];
+};
+
+static struct xml_node *xml_node_new(struct xml_writer *w)
+{
+        struct xml_node_chunk *chunk = w->chunks;
+        struct xml_node *node;
+
+        if ((chunk == NULL) || (chunk->used == XML_NODE_CHUNK)) {
+                chunk = calloc(1, sizeof(*chunk));
+                if (chunk == NULL)
+                        return NULL;
+
+                chunk->next = w->chunks;
+                w->chunks = chunk;
+        }
+
+        node = &chunk->nodes[chunk->used++];
+        node->w = w;
+        node->serial = ++w->serial;
+
+        return node;
+}
+
+static bool stream_grow(struct xml_writer *w, size_t count)
+{
+        size_t size;
+        char *buf;
+
+        if (w->len + count < w->size)
+                return true;
+
+        size = (w->size == 0) ? XML_STREAM_SIZE : w->size;
+        while (size <= w->len + count)
+                size *= 2;
+
+        buf = realloc(w->buf, size);
+        if (buf == NULL) {
+                w->failed = true;
+                return false;
+        }
+
+        w->buf = buf;
+        w->size = size;
+
+        return true;
+}
+
+static void stream_write(struct xml_writer *w, const char *str, size_t len)
+{
+        if (!stream_grow(w, len))
+                return;
+
+        memcpy(w->buf + w->len, str, len);
+        w->len += len;
+        w->buf[w->len] = '\0';
+}
+
+static void stream_puts(struct xml_writer *w, const char *str)
+{
+        stream_write(w, str, strlen(str));
+}
+
+static void stream_indent(struct xml_writer *w, int depth)
+{
+        size_t count = 2 * (depth - 1);
+
+        if (!stream_grow(w, count))
+                return;
+
+        memset(w->buf + w->len, ' ', count);
+        w->len += count;
+        w->buf[w->len] = '\0';
+}
+
+/* Only plain ASCII is streamed: libxml2 turns other bytes into character
+ * references and entity-parses '&' in xmlNewChild() content, so those
+ * values go through the tree instead.
+ */
+static bool stream_safe(const char *str, bool attr)
+{
+        const unsigned char *p;
+
+        for (p = (const unsigned char *)str; *p != '\0'; p++) {
+                if (*p >= 0x80)
+                        return false;
+                if ((*p < 0x20) && (*p != '\n') && (*p != '\t'))
+                        return false;
+                if (!attr && (*p == '&'))
+                        return false;
+        }
+
+        return true;
+}
+
+static void stream_escape(struct xml_writer *w, const char *str, bool attr)
+{
+        const char *run = str;
+        const char *p;
+        const char *esc;
+
+        for (p = str; *p != '\0'; p++) {
+                switch (*p) {
+                case '<':
+                        esc = "&lt;";
+                        break;
+                case '>':
+                        esc = "&gt;";
+                        break;
+                case '&':
+                        esc = "&amp;";
+                        break;
+                case '"':
+                        esc = attr ? "&quot;" : NULL;
+                        break;
+                case '\n':
+                        esc = attr ? "&#10;" : NULL;
+                        break;
+                case '\t':
+                        esc = attr ? "&#9;" : NULL;
+                        break;
+                default:
+                        esc = NULL;
+                }
+
+                if (esc == NULL)
+                        continue;
+
+                stream_write(w, run, p - run);
+                stream_puts(w, esc);
+                run = p + 1;
+        }
+
+        stream_write(w, run, p - run);
+}
+
+static void stream_end(struct xml_writer *w)
+{
+        int top = w->depth - 1;
+        const char *name = w->names[top];
+
+        if (w->tag_open && (w->text_len > 0)) {
+                stream_puts(w, ">");
+                stream_escape(w, w->text, false);
+                stream_puts(w, "</");
+                stream_puts(w, name);
+                stream_puts(w, ">");
+                w->text_len = 0;
+        } else if (w->tag_open) {
+                stream_puts(w, "/>");
+        } else {
+                stream_indent(w, top);
+                stream_puts(w, "</");
+                stream_puts(w, name);
+                stream_puts(w, ">");
+        }
+
+        w->depth = top;
+        w->tag_open = false;
+
+        if (w->depth > 1)
+                stream_puts(w, "\n");
+}
+
+static bool stream_set_text(struct xml_writer *w, const char *text)
+{
+        size_t len = strlen(text);
+        char *buf;
+
+        if (len >= w->text_size) {
+                buf = realloc(w->text, len + 1);
+                if (buf == NULL)
+                        return false;
+
+                w->text = buf;
+                w->text_size = len + 1;
+        }
+
+        memcpy(w->text, text, len + 1);
+        w->text_len = len;
+
+        return true;
+}
+
+static bool stream_is_open(struct xml_node *node)
+{
+        struct xml_writer *w = node->w;
+
+        return (node->depth < w->depth) &&
+                (w->serials[node->depth] == node->serial);
+}
+
+static struct xml_node *stream_child(struct xml_node *parent,
+                                     struct xml_node *node,
+                                     const char *name,
+                                     const char *content)
+{
+        struct xml_writer *w = parent->w;
+
+        if (!stream_is_open(parent) || (parent->depth + 1 >= XML_STREAM_DEPTH))
+                goto fail;
+
+        if ((content != NULL) && !stream_safe(content, false))
+                goto fail;
+
+        while (w->depth > parent->depth + 1)
+                stream_end(w);
+
+        if (parent->depth == 0) {
+                /* tree_to_xml() only ever saves the first top-level node */
+                if (w->roots++ > 0)
+                        goto fail;
+        } else if (w->tag_open) {
+                if (w->text_len > 0)
+                        goto fail;
+                stream_puts(w, ">\n");
+        }
+
+        stream_indent(w, w->depth);
+        stream_puts(w, "<");
+        stream_puts(w, name);
+
+        node->depth = w->depth;
+        w->names[w->depth] = name;
+        w->serials[w->depth] = node->serial;
+        w->depth++;
+        w->tag_open = true;
+
+        if ((content != NULL) && !stream_set_text(w, content))
+                goto fail;
+
+        if (w->failed)
+                return NULL;
+
+        return node;
+ fail:
+        w->failed = true;
+
+        return NULL;
+}
+
+/* Element names must outlive the writer; every caller passes a literal */
+static struct xml_node *xml_child(struct xml_node *parent,
+                                  const char *name,
+                                  const char *content)
+{
+        struct xml_node *node;
+
+        if ((parent == NULL) || parent->w->failed)
+                return NULL;
+
+        node = xml_node_new(parent->w);
+        if (node == NULL)
+                return NULL;
+
+        if (parent->w->stream)
+                return stream_child(parent, node, name, content);
+
+        node->node = xmlNewChild(parent->node,
+                                 NULL,
+                                 BAD_CAST name,
+                                 BAD_CAST content);
+        if (node->node == NULL)
+                return NULL;
+
+        return node;
+}
+
+static bool xml_prop(struct xml_node *node,
+                     const char *name,
+                     const char *value)
+{
+        struct xml_writer *w;
+
+        if (node == NULL)
+                return false;
+
+        w = node->w;
+        if (!w->stream)
+                return xmlNewProp(node->node,
+                                  BAD_CAST name,
+                                  BAD_CAST value) != NULL;
+
+        if (w->failed)
+                return false;
+
+        if ((node->depth != w->depth - 1) || !w->tag_open ||
+            !stream_is_open(node) ||
+            ((value != NULL) && !stream_safe(value, true))) {
+                w->failed = true;
+                return false;
+        }
+
+        stream_puts(w, " ");
+        stream_puts(w, name);
+        stream_puts(w, "=\"");
+        if (value != NULL)
+                stream_escape(w, value, true);
+        stream_puts(w, "\"");
+
+        return !w->failed;
+}
+
+static struct xml_node *xml_writer_init(struct xml_writer *w, bool stream)
+{
+        memset(w, 0, sizeof(*w));
+        w->stream = stream;
+
+        w->doc = xml_node_new(w);
+        if (w->doc == NULL)
+                return NULL;
+
+        if (stream) {
+                w->serials[0] = w->doc->serial;
+                w->depth = 1;
+        } else {
+                w->doc->node = xmlNewNode(NULL, BAD_CAST "tmp");
+                if (w->doc->node == NULL)
+                        return NULL;
+        }
+
+        return w->doc;
+}
+
+static void xml_writer_free(struct xml_writer *w)
+{
+        struct xml_node_chunk *chunk;
+
+        if ((w->doc != NULL) && (w->doc->node != NULL))
+                xmlFreeNode(w->doc->node);
+
+        while (w->chunks != NULL) {
+                chunk = w->chunks;
+                w->chunks = chunk->next;
+                free(chunk);
+        }
+
+        free(w->buf);
+        free(w->text);
+}
+
+typedef const char *(*devfn_t)(struct xml_node *node, struct domain *dominfo);
 typedef const char *(*poolfn_t)(xmlNodePtr node, struct virt_pool *pool);
 typedef const char *(*resfn_t)(xmlNodePtr node, struct virt_pool_res *res);
 
-static const char *console_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *console_xml(struct xml_node *root, struct domain *dominfo)
 {
         int i;
-        xmlNodePtr console;
-        xmlNodePtr tmp;
+        struct xml_node *console;
+        struct xml_node *tmp;
 
         for (i = 0; i < dominfo->dev_console_ct; i++) {
                 struct virt_device *_dev = &dominfo->dev_console[i];
@@ -55,108 +442,87 @@ static const char *console_xml(xmlNodePtr root, struct domain *dominfo)
 
                 struct console_device *cdev = &_dev->dev.console;
 
-                console = xmlNewChild(root, NULL, BAD_CAST "console", NULL);
+                console = xml_child(root, "console", NULL);
                 if (console == NULL)
                         return XML_ERROR;
 
-                xmlNewProp(console, BAD_CAST "type",
-                           BAD_CAST
-                           chardev_source_type_IDToStr(cdev->source_type));
+                xml_prop(console, "type",
+                         chardev_source_type_IDToStr(cdev->source_type));
 
                 switch (cdev->source_type) {
                 case CIM_CHARDEV_SOURCE_TYPE_PTY:
                         /* The path property is not mandatory */
                         if (cdev->source_dev.pty.path) {
-                                tmp = xmlNewChild(console, NULL,
-                                                  BAD_CAST "source", NULL);
+                                tmp = xml_child(console, "source", NULL);
                                 if (tmp == NULL)
                                         return XML_ERROR;
-                                xmlNewProp(tmp, BAD_CAST "path",
-                                           BAD_CAST cdev->source_dev.pty.path);
+                                xml_prop(tmp, "path",
+                                         cdev->source_dev.pty.path);
                         }
                         break;
                 case CIM_CHARDEV_SOURCE_TYPE_DEV:
-                        tmp = xmlNewChild(console, NULL,
-                                          BAD_CAST "source", NULL);
+                        tmp = xml_child(console, "source", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "path",
-                                   BAD_CAST cdev->source_dev.dev.path);
+                        xml_prop(tmp, "path", cdev->source_dev.dev.path);
                         break;
                 case CIM_CHARDEV_SOURCE_TYPE_FILE:
-                        tmp = xmlNewChild(console, NULL,
-                                          BAD_CAST "source", NULL);
+                        tmp = xml_child(console, "source", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "path",
-                                   BAD_CAST cdev->source_dev.file.path);
+                        xml_prop(tmp, "path", cdev->source_dev.file.path);
                         break;
                 case CIM_CHARDEV_SOURCE_TYPE_PIPE:
-                        tmp = xmlNewChild(console, NULL,
-                                          BAD_CAST "source", NULL);
+                        tmp = xml_child(console, "source", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "path",
-                                   BAD_CAST cdev->source_dev.pipe.path);
+                        xml_prop(tmp, "path", cdev->source_dev.pipe.path);
                         break;
                 case CIM_CHARDEV_SOURCE_TYPE_UNIXSOCK:
-                        tmp = xmlNewChild(console, NULL,
-                                          BAD_CAST "source", NULL);
+                        tmp = xml_child(console, "source", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "mode",
-                                   BAD_CAST cdev->source_dev.unixsock.mode);
-                        xmlNewProp(tmp, BAD_CAST "path",
-                                   BAD_CAST cdev->source_dev.unixsock.path);
+                        xml_prop(tmp, "mode", cdev->source_dev.unixsock.mode);
+                        xml_prop(tmp, "path", cdev->source_dev.unixsock.path);
                         break;
                 case CIM_CHARDEV_SOURCE_TYPE_UDP:
-                        tmp = xmlNewChild(console, NULL,
-                                          BAD_CAST "source", NULL);
+                        tmp = xml_child(console, "source", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "mode", BAD_CAST "bind");
-                        xmlNewProp(tmp, BAD_CAST "host",
-                                   BAD_CAST cdev->source_dev.udp.bind_host);
+                        xml_prop(tmp, "mode", "bind");
+                        xml_prop(tmp, "host", cdev->source_dev.udp.bind_host);
                         /* The service property is not mandatory */
                         if (cdev->source_dev.udp.bind_service)
-                                xmlNewProp(tmp, BAD_CAST "service",
-                                           BAD_CAST
-                                           cdev->source_dev.udp.bind_service);
+                                xml_prop(tmp, "service",
+                                         cdev->source_dev.udp.bind_service);
 
-                        tmp = xmlNewChild(console, NULL,
-                                          BAD_CAST "source", NULL);
+                        tmp = xml_child(console, "source", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "mode", BAD_CAST "connect");
-                        xmlNewProp(tmp, BAD_CAST "host",
-                                   BAD_CAST cdev->source_dev.udp.connect_host);
+                        xml_prop(tmp, "mode", "connect");
+                        xml_prop(tmp, "host",
+                                 cdev->source_dev.udp.connect_host);
                         /* The service property is not mandatory */
                         if (cdev->source_dev.udp.connect_service)
-                                xmlNewProp(tmp, BAD_CAST "service",
-                                           BAD_CAST
-                                           cdev->source_dev.udp.connect_service);
+                                xml_prop(tmp, "service",
+                                         cdev->source_dev.udp.connect_service);
 
                         break;
                 case CIM_CHARDEV_SOURCE_TYPE_TCP:
-                        tmp = xmlNewChild(console, NULL,
-                                          BAD_CAST "source", NULL);
+                        tmp = xml_child(console, "source", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "mode",
-                                   BAD_CAST cdev->source_dev.tcp.mode);
-                        xmlNewProp(tmp, BAD_CAST "host",
-                                   BAD_CAST cdev->source_dev.tcp.host);
+                        xml_prop(tmp, "mode", cdev->source_dev.tcp.mode);
+                        xml_prop(tmp, "host", cdev->source_dev.tcp.host);
                         if (cdev->source_dev.tcp.service)
-                                xmlNewProp(tmp, BAD_CAST "service",
-                                           BAD_CAST
-                                           cdev->source_dev.tcp.service);
+                                xml_prop(tmp, "service",
+                                         cdev->source_dev.tcp.service);
                         if (cdev->source_dev.tcp.protocol) {
-                                tmp = xmlNewChild(console, NULL,
-                                                  BAD_CAST "protocol", NULL);
+                                tmp = xml_child(console, "protocol", NULL);
                                 if (tmp == NULL)
                                         return XML_ERROR;
-                                xmlNewProp(tmp, BAD_CAST "type",
-                                           BAD_CAST cdev->source_dev.tcp.protocol);
+                                xml_prop(tmp, "type",
+                                         cdev->source_dev.tcp.protocol);
                         }
                         break;
                 default:
@@ -170,84 +536,82 @@ static const char *console_xml(xmlNodePtr root, struct domain *dominfo)
                 }
 
                 if (cdev->target_type) {
-                        tmp = xmlNewChild(console, NULL,
-                                          BAD_CAST "target", NULL);
+                        tmp = xml_child(console, "target", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "type",
-                                   BAD_CAST cdev->target_type);
+                        xml_prop(tmp, "type", cdev->target_type);
                 }
         }
 
         return NULL;
 }
 
-static char *device_address_xml(xmlNodePtr root, struct device_address *addr)
+static char *device_address_xml(struct xml_node *root,
+                                struct device_address *addr)
 {
         int i;
-        xmlNodePtr address;
+        struct xml_node *address;
 
         if (addr == NULL || addr->ct == 0)
                 return NULL;
 
-        address = xmlNewChild(root, NULL, BAD_CAST "address", NULL);
+        address = xml_child(root, "address", NULL);
         if (address == NULL)
                 return XML_ERROR;
 
         for (i = 0; i < addr->ct; i++) {
-                xmlNewProp(address, BAD_CAST addr->key[i] , BAD_CAST addr->value[i]);
+                xml_prop(address, addr->key[i], addr->value[i]);
         }
 
         return NULL;
 }
 
-static char *disk_block_xml(xmlNodePtr root, struct disk_device *dev)
+static char *disk_block_xml(struct xml_node *root, struct disk_device *dev)
 {
-        xmlNodePtr disk;
-        xmlNodePtr tmp;
+        struct xml_node *disk;
+        struct xml_node *tmp;
 
-        disk = xmlNewChild(root, NULL, BAD_CAST "disk", NULL);
+        disk = xml_child(root, "disk", NULL);
         if (disk == NULL)
                 return XML_ERROR;
-        xmlNewProp(disk, BAD_CAST "type", BAD_CAST "block");
+        xml_prop(disk, "type", "block");
         if (dev->device)
-                xmlNewProp(disk, BAD_CAST "device", BAD_CAST dev->device);
+                xml_prop(disk, "device", dev->device);
         if (dev->rawio)
-                xmlNewProp(disk, BAD_CAST "rawio", BAD_CAST dev->rawio);
+                xml_prop(disk, "rawio", dev->rawio);
         if (dev->sgio)
-                xmlNewProp(disk, BAD_CAST "sgio", BAD_CAST dev->sgio);
+                xml_prop(disk, "sgio", dev->sgio);
 
         if (dev->driver) {
-                tmp = xmlNewChild(disk, NULL, BAD_CAST "driver", NULL);
+                tmp = xml_child(disk, "driver", NULL);
                 if (tmp == NULL)
                         return XML_ERROR;
-                xmlNewProp(tmp, BAD_CAST "name", BAD_CAST dev->driver);
+                xml_prop(tmp, "name", dev->driver);
                 if (dev->driver_type)
-                        xmlNewProp(tmp, BAD_CAST "type",
-                                   BAD_CAST dev->driver_type);
+                        xml_prop(tmp, "type", dev->driver_type);
                 if (dev->cache)
-                        xmlNewProp(tmp, BAD_CAST "cache", BAD_CAST dev->cache);
+                        xml_prop(tmp, "cache", dev->cache);
         }
 
         if ((dev->source != NULL) && (!XSTREQ(dev->source, "/dev/null"))) {
-                tmp = xmlNewChild(disk, NULL, BAD_CAST "source", NULL);
+                tmp = xml_child(disk, "source", NULL);
                 if (tmp == NULL)
                        return XML_ERROR;
-                xmlNewProp(tmp, BAD_CAST "dev", BAD_CAST dev->source);
+                xml_prop(tmp, "dev", dev->source);
         }
 
-        tmp = xmlNewChild(disk, NULL, BAD_CAST "target", NULL);
+        tmp = xml_child(disk, "target", NULL);
         if (tmp == NULL)
                 return XML_ERROR;
-        xmlNewProp(tmp, BAD_CAST "dev", BAD_CAST dev->virtual_dev);
+        xml_prop(tmp, "dev", dev->virtual_dev);
         if (dev->bus_type)
-                xmlNewProp(tmp, BAD_CAST "bus", BAD_CAST dev->bus_type);
+                xml_prop(tmp, "bus", dev->bus_type);
 
         if (dev->readonly)
-                xmlNewChild(disk, NULL, BAD_CAST "readonly", NULL);
+                xml_child(disk, "readonly", NULL);
 
         if (dev->shareable)
-                xmlNewChild(disk, NULL, BAD_CAST "shareable", NULL);
+                xml_child(disk, "shareable", NULL);
 
         if (dev->address.ct > 0)
                 return device_address_xml(disk, &dev->address);
@@ -255,28 +619,27 @@ static char *disk_block_xml(xmlNodePtr root, struct disk_device *dev)
         return NULL;
 }
 
-static const char *disk_file_xml(xmlNodePtr root, struct disk_device *dev)
+static const char *disk_file_xml(struct xml_node *root, struct disk_device *dev)
 {
-        xmlNodePtr disk;
-        xmlNodePtr tmp;
+        struct xml_node *disk;
+        struct xml_node *tmp;
 
-        disk = xmlNewChild(root, NULL, BAD_CAST "disk", NULL);
+        disk = xml_child(root, "disk", NULL);
         if (disk == NULL)
                 return XML_ERROR;
-        xmlNewProp(disk, BAD_CAST "type", BAD_CAST "file");
+        xml_prop(disk, "type", "file");
         if (dev->device)
-                xmlNewProp(disk, BAD_CAST "device", BAD_CAST dev->device);
+                xml_prop(disk, "device", dev->device);
 
         if (dev->driver) {
-                tmp = xmlNewChild(disk, NULL, BAD_CAST "driver", NULL);
+                tmp = xml_child(disk, "driver", NULL);
                 if (tmp == NULL)
                         return XML_ERROR;
-                xmlNewProp(tmp, BAD_CAST "name", BAD_CAST dev->driver);
+                xml_prop(tmp, "name", dev->driver);
                 if (dev->driver_type)
-                        xmlNewProp(tmp, BAD_CAST "type",
-                                   BAD_CAST dev->driver_type);
+                        xml_prop(tmp, "type", dev->driver_type);
                 if (dev->cache)
-                        xmlNewProp(tmp, BAD_CAST "cache", BAD_CAST dev->cache);
+                        xml_prop(tmp, "cache", dev->cache);
         }
 
         if (dev->device != NULL && XSTREQ(dev->device, "cdrom") &&
@@ -286,25 +649,25 @@ static const char *disk_file_xml(xmlNodePtr root, struct disk_device *dev)
                  xml defination for libvirt should not have this defined in this
                  situation. */
         } else {
-                tmp = xmlNewChild(disk, NULL, BAD_CAST "source", NULL);
+                tmp = xml_child(disk, "source", NULL);
                 if (tmp == NULL)
                         return XML_ERROR;
-                xmlNewProp(tmp, BAD_CAST "file", BAD_CAST dev->source);
+                xml_prop(tmp, "file", dev->source);
         }
 
-        tmp = xmlNewChild(disk, NULL, BAD_CAST "target", NULL);
+        tmp = xml_child(disk, "target", NULL);
         if (tmp == NULL)
                 return XML_ERROR;
-        xmlNewProp(tmp, BAD_CAST "dev", BAD_CAST dev->virtual_dev);
+        xml_prop(tmp, "dev", dev->virtual_dev);
         if (dev->bus_type)
-                xmlNewProp(tmp, BAD_CAST "bus", BAD_CAST dev->bus_type);
+                xml_prop(tmp, "bus", dev->bus_type);
 
 
         if (dev->readonly)
-                xmlNewChild(disk, NULL, BAD_CAST "readonly", NULL);
+                xml_child(disk, "readonly", NULL);
 
         if (dev->shareable)
-                xmlNewChild(disk, NULL, BAD_CAST "shareable", NULL);
+                xml_child(disk, "shareable", NULL);
 
         if (dev->address.ct > 0)
                 return device_address_xml(disk, &dev->address);
@@ -312,12 +675,12 @@ static const char *disk_file_xml(xmlNodePtr root, struct disk_device *dev)
         return NULL;
 }
 
-static const char *disk_fs_xml(xmlNodePtr root, struct disk_device *dev)
+static const char *disk_fs_xml(struct xml_node *root, struct disk_device *dev)
 {
-        xmlNodePtr fs;
-        xmlNodePtr tmp;
+        struct xml_node *fs;
+        struct xml_node *tmp;
 
-        fs = xmlNewChild(root, NULL, BAD_CAST "filesystem", NULL);
+        fs = xml_child(root, "filesystem", NULL);
         if (fs == NULL)
                 return XML_ERROR;
 
@@ -328,23 +691,23 @@ static const char *disk_fs_xml(xmlNodePtr root, struct disk_device *dev)
          So generate here if specified by user, else leave it to libvirt. */
 
         if (dev->access_mode) {
-                xmlNewProp(fs, BAD_CAST "accessmode", BAD_CAST dev->access_mode);
+                xml_prop(fs, "accessmode", dev->access_mode);
         }
 
         if(dev->driver_type) {
-                tmp = xmlNewChild(fs, NULL, BAD_CAST "driver", NULL);
-                xmlNewProp(tmp, BAD_CAST "type", BAD_CAST dev->driver_type);
+                tmp = xml_child(fs, "driver", NULL);
+                xml_prop(tmp, "type", dev->driver_type);
         }
 
-        tmp = xmlNewChild(fs, NULL, BAD_CAST "source", NULL);
+        tmp = xml_child(fs, "source", NULL);
         if (tmp == NULL)
                 return XML_ERROR;
-        xmlNewProp(tmp, BAD_CAST "dir", BAD_CAST dev->source);
+        xml_prop(tmp, "dir", dev->source);
 
-        tmp = xmlNewChild(fs, NULL, BAD_CAST "target", NULL);
+        tmp = xml_child(fs, "target", NULL);
         if (tmp == NULL)
                 return XML_ERROR;
-        xmlNewProp(tmp, BAD_CAST "dir", BAD_CAST dev->virtual_dev);
+        xml_prop(tmp, "dir", dev->virtual_dev);
 
         if (dev->address.ct > 0)
                 return device_address_xml(fs, &dev->address);
@@ -352,7 +715,7 @@ static const char *disk_fs_xml(xmlNodePtr root, struct disk_device *dev)
         return NULL;
 }
 
-static const char *disk_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *disk_xml(struct xml_node *root, struct domain *dominfo)
 {
         int i;
         const char *msg = NULL;;
@@ -382,58 +745,51 @@ static const char *disk_xml(xmlNodePtr root, struct domain *dominfo)
         return msg;
 }
 
-static const char *set_net_vsi(xmlNodePtr nic, struct vsi_device *dev)
+static const char *set_net_vsi(struct xml_node *nic, struct vsi_device *dev)
 {
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
 
-        tmp = xmlNewChild(nic, NULL, BAD_CAST "virtualport", NULL);
+        tmp = xml_child(nic, "virtualport", NULL);
         if (tmp == NULL)
                 return XML_ERROR;
-        xmlNewProp(tmp, BAD_CAST "type", BAD_CAST dev->vsi_type);
+        xml_prop(tmp, "type", dev->vsi_type);
 
-        tmp = xmlNewChild(tmp, NULL, BAD_CAST "parameters", NULL);
+        tmp = xml_child(tmp, "parameters", NULL);
         if (tmp == NULL)
                 return XML_ERROR;
         if (STREQ(dev->vsi_type, "802.1Qbh")) {
                 if (dev->profile_id != NULL)
-                        xmlNewProp(tmp, BAD_CAST "profileid",
-                                   BAD_CAST dev->profile_id);
+                        xml_prop(tmp, "profileid", dev->profile_id);
         } else {
                 if (dev->manager_id != NULL)
-                        xmlNewProp(tmp, BAD_CAST "managerid",
-                                   BAD_CAST dev->manager_id);
+                        xml_prop(tmp, "managerid", dev->manager_id);
                 if (dev->type_id != NULL)
-                        xmlNewProp(tmp, BAD_CAST "typeid",
-                                   BAD_CAST dev->type_id);
+                        xml_prop(tmp, "typeid", dev->type_id);
                 if (dev->type_id_version != NULL)
-                        xmlNewProp(tmp, BAD_CAST "typeidversion",
-                                   BAD_CAST dev->type_id_version);
+                        xml_prop(tmp, "typeidversion", dev->type_id_version);
                 if (dev->instance_id != NULL)
-                        xmlNewProp(tmp, BAD_CAST "instanceid",
-                                   BAD_CAST dev->instance_id);
+                        xml_prop(tmp, "instanceid", dev->instance_id);
         }
 
         return NULL;
 }
 
-static const char *set_net_source(xmlNodePtr nic,
+static const char *set_net_source(struct xml_node *nic,
                                   struct net_device *dev,
                                   const char *src_type)
 {
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
 
         if (dev->source != NULL) {
-                tmp = xmlNewChild(nic, NULL, BAD_CAST "source", NULL);
+                tmp = xml_child(nic, "source", NULL);
                 if (tmp == NULL)
                         return XML_ERROR;
                 if (STREQ(src_type, "direct")) {
-                        xmlNewProp(tmp, BAD_CAST "dev", BAD_CAST dev->source);
+                        xml_prop(tmp, "dev", dev->source);
                         if (dev->net_mode != NULL)
-                                xmlNewProp(tmp, BAD_CAST "mode",
-                                           BAD_CAST dev->net_mode);
+                                xml_prop(tmp, "mode", dev->net_mode);
                 } else
-                        xmlNewProp(tmp, BAD_CAST src_type,
-                                   BAD_CAST dev->source);
+                        xml_prop(tmp, src_type, dev->source);
         } else
                 return XML_ERROR;
 
@@ -441,21 +797,22 @@ static const char *set_net_source(xmlNodePtr nic,
 }
 
 
-static const char *bridge_net_to_xml(xmlNodePtr nic, struct net_device *dev,
+static const char *bridge_net_to_xml(struct xml_node *nic,
+                                     struct net_device *dev,
                                      int domtype)
 {
         const char *script = "vif-bridge";
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
         const char *msg = NULL;
 
        /* Scripts only supported on Xen guests see 'libvirt'
         * commit id 1734cdb99 (since 0.9.10) */
        if (domtype == DOMAIN_XENPV || domtype == DOMAIN_XENFV) {
-            tmp = xmlNewChild(nic, NULL, BAD_CAST "script", NULL);
+            tmp = xml_child(nic, "script", NULL);
             if (tmp == NULL) {
                     return XML_ERROR;
             }
-            xmlNewProp(tmp, BAD_CAST "path", BAD_CAST script);
+            xml_prop(tmp, "path", script);
        }
 
         msg = set_net_source(nic, dev, "bridge");
@@ -463,12 +820,12 @@ static const char *bridge_net_to_xml(xmlNodePtr nic, struct net_device *dev,
         return msg;
 }
 
-static const char *net_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *net_xml(struct xml_node *root, struct domain *dominfo)
 {
         int i;
         const char *msg = NULL;
-        xmlNodePtr nic;
-        xmlNodePtr tmp;
+        struct xml_node *nic;
+        struct xml_node *tmp;
 
         for (i = 0; (i < dominfo->dev_net_ct) && (msg == NULL); i++) {
                 struct virt_device *dev = &dominfo->dev_net[i];
@@ -477,40 +834,38 @@ static const char *net_xml(xmlNodePtr root, struct domain *dominfo)
 
                 struct net_device *net = &dev->dev.net;
 
-                nic = xmlNewChild(root, NULL, BAD_CAST "interface", NULL);
+                nic = xml_child(root, "interface", NULL);
                 if (nic == NULL)
                         return XML_ERROR;
-                xmlNewProp(nic, BAD_CAST "type", BAD_CAST net->type);
+                xml_prop(nic, "type", net->type);
 
                 if (net->mac != NULL) {
-                        tmp = xmlNewChild(nic, NULL, BAD_CAST "mac", NULL);
+                        tmp = xml_child(nic, "mac", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "address", BAD_CAST net->mac);
+                        xml_prop(tmp, "address", net->mac);
                 }
 
                 if (net->device != NULL) {
-                        tmp = xmlNewChild(nic, NULL, BAD_CAST "target", NULL);
+                        tmp = xml_child(nic, "target", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "dev", BAD_CAST net->device);
+                        xml_prop(tmp, "dev", net->device);
                 }
 
 
                 if (net->model != NULL) {
-                        tmp = xmlNewChild(nic, NULL, BAD_CAST "model", NULL);
+                        tmp = xml_child(nic, "model", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "type", BAD_CAST net->model);
+                        xml_prop(tmp, "type", net->model);
                 }
 
                 if (net->filter_ref != NULL) {
-                        tmp = xmlNewChild(nic, NULL,
-                                BAD_CAST "filterref", NULL);
+                        tmp = xml_child(nic, "filterref", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
-                        xmlNewProp(tmp, BAD_CAST "filter",
-                                BAD_CAST net->filter_ref);
+                        xml_prop(tmp, "filter", net->filter_ref);
                 }
 
 #if LIBVIR_VERSION_NUMBER >= 9000
@@ -519,14 +874,12 @@ static const char *net_xml(xmlNodePtr root, struct domain *dominfo)
                         int ret;
                         char *string = NULL;
 
-                        tmp = xmlNewChild(nic, NULL,
-                                          BAD_CAST "bandwidth", NULL);
+                        tmp = xml_child(nic, "bandwidth", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
 
                         /* Set inbound bandwidth from Reservation & Limit */
-                        tmp = xmlNewChild(tmp, NULL,
-                                          BAD_CAST "inbound", NULL);
+                        tmp = xml_child(tmp, "inbound", NULL);
                         if (tmp == NULL)
                                 return XML_ERROR;
 
@@ -535,8 +888,7 @@ static const char *net_xml(xmlNodePtr root, struct domain *dominfo)
                                                net->reservation);
                                 if (ret == -1)
                                         return XML_ERROR;
-                                xmlNewProp(tmp, BAD_CAST "average",
-                                           BAD_CAST string);
+                                xml_prop(tmp, "average", string);
                                 free(string);
                         }
 
@@ -545,8 +897,7 @@ static const char *net_xml(xmlNodePtr root, struct domain *dominfo)
                                                net->limit);
                                 if (ret == -1)
                                         return XML_ERROR;
-                                xmlNewProp(tmp, BAD_CAST "peak",
-                                           BAD_CAST string);
+                                xml_prop(tmp, "peak", string);
                                 free(string);
                         }
                 }
@@ -575,10 +926,10 @@ static const char *net_xml(xmlNodePtr root, struct domain *dominfo)
         return msg;
 }
 
-static const char *vcpu_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *vcpu_xml(struct xml_node *root, struct domain *dominfo)
 {
         struct vcpu_device *vcpu;
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
         int ret;
         char *string = NULL;
 
@@ -591,7 +942,7 @@ static const char *vcpu_xml(xmlNodePtr root, struct domain *dominfo)
         if (ret == -1)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "vcpu", BAD_CAST string);
+        tmp = xml_child(root, "vcpu", string);
         free(string);
 
         if (tmp == NULL)
@@ -601,10 +952,10 @@ static const char *vcpu_xml(xmlNodePtr root, struct domain *dominfo)
 }
 
 #if LIBVIR_VERSION_NUMBER >= 9000
-static const char *cputune_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *cputune_xml(struct xml_node *root, struct domain *dominfo)
 {
         struct vcpu_device *vcpu;
-        xmlNodePtr cputune, tmp;
+        struct xml_node *cputune, *tmp;
         int ret;
         char *string = NULL;
 
@@ -614,7 +965,7 @@ static const char *cputune_xml(xmlNodePtr root, struct domain *dominfo)
         vcpu = &dominfo->dev_vcpu[0].dev.vcpu;
 
         /* CPU cgroup setting saved by libvirt under <cputune> XML section */
-        cputune = xmlNewChild(root, NULL, BAD_CAST "cputune", NULL);
+        cputune = xml_child(root, "cputune", NULL);
         if (cputune == NULL)
                 return XML_ERROR;
 
@@ -625,10 +976,7 @@ static const char *cputune_xml(xmlNodePtr root, struct domain *dominfo)
         if (ret == -1)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(cputune,
-                          NULL,
-                          BAD_CAST "shares",
-                          BAD_CAST string);
+        tmp = xml_child(cputune, "shares", string);
         free(string);
 
         if (tmp == NULL)
@@ -638,10 +986,10 @@ static const char *cputune_xml(xmlNodePtr root, struct domain *dominfo)
 }
 #endif
 
-static const char *mem_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *mem_xml(struct xml_node *root, struct domain *dominfo)
 {
         struct mem_device *mem;
-        xmlNodePtr tmp = NULL;
+        struct xml_node *tmp = NULL;
         int ret;
         char *string = NULL;
 
@@ -653,10 +1001,7 @@ static const char *mem_xml(xmlNodePtr root, struct domain *dominfo)
         ret = asprintf(&string, "%" PRIu64, mem->size);
         if (ret == -1)
                 goto out;
-        tmp = xmlNewChild(root,
-                          NULL,
-                          BAD_CAST "currentMemory",
-                          BAD_CAST string);
+        tmp = xml_child(root, "currentMemory", string);
         if (tmp == NULL)
                 return XML_ERROR;
 
@@ -666,19 +1011,16 @@ static const char *mem_xml(xmlNodePtr root, struct domain *dominfo)
         ret = asprintf(&string, "%" PRIu64, mem->maxsize);
         if (ret == -1)
                 goto out;
-        tmp = xmlNewChild(root,
-                          NULL,
-                          BAD_CAST "memory",
-                          BAD_CAST string);
+        tmp = xml_child(root, "memory", string);
 
         free(string);
 
         if (tmp == NULL)
                 return XML_ERROR;
         if (mem->dumpCore == MEM_DUMP_CORE_ON) {
-                xmlNewProp(tmp, BAD_CAST "dumpCore", BAD_CAST "on");
+                xml_prop(tmp, "dumpCore", "on");
         } else if (mem->dumpCore == MEM_DUMP_CORE_OFF) {
-                xmlNewProp(tmp, BAD_CAST "dumpCore", BAD_CAST "off");
+                xml_prop(tmp, "dumpCore", "off");
         }
 
  out:
@@ -688,70 +1030,67 @@ static const char *mem_xml(xmlNodePtr root, struct domain *dominfo)
                 return NULL;
 }
 
-static const char *emu_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *emu_xml(struct xml_node *root, struct domain *dominfo)
 {
         struct emu_device *emu;
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
 
         if (dominfo->dev_emu == NULL)
                 return NULL;
 
         emu = &dominfo->dev_emu->dev.emu;
-        tmp = xmlNewChild(root, NULL, BAD_CAST "emulator", BAD_CAST emu->path);
+        tmp = xml_child(root, "emulator", emu->path);
         if (tmp == NULL)
                 return XML_ERROR;
 
         return NULL;
 }
 
-static const char *graphics_vnc_xml(xmlNodePtr root,
+static const char *graphics_vnc_xml(struct xml_node *root,
                        struct graphics_device *dev)
 {
-        xmlNodePtr tmp = NULL;
+        struct xml_node *tmp = NULL;
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "graphics", NULL);
+        tmp = xml_child(root, "graphics", NULL);
         if (tmp == NULL)
                 return XML_ERROR;
 
-        xmlNewProp(tmp, BAD_CAST "type", BAD_CAST dev->type);
+        xml_prop(tmp, "type", dev->type);
 
         if (STREQC(dev->type, "sdl")) {
                 if (dev->dev.sdl.display) {
-                        xmlNewProp(tmp, BAD_CAST "display",
-                                        BAD_CAST dev->dev.sdl.display);
+                        xml_prop(tmp, "display", dev->dev.sdl.display);
                 }
                 if (dev->dev.sdl.xauth) {
-                        xmlNewProp(tmp, BAD_CAST "xauth",
-                                        BAD_CAST dev->dev.sdl.xauth);
+                        xml_prop(tmp, "xauth", dev->dev.sdl.xauth);
                 }
                 if (dev->dev.sdl.fullscreen) {
-                        xmlNewProp(tmp, BAD_CAST "fullscreen",
-                                        BAD_CAST dev->dev.sdl.fullscreen);
+                        xml_prop(tmp, "fullscreen", dev->dev.sdl.fullscreen);
                 }
                 return NULL;
         }
 
         if (dev->dev.vnc.port) {
-                xmlNewProp(tmp, BAD_CAST "port", BAD_CAST dev->dev.vnc.port);
+                xml_prop(tmp, "port", dev->dev.vnc.port);
                 if (STREQC(dev->dev.vnc.port, "-1"))
-                        xmlNewProp(tmp, BAD_CAST "autoport", BAD_CAST "yes");
+                        xml_prop(tmp, "autoport", "yes");
                 else
-                        xmlNewProp(tmp, BAD_CAST "autoport", BAD_CAST "no");
+                        xml_prop(tmp, "autoport", "no");
         }
 
         if (dev->dev.vnc.host)
-                xmlNewProp(tmp, BAD_CAST "listen", BAD_CAST dev->dev.vnc.host);
+                xml_prop(tmp, "listen", dev->dev.vnc.host);
 
         if (dev->dev.vnc.passwd)
-                xmlNewProp(tmp, BAD_CAST "passwd", BAD_CAST dev->dev.vnc.passwd);
+                xml_prop(tmp, "passwd", dev->dev.vnc.passwd);
 
         if (dev->dev.vnc.keymap)
-                xmlNewProp(tmp, BAD_CAST "keymap", BAD_CAST dev->dev.vnc.keymap);
+                xml_prop(tmp, "keymap", dev->dev.vnc.keymap);
 
         return NULL;
 }
 
-static const char *graphics_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *graphics_xml(struct xml_node *root, struct domain *dominfo)
 {
         const char *msg = NULL;
         int i;
@@ -775,38 +1114,38 @@ static const char *graphics_xml(xmlNodePtr root, struct domain *dominfo)
         return NULL;
 }
 
-static const char *input_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *input_xml(struct xml_node *root, struct domain *dominfo)
 {
         int i;
 
         for (i = 0; i < dominfo->dev_input_ct; i++) {
-                xmlNodePtr tmp;
+                struct xml_node *tmp;
                 struct virt_device *_dev = &dominfo->dev_input[i];
                 if (_dev->type == CIM_RES_TYPE_UNKNOWN)
                         continue;
 
                 struct input_device *dev = &_dev->dev.input;
 
-                tmp = xmlNewChild(root, NULL, BAD_CAST "input", NULL);
+                tmp = xml_child(root, "input", NULL);
                 if (tmp == NULL)
                         return XML_ERROR;
 
-                xmlNewProp(tmp, BAD_CAST "type", BAD_CAST dev->type);
-                xmlNewProp(tmp, BAD_CAST "bus", BAD_CAST dev->bus);
+                xml_prop(tmp, "type", dev->type);
+                xml_prop(tmp, "bus", dev->bus);
         }
 
         return NULL;
 }
 
-static const char *controller_xml(xmlNodePtr root, struct domain *dominfo)
+static const char *controller_xml(struct xml_node *root, struct domain *dominfo)
 {
         int i;
         const char *msg = NULL;
 
         CU_DEBUG("Found %d controllers", dominfo->dev_controller_ct);
         for (i = 0; i < dominfo->dev_controller_ct; i++) {
-                xmlNodePtr ctlr;
-                xmlNodePtr tmp;
+                struct xml_node *ctlr;
+                struct xml_node *tmp;
                 const char *type_str;
 
                 struct virt_device *_dev = &dominfo->dev_controller[i];
@@ -815,7 +1154,7 @@ static const char *controller_xml(xmlNodePtr root, struct domain *dominfo)
 
                 struct controller_device *cdev = &_dev->dev.controller;
 
-                ctlr = xmlNewChild(root, NULL, BAD_CAST "controller", NULL);
+                ctlr = xml_child(root, "controller", NULL);
                 if (ctlr == NULL)
                         return XML_ERROR;
 
@@ -825,32 +1164,27 @@ static const char *controller_xml(xmlNodePtr root, struct domain *dominfo)
                         return XML_ERROR;
 
                 CU_DEBUG("Type=%s Index=%" PRIu64, type_str, cdev->index);
-                xmlNewProp(ctlr, BAD_CAST "type",
-                           BAD_CAST type_str);
+                xml_prop(ctlr, "type", type_str);
 
                 /* If index is missing, let libvirt generate it */
                 if (cdev->index != CONTROLLER_INDEX_NOT_SET) {
                     char *index;
                     if (asprintf(&index, "%" PRIu64, cdev->index) == -1)
                         return XML_ERROR;
-                    xmlNewProp(ctlr, BAD_CAST "index", BAD_CAST index);
+                    xml_prop(ctlr, "index", index);
                     free(index);
                 }
 
                 /* Optional */
                 if (cdev->model)
-                    xmlNewProp(ctlr, BAD_CAST "model",
-                               BAD_CAST cdev->model);
+                    xml_prop(ctlr, "model", cdev->model);
                 if (cdev->ports)
-                    xmlNewProp(ctlr, BAD_CAST "ports",
-                               BAD_CAST cdev->ports);
+                    xml_prop(ctlr, "ports", cdev->ports);
                 if (cdev->vectors)
-                    xmlNewProp(ctlr, BAD_CAST "vectors",
-                               BAD_CAST cdev->vectors);
+                    xml_prop(ctlr, "vectors", cdev->vectors);
                 if (cdev->queues) {
-                    tmp = xmlNewChild(ctlr, NULL, BAD_CAST "driver", NULL);
-                    xmlNewProp(tmp, BAD_CAST "queueus",
-                               BAD_CAST cdev->queues);
+                    tmp = xml_child(ctlr, "driver", NULL);
+                    xml_prop(tmp, "queueus", cdev->queues);
                 }
                 if (cdev->address.ct > 0) {
                     msg = device_address_xml(ctlr, &cdev->address);
@@ -864,67 +1198,55 @@ static const char *controller_xml(xmlNodePtr root, struct domain *dominfo)
         return NULL;
 }
 
-static char *system_xml(xmlNodePtr root, struct domain *domain)
+static char *system_xml(struct xml_node *root, struct domain *domain)
 {
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "name", BAD_CAST domain->name);
+        tmp = xml_child(root, "name", domain->name);
         if (tmp == NULL)
                 return XML_ERROR;
 
         if (domain->bootloader) {
-                tmp = xmlNewChild(root,
-                                  NULL,
-                                  BAD_CAST "bootloader",
-                                  BAD_CAST domain->bootloader);
+                tmp = xml_child(root, "bootloader", domain->bootloader);
                 if (tmp == NULL)
                         return XML_ERROR;
         }
 
         if (domain->bootloader_args) {
-                tmp = xmlNewChild(root,
-                                  NULL,
-                                  BAD_CAST "bootloader_args",
-                                  BAD_CAST domain->bootloader_args);
+                tmp = xml_child(root, "bootloader_args",
+                                domain->bootloader_args);
                 if (tmp == NULL)
                         return XML_ERROR;
         }
 
-        tmp = xmlNewChild(root,
-                          NULL,
-                          BAD_CAST "on_poweroff",
-                          BAD_CAST vssd_recovery_action_str(domain->on_poweroff));
+        tmp = xml_child(root, "on_poweroff",
+                        vssd_recovery_action_str(domain->on_poweroff));
         if (tmp == NULL)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(root,
-                          NULL,
-                          BAD_CAST "on_crash",
-                          BAD_CAST vssd_recovery_action_str(domain->on_crash));
+        tmp = xml_child(root, "on_crash",
+                        vssd_recovery_action_str(domain->on_crash));
         if (tmp == NULL)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(root,
-                          NULL,
-                          BAD_CAST "uuid",
-                          BAD_CAST domain->uuid);
+        tmp = xml_child(root, "uuid", domain->uuid);
         if (tmp == NULL)
                 return XML_ERROR;
 
         if (domain->clock != NULL) {
-                tmp = xmlNewChild(root, NULL, BAD_CAST "clock", NULL);
+                tmp = xml_child(root, "clock", NULL);
                 if (tmp == NULL)
                         return XML_ERROR;
-                xmlNewProp(tmp, BAD_CAST "offset", BAD_CAST domain->clock);
+                xml_prop(tmp, "offset", domain->clock);
         }
 
         return NULL;
 }
 
-static char *_xenpv_os_xml(xmlNodePtr root, struct domain *domain)
+static char *_xenpv_os_xml(struct xml_node *root, struct domain *domain)
 {
         struct pv_os_info *os = &domain->os_info.pv;
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
 
         if (os->type == NULL)
                 os->type = strdup("linux");
@@ -932,45 +1254,45 @@ static char *_xenpv_os_xml(xmlNodePtr root, struct domain *domain)
         if (os->kernel == NULL)
                 os->kernel = strdup("/dev/null");
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "type", BAD_CAST os->type);
+        tmp = xml_child(root, "type", os->type);
         if (tmp == NULL)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "kernel", BAD_CAST os->kernel);
+        tmp = xml_child(root, "kernel", os->kernel);
         if (tmp == NULL)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "initrd", BAD_CAST os->initrd);
+        tmp = xml_child(root, "initrd", os->initrd);
         if (tmp == NULL)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "cmdline", BAD_CAST os->cmdline);
+        tmp = xml_child(root, "cmdline", os->cmdline);
         if (tmp == NULL)
                 return XML_ERROR;
 
         return NULL;
 }
 
-static int _fv_bootlist_xml(xmlNodePtr root, struct fv_os_info *os)
+static int _fv_bootlist_xml(struct xml_node *root, struct fv_os_info *os)
 {
         unsigned i;
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
 
         for (i = 0; i < os->bootlist_ct; i++) {
-                tmp = xmlNewChild(root, NULL, BAD_CAST "boot", NULL);
+                tmp = xml_child(root, "boot", NULL);
                 if (tmp == NULL)
                         return 0;
 
-                xmlNewProp(tmp, BAD_CAST "dev", BAD_CAST os->bootlist[i]);
+                xml_prop(tmp, "dev", os->bootlist[i]);
         }
 
         return 1;
 }
 
-static char *_xenfv_os_xml(xmlNodePtr root, struct domain *domain)
+static char *_xenfv_os_xml(struct xml_node *root, struct domain *domain)
 {
         struct fv_os_info *os = &domain->os_info.fv;
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
         unsigned ret;
 
         if (os->type == NULL)
@@ -985,11 +1307,11 @@ static char *_xenfv_os_xml(xmlNodePtr root, struct domain *domain)
                 os->bootlist[0] = strdup("hd");
         }
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "type", BAD_CAST os->type);
+        tmp = xml_child(root, "type", os->type);
         if (tmp == NULL)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "loader", BAD_CAST os->loader);
+        tmp = xml_child(root, "loader", os->loader);
         if (tmp == NULL)
                 return XML_ERROR;
 
@@ -1000,10 +1322,10 @@ static char *_xenfv_os_xml(xmlNodePtr root, struct domain *domain)
         return NULL;
 }
 
-static char *_kvm_os_xml(xmlNodePtr root, struct domain *domain)
+static char *_kvm_os_xml(struct xml_node *root, struct domain *domain)
 {
         struct fv_os_info *os = &domain->os_info.fv;
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
         unsigned ret;
 
         if (os->type == NULL)
@@ -1015,15 +1337,15 @@ static char *_kvm_os_xml(xmlNodePtr root, struct domain *domain)
                 os->bootlist[0] = strdup("hd");
         }
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "type", BAD_CAST os->type);
+        tmp = xml_child(root, "type", os->type);
         if (tmp == NULL)
                 return XML_ERROR;
 
         if (os->arch)
-                xmlNewProp(tmp, BAD_CAST "arch", BAD_CAST os->arch);
+                xml_prop(tmp, "arch", os->arch);
 
         if (os->machine)
-                xmlNewProp(tmp, BAD_CAST "machine", BAD_CAST os->machine);
+                xml_prop(tmp, "machine", os->machine);
 
         ret = _fv_bootlist_xml(root, os);
         if (ret == 0)
@@ -1032,30 +1354,30 @@ static char *_kvm_os_xml(xmlNodePtr root, struct domain *domain)
         return NULL;
 }
 
-static char *_lxc_os_xml(xmlNodePtr root, struct domain *domain)
+static char *_lxc_os_xml(struct xml_node *root, struct domain *domain)
 {
         struct lxc_os_info *os = &domain->os_info.lxc;
-        xmlNodePtr tmp;
+        struct xml_node *tmp;
 
         if (os->type == NULL)
                 os->type = strdup("exe");
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "init", BAD_CAST os->init);
+        tmp = xml_child(root, "init", os->init);
         if (tmp == NULL)
                 return XML_ERROR;
 
-        tmp = xmlNewChild(root, NULL, BAD_CAST "type", BAD_CAST os->type);
+        tmp = xml_child(root, "type", os->type);
         if (tmp == NULL)
                 return XML_ERROR;
 
         return NULL;
 }
 
-static char *os_xml(xmlNodePtr root, struct domain *domain)
+static char *os_xml(struct xml_node *root, struct domain *domain)
 {
-        xmlNodePtr os;
+        struct xml_node *os;
 
-        os = xmlNewChild(root, NULL, BAD_CAST "os", NULL);
+        os = xml_child(root, "os", NULL);
         if (os == NULL)
                 return "Failed to allocate XML memory";
 
@@ -1071,22 +1393,22 @@ static char *os_xml(xmlNodePtr root, struct domain *domain)
                 return "Unsupported domain type";
 }
 
-static char *features_xml(xmlNodePtr root, struct domain *domain)
+static char *features_xml(struct xml_node *root, struct domain *domain)
 {
-        xmlNodePtr features;
+        struct xml_node *features;
 
-        features = xmlNewChild(root, NULL, BAD_CAST "features", NULL);
+        features = xml_child(root, "features", NULL);
         if (features == NULL)
                 return "Failed to allocate XML memory";
 
         if (domain->acpi)
-                xmlNewChild(features, NULL, BAD_CAST "acpi", NULL);
+                xml_child(features, "acpi", NULL);
 
         if (domain->apic)
-                xmlNewChild(features, NULL, BAD_CAST "apic", NULL);
+                xml_child(features, "apic", NULL);
 
         if (domain->pae)
-                xmlNewChild(features, NULL, BAD_CAST "pae", NULL);
+                xml_child(features, "pae", NULL);
 
         return NULL;
 }
@@ -1131,12 +1453,67 @@ static char *tree_to_xml(xmlNodePtr root)
         return xml;
 }
 
-char *device_to_xml(struct virt_device *_dev)
+static char *xml_writer_finish(struct xml_writer *w)
+{
+        char *xml;
+
+        if (!w->stream) {
+                if (w->doc->node->children == NULL)
+                        return NULL;
+
+                return tree_to_xml(w->doc->node->children);
+        }
+
+        while (w->depth > 1)
+                stream_end(w);
+
+        if (w->failed || (w->roots == 0))
+                return NULL;
+
+        xml = w->buf;
+        w->buf = NULL;
+
+        return xml;
+}
+
+static char *generate_xml(devfn_t func, struct domain *dominfo, bool stream)
+{
+        struct xml_writer w;
+        struct xml_node *doc;
+        const char *msg = XML_ERROR;
+        char *xml = NULL;
+
+        doc = xml_writer_init(&w, stream);
+        if (doc == NULL)
+                goto out;
+
+        msg = func(doc, dominfo);
+        if (msg != NULL)
+                goto out;
+
+        xml = xml_writer_finish(&w);
+        if (xml == NULL)
+                msg = "XML generation failed";
+ out:
+        if (stream && w.failed) {
+                CU_DEBUG("XML stream writer gave up, generating from tree");
+                xml_writer_free(&w);
+                return generate_xml(func, dominfo, false);
+        }
+
+        if (msg != NULL) {
+                CU_DEBUG("Failed to create XML: %s", msg);
+        }
+
+        xml_writer_free(&w);
+
+        return xml;
+}
+
+static char *_device_to_xml(struct virt_device *_dev, bool stream)
 {
         char *xml = NULL;
         int type = _dev->type;
-        xmlNodePtr root = NULL;
-        const char *msg;
         struct domain *dominfo;
         devfn_t func;
         struct virt_device *dev = NULL;
@@ -1149,12 +1526,6 @@ char *device_to_xml(struct virt_device *_dev)
         if (dev == NULL)
                 goto out;
 
-        root = xmlNewNode(NULL, BAD_CAST "tmp");
-        if (root == NULL) {
-                cleanup_virt_devices(&dev, 1);
-                goto out;
-        }
-
         switch (type) {
         case CIM_RES_TYPE_DISK:
                 func = disk_xml;
@@ -1205,31 +1576,33 @@ char *device_to_xml(struct virt_device *_dev)
                 goto out;
         }
 
-        msg = func(root, dominfo);
-        if (msg != NULL) {
-                CU_DEBUG("Failed to create device XML: %s", msg);
-                goto out;
-        }
-
-        xml = tree_to_xml(root->children);
+        xml = generate_xml(func, dominfo, stream);
  out:
         CU_DEBUG("Created Device XML:\n%s\n", xml);
 
         cleanup_dominfo(&dominfo);
-        xmlFreeNode(root);
 
         return xml;
 }
 
-char *system_to_xml(struct domain *dominfo)
+char *device_to_xml(struct virt_device *dev)
 {
-        xmlNodePtr root = NULL;
-        xmlNodePtr devices = NULL;
-        char *xml = NULL;
+        return _device_to_xml(dev, true);
+}
+
+char *device_to_xml_tree(struct virt_device *dev)
+{
+        return _device_to_xml(dev, false);
+}
+
+static const char *domain_xml(struct xml_node *doc, struct domain *dominfo)
+{
+        struct xml_node *root;
+        struct xml_node *devices;
         uint8_t uuid[16];
         char uuidstr[37];
         const char *domtype;
-        const char *msg = XML_ERROR;
+        const char *msg;
         int i;
         devfn_t device_handlers[] = {
                 &disk_xml,
@@ -1262,78 +1635,74 @@ char *system_to_xml(struct domain *dominfo)
                 dominfo->uuid = strdup(uuidstr);
         }
 
-        root = xmlNewNode(NULL, BAD_CAST "domain");
+        root = xml_child(doc, "domain", NULL);
         if (root == NULL)
-                goto out;
+                return XML_ERROR;
 
-        if (xmlNewProp(root, BAD_CAST "type", BAD_CAST domtype) == NULL)
-                goto out;
+        if (!xml_prop(root, "type", domtype))
+                return XML_ERROR;
 
         msg = system_xml(root, dominfo);
         if (msg != NULL)
-                goto out;
+                return msg;
 
         msg = os_xml(root, dominfo);
         if (msg != NULL)
-                goto out;
+                return msg;
 
         msg = features_xml(root, dominfo);
         if (msg != NULL)
-                goto out;
+                return msg;
 
         msg = mem_xml(root, dominfo);
         if (msg != NULL)
-                goto out;
+                return msg;
 
         msg = vcpu_xml(root, dominfo);
         if (msg != NULL)
-                goto out;
+                return msg;
 
 #if LIBVIR_VERSION_NUMBER >= 9000
         /* Recent libvirt versions add new <cputune> section to XML */
         msg = cputune_xml(root, dominfo);
         if (msg != NULL)
-                goto out;
+                return msg;
 #endif
 
-        devices = xmlNewChild(root, NULL, BAD_CAST "devices", NULL);
-        if (devices == NULL) {
-                msg = XML_ERROR;
-                goto out;
-        }
+        devices = xml_child(root, "devices", NULL);
+        if (devices == NULL)
+                return XML_ERROR;
 
         for (i = 0; device_handlers[i] != NULL; i++) {
                 devfn_t fn = device_handlers[i];
 
                 msg = fn(devices, dominfo);
                 if (msg != NULL)
-                        goto out;
+                        return msg;
         }
 
-        msg = XML_ERROR;
         if (dominfo->type == DOMAIN_LXC) {
-                xmlNodePtr cons;
+                struct xml_node *cons;
 
-                cons = xmlNewChild(devices, NULL, BAD_CAST "console", NULL);
+                cons = xml_child(devices, "console", NULL);
                 if (cons == NULL)
-                        goto out;
+                        return XML_ERROR;
 
-                if (xmlNewProp(cons, BAD_CAST "type", BAD_CAST "pty") == NULL)
-                        goto out;
+                if (!xml_prop(cons, "type", "pty"))
+                        return XML_ERROR;
         }
 
-        msg = NULL;
-        xml = tree_to_xml(root);
-        if (xml == NULL)
-                msg = "XML generation failed";
- out:
-        if (msg != NULL) {
-                CU_DEBUG("Failed to create XML: %s", msg);
-        }
+        return NULL;
+}
 
-        xmlFreeNode(root);
+char *system_to_xml(struct domain *dominfo)
+{
+        return generate_xml(domain_xml, dominfo, true);
+}
 
-        return xml;
+char *system_to_xml_tree(struct domain *dominfo)
+{
+        return generate_xml(domain_xml, dominfo, false);
 }
 
 static const char *net_pool_xml(xmlNodePtr root,
@@ -35,6 +35,11 @@ struct kv {
 char *system_to_xml(struct domain *dominfo);
 char *device_to_xml(struct virt_device *dev);
 
+/* Same output, always built as a libxml2 tree; used to check the
+ * streaming writer behind system_to_xml() and device_to_xml() */
+char *system_to_xml_tree(struct domain *dominfo);
+char *device_to_xml_tree(struct virt_device *dev);
+
 char *pool_to_xml(struct virt_pool *pool);
 
 char *res_to_xml(struct virt_pool_res *res);
@@ -81,9 +81,9 @@ CMPIStatus enum_alloc_cap_instances(const CMPIBroker *broker,
                                     struct inst_list *list)
 {
         CMPIInstance *alloc_cap_inst;
+        CMPIInstance *pool = NULL;
         struct inst_list device_pool_list;
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        const char *inst_id;
         int i;
 
         inst_list_init(&device_pool_list);
@@ -91,6 +91,20 @@ CMPIStatus enum_alloc_cap_instances(const CMPIBroker *broker,
         if (!provider_is_responsible(broker, ref, &s))
                 goto out;
 
+        /* The pool type is in the id, so only that pool is needed */
+        if (id != NULL) {
+                s = get_pool_by_name(broker, ref, id, &pool);
+                if ((s.rc != CMPI_RC_OK) || (pool == NULL))
+                        goto out;
+
+                s = ac_from_pool(broker, ref, pool, &alloc_cap_inst);
+                if (s.rc != CMPI_RC_OK)
+                        goto out;
+
+                inst_list_add(list, alloc_cap_inst);
+                goto out;
+        }
+
         s = enum_pools(broker, ref, CIM_RES_TYPE_ALL, &device_pool_list);
         if (s.rc != CMPI_RC_OK) {
                 cu_statusf(broker, &s,
@@ -100,18 +114,6 @@ CMPIStatus enum_alloc_cap_instances(const CMPIBroker *broker,
         }
 
         for (i = 0; i < device_pool_list.cur; i++) {
-                if (cu_get_str_prop(device_pool_list.list[i],
-                                    "InstanceID", &inst_id) != CMPI_RC_OK) {
-                        cu_statusf(broker, &s,
-                                   CMPI_RC_ERR_FAILED,
-                                   "Error fetching device pool InstanceID");
-                        goto out;
-                }
-                if (id && (!STREQ(inst_id, id))) {
-                        inst_id = NULL;
-                        continue;
-                }
-
                 s = ac_from_pool(broker, ref, 
                                  device_pool_list.list[i], 
                                  &alloc_cap_inst);
@@ -119,18 +121,8 @@ CMPIStatus enum_alloc_cap_instances(const CMPIBroker *broker,
                         goto out;
 
                 inst_list_add(list, alloc_cap_inst);
-
-                if (id && (STREQ(inst_id, id)))
-                        break;
         }
 
-        if (id && !inst_id) {
-            cu_statusf(broker, &s,
-                       CMPI_RC_ERR_NOT_FOUND,
-                       "Instance not found.");
-            goto out; 
-        }
-        
  out:
         inst_list_free(&device_pool_list);
 
@@ -244,10 +236,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
-                   Virt_AllocationCapabilities,
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_AllocationCapabilities,
+                     _BROKER,
+                     libvirt_cim_init());
 
 /*
  * Local Variables:
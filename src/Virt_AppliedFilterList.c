@@ -396,7 +396,7 @@ static struct std_assoc *handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(,
+STATS_AssocMIStub(,
         Virt_AppliedFilterList,
         _BROKER,
         libvirt_cim_init(),
@@ -653,7 +653,7 @@ DEFAULT_MI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
+STATS_InstanceMIStub(,
         Virt_AppliedFilterList,
         _BROKER,
         libvirt_cim_init());
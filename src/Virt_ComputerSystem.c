@@ -274,7 +274,7 @@ static unsigned char adjust_state_xen(virDomainPtr dom,
 
         conn = virDomainGetConnect(dom);
 
-        if (STREQC(virConnectGetType(conn), "Xen"))
+        if (STREQC(type_from_conn(conn), "Xen"))
            return VIR_DOMAIN_RUNNING;
 
         return state;
@@ -292,34 +292,26 @@ static uint16_t adjust_state_if_saved(const char *name,
         return state;
 }
 
-static int set_state_from_dom(const CMPIBroker *broker,
-                              virDomainPtr dom,
-                              CMPIInstance *instance)
+static int set_state_from_lv(const CMPIBroker *broker,
+                             const char *name,
+                             int lv_state,
+                             bool migrating,
+                             uint16_t req_state,
+                             CMPIInstance *instance)
 {
-        virDomainInfo info;
-        int ret;
         uint16_t cim_state;
         uint16_t health_state;
-        uint16_t req_state;
         uint16_t op_status;
         uint16_t oping_status;
         CMPIArray *array;
         CMPIStatus s;
-        struct infostore_ctx *infostore = NULL;
-        bool migrating = false;
 
-        ret = virDomainGetInfo(dom, &info);
-        if (ret != 0) 
-                return 0;
-
-        info.state = adjust_state_xen(dom, info.state);
-
-        cim_state = state_lv_to_cim((const int)info.state);
-        cim_state = adjust_state_if_saved(virDomainGetName(dom), cim_state);
+        cim_state = state_lv_to_cim((const int)lv_state);
+        cim_state = adjust_state_if_saved(name, cim_state);
         CMSetProperty(instance, "EnabledState",
                       (CMPIValue *)&cim_state, CMPI_uint16);
 
-        health_state = state_lv_to_cim_health((const int)info.state);
+        health_state = state_lv_to_cim_health((const int)lv_state);
         CMSetProperty(instance, "HealthState",
                       (CMPIValue *)&health_state, CMPI_uint16);
 
@@ -327,32 +319,69 @@ static int set_state_from_dom(const CMPIBroker *broker,
         if ((s.rc != CMPI_RC_OK) || (CMIsNullObject(array)))
                 return 0;
 
-        op_status = state_lv_to_cim_os((const int)info.state);
+        op_status = state_lv_to_cim_os((const int)lv_state);
         CMSetArrayElementAt(array, 0, &op_status, CMPI_uint16);
 
         CMSetProperty(instance, "OperationalStatus",
                       (CMPIValue *)&array, CMPI_uint16A);
 
+        oping_status = state_lv_to_cim_oings((const int)lv_state, migrating);
+        CMSetProperty(instance, "OperatingStatus",
+                      (CMPIValue *)&oping_status, CMPI_uint16);
+
+        CMSetProperty(instance, "RequestedState",
+                      (CMPIValue *)&req_state, CMPI_uint16);
+
+        return 1;
+}
+
+static int set_state_from_dom(const CMPIBroker *broker,
+                              virDomainPtr dom,
+                              CMPIInstance *instance)
+{
+        virDomainInfo info;
+        int ret;
+        uint16_t req_state;
+        struct infostore_ctx *infostore = NULL;
+        bool migrating = false;
+
+        ret = virDomainGetInfo(dom, &info);
+        if (ret != 0) 
+                return 0;
+
+        info.state = adjust_state_xen(dom, info.state);
+
         infostore = infostore_open(dom);
 
         if (infostore != NULL) 
                 migrating = infostore_get_bool(infostore, "migrating");
 
-        oping_status = state_lv_to_cim_oings((const int)info.state, migrating);
-        CMSetProperty(instance, "OperatingStatus",
-                      (CMPIValue *)&oping_status, CMPI_uint16);
-
         if (infostore != NULL)
                 req_state = (uint16_t)infostore_get_u64(infostore, "reqstate");
         else
                 req_state = CIM_STATE_UNKNOWN;
 
-        CMSetProperty(instance, "RequestedState",
-                      (CMPIValue *)&req_state, CMPI_uint16);
-
         infostore_close(infostore);
 
-        return 1;
+        return set_state_from_lv(broker,
+                                 virDomainGetName(dom),
+                                 info.state,
+                                 migrating,
+                                 req_state,
+                                 instance);
+}
+
+int set_domain_state(const CMPIBroker *broker,
+                     const char *name,
+                     int lv_state,
+                     CMPIInstance *instance)
+{
+        return set_state_from_lv(broker,
+                                 name,
+                                 lv_state,
+                                 false,
+                                 CIM_STATE_UNKNOWN,
+                                 instance);
 }
 
 static int set_creation_class(CMPIInstance *instance)
@@ -518,30 +547,26 @@ CMPIStatus instance_from_dominfo(const CMPIBroker *broker,
 
 }
 
-/* Populate an instance with information from a domain */
+/* Populate an instance with information from a domain.  Only the keys
+ * and the requested properties are filled in, the domain XML is parsed
+ * for Caption and Description only.
+ */
 static CMPIStatus set_properties(const CMPIBroker *broker,
                                  virDomainPtr dom,
                                  const char *prefix,
+                                 const char **properties,
                                  CMPIInstance *instance)
 {
         CMPIStatus s = {CMPI_RC_ERR_FAILED, NULL};
         char *uuid = NULL;
         struct domain *domain = NULL;
+        struct arena *arena = NULL;
         CMPIObjectPath *ref = NULL;
 
         ref = CMGetObjectPath(instance, &s);
         if ((ref == NULL) || (s.rc != CMPI_RC_OK))
                 return s;
 
-        if (get_dominfo(dom, &domain) == 0) {
-                CU_DEBUG("Unable to get domain information");
-                virt_set_status(broker, &s,
-                                CMPI_RC_ERR_FAILED,
-                                virDomainGetConnect(dom),
-                                "Unable to get domain information");
-                goto out;
-        }
-
         if (!set_name_from_dom(dom, instance)) {
                 CU_DEBUG("Unable to get domain name");
                 virt_set_status(broker, &s,
@@ -551,7 +576,12 @@ static CMPIStatus set_properties(const CMPIBroker *broker,
                 goto out;
         }
 
-        if (!set_uuid_from_dom(dom, instance, &uuid)) {
+        if (property_requested(properties,
+                               "UUID",
+                               "OtherIdentifyingInfo",
+                               "IdentifyingDescriptions",
+                               NULL) &&
+            !set_uuid_from_dom(dom, instance, &uuid)) {
                 CU_DEBUG("Unable to get domain uuid");
                 virt_set_status(broker, &s,
                                 CMPI_RC_ERR_FAILED,
@@ -561,12 +591,38 @@ static CMPIStatus set_properties(const CMPIBroker *broker,
                 goto out;
         }
 
-        if (!set_capdesc_from_dominfo(broker, domain, ref, instance)) {
-                /* Print trace error */
-                goto out;
+        if (property_requested(properties, "Caption", "Description", NULL)) {
+                arena = arena_new();
+                if (arena == NULL) {
+                        cu_statusf(broker, &s,
+                                   CMPI_RC_ERR_FAILED,
+                                   "Unable to allocate memory");
+                        goto out;
+                }
+
+                if (get_dominfo_arena(dom, arena, &domain) == 0) {
+                        CU_DEBUG("Unable to get domain information");
+                        virt_set_status(broker, &s,
+                                        CMPI_RC_ERR_FAILED,
+                                        virDomainGetConnect(dom),
+                                        "Unable to get domain information");
+                        goto out;
+                }
+
+                if (!set_capdesc_from_dominfo(broker, domain, ref, instance)) {
+                        /* Print trace error */
+                        goto out;
+                }
         }
 
-        if (!set_state_from_dom(broker, dom, instance)) {
+        if (property_requested(properties,
+                               "EnabledState",
+                               "HealthState",
+                               "OperationalStatus",
+                               "OperatingStatus",
+                               "RequestedState",
+                               NULL) &&
+            !set_state_from_dom(broker, dom, instance)) {
                 CU_DEBUG("Unable to get domain info");
                 virt_set_status(broker, &s,
                                 CMPI_RC_ERR_FAILED,
@@ -581,7 +637,8 @@ static CMPIStatus set_properties(const CMPIBroker *broker,
                 goto out;
         }
 
-        if (!set_other_id_info(broker, uuid, prefix, instance)) {
+        if ((uuid != NULL) &&
+            !set_other_id_info(broker, uuid, prefix, instance)) {
                 /* Print trace error */
                 goto out;
         }
@@ -594,7 +651,7 @@ static CMPIStatus set_properties(const CMPIBroker *broker,
 
  out:
         free(uuid);
-        cleanup_dominfo(&domain);
+        arena_free(arena);
 
         return s;
 }
@@ -603,6 +660,7 @@ static CMPIStatus instance_from_dom(const CMPIBroker *broker,
                                      const CMPIObjectPath *reference,
                                      virConnectPtr conn,
                                      virDomainPtr domain,
+                                     const char **properties,
                                      CMPIInstance **_inst)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
@@ -623,6 +681,7 @@ static CMPIStatus instance_from_dom(const CMPIBroker *broker,
         s = set_properties(broker,
                            domain, 
                            pfx_from_conn(conn), 
+                           properties,
                            inst);
         if (s.rc != CMPI_RC_OK)
                 goto out;
@@ -633,11 +692,14 @@ static CMPIStatus instance_from_dom(const CMPIBroker *broker,
         return s;
 }
 
-CMPIStatus enum_domains(const CMPIBroker *broker,
-                        const CMPIObjectPath *reference,
-                        struct inst_list *instlist)
+CMPIStatus stream_domains(const CMPIBroker *broker,
+                          const CMPIObjectPath *reference,
+                          const char **properties,
+                          inst_handler_t handler,
+                          void *data)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIStatus hs = {CMPI_RC_OK, NULL};
         virDomainPtr *list = NULL;
         virConnectPtr conn = NULL;
         int count;
@@ -658,20 +720,28 @@ CMPIStatus enum_domains(const CMPIBroker *broker,
         for (i = 0; i < count; i++) {
                 CMPIInstance *inst = NULL;
                 
+                /* Once the handler fails only the domains are freed */
+                if (hs.rc != CMPI_RC_OK)
+                        goto end;
+
                 s = instance_from_dom(broker,
                                       reference,
                                       conn,
                                       list[i],  
+                                      properties,
                                       &inst);
                 if (s.rc != CMPI_RC_OK)
                         goto end;
 
-                inst_list_add(instlist, inst);
+                hs = handler(inst, data);
 
           end:
                 virDomainFree(list[i]);
         }
 
+        if (hs.rc != CMPI_RC_OK)
+                s = hs;
+
  out:
         virConnectClose(conn);
         free(list);
@@ -679,49 +749,40 @@ CMPIStatus enum_domains(const CMPIBroker *broker,
         return s;
 }
 
+CMPIStatus enum_domains(const CMPIBroker *broker,
+                        const CMPIObjectPath *reference,
+                        struct inst_list *instlist)
+{
+        return stream_domains(broker, reference, NULL,
+                              inst_list_handler, instlist);
+}
+
 static CMPIStatus return_enum_domains(const CMPIObjectPath *reference,
                                       const CMPIResult *results,
+                                      const char **properties,
                                       bool names_only)
 {
-        struct inst_list list;
-        CMPIStatus s = {CMPI_RC_OK, NULL};
-
-        inst_list_init(&list);
-
-        s = enum_domains(_BROKER, reference, &list);
-        if (s.rc != CMPI_RC_OK)
-                goto out;
+        struct inst_result res = {_BROKER, results, names_only};
+        const char *keys_only[] = {NULL};
 
         if (names_only)
-                cu_return_instance_names(results, &list);
-        else
-                cu_return_instances(results, &list);
+                properties = keys_only;
 
- out:
-        inst_list_free(&list);
-
-        return s;
+        return stream_domains(_BROKER, reference, properties,
+                              inst_result_handler, &res);
 }
 
-CMPIStatus get_domain_by_name(const CMPIBroker *broker,
-                              const CMPIObjectPath *reference,
-                              const char *name,
-                              CMPIInstance **_inst)
+static CMPIStatus _get_domain_by_name_conn(const CMPIBroker *broker,
+                                           const CMPIObjectPath *reference,
+                                           virConnectPtr conn,
+                                           const char *name,
+                                           const char **properties,
+                                           CMPIInstance **_inst)
 {
         CMPIInstance *inst = NULL;
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        virConnectPtr conn = NULL;
         virDomainPtr dom;
 
-        conn = connect_by_classname(broker, CLASSNAME(reference), &s);
-        if (conn == NULL) {
-                CU_DEBUG("No such instance");
-                cu_statusf(broker, &s,
-                           CMPI_RC_ERR_NOT_FOUND,
-                           "No such instance.");
-                return s;
-        }
-
         dom = virDomainLookupByName(conn, name);
         if (dom == NULL) {
                 CU_DEBUG("Domain '%s' does not exist", name);
@@ -737,6 +798,7 @@ CMPIStatus get_domain_by_name(const CMPIBroker *broker,
                               reference,
                               conn,
                               dom,  
+                              properties,
                               &inst);
         if (s.rc != CMPI_RC_OK) {
                 CU_DEBUG("Unable to retrieve instance from domain");
@@ -747,14 +809,58 @@ CMPIStatus get_domain_by_name(const CMPIBroker *broker,
 
  out:
         virDomainFree(dom);
+
+        return s;
+}
+
+CMPIStatus get_domain_by_name_conn(const CMPIBroker *broker,
+                                   const CMPIObjectPath *reference,
+                                   virConnectPtr conn,
+                                   const char *name,
+                                   CMPIInstance **_inst)
+{
+        return _get_domain_by_name_conn(broker, reference, conn, name,
+                                        NULL, _inst);
+}
+
+static CMPIStatus _get_domain_by_name(const CMPIBroker *broker,
+                                      const CMPIObjectPath *reference,
+                                      const char *name,
+                                      const char **properties,
+                                      CMPIInstance **_inst)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        virConnectPtr conn = NULL;
+
+        conn = connect_by_classname(broker, CLASSNAME(reference), &s);
+        if (conn == NULL) {
+                CU_DEBUG("No such instance");
+                cu_statusf(broker, &s,
+                           CMPI_RC_ERR_NOT_FOUND,
+                           "No such instance.");
+                return s;
+        }
+
+        s = _get_domain_by_name_conn(broker, reference, conn, name,
+                                     properties, _inst);
+
         virConnectClose(conn);
 
         return s;
 }
 
-CMPIStatus get_domain_by_ref(const CMPIBroker *broker,
-                             const CMPIObjectPath *reference,
-                             CMPIInstance **_inst)
+CMPIStatus get_domain_by_name(const CMPIBroker *broker,
+                              const CMPIObjectPath *reference,
+                              const char *name,
+                              CMPIInstance **_inst)
+{
+        return _get_domain_by_name(broker, reference, name, NULL, _inst);
+}
+
+static CMPIStatus _get_domain_by_ref(const CMPIBroker *broker,
+                                     const CMPIObjectPath *reference,
+                                     const char **properties,
+                                     CMPIInstance **_inst)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIInstance *inst = NULL;
@@ -767,7 +873,7 @@ CMPIStatus get_domain_by_ref(const CMPIBroker *broker,
                 goto out;
         }
 
-        s = get_domain_by_name(broker, reference, name, &inst);
+        s = _get_domain_by_name(broker, reference, name, properties, &inst);
         if (s.rc != CMPI_RC_OK)
                 goto out;
         
@@ -782,12 +888,19 @@ CMPIStatus get_domain_by_ref(const CMPIBroker *broker,
         return s;
 }
 
+CMPIStatus get_domain_by_ref(const CMPIBroker *broker,
+                             const CMPIObjectPath *reference,
+                             CMPIInstance **_inst)
+{
+        return _get_domain_by_ref(broker, reference, NULL, _inst);
+}
+
 static CMPIStatus EnumInstanceNames(CMPIInstanceMI *self,
                                     const CMPIContext *context,
                                     const CMPIResult *results,
                                     const CMPIObjectPath *reference)
 {
-        return return_enum_domains(reference, results, true);
+        return return_enum_domains(reference, results, NULL, true);
 }
 
 static CMPIStatus EnumInstances(CMPIInstanceMI *self,
@@ -797,7 +910,7 @@ static CMPIStatus EnumInstances(CMPIInstanceMI *self,
                                 const char **properties)
 {
 
-        return return_enum_domains(reference, results, false);
+        return return_enum_domains(reference, results, properties, false);
 }
 
 static CMPIStatus GetInstance(CMPIInstanceMI *self,
@@ -809,7 +922,7 @@ static CMPIStatus GetInstance(CMPIInstanceMI *self,
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIInstance *inst;
         
-        s = get_domain_by_ref(_BROKER, reference, &inst);
+        s = _get_domain_by_ref(_BROKER, reference, properties, &inst);
         if (s.rc != CMPI_RC_OK)
                 goto out;
 
@@ -933,15 +1046,15 @@ static void set_scheduler_params(virDomainPtr dom)
                 return;
         }
 
-        if (STREQC(virConnectGetType(conn), "xen"))
+        if (STREQC(type_from_conn(conn), "xen"))
                 count = xen_scheduler_params(ctx, &params);
-        else if (STREQC(virConnectGetType(conn), "lxc"))
+        else if (STREQC(type_from_conn(conn), "lxc"))
                 count = lxc_scheduler_params(ctx, &params);
-        else if (STREQC(virConnectGetType(conn), "QEMU"))
+        else if (STREQC(type_from_conn(conn), "QEMU"))
                 count = kvm_scheduler_params(ctx, &params);
         else {
                 CU_DEBUG("Not setting sched params for type %s",
-                         virConnectGetType(conn));
+                         type_from_conn(conn));
                 goto out;
         }
 
@@ -1325,10 +1438,10 @@ static CMPIStatus state_change(CMPIMethodMI *self,
         return s;
 }
 
-STD_InstanceMIStub(, 
-                   Virt_ComputerSystem, 
-                   _BROKER, 
-                   libvirt_cim_init());
+STATS_InstanceMIStub(, 
+                     Virt_ComputerSystem, 
+                     _BROKER, 
+                     libvirt_cim_init());
 
 static struct method_handler RequestStateChange = {
         .name = "RequestStateChange",
@@ -1344,7 +1457,7 @@ static struct method_handler *my_handlers[] = {
         NULL
 };
 
-STDIM_MethodMIStub(,
+STATS_MethodMIStub(,
                    Virt_ComputerSystem,
                    _BROKER,
                    libvirt_cim_init(),
@@ -36,6 +36,23 @@ CMPIStatus enum_domains(const CMPIBroker *broker,
                         const CMPIObjectPath *reference,
                         struct inst_list *instlist);
 
+/**
+ * Hand each domain instance to handler as soon as it is built
+ *
+ * @param broker A pointer to the current broker
+ * @param reference The object path containing namespace and prefix info
+ * @param properties The properties to fill in besides the keys, NULL
+ *                   for all of them
+ * @param handler Called with each instance and data
+ * @param data Passed to handler
+ * @returns CMPIStatus
+ */
+CMPIStatus stream_domains(const CMPIBroker *broker,
+                          const CMPIObjectPath *reference,
+                          const char **properties,
+                          inst_handler_t handler,
+                          void *data);
+
 /**
  * Get domain instance specified by the client given domain 
  * object path
@@ -63,6 +80,23 @@ CMPIStatus get_domain_by_name(const CMPIBroker *broker,
                               const char *name,
                               CMPIInstance **_inst);
 
+/**
+ * Get domain instance specified by the domain name, using an already
+ * open connection
+ *
+ * @param broker A pointer to the current broker
+ * @param ref The object path containing namespace and prefix info
+ * @param conn The connection to look the domain up on
+ * @param name The domain name
+ * @param _inst In case of success the pointer to the instance
+ * @returns CMPIStatus
+ */
+CMPIStatus get_domain_by_name_conn(const CMPIBroker *broker,
+                                   const CMPIObjectPath *reference,
+                                   virConnectPtr conn,
+                                   const char *name,
+                                   CMPIInstance **_inst);
+
 /**
  * Create a domain instance from the domain structure. Note that the instance
  * doesn't necessarily represents an existing domain (can represent a deleted
@@ -83,6 +117,22 @@ CMPIStatus instance_from_dominfo(const CMPIBroker *broker,
                                  struct domain *dominfo,
                                  CMPIInstance **_inst);
 
+/**
+ * Set the state properties (EnabledState, HealthState and others) of a
+ * domain instance from a libvirt domain state, without querying libvirt.
+ * RequestedState is set to unknown.
+ *
+ * @param broker A pointer to the current broker
+ * @param name The domain name
+ * @param lv_state The libvirt state of the domain (virDomainState)
+ * @param instance The domain instance to update
+ * @returns 1 on success, 0 on failure
+ */
+int set_domain_state(const CMPIBroker *broker,
+                     const char *name,
+                     int lv_state,
+                     CMPIInstance *instance);
+
 
 #endif
 
@@ -28,6 +28,8 @@
 #include <fcntl.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
 #include <pthread.h>
 
 #include <cmpidt.h>
@@ -43,6 +45,7 @@
 #include <misc_util.h>
 #include <cs_util.h>
 #include <list_util.h>
+#include <ind_queue.h>
 
 #include "Virt_ComputerSystem.h"
 #include "Virt_ComputerSystemIndication.h"
@@ -57,6 +60,7 @@ enum CSI_PLATFORMS {
 
 #define CS_NUM_EVENTS 3
 enum CS_EVENTS {
+        CS_NONE = -1,
         CS_CREATED,
         CS_DELETED,
         CS_MODIFIED,
@@ -67,6 +71,18 @@ struct _csi_dom_xml_t {
         char uuid[VIR_UUID_STRING_BUFLEN];
         char *name;
         char *xml;
+        int state;
+};
+
+/* Events seen for one domain during the current coalescing window */
+typedef struct _csi_pending_t csi_pending_t;
+struct _csi_pending_t {
+        int cs_event;
+        unsigned int raw;
+        uint64_t first;
+        uint64_t deadline;
+        csi_dom_xml_t *dom;
+        csi_pending_t *next;
 };
 
 typedef struct _csi_thread_data_t csi_thread_data_t;
@@ -76,41 +92,65 @@ struct _csi_thread_data_t {
         int dom_count;
         list_t *dom_list;
         struct ind_args *args;
+        virConnectPtr conn;
+        csi_pending_t *pending;
+        int timer;
+        unsigned long raw_events;
+        unsigned long delivered_events;
 };
 
 static const CMPIBroker *_BROKER;
 static pthread_mutex_t lifecycle_mutex = PTHREAD_MUTEX_INITIALIZER;
 static bool lifecycle_enabled = false;
 static csi_thread_data_t csi_thread_data[CSI_NUM_PLATFORMS] = {{0}, {0}, {0}};
+static struct ind_queue csi_ind_queue =
+        IND_QUEUE_INITIALIZER("Virt_ComputerSystemIndication");
 
-void set_source_inst_props(const CMPIBroker *broker,
-                           const CMPIContext *context,
-                           const CMPIObjectPath *ref,
-                           CMPIInstance *ind)
+void get_ind_source(const CMPIBroker *broker,
+                    const CMPIContext *context,
+                    const CMPIObjectPath *ref,
+                    struct ind_source *src)
 {
-        const char *host;
         const char *hostccn;
         CMPIStatus s;
-        CMPIString *str;
 
-        str = CMObjectPathToString(ref, &s);
-        if ((str == NULL) || (s.rc != CMPI_RC_OK)) {
+        src->model_path = CMObjectPathToString(ref, &s);
+        if ((src->model_path == NULL) || (s.rc != CMPI_RC_OK)) {
                 CU_DEBUG("Unable to get path string");
-        } else {
-                CMSetProperty(ind, "SourceInstanceModelPath",
-                              (CMPIValue *)&str, CMPI_string);
+                src->model_path = NULL;
         }
 
-        s = get_host_system_properties(&host, &hostccn, ref, broker, context);
+        s = get_host_system_properties(&src->host, &hostccn,
+                                       ref, broker, context);
         if (s.rc != CMPI_RC_OK) {
                 CU_DEBUG("Unable to get host properties (%s): %s",
                          CLASSNAME(ref), CMGetCharPtr(s.msg));
-        } else {
-                CMSetProperty(ind, "SourceInstanceHost",
-                              (CMPIValue *)host, CMPI_chars);
+                src->host = NULL;
         }
 }
 
+void set_ind_source(CMPIInstance *ind, const struct ind_source *src)
+{
+        if (src->model_path != NULL)
+                CMSetProperty(ind, "SourceInstanceModelPath",
+                              (CMPIValue *)&src->model_path, CMPI_string);
+
+        if (src->host != NULL)
+                CMSetProperty(ind, "SourceInstanceHost",
+                              (CMPIValue *)src->host, CMPI_chars);
+}
+
+void set_source_inst_props(const CMPIBroker *broker,
+                           const CMPIContext *context,
+                           const CMPIObjectPath *ref,
+                           CMPIInstance *ind)
+{
+        struct ind_source src;
+
+        get_ind_source(broker, context, ref, &src);
+        set_ind_source(ind, &src);
+}
+
 static bool _do_indication(const CMPIBroker *broker,
                            const CMPIContext *ctx,
                            CMPIInstance *prev_inst,
@@ -195,11 +235,11 @@ static bool _do_indication(const CMPIBroker *broker,
         CU_DEBUG("Delivering Indication: %s",
                  CMGetCharPtr(CMObjectPathToString(ind_op, NULL)));
 
-        s = stdi_deliver(broker, ctx, args, ind);
+        s = ind_queue_push(&csi_ind_queue, broker, ctx, args, ind);
         if (s.rc == CMPI_RC_OK) {
-                CU_DEBUG("Indication delivered");
+                CU_DEBUG("Indication queued");
         } else {
-                CU_DEBUG("Not delivered: %s", CMGetCharPtr(s.msg));
+                CU_DEBUG("Not queued: %s", CMGetCharPtr(s.msg));
         }
 
  out:
@@ -288,6 +328,44 @@ static bool create_deleted_guest_inst(const char *xml,
         return rc;
 }
 
+static bool create_prev_guest_inst(const char *xml,
+                                   int lv_state,
+                                   const char *namespace,
+                                   const char *prefix,
+                                   CMPIInstance **inst)
+{
+        bool rc = false;
+        struct domain *dominfo = NULL;
+        int res;
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+
+        res = get_dominfo_from_xml(xml, &dominfo);
+        if (res == 0) {
+                CU_DEBUG("failed to extract domain info from xml");
+                goto out;
+        }
+
+        s = instance_from_dominfo(_BROKER,
+                                  namespace,
+                                  prefix,
+                                  dominfo,
+                                  inst);
+        if (s.rc != CMPI_RC_OK) {
+                CU_DEBUG("instance from domain info error: %s",
+                         CMGetCharPtr(s.msg));
+                goto out;
+        }
+
+        rc = set_domain_state(_BROKER, dominfo->name, lv_state, *inst);
+        if (!rc)
+                CU_DEBUG("Error setting instance state");
+
+ out:
+        cleanup_dominfo(&dominfo);
+
+        return rc;
+}
+
 static int platform_from_class(const char *cn)
 {
         if (STARTS_WITH(cn, "Xen")) {
@@ -421,6 +499,22 @@ static int dom_state(virDomainPtr dom)
         };
 }
 
+static int dom_lv_state(struct dom_xml dom)
+{
+        switch (dom.state) {
+        case DOM_ONLINE:
+                return VIR_DOMAIN_RUNNING;
+        case DOM_PAUSED:
+                return VIR_DOMAIN_PAUSED;
+        case DOM_OFFLINE:
+                return VIR_DOMAIN_SHUTOFF;
+        case DOM_CRASHED:
+                return VIR_DOMAIN_CRASHED;
+        default:
+                return VIR_DOMAIN_NOSTATE;
+        }
+}
+
 static CMPIStatus doms_to_xml(struct dom_xml **dom_xml_list,
                               virDomainPtr *dom_ptr_list,
                               int dom_ptr_count)
@@ -577,10 +671,18 @@ static bool async_ind_native(CMPIContext *context,
                 goto out;
         }
 
-        /* FIXME: We are unable to get the previous CS instance after it has
-                  been modified. Consider keeping track of the previous
-                  state in the place we keep track of the requested state */
+        /* The previous instance comes from the XML and state recorded at
+           the last poll */
         prev_inst = affected_inst;
+        if ((ind_type == CS_MODIFIED) &&
+            !create_prev_guest_inst(prev_dom.xml,
+                                    dom_lv_state(prev_dom),
+                                    args->ns,
+                                    prefix,
+                                    &prev_inst)) {
+                CU_DEBUG("Could not recreate previous guest instance");
+                prev_inst = affected_inst;
+        }
 
         CMSetProperty(affected_inst, "Name",
                       (CMPIValue *)name, CMPI_chars);
@@ -896,6 +998,14 @@ static CMPIInstance *get_prev_inst(const CMPIBroker *broker,
         return prev_inst;
 }
 
+/* Only raised while lifecycle indications are enabled */
+static struct std_indication_ctx raise_ctx = {
+        .brkr = NULL,
+        .handler = NULL,
+        .filters = filters,
+        .enabled = 1,
+};
+
 static CMPIStatus raise_indication(const CMPIBroker *broker,
                                    const CMPIContext *ctx,
                                    const CMPIObjectPath *ref,
@@ -905,7 +1015,6 @@ static CMPIStatus raise_indication(const CMPIBroker *broker,
         CMPIInstance *prev_inst;
         CMPIInstance *src_inst;
         CMPIObjectPath *_ref = NULL;
-        struct std_indication_ctx *_ctx = NULL;
         struct ind_args *args = NULL;
         char *prefix = NULL;
         bool rc;
@@ -941,18 +1050,8 @@ static CMPIStatus raise_indication(const CMPIBroker *broker,
                 goto out;
         }
 
-        _ctx = malloc(sizeof(struct std_indication_ctx));
-        if (_ctx == NULL) {
-                cu_statusf(broker, &s,
-                           CMPI_RC_ERR_FAILED,
-                           "Unable to allocate indication context");
-                goto out;
-        }
-
-        _ctx->brkr = broker;
-        _ctx->handler = NULL;
-        _ctx->filters = filters;
-        _ctx->enabled = lifecycle_enabled;
+        /* Delivery is queued, so the context must outlive this call */
+        raise_ctx.brkr = broker;
 
         args = malloc(sizeof(struct ind_args));
         if (args == NULL) {
@@ -971,7 +1070,7 @@ static CMPIStatus raise_indication(const CMPIBroker *broker,
                            "Failed in strdup in indication raising");
                 goto out;
         }
-        args->_ctx = _ctx;
+        args->_ctx = &raise_ctx;
 
         prefix = class_prefix_name(args->classname);
 
@@ -989,10 +1088,6 @@ static CMPIStatus raise_indication(const CMPIBroker *broker,
                 stdi_free_ind_args(&args);
         }
 
-        if (_ctx != NULL) {
-                free(_ctx);
-        }
-
         free(prefix);
         return s;
 }
@@ -1060,6 +1155,7 @@ static csi_dom_xml_t *csi_dom_xml_new(virDomainPtr dom_ptr, CMPIStatus *s)
 {
         int rc;
         csi_dom_xml_t *dom;
+        virDomainInfo info;
 
         dom = calloc(1, sizeof(*dom));
         if (dom == NULL) {
@@ -1079,6 +1175,12 @@ static csi_dom_xml_t *csi_dom_xml_new(virDomainPtr dom_ptr, CMPIStatus *s)
                 goto error;
         }
 
+        /* state, kept up to date from events afterwards */
+        if (virDomainGetInfo(dom_ptr, &info) == 0)
+                dom->state = info.state;
+        else
+                dom->state = VIR_DOMAIN_NOSTATE;
+
         return dom;
 
  error:
@@ -1086,6 +1188,31 @@ static csi_dom_xml_t *csi_dom_xml_new(virDomainPtr dom_ptr, CMPIStatus *s)
         return NULL;
 }
 
+static csi_dom_xml_t *csi_dom_xml_dup(csi_dom_xml_t *dom)
+{
+        csi_dom_xml_t *dup;
+
+        dup = calloc(1, sizeof(*dup));
+        if (dup == NULL)
+                return NULL;
+
+        memcpy(dup->uuid, dom->uuid, sizeof(dup->uuid));
+        dup->state = dom->state;
+
+        if (dom->name != NULL)
+                dup->name = strdup(dom->name);
+        if (dom->xml != NULL)
+                dup->xml = strdup(dom->xml);
+
+        if (((dom->name != NULL) && (dup->name == NULL)) ||
+            ((dom->xml != NULL) && (dup->xml == NULL))) {
+                csi_dom_xml_free(dup);
+                return NULL;
+        }
+
+        return dup;
+}
+
 static void csi_thread_dom_list_append(csi_thread_data_t *thread,
                                        csi_dom_xml_t *dom)
 {
@@ -1112,8 +1239,10 @@ static void csi_free_thread_data(void *data)
 }
 
 static bool async_ind(struct ind_args *args,
+                      virConnectPtr conn,
                       int ind_type,
                       csi_dom_xml_t *dom,
+                      csi_dom_xml_t *prev,
                       const char *prefix)
 {
         bool rc = false;
@@ -1137,7 +1266,11 @@ static bool async_ind(struct ind_args *args,
         }
 
         if (ind_type == CS_CREATED || ind_type == CS_MODIFIED) {
-                s = get_domain_by_name(_BROKER, op, dom->name, &affected_inst);
+                s = get_domain_by_name_conn(_BROKER,
+                                            op,
+                                            conn,
+                                            dom->name,
+                                            &affected_inst);
 
                 /* If domain is not found, we create the instance from the data
                    previously stored */
@@ -1173,10 +1306,19 @@ static bool async_ind(struct ind_args *args,
                 goto out;
         }
 
-        /* FIXME: We are unable to get the previous CS instance after it has
-                  been modified. Consider keeping track of the previous
-                  state in the place we keep track of the requested state */
+        /* The previous instance comes from the XML and state cached before
+           the first event of the burst, so it needs no libvirt calls */
         prev_inst = affected_inst;
+        if ((ind_type == CS_MODIFIED) &&
+            (prev != NULL) &&
+            !create_prev_guest_inst(prev->xml,
+                                    prev->state,
+                                    args->ns,
+                                    prefix,
+                                    &prev_inst)) {
+                CU_DEBUG("Could not recreate previous guest instance");
+                prev_inst = affected_inst;
+        }
 
         CMSetProperty(affected_inst, "Name",
                       (CMPIValue *) dom->name, CMPI_chars);
@@ -1218,6 +1360,196 @@ static int update_domain_list(virConnectPtr conn, csi_thread_data_t *thread)
         return s.rc;
 }
 
+/*
+ * Event coalescing
+ *
+ * A single operation on a guest makes libvirt emit a burst of lifecycle
+ * events.  Events are queued per domain and merged until no new event has
+ * arrived for csi_coalesce_ms (or ten times that has passed since the
+ * first one), then a single indication carrying the final state is sent.
+ */
+#define CSI_MAX_DEFER 10
+
+static uint64_t csi_now_ms(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ((uint64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static int csi_state_from_event(int event, int state)
+{
+        switch (event) {
+        case VIR_DOMAIN_EVENT_STARTED:
+        case VIR_DOMAIN_EVENT_RESUMED:
+                return VIR_DOMAIN_RUNNING;
+        case VIR_DOMAIN_EVENT_SUSPENDED:
+                return VIR_DOMAIN_PAUSED;
+        case VIR_DOMAIN_EVENT_STOPPED:
+                return VIR_DOMAIN_SHUTOFF;
+        default:
+                return state;
+        }
+}
+
+static int csi_merge_event(int prev, int next)
+{
+        switch (prev) {
+        case CS_NONE:
+                return next;
+        case CS_CREATED:
+                /* Nobody has seen the guest yet, so nothing happened */
+                return next == CS_DELETED ? CS_NONE : CS_CREATED;
+        default: /* CS_MODIFIED, CS_DELETED */
+                return next == CS_DELETED ? CS_DELETED : CS_MODIFIED;
+        }
+}
+
+static void csi_pending_free(csi_pending_t *pending)
+{
+        csi_pending_t *next;
+
+        while (pending != NULL) {
+                next = pending->next;
+                csi_dom_xml_free(pending->dom);
+                free(pending);
+                pending = next;
+        }
+}
+
+/* Call with lifecycle_mutex held */
+static void csi_queue_event(csi_thread_data_t *thread,
+                            int cs_event,
+                            csi_dom_xml_t *dom)
+{
+        csi_pending_t **pp;
+        csi_pending_t *pending;
+        uint64_t now = csi_now_ms();
+        uint64_t window = get_csi_coalesce_ms();
+
+        for (pp = &thread->pending; *pp != NULL; pp = &(*pp)->next) {
+                if (STREQ((*pp)->dom->uuid, dom->uuid))
+                        break;
+        }
+
+        pending = *pp;
+        if (pending == NULL) {
+                pending = calloc(1, sizeof(*pending));
+                if (pending == NULL) {
+                        CU_DEBUG("Failed to allocate pending event");
+                        return;
+                }
+
+                /* Keep the guest as it was before the burst */
+                pending->dom = csi_dom_xml_dup(dom);
+                if (pending->dom == NULL) {
+                        CU_DEBUG("Failed to copy domain %s", dom->name);
+                        free(pending);
+                        return;
+                }
+
+                pending->cs_event = cs_event;
+                pending->first = now;
+                *pp = pending;
+        } else
+                pending->cs_event = csi_merge_event(pending->cs_event,
+                                                    cs_event);
+
+        pending->raw += 1;
+        pending->deadline = now + window;
+        if (pending->deadline > pending->first + (window * CSI_MAX_DEFER))
+                pending->deadline = pending->first + (window * CSI_MAX_DEFER);
+}
+
+/* Call with lifecycle_mutex held */
+static void csi_flush_events(csi_thread_data_t *thread, bool all)
+{
+        csi_pending_t **pp = &thread->pending;
+        csi_pending_t *pending;
+        csi_dom_xml_t *dom;
+        uint64_t now = csi_now_ms();
+        char *prefix = class_prefix_name(thread->args->classname);
+
+        while (*pp != NULL) {
+                pending = *pp;
+                if (!all && (pending->deadline > now)) {
+                        pp = &pending->next;
+                        continue;
+                }
+
+                *pp = pending->next;
+                pending->next = NULL;
+
+                if (pending->cs_event == CS_NONE) {
+                        CU_DEBUG("Dropping %u events for transient domain %s",
+                                 pending->raw, pending->dom->name);
+                        goto next;
+                }
+
+                /* Undefined guests are only left in the pending copy */
+                dom = list_find(thread->dom_list, pending->dom->uuid);
+                if (dom == NULL)
+                        dom = pending->dom;
+
+                CU_DEBUG("Coalesced %u events for domain %s",
+                         pending->raw, dom->name);
+
+                if (async_ind(thread->args,
+                              thread->conn,
+                              pending->cs_event,
+                              dom,
+                              pending->dom,
+                              prefix))
+                        thread->delivered_events += 1;
+ next:
+                csi_pending_free(pending);
+        }
+
+        CU_DEBUG("%s events: %lu raw, %lu delivered",
+                 prefix, thread->raw_events, thread->delivered_events);
+
+        free(prefix);
+}
+
+/* Call with lifecycle_mutex held */
+static void csi_update_timer(csi_thread_data_t *thread)
+{
+        csi_pending_t *pending;
+        uint64_t deadline = UINT64_MAX;
+        uint64_t now;
+
+        if (thread->timer < 0) {
+                csi_flush_events(thread, true);
+                return;
+        }
+
+        if (thread->pending == NULL) {
+                virEventUpdateTimeout(thread->timer, -1);
+                return;
+        }
+
+        for (pending = thread->pending; pending; pending = pending->next) {
+                if (pending->deadline < deadline)
+                        deadline = pending->deadline;
+        }
+
+        now = csi_now_ms();
+        virEventUpdateTimeout(thread->timer,
+                              deadline > now ? (int)(deadline - now) : 0);
+}
+
+static void csi_timer_cb(int timer, void *data)
+{
+        csi_thread_data_t *thread = (csi_thread_data_t *) data;
+
+        pthread_mutex_lock(&lifecycle_mutex);
+        csi_flush_events(thread, false);
+        csi_update_timer(thread);
+        pthread_mutex_unlock(&lifecycle_mutex);
+}
+
 /* following function will protect global data with lifecycle_mutex.
    TODO: improve it with seperate lock later. */
 static void csi_domain_event_cb(virConnectPtr conn,
@@ -1229,6 +1561,7 @@ static void csi_domain_event_cb(virConnectPtr conn,
         int cs_event = CS_MODIFIED;
         csi_thread_data_t *thread = (csi_thread_data_t *) data;
         csi_dom_xml_t *dom_xml = NULL;
+        char uuid[VIR_UUID_STRING_BUFLEN] = {0};
         char *prefix = class_prefix_name(thread->args->classname);
         CMPIStatus s = {CMPI_RC_OK, NULL};
 
@@ -1236,7 +1569,7 @@ static void csi_domain_event_cb(virConnectPtr conn,
         if (lifecycle_enabled == false || thread->active_filters <= 0) {
                 CU_DEBUG("%s indications deactivated, return", prefix);
                 pthread_mutex_unlock(&lifecycle_mutex);
-                return;
+                goto end;
         }
         pthread_mutex_unlock(&lifecycle_mutex);
 
@@ -1248,7 +1581,6 @@ static void csi_domain_event_cb(virConnectPtr conn,
                 if (detail == VIR_DOMAIN_EVENT_DEFINED_ADDED) {
                         CU_DEBUG("Domain defined");
                         cs_event = CS_CREATED;
-                        dom_xml = csi_dom_xml_new(dom, &s);
                 } else if (detail == VIR_DOMAIN_EVENT_DEFINED_UPDATED) {
                         CU_DEBUG("Domain modified");
                         cs_event = CS_MODIFIED;
@@ -1267,43 +1599,49 @@ static void csi_domain_event_cb(virConnectPtr conn,
                 break;
         }
 
-        if (cs_event != CS_CREATED) {
-                char uuid[VIR_UUID_STRING_BUFLEN] = {0};
-                if (virDomainGetUUIDString(dom, &uuid[0]) == -1) {
-                    CU_DEBUG("Failed to get domain UUID");
-                    goto end;
+        if (virDomainGetUUIDString(dom, &uuid[0]) == -1) {
+                CU_DEBUG("Failed to get domain UUID");
+                goto end;
+        }
+
+        pthread_mutex_lock(&lifecycle_mutex);
+        thread->raw_events += 1;
+
+        dom_xml = list_find(thread->dom_list, uuid);
+        if ((dom_xml == NULL) && (cs_event == CS_CREATED)) {
+                dom_xml = csi_dom_xml_new(dom, &s);
+                if (dom_xml == NULL) {
+                        CU_DEBUG("Failed to get domain info %s",
+                                 CMGetCharPtr(s.msg));
+                        goto unlock;
                 }
-                pthread_mutex_lock(&lifecycle_mutex);
-                dom_xml = list_find(thread->dom_list, uuid);
-                pthread_mutex_unlock(&lifecycle_mutex);
+
+                csi_thread_dom_list_append(thread, dom_xml);
         }
 
         if (dom_xml == NULL) {
                 CU_DEBUG("Domain not found in current list");
-                goto end;
+                goto unlock;
         }
 
-        pthread_mutex_lock(&lifecycle_mutex);
-        async_ind(thread->args, cs_event, dom_xml, prefix);
-        pthread_mutex_unlock(&lifecycle_mutex);
+        csi_queue_event(thread, cs_event, dom_xml);
 
         /* Update the domain list accordingly */
-        if (event == VIR_DOMAIN_EVENT_DEFINED) {
-                if (detail == VIR_DOMAIN_EVENT_DEFINED_ADDED) {
-                        pthread_mutex_lock(&lifecycle_mutex);
-                        csi_thread_dom_list_append(thread, dom_xml);
-                        pthread_mutex_unlock(&lifecycle_mutex);
-                } else if (detail == VIR_DOMAIN_EVENT_DEFINED_UPDATED) {
-                        free(dom_xml->name);
-                        free(dom_xml->xml);
-                        csi_dom_xml_set(dom_xml, dom, &s);
-                } else if (detail == VIR_DOMAIN_EVENT_UNDEFINED_REMOVED) {
-                        pthread_mutex_lock(&lifecycle_mutex);
-                        list_remove(thread->dom_list, dom_xml);
-                        pthread_mutex_unlock(&lifecycle_mutex);
-                }
+        dom_xml->state = csi_state_from_event(event, dom_xml->state);
+
+        if (event == VIR_DOMAIN_EVENT_DEFINED &&
+            detail == VIR_DOMAIN_EVENT_DEFINED_UPDATED) {
+                free(dom_xml->name);
+                free(dom_xml->xml);
+                csi_dom_xml_set(dom_xml, dom, &s);
+        } else if (event == VIR_DOMAIN_EVENT_UNDEFINED) {
+                list_remove(thread->dom_list, uuid);
         }
 
+        csi_update_timer(thread);
+
+ unlock:
+        pthread_mutex_unlock(&lifecycle_mutex);
  end:
         free(prefix);
 }
@@ -1313,6 +1651,7 @@ static CMPI_THREAD_RETURN lifecycle_thread(void *params)
         csi_thread_data_t *thread = (csi_thread_data_t *) params;
         struct ind_args *args = thread->args;
         char *prefix = class_prefix_name(args->classname);
+        csi_pending_t *pending;
 
         virConnectPtr conn;
 
@@ -1331,6 +1670,21 @@ static CMPI_THREAD_RETURN lifecycle_thread(void *params)
                 goto conn_out;
         }
 
+        thread->conn = conn;
+        thread->pending = NULL;
+        thread->raw_events = 0;
+        thread->delivered_events = 0;
+
+        /* Without a timer, events are delivered as they arrive */
+        thread->timer = -1;
+        if (get_csi_coalesce_ms() > 0) {
+                thread->timer = virEventAddTimeout(-1, csi_timer_cb,
+                                                   thread, NULL);
+                if (thread->timer < 0)
+                        CU_DEBUG("Failed to add coalescing timer for '%s'",
+                                 args->classname);
+        }
+
         /* register callback */
         cb_id = virConnectDomainEventRegisterAny(conn, NULL,
                                 VIR_DOMAIN_EVENT_ID_LIFECYCLE,
@@ -1373,14 +1727,32 @@ static CMPI_THREAD_RETURN lifecycle_thread(void *params)
         CU_DEBUG("Exiting CSI event loop (%s)", prefix);
 
         pthread_mutex_lock(&lifecycle_mutex);
+        /* Events still being coalesced are raised, not lost */
+        csi_flush_events(thread, true);
         CBDetachThread(_BROKER, args->context);
         pthread_mutex_unlock(&lifecycle_mutex);
  end:
         virConnectDomainEventDeregisterAny(conn, cb_id);
 
  cb_out:
+        /* Deliver what this thread raised before the provider can go */
+        ind_queue_flush(&csi_ind_queue);
+
         pthread_mutex_lock(&lifecycle_mutex);
 
+        if (thread->timer >= 0)
+                virEventRemoveTimeout(thread->timer);
+        thread->timer = -1;
+
+        CU_DEBUG("%s events: %lu raw, %lu delivered",
+                 prefix, thread->raw_events, thread->delivered_events);
+        for (pending = thread->pending; pending; pending = pending->next)
+                CU_DEBUG("Dropping %u events for domain %s",
+                         pending->raw, pending->dom->name);
+        csi_pending_free(thread->pending);
+        thread->pending = NULL;
+        thread->conn = NULL;
+
         thread->id = 0;
         thread->active_filters = 0;
 
@@ -1525,7 +1897,15 @@ static struct std_indication_handler csi = {
 };
 #endif
 
-DEFAULT_IND_CLEANUP();
+static CMPIStatus IndicationCleanup(CMPIIndicationMI *self,
+                                    const CMPIContext *context,
+                                    CMPIBoolean terminating)
+{
+        ind_queue_stop(&csi_ind_queue);
+
+        CMReturn(CMPI_RC_OK);
+}
+
 DEFAULT_AF();
 DEFAULT_MP();
 
@@ -24,6 +24,21 @@
 #include <cmpidt.h>
 #include <stdbool.h>
 
+/* The source properties shared by the indications raised for one
+ * reference, so a batch of indications looks them up once.
+ */
+struct ind_source {
+        CMPIString *model_path;
+        const char *host;
+};
+
+void get_ind_source(const CMPIBroker *broker,
+                    const CMPIContext *context,
+                    const CMPIObjectPath *ref,
+                    struct ind_source *src);
+
+void set_ind_source(CMPIInstance *ind, const struct ind_source *src);
+
 void set_source_inst_props(const CMPIBroker *broker,
                            const CMPIContext *context,
                            const CMPIObjectPath *ref,
@@ -35,6 +35,7 @@
 #include <misc_util.h>
 #include <libcmpiutil/std_indication.h>
 #include <cs_util.h>
+#include <ind_queue.h>
 
 #include "config.h"
 
@@ -59,7 +60,96 @@ static struct std_ind_filter *filters[] = {
         NULL,
 };
 
-DEFAULT_IND_CLEANUP();
+static struct ind_queue migration_ind_queue =
+        IND_QUEUE_INITIALIZER("Virt_ComputerSystemMigrationIndication");
+
+/* Indications are delivered from the queue with this context rather
+ * than the provider's own, so it follows the provider's enabled state
+ */
+static struct std_indication_ctx migration_ind_ctx = {
+        .brkr = NULL,
+        .handler = NULL,
+        .filters = filters,
+        .enabled = false,
+};
+
+/* Queued, so a slow listener does not hold up the migration thread */
+static CMPIStatus raise_indication(const CMPIBroker *broker,
+                                   const CMPIContext *ctx,
+                                   const CMPIObjectPath *ref,
+                                   const CMPIInstance *ind)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        struct ind_args args;
+        CMPIObjectPath *_ref;
+
+        _ref = CMGetObjectPath(ind, &s);
+        if (_ref == NULL) {
+                cu_statusf(broker, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Got a null object path");
+                return s;
+        }
+
+        /* FIXME:  This is a Pegasus work around. Pegsus loses the namespace
+                   when an ObjectPath is pulled from an instance */
+        if (STREQ(NAMESPACE(_ref), ""))
+                CMSetNameSpace(_ref, "root/virt");
+
+        migration_ind_ctx.brkr = broker;
+        args.context = NULL;
+        args.ns = (char *)NAMESPACE(_ref);
+        args.classname = (char *)CLASSNAME(_ref);
+        args._ctx = &migration_ind_ctx;
+
+        ind->ft->setObjectPath((CMPIInstance *)ind, _ref);
+
+        s = ind_queue_push(&migration_ind_queue, broker, ctx, &args, ind);
+        if (s.rc != CMPI_RC_OK)
+                CU_DEBUG("Not queued: %s", CMGetCharPtr(s.msg));
+
+        return s;
+}
+
+static _EI_RTYPE EnableIndications(CMPIIndicationMI *mi,
+                                   const CMPIContext *ctx)
+{
+        CU_DEBUG("EnableIndications");
+        migration_ind_ctx.enabled = true;
+
+        _EI_RET();
+}
+
+static _EI_RTYPE DisableIndications(CMPIIndicationMI *mi,
+                                    const CMPIContext *ctx)
+{
+        CU_DEBUG("DisableIndications");
+        migration_ind_ctx.enabled = false;
+
+        _EI_RET();
+}
+
+static struct std_indication_handler migration_ind = {
+        .raise_fn = raise_indication,
+        .trigger_fn = NULL,
+        .activate_fn = NULL,
+        .deactivate_fn = NULL,
+        .enable_fn = EnableIndications,
+        .disable_fn = DisableIndications,
+};
+
+/* Migration jobs may have queued indications that are not delivered
+ * yet; they go out before the provider does
+ */
+static CMPIStatus IndicationCleanup(CMPIIndicationMI *self,
+                                    const CMPIContext *context,
+                                    CMPIBoolean terminating)
+{
+        ind_queue_stop(&migration_ind_queue);
+
+        CMReturn(CMPI_RC_OK);
+}
+
 DEFAULT_AF();
 DEFAULT_MP();
 
@@ -67,7 +157,7 @@ STDI_IndicationMIStub(,
                       Virt_ComputerSystemMigrationIndicationProvider,
                       _BROKER,
                       libvirt_cim_init(), 
-                      NULL,
+                      &migration_ind,
                       filters);
 
 /*
@@ -211,10 +211,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(, 
-                   Virt_ConsoleRedirectionService, 
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(, 
+                     Virt_ConsoleRedirectionService, 
+                     _BROKER,
+                     libvirt_cim_init());
 
 
 /*
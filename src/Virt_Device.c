@@ -633,8 +633,17 @@ static CMPIStatus _get_devices(const CMPIBroker *broker,
         int count;
         bool rc;
         struct virt_device *devs = NULL;
+        struct arena *arena;
 
-        count = get_devices(dom, &devs, type, 0);
+        arena = arena_new();
+        if (arena == NULL) {
+                cu_statusf(broker, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to allocate memory");
+                return s;
+        }
+
+        count = get_devices_arena(dom, arena, &devs, type, 0);
         if (count <= 0)
                 goto out;
 
@@ -651,10 +660,8 @@ static CMPIStatus _get_devices(const CMPIBroker *broker,
                            "Couldn't get device instances");
         }
 
-        cleanup_virt_devices(&devs, count);
-
  out:
-        free(devs);
+        arena_free(arena);
         return s;
 }
 
@@ -685,15 +692,18 @@ static CMPIStatus _enum_devices(const CMPIBroker *broker,
         return s;
 }
 
-CMPIStatus enum_devices(const CMPIBroker *broker,
-                        const CMPIObjectPath *reference,
-                        const char *domain,
-                        const uint16_t type,
-                        struct inst_list *list)
+CMPIStatus stream_devices(const CMPIBroker *broker,
+                          const CMPIObjectPath *reference,
+                          const char *domain,
+                          const uint16_t type,
+                          inst_handler_t handler,
+                          void *data)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIStatus hs = {CMPI_RC_OK, NULL};
         virConnectPtr conn = NULL;
         virDomainPtr *doms = NULL;
+        struct inst_list list;
         int count = 1;
         int i;
 
@@ -708,16 +718,27 @@ CMPIStatus enum_devices(const CMPIBroker *broker,
         else
                 count = get_domain_list(conn, &doms);
 
+        /* Only one domain's devices are held at a time */
         for (i = 0; i < count; i++) {
-                s = _enum_devices(broker,
-                                  reference,
-                                  doms[i],
-                                  type,
-                                  list);
+                if (hs.rc == CMPI_RC_OK) {
+                        inst_list_init(&list);
+
+                        s = _enum_devices(broker,
+                                          reference,
+                                          doms[i],
+                                          type,
+                                          &list);
+
+                        hs = inst_list_emit(&list, handler, data);
+                        inst_list_free(&list);
+                }
 
                 virDomainFree(doms[i]);
         }
 
+        if (hs.rc != CMPI_RC_OK)
+                s = hs;
+
  out:
         virConnectClose(conn);
         free(doms);
@@ -725,35 +746,35 @@ CMPIStatus enum_devices(const CMPIBroker *broker,
         return s;
 }
 
+CMPIStatus enum_devices(const CMPIBroker *broker,
+                        const CMPIObjectPath *reference,
+                        const char *domain,
+                        const uint16_t type,
+                        struct inst_list *list)
+{
+        return stream_devices(broker, reference, domain, type,
+                              inst_list_handler, list);
+}
+
 static CMPIStatus return_enum_devices(const CMPIObjectPath *reference,
                                       const CMPIResult *results,
                                       int names_only)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        struct inst_list list;
+        struct inst_result res = {_BROKER, results, names_only};
+        uint16_t type;
 
         if (!provider_is_responsible(_BROKER, reference, &s))
-                goto out;
+                return s;
 
-        inst_list_init(&list);
+        type = res_type_from_device_classname(CLASSNAME(reference));
 
-        s = enum_devices(_BROKER,
-                         reference,
-                         NULL,
-                         res_type_from_device_classname(CLASSNAME(reference)),
-                         &list);
-        if (s.rc != CMPI_RC_OK)
-                goto out;
-
-        if (names_only)
-                cu_return_instance_names(results, &list);
-        else
-                cu_return_instances(results, &list);
-
- out:
-        inst_list_free(&list);
-
-        return s;
+        return stream_devices(_BROKER,
+                              reference,
+                              NULL,
+                              type,
+                              inst_result_handler,
+                              &res);
 }
 
 static int parse_devid(const char *devid, char **dom, char **dev)
@@ -770,68 +791,60 @@ static int parse_devid(const char *devid, char **dom, char **dev)
         return 1;
 }
 
-static int proc_dev_list(uint64_t quantity,
-                         struct virt_device **list)
+/* Finds the number of the vcpu named device */
+static bool find_dom_vcpu(virDomainPtr dom,
+                          const char *device,
+                          int *num)
 {
-        int i;
-
-        *list = (struct virt_device *)calloc(quantity,
-                                             sizeof(struct virt_device));
+        struct devlist *devs;
+        bool found = false;
+        uint64_t i;
 
-        for (i = 0; i < quantity; i++) {
-                char *dev_num;
-                int ret;
-
-                ret = asprintf(&dev_num, "%d", i);
-                if (ret == -1)
-                        CU_DEBUG("asprintf error %d" , ret);
+        devs = get_devlist(dom, CIM_RES_TYPE_PROC, 0);
+        if (devs == NULL || devs->count == 0) {
+                CU_DEBUG("No devices for %i", CIM_RES_TYPE_PROC);
+                goto out;
+        }
 
-                (*list)[i].id = strdup(dev_num);
+        for (i = 0; i < devs->list[0].dev.vcpu.quantity; i++) {
+                char dev_num[21];
 
-                free(dev_num);
+                snprintf(dev_num, sizeof(dev_num), "%d", (int)i);
+                if (STREQC(device, dev_num)) {
+                        *num = i;
+                        found = true;
+                        break;
+                }
         }
 
-        return quantity;
+ out:
+        devlist_unref(devs);
+
+        return found;
 }
 
+/* The device is borrowed from *devs, which the caller must unref */
 static struct virt_device *find_dom_dev(virDomainPtr dom, 
                                         char *device,
-                                        int type)
+                                        int type,
+                                        struct devlist **devs)
 {
-        struct virt_device *list = NULL;
-        struct virt_device *dev = NULL;
-        int count;
         int i;
 
-        count = get_devices(dom, &list, type, 0);
-        if (!count) {
-                CU_DEBUG("No devices for %i", type);
-                goto out;
-        }
-
-        if (type == CIM_RES_TYPE_PROC) {
-                struct virt_device *tmp_list;
-                int tmp_count;
-
-                tmp_count = proc_dev_list(list[0].dev.vcpu.quantity,
-                                          &tmp_list);
-                cleanup_virt_devices(&list, count);
-                list = tmp_list;
-                count = tmp_count;
+        *devs = get_devlist_by_id(dom, type, device, 0);
+        if (*devs == NULL || (*devs)->count == 0) {
+                CU_DEBUG("No device %s for %i", device, type);
+                return NULL;
         }
 
-        for (i = 0; i < count; i++) {
-                if (STREQC(device, list[i].id)) {
-                        dev = virt_device_dup(&list[i]);
-                        break;
-                }
+        for (i = 0; i < (*devs)->count; i++) {
+                struct virt_device *dev = &(*devs)->list[i];
 
+                if (dev->id != NULL && STREQC(device, dev->id))
+                        return dev;
         }
 
-        cleanup_virt_devices(&list, count);
- out:
-
-        return dev;
+        return NULL;
 }
 
 CMPIStatus get_device_by_name(const CMPIBroker *broker,
@@ -846,6 +859,7 @@ CMPIStatus get_device_by_name(const CMPIBroker *broker,
         virConnectPtr conn = NULL;
         virDomainPtr dom = NULL;
         struct virt_device *dev = NULL;
+        struct devlist *devs = NULL;
         struct inst_list tmp_list;
 
         inst_list_init(&tmp_list);
@@ -876,31 +890,37 @@ CMPIStatus get_device_by_name(const CMPIBroker *broker,
                 goto err;
         }
 
-        dev = find_dom_dev(dom, device, type);
-        if (!dev) {
-                cu_statusf(broker, &s,
-                           CMPI_RC_ERR_NOT_FOUND,
-                           "No such instance (no device %s)",
-                           name);
-                goto err;
-        }
-
         if (type == CIM_RES_TYPE_PROC) {
                 int dev_id_num;
-                sscanf(dev->id, "%d", &dev_id_num);
+
+                if (!find_dom_vcpu(dom, device, &dev_id_num)) {
+                        cu_statusf(broker, &s,
+                                   CMPI_RC_ERR_NOT_FOUND,
+                                   "No such instance (no device %s)",
+                                   name);
+                        goto err;
+                }
 
                 vcpu_inst(broker, dom, NAMESPACE(reference),
                           dev_id_num, &tmp_list);
         } else {
+                dev = find_dom_dev(dom, device, type, &devs);
+                if (!dev) {
+                        cu_statusf(broker, &s,
+                                   CMPI_RC_ERR_NOT_FOUND,
+                                   "No such instance (no device %s)",
+                                   name);
+                        goto err;
+                }
+
                 device_instances(broker, dev, 1, dom,
                                  NAMESPACE(reference), &tmp_list);
         }
 
-        cleanup_virt_devices(&dev, 1);
-
         *_inst = tmp_list.list[0];
 
  err:
+        devlist_unref(devs);
         virDomainFree(dom);
         free(domain);
         free(device);
@@ -987,10 +1007,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
-                   Virt_Device,
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_Device,
+                     _BROKER,
+                     libvirt_cim_init());
 
 /*
  * Local Variables:
@@ -40,6 +40,20 @@ CMPIStatus enum_devices(const CMPIBroker *broker,
                         const uint16_t type,
                         struct inst_list *list);
 
+/**
+ * Like enum_devices(), but hand the devices of each domain to handler
+ * before the next domain is read
+ *
+ * @param handler Called with each instance and data
+ * @param data Passed to handler
+ */
+CMPIStatus stream_devices(const CMPIBroker *broker,
+                          const CMPIObjectPath *reference,
+                          const char *domain,
+                          const uint16_t type,
+                          inst_handler_t handler,
+                          void *data);
+
 /**
  * Returns the device instance defined by the reference
  *
@@ -862,7 +862,7 @@ static bool mempool_set_total(CMPIInstance *inst, virConnectPtr conn)
         int ret;
         uint64_t memory = 0;
 
-        ret = virNodeGetInfo(conn, &info);
+        ret = node_info_from_conn(conn, &info);
         if (ret == 0)
                 memory = (uint64_t)info.memory;
 
@@ -961,7 +961,7 @@ static bool procpool_set_total(CMPIInstance *inst, virConnectPtr conn)
         CMSetProperty(inst, "Reserved",
                       (CMPIValue *)&procs, CMPI_uint64);
 
-        ret = virNodeGetInfo(conn, &info);
+        ret = node_info_from_conn(conn, &info);
         if (ret == 0)
                 procs = (uint64_t)info.cpus;
 
@@ -1547,16 +1547,12 @@ static CMPIStatus controllerpool_instance(virConnectPtr conn,
 
 static CMPIStatus _get_pools(const CMPIBroker *broker,
                              const CMPIObjectPath *reference,
+                             virConnectPtr conn,
                              const uint16_t type,
                              const char *id,
                              struct inst_list *list)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        virConnectPtr conn;
-
-        conn = connect_by_classname(broker, CLASSNAME(reference), &s);
-        if (conn == NULL)
-                goto out;
 
         if ((type == CIM_RES_TYPE_PROC) || 
             (type == CIM_RES_TYPE_ALL))
@@ -1624,8 +1620,6 @@ static CMPIStatus _get_pools(const CMPIBroker *broker,
                            CMPI_RC_ERR_NOT_FOUND,
                            "No such instance (%s)", id);
 
- out:
-        virConnectClose(conn);
         return s;
 }
 
@@ -1670,7 +1664,7 @@ CMPIStatus get_pool_by_name(const CMPIBroker *broker,
                 goto out;
         }
 
-        s = _get_pools(broker, reference, type, poolid, &list);
+        s = _get_pools(broker, reference, conn, type, poolid, &list);
         if (s.rc != CMPI_RC_OK)
                 goto out;
 
@@ -1740,7 +1734,18 @@ CMPIStatus enum_pools(const CMPIBroker *broker,
                       const uint16_t type,
                       struct inst_list *list)
 {
-        return _get_pools(broker, reference, type, NULL, list);
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        virConnectPtr conn;
+
+        conn = connect_by_classname(broker, CLASSNAME(reference), &s);
+        if (conn == NULL)
+                return s;
+
+        s = _get_pools(broker, reference, conn, type, NULL, list);
+
+        virConnectClose(conn);
+
+        return s;
 }
 
 CMPIInstance *parent_device_pool(const CMPIBroker *broker,
@@ -1903,10 +1908,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(, 
-                   Virt_DevicePool,
-                   _BROKER, 
-                   libvirt_cim_init());
+STATS_InstanceMIStub(, 
+                     Virt_DevicePool,
+                     _BROKER, 
+                     libvirt_cim_init());
 
 
 /*
@@ -587,11 +587,11 @@ static struct std_assoc *assoc_handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(, 
-                 Virt_ElementCapabilities,
-                 _BROKER,
-                 libvirt_cim_init(), 
-                 assoc_handlers);
+STATS_AssocMIStub(, 
+                  Virt_ElementCapabilities,
+                  _BROKER,
+                  libvirt_cim_init(), 
+                  assoc_handlers);
 /*
  * Local Variables:
  * mode: C
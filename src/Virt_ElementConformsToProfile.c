@@ -310,11 +310,11 @@ static struct std_assoc *assoc_handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(,
-                 Virt_ElementConformsToProfile,
-                 _BROKER, 
-                 libvirt_cim_init(), 
-                 assoc_handlers);
+STATS_AssocMIStub(,
+                  Virt_ElementConformsToProfile,
+                  _BROKER, 
+                  libvirt_cim_init(), 
+                  assoc_handlers);
 /*
  * Local Variables:
  * mode: C
@@ -187,11 +187,11 @@ static struct std_assoc *handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(, 
-                 Virt_ElementSettingData, 
-                 _BROKER,
-                 libvirt_cim_init(),
-                 handlers);
+STATS_AssocMIStub(, 
+                  Virt_ElementSettingData, 
+                  _BROKER,
+                  libvirt_cim_init(),
+                  handlers);
 
 /*
  * Local Variables:
@@ -203,7 +203,7 @@ static struct std_assoc *handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(,
+STATS_AssocMIStub(,
         Virt_EntriesInFilterList,
         _BROKER,
         libvirt_cim_init(),
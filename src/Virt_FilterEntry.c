@@ -796,7 +796,7 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
+STATS_InstanceMIStub(,
         Virt_FilterEntry,
         _BROKER,
         libvirt_cim_init());
@@ -379,7 +379,7 @@ DEFAULT_MI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
+STATS_InstanceMIStub(,
         Virt_FilterList,
         _BROKER,
         libvirt_cim_init());
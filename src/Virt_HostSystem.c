@@ -24,6 +24,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <netdb.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <cmpidt.h>
 #include <cmpift.h>
@@ -94,26 +96,265 @@ static int get_fqdn(char *host, int size)
         return ret;
 }
 
-static int set_host_system_properties(CMPIInstance *instance)
-{
-        CMPIStatus s = {CMPI_RC_OK, NULL};
+/*
+ * Every indication and many associations carry the host's name, and
+ * resolving it can stall for as long as DNS takes to answer.  So the
+ * name is resolved by a thread of its own, again every
+ * host_refresh_interval seconds or as soon as a request notices that
+ * the hostname changed.  Requests only read the last result, and use
+ * the plain hostname until there is one.
+ */
+static pthread_mutex_t host_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t host_wakeup = PTHREAD_COND_INITIALIZER;
+static const CMPIBroker *host_broker = NULL;
+static CMPI_THREAD_TYPE host_resolver;
+static bool host_resolver_running = false;
+static bool host_resolver_stop = false;
+static bool host_refresh = false;
+
+/* A name, once published, is never freed: requests hand it out without
+ * holding host_lock.  It only changes along with the hostname.
+ */
+static char *host_fqdn = NULL;
+static char host_shortname[256];
+
+/* The object path of each HostSystem class, built by the first request
+ * that needs it and again only when the host's name changes.  Call
+ * host_path() with host_lock held, the path it returns is valid until
+ * host_lock is dropped.
+ */
+static struct host_path {
+        const char *pfx;
+        const char *ccname;
+        char *ns;
+        const char *name;
         CMPIObjectPath *op;
+} host_paths[] = {
+        {"Xen", "Xen_HostSystem", NULL, NULL, NULL},
+        {"KVM", "KVM_HostSystem", NULL, NULL, NULL},
+        {"LXC", "LXC_HostSystem", NULL, NULL, NULL},
+};
+
+#define HOST_NUM_CLASSES (sizeof(host_paths) / sizeof(host_paths[0]))
+
+/* Call with host_lock held */
+static void host_publish(const char *fqdn, const char *shortname)
+{
+        if ((host_fqdn == NULL) || !STREQ(host_fqdn, fqdn)) {
+                char *name = strdup(fqdn);
+
+                if (name == NULL)
+                        return;
+
+                CU_DEBUG("hostname is %s", name);
+                host_fqdn = name;
+        }
+
+        strncpy(host_shortname, shortname, sizeof(host_shortname) - 1);
+}
+
+static void host_resolve(void)
+{
+        char shortname[256] = {0};
         char hostname[256] = {0};
+        int ret;
+
+        if (gethostname(shortname, sizeof(shortname) - 1) != 0)
+                CU_DEBUG("gethostname(): %m");
+
+        ret = get_fqdn(hostname, sizeof(hostname));
+
+        pthread_mutex_lock(&host_lock);
+
+        if (ret == 0) {
+                host_publish(hostname, shortname);
+        } else if (host_fqdn == NULL) {
+                CU_DEBUG("Unable to resolve host, using hostname");
+                host_publish(shortname[0] != '\0' ? shortname : "unknown",
+                             shortname);
+        } else {
+                CU_DEBUG("Unable to resolve host, keeping %s", host_fqdn);
+                strncpy(host_shortname, shortname,
+                        sizeof(host_shortname) - 1);
+        }
+
+        pthread_mutex_unlock(&host_lock);
+}
+
+static CMPI_THREAD_RETURN host_resolver_thread(void *arg)
+{
+        struct timespec deadline;
+        int interval;
+
+        CU_DEBUG("Host resolver started");
+
+        pthread_mutex_lock(&host_lock);
+
+        while (!host_resolver_stop) {
+                host_refresh = false;
+                pthread_mutex_unlock(&host_lock);
+
+                host_resolve();
+                interval = get_host_refresh_interval();
+
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += interval;
+
+                pthread_mutex_lock(&host_lock);
+
+                while (!host_resolver_stop && !host_refresh) {
+                        if (interval <= 0) {
+                                pthread_cond_wait(&host_wakeup, &host_lock);
+                        } else if (pthread_cond_timedwait(&host_wakeup,
+                                                          &host_lock,
+                                                          &deadline) != 0) {
+                                break;
+                        }
+                }
+        }
+
+        pthread_mutex_unlock(&host_lock);
+
+        CU_DEBUG("Host resolver stopped");
+
+        return (CMPI_THREAD_RETURN) 0;
+}
+
+/* Call with host_lock held */
+static void host_resolver_start(const CMPIBroker *broker)
+{
+        if (host_resolver_running || host_resolver_stop || (broker == NULL))
+                return;
+
+        host_resolver = broker->xft->newThread(host_resolver_thread,
+                                               NULL, 0);
+        if (host_resolver == 0) {
+                CU_DEBUG("Unable to start host resolver");
+                return;
+        }
+
+        host_broker = broker;
+        host_resolver_running = true;
+}
+
+static void host_resolver_join(void)
+{
+        struct host_path *hp;
+        unsigned int i;
+
+        pthread_mutex_lock(&host_lock);
+
+        host_resolver_stop = true;
+        pthread_cond_signal(&host_wakeup);
+
+        pthread_mutex_unlock(&host_lock);
 
-        op = CMGetObjectPath(instance, &s);
-        if ((s.rc == CMPI_RC_OK) && !CMIsNullObject(op)) {
-                CMSetProperty(instance, "CreationClassName",
-                              (CMPIValue *)CLASSNAME(op), CMPI_chars);
+        if (host_resolver_running) {
+                host_broker->xft->joinThread(host_resolver, NULL);
+                host_resolver_running = false;
         }
 
-        if (get_fqdn(hostname, sizeof(hostname)) != 0)
-                strcpy(hostname, "unknown");
+        for (i = 0; i < HOST_NUM_CLASSES; i++) {
+                hp = &host_paths[i];
 
-        CU_DEBUG("hostname is %s", hostname);
-        CMSetProperty(instance, "Name",
-                      (CMPIValue *)hostname, CMPI_chars);
-        
-        return 1;
+                if (hp->op != NULL)
+                        CMRelease(hp->op);
+                free(hp->ns);
+
+                hp->op = NULL;
+                hp->ns = NULL;
+                hp->name = NULL;
+        }
+}
+
+static const char *host_name(const CMPIBroker *broker)
+{
+        char shortname[256] = {0};
+        const char *name;
+
+        if (gethostname(shortname, sizeof(shortname) - 1) != 0)
+                CU_DEBUG("gethostname(): %m");
+
+        pthread_mutex_lock(&host_lock);
+
+        host_resolver_start(broker);
+
+        if (host_fqdn == NULL) {
+                host_publish(shortname[0] != '\0' ? shortname : "unknown",
+                             shortname);
+        } else if (!STREQ(shortname, host_shortname)) {
+                CU_DEBUG("Hostname changed to %s", shortname);
+                host_refresh = true;
+                pthread_cond_signal(&host_wakeup);
+        }
+
+        name = host_fqdn;
+
+        pthread_mutex_unlock(&host_lock);
+
+        return name != NULL ? name : "unknown";
+}
+
+/* Lets the host's properties be returned without building an instance */
+static struct host_path *host_class(const char *classname)
+{
+        struct host_path *hp;
+        size_t len;
+        unsigned int i;
+
+        for (i = 0; i < HOST_NUM_CLASSES; i++) {
+                hp = &host_paths[i];
+                len = strlen(hp->pfx);
+
+                if (STARTS_WITH(classname, hp->pfx) &&
+                    ((classname[len] == '_') || (classname[len] == '\0')))
+                        return hp;
+        }
+
+        return NULL;
+}
+
+/* Call with host_lock held */
+static CMPIObjectPath *host_path(const CMPIBroker *broker,
+                                 struct host_path *hp,
+                                 const char *ns,
+                                 const char *name,
+                                 CMPIStatus *s)
+{
+        CMPIObjectPath *op;
+        char *new_ns;
+
+        if ((hp->op != NULL) && (hp->name == name) && STREQ(hp->ns, ns))
+                return hp->op;
+
+        op = CMNewObjectPath(broker, ns, hp->ccname, s);
+        if ((s->rc != CMPI_RC_OK) || CMIsNullObject(op))
+                return NULL;
+
+        CMAddKey(op, "CreationClassName",
+                 (CMPIValue *)hp->ccname, CMPI_chars);
+        CMAddKey(op, "Name", (CMPIValue *)name, CMPI_chars);
+
+        op = CMClone(op, s);
+        new_ns = strdup(ns);
+        if ((op == NULL) || (s->rc != CMPI_RC_OK) || (new_ns == NULL)) {
+                if (op != NULL)
+                        CMRelease(op);
+                free(new_ns);
+                return NULL;
+        }
+
+        if (hp->op != NULL)
+                CMRelease(hp->op);
+        free(hp->ns);
+
+        hp->op = op;
+        hp->ns = new_ns;
+        hp->name = name;
+
+        CU_DEBUG("Built %s path for %s", hp->ccname, name);
+
+        return hp->op;
 }
 
 static CMPIStatus fake_host(const CMPIBroker *broker,
@@ -122,7 +363,10 @@ static CMPIStatus fake_host(const CMPIBroker *broker,
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIInstance *inst = NULL;
+        CMPIObjectPath *op;
         virConnectPtr conn = NULL;
+        struct host_path *hp;
+        const char *name;
 
         conn = connect_by_classname(broker, CLASSNAME(reference), &s);
         if (conn == NULL) {
@@ -132,20 +376,34 @@ static CMPIStatus fake_host(const CMPIBroker *broker,
                 goto out;
         }
 
-        inst = get_typed_instance(broker,
-                                  pfx_from_conn(conn),
-                                  "HostSystem",
-                                  NAMESPACE(reference),
-                                  true);
+        hp = host_class(pfx_from_conn(conn));
+        if (hp == NULL) {
+                cu_statusf(broker, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Can't create HostSystem instance");
+                goto out;
+        }
+
+        name = host_name(broker);
+
+        pthread_mutex_lock(&host_lock);
+        op = host_path(broker, hp, NAMESPACE(reference), name, &s);
+        if (op != NULL)
+                inst = CMNewInstance(broker, op, &s);
+        pthread_mutex_unlock(&host_lock);
 
-        if (inst == NULL) {
+        if ((inst == NULL) || (s.rc != CMPI_RC_OK)) {
                 cu_statusf(broker, &s, 
                            CMPI_RC_ERR_FAILED,
                            "Can't create HostSystem instance");
                 goto out;
         }
 
-        set_host_system_properties(inst);
+        CMSetProperty(inst, "CreationClassName",
+                      (CMPIValue *)hp->ccname, CMPI_chars);
+        CMSetProperty(inst, "Name",
+                      (CMPIValue *)name, CMPI_chars);
+
         *_inst = inst;
  out:
         virConnectClose(conn);
@@ -204,6 +462,14 @@ CMPIStatus get_host_system_properties(const char **name,
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIInstance *host = NULL;
+        struct host_path *hp;
+
+        hp = host_class(CLASSNAME(ref));
+        if (hp != NULL) {
+                *ccname = hp->ccname;
+                *name = host_name(broker);
+                goto out;
+        }
 
         s = get_host(broker, context, ref, &host, false);
         if (s.rc != CMPI_RC_OK || host == NULL)
@@ -258,12 +524,30 @@ DEFAULT_CI();
 DEFAULT_MI();
 DEFAULT_DI();
 DEFAULT_EQ();
-DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(, 
-                   Virt_HostSystem,
-                   _BROKER, 
-                   libvirt_cim_init());
+static CMPIStatus Cleanup(CMPIInstanceMI *self,
+                          const CMPIContext *context,
+                          CMPIBoolean terminating)
+{
+        host_resolver_join();
+
+        CMReturn(CMPI_RC_OK);
+}
+
+static bool host_system_init(void)
+{
+        pthread_mutex_lock(&host_lock);
+        host_resolver_stop = false;
+        host_resolver_start(_BROKER);
+        pthread_mutex_unlock(&host_lock);
+
+        return libvirt_cim_init();
+}
+
+STATS_InstanceMIStub(, 
+                     Virt_HostSystem,
+                     _BROKER, 
+                     host_system_init());
 
 /*
  * Local Variables:
@@ -141,11 +141,11 @@ static struct std_assoc *handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(,
-                 Virt_HostedAccessPoint,
-                 _BROKER, 
-                 libvirt_cim_init(), 
-                 handlers);
+STATS_AssocMIStub(,
+                  Virt_HostedAccessPoint,
+                  _BROKER, 
+                  libvirt_cim_init(), 
+                  handlers);
 
 /*
  * Local Variables:
@@ -127,7 +127,7 @@ static struct std_assoc *handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(,
+STATS_AssocMIStub(,
         Virt_HostedFilterList,
         _BROKER,
         libvirt_cim_init(),
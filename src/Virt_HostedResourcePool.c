@@ -162,11 +162,11 @@ static struct std_assoc *assoc_handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(,
-                 Virt_HostedResourcePool,
-                 _BROKER,
-                 libvirt_cim_init(),
-                 assoc_handlers);
+STATS_AssocMIStub(,
+                  Virt_HostedResourcePool,
+                  _BROKER,
+                  libvirt_cim_init(),
+                  assoc_handlers);
 
 /*
  * Local Variables:
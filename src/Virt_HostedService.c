@@ -195,11 +195,11 @@ static struct std_assoc *handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(, 
-                 Virt_HostedService,
-                 _BROKER,
-                 libvirt_cim_init(),
-                 handlers);
+STATS_AssocMIStub(, 
+                  Virt_HostedService,
+                  _BROKER,
+                  libvirt_cim_init(),
+                  handlers);
 
 /*
  * Local Variables:
@@ -42,20 +42,122 @@
 #define PROC_TCP4 "/proc/net/tcp"
 #define PROC_TCP6 "/proc/net/tcp6"
 
+/* Guests are hashed by local VNC port so that each socket listed in
+ * /proc/net/tcp{,6} costs a single bucket probe instead of a scan
+ * over every guest.
+ */
+#define VNC_PORT_BUCKETS 256
+
 const static CMPIBroker *_BROKER;
 
 struct vnc_port {
         char *name;
         int port;
         int remote_port;
+        struct vnc_port *next;
 };
 
 struct vnc_ports {
         struct vnc_port **list;
         unsigned int max;
         unsigned int cur;
+        struct vnc_port *index[VNC_PORT_BUCKETS];
 };
 
+static void index_vnc_ports(struct vnc_ports *ports)
+{
+        unsigned int i;
+
+        memset(ports->index, 0, sizeof(ports->index));
+
+        for (i = 0; i < ports->max; i++) {
+                struct vnc_port *port = ports->list[i];
+                unsigned int bucket;
+
+                if (port->port < 0)
+                        continue;
+
+                bucket = port->port % VNC_PORT_BUCKETS;
+                port->next = ports->index[bucket];
+                ports->index[bucket] = port;
+        }
+}
+
+static int hex_value(char c)
+{
+        if ((c >= '0') && (c <= '9'))
+                return c - '0';
+        else if ((c >= 'A') && (c <= 'F'))
+                return c - 'A' + 10;
+        else if ((c >= 'a') && (c <= 'f'))
+                return c - 'a' + 10;
+        else
+                return -1;
+}
+
+/* Parse one "ADDRESS:PORT" column, where both halves are hex encoded,
+ * and leave *_p pointing just past the port.
+ */
+static bool parse_tcp_addr(const char **_p, unsigned int *port)
+{
+        const char *p = *_p;
+        unsigned int val = 0;
+        int digits;
+        int x;
+
+        while (*p == ' ')
+                p++;
+
+        while (hex_value(*p) >= 0)
+                p++;
+
+        if (*p++ != ':')
+                return false;
+
+        for (digits = 0; (x = hex_value(*p)) >= 0; digits++, p++) {
+                if (digits == 4)
+                        return false;
+                val = (val << 4) | x;
+        }
+
+        if (digits == 0)
+                return false;
+
+        *port = val;
+        *_p = p;
+
+        return true;
+}
+
+/* Equivalent to sscanf(line, "%d: %*[^:]:%X %*[^:]:%X", ...) for the
+ * fixed layout the kernel uses in /proc/net/tcp and /proc/net/tcp6:
+ *
+ *   "   0: 0100007F:170C 00000000:0000 0A ..."
+ */
+static bool parse_tcp_line(const char *line,
+                           unsigned int *lport,
+                           unsigned int *rport)
+{
+        const char *p = line;
+
+        while (*p == ' ')
+                p++;
+
+        if ((*p < '0') || (*p > '9'))
+                return false;
+
+        while ((*p >= '0') && (*p <= '9'))
+                p++;
+
+        if (*p++ != ':')
+                return false;
+
+        if (!parse_tcp_addr(&p, lport))
+                return false;
+
+        return parse_tcp_addr(&p, rport);
+}
+
 static int inst_from_dom(const CMPIBroker *broker,
                          const CMPIObjectPath *ref,
                          struct vnc_port *port,
@@ -148,19 +250,18 @@ static CMPIInstance *get_console_sap(const CMPIBroker *broker,
 static CMPIStatus read_tcp_file(const CMPIBroker *broker,
                                 const CMPIObjectPath *ref,
                                 virConnectPtr conn,
-                                struct vnc_ports ports,
-                                struct inst_list *list,
+                                struct vnc_ports *ports,
+                                inst_handler_t handler,
+                                void *data,
                                 FILE *fl)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIInstance *inst;
+        struct vnc_port *port;
         unsigned int lport = 0;
         unsigned int rport = 0;
         char *line = NULL;
         size_t len = 0;
-        int val;
-        int ret;
-        int i;
 
         if (getline(&line, &len, fl) == -1) {
                 cu_statusf(broker, 
@@ -172,12 +273,7 @@ static CMPIStatus read_tcp_file(const CMPIBroker *broker,
         }
 
         while (getline(&line, &len, fl) > 0) {
-                ret = sscanf(line, 
-                             "%d: %*[^:]:%X %*[^:]:%X", 
-                             &val, 
-                             &lport, 
-                             &rport);
-                if (ret != 3) {
+                if (!parse_tcp_line(line, &lport, &rport)) {
                         cu_statusf(broker, 
                                    &s,
                                    CMPI_RC_ERR_FAILED,
@@ -185,20 +281,23 @@ static CMPIStatus read_tcp_file(const CMPIBroker *broker,
                         goto out;
                 }
 
-                for (i = 0; i < ports.max; i++) { 
-                       if (lport != ports.list[i]->port)
+                port = ports->index[lport % VNC_PORT_BUCKETS];
+                for (; port != NULL; port = port->next) {
+                       if (lport != port->port)
                                continue;
 
-                       ports.list[i]->remote_port = rport;
+                       port->remote_port = rport;
                        inst = get_console_sap(broker, 
                                               ref, 
                                               conn, 
-                                              ports.list[i], 
+                                              port, 
                                               &s);
                        if ((s.rc != CMPI_RC_OK) || (inst == NULL))
                                goto out;
 
-                       inst_list_add(list, inst);
+                       s = handler(inst, data);
+                       if (s.rc != CMPI_RC_OK)
+                               goto out;
                 }
         }
  
@@ -211,8 +310,9 @@ static CMPIStatus read_tcp_file(const CMPIBroker *broker,
 static CMPIStatus get_vnc_sessions(const CMPIBroker *broker,
                                    const CMPIObjectPath *ref,
                                    virConnectPtr conn,
-                                   struct vnc_ports ports,
-                                   struct inst_list *list)
+                                   struct vnc_ports *ports,
+                                   inst_handler_t handler,
+                                   void *data)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIInstance *inst;
@@ -235,7 +335,8 @@ static CMPIStatus get_vnc_sessions(const CMPIBroker *broker,
                                   ref,
                                   conn,
                                   ports,
-                                  list,
+                                  handler,
+                                  data,
                                   tcp_info);
 
                 fclose(tcp_info);
@@ -246,15 +347,17 @@ static CMPIStatus get_vnc_sessions(const CMPIBroker *broker,
 
         /* Handle any guests that were missed.  These guest don't have active 
            or enabled sessions. */
-        for (i = 0; i < ports.max; i++) { 
-                if (ports.list[i]->remote_port != -1)
+        for (i = 0; i < ports->max; i++) { 
+                if (ports->list[i]->remote_port != -1)
                         continue;
 
-                inst = get_console_sap(broker, ref, conn, ports.list[i], &s);
+                inst = get_console_sap(broker, ref, conn, ports->list[i], &s);
                 if ((s.rc != CMPI_RC_OK) || (inst == NULL))
                         goto out;
 
-                inst_list_add(list, inst);
+                s = handler(inst, data);
+                if (s.rc != CMPI_RC_OK)
+                        goto out;
         }
 
         if (error != 2)
@@ -295,28 +398,22 @@ static CMPIStatus return_console_sap(const CMPIObjectPath *ref,
                                      const CMPIResult *results,
                                      bool names_only)
 {
-        CMPIStatus s = {CMPI_RC_OK, NULL};
-        struct inst_list list;
-
-        inst_list_init(&list);
-
-        s = enum_console_sap(_BROKER, ref, &list);
-        if (s.rc != CMPI_RC_OK)
-                goto out;
-
-        if (names_only)
-                cu_return_instance_names(results, &list);
-        else
-                cu_return_instances(results, &list);
+        struct inst_result res = {_BROKER, results, names_only};
 
- out:
-        inst_list_free(&list);
-        return s;
+        return stream_console_sap(_BROKER, ref, inst_result_handler, &res);
 }
 
 CMPIStatus enum_console_sap(const CMPIBroker *broker,
                             const CMPIObjectPath *ref,
                             struct inst_list *list)
+{
+        return stream_console_sap(broker, ref, inst_list_handler, list);
+}
+
+CMPIStatus stream_console_sap(const CMPIBroker *broker,
+                              const CMPIObjectPath *ref,
+                              inst_handler_t handler,
+                              void *data)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         virConnectPtr conn = NULL;
@@ -400,8 +497,9 @@ CMPIStatus enum_console_sap(const CMPIBroker *broker,
 
         port_list.max = port_list.cur;
         port_list.cur = 0;
+        index_vnc_ports(&port_list);
  
-        s = get_vnc_sessions(broker, ref, conn, port_list, list);
+        s = get_vnc_sessions(broker, ref, conn, &port_list, handler, data);
         if (s.rc != CMPI_RC_OK)
                 goto out;
 
@@ -585,10 +683,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(, 
-                   Virt_KVMRedirectionSAP, 
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(, 
+                     Virt_KVMRedirectionSAP, 
+                     _BROKER,
+                     libvirt_cim_init());
 
 
 /*
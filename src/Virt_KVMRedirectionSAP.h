@@ -32,6 +32,12 @@ CMPIStatus enum_console_sap(const CMPIBroker *broker,
                             const CMPIObjectPath *ref,
                             struct inst_list *list);
 
+/* Like enum_console_sap(), but hands each instance to handler */
+CMPIStatus stream_console_sap(const CMPIBroker *broker,
+                              const CMPIObjectPath *ref,
+                              inst_handler_t handler,
+                              void *data);
+
 /*
  * Local Variables:
  * mode: C
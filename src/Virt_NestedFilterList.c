@@ -290,7 +290,7 @@ static struct std_assoc *handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(,
+STATS_AssocMIStub(,
         Virt_NestedFilterList,
         _BROKER,
         libvirt_cim_init(),
@@ -505,7 +505,7 @@ DEFAULT_MI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
+STATS_InstanceMIStub(,
         Virt_NestedFilterList,
         _BROKER,
         libvirt_cim_init());
@@ -34,41 +34,15 @@
 #include "misc_util.h"
 #include "cs_util.h"
 #include "infostore.h"
+#include "tc_util.h"
 
 #include "Virt_RASD.h"
 #include "svpc_types.h"
 #include "Virt_Device.h"
 
-#if LIBVIR_VERSION_NUMBER < 9000
-/* Network QoS support */
-#define QOSCMD_MAC2BANDWIDTH "_ROOT=$(tc class show dev %s | awk '($4==\"root\")\
-{print $3}')\n _ID=$(tc filter show dev %s | awk 'BEGIN {RS=\"\\nfilter\"} (NR>2)\
-{m1=substr($24,1,2);m2=substr($24,3,2);m3=substr($24,5,2);m4=substr($24,7,2);\
-m5=substr($20,1,2);m6=substr($20,3,2);printf(\"%%s:%%s:%%s:%%s:%%s:%%s %%s\\n\",\
-m1,m2,m3,m4,m5,m6,$18)}' | awk -v mm=%s '($1==mm){print $2}')\n \
-if [[ -n \"$_ID\" ]]; then\n tc class show dev %s | awk -v rr=$_ROOT -v id=$_ID \
-'($4==\"parent\" && $5==rr && $3==id){print \
-substr($13,1,(index($13,\"Kbit\")-1))}'\n fi\n"
-#endif
 
 const static CMPIBroker *_BROKER;
 
-static struct virt_device *_find_dev(struct virt_device *list,
-                                    int count,
-                                    const char *id)
-{
-        int i;
-
-        for (i = 0; i < count; i++) {
-                struct virt_device *dev = &list[i];
-
-                if (STREQ(dev->id, id))
-                        return virt_device_dup(dev);
-        }
-
-        return NULL;
-}
-
 int list_rasds(virConnectPtr conn,
               const uint16_t type,
               const char *host,
@@ -88,20 +62,27 @@ int list_rasds(virConnectPtr conn,
         return count;
 }
 
+/* The device is borrowed from *devs, which the caller must unref */
 static struct virt_device *find_dev(virConnectPtr conn,
                                     const uint16_t type,
                                     const char *host,
-                                    const char *devid)
+                                    const char *devid,
+                                    struct devlist **devs)
 {
-        int count = -1;
-        struct virt_device *list = NULL;
+        virDomainPtr dom;
         struct virt_device *dev = NULL;
 
-        count = list_rasds(conn, type, host, &list);
-        if (count > 0) {
-                dev = _find_dev(list, count, devid);
-                cleanup_virt_devices(&list, count);
-        }
+        *devs = NULL;
+
+        dom = virDomainLookupByName(conn, host);
+        if (dom == NULL)
+                return NULL;
+
+        *devs = get_devlist_by_id(dom, type, devid, 0);
+        if (*devs != NULL)
+                dev = devlist_find(*devs, devid);
+
+        virDomainFree(dom);
 
         return dev;
 }
@@ -112,41 +93,26 @@ char *rasd_to_xml(CMPIInstance *rasd)
         return NULL;
 }
 
-static CMPIStatus set_proc_rasd_params(const CMPIBroker *broker,
-                                       const CMPIObjectPath *ref,
-                                       struct virt_device *dev,
-                                       const char *domain,
-                                       CMPIInstance *inst)
+static CMPIStatus _set_proc_rasd_params(const CMPIBroker *broker,
+                                        virDomainPtr dom,
+                                        struct virt_device *dev,
+                                        const char **properties,
+                                        CMPIInstance *inst)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        virConnectPtr conn = NULL;
-        virDomainPtr dom = NULL;
+        virConnectPtr conn = virDomainGetConnect(dom);
         struct infostore_ctx *info = NULL;
         uint32_t weight = 0;
         uint64_t limit;
         uint64_t count = 0;
 
-        conn = connect_by_classname(broker, CLASSNAME(ref), &s);
-        if (conn == NULL)
-                return s;
-
-        dom = virDomainLookupByName(conn, domain);
-        if (dom == NULL) {
-                virt_set_status(broker, &s,
-                                CMPI_RC_ERR_NOT_FOUND,
-                                conn,
-                                "Domain `%s' not found while getting info",
-                                domain);
-                goto out;
-        }
-
         if (domain_online(dom)) {
                 int active_count = domain_vcpu_count(dom);
                 if (active_count < 0) {
                     cu_statusf(broker, &s,
                                CMPI_RC_ERR_FAILED,
                                "Unable to get domain `%s' vcpu count",
-                               domain);
+                               virDomainGetName(dom));
                     goto out;
                 }
                 count = active_count;
@@ -160,6 +126,9 @@ static CMPIStatus set_proc_rasd_params(const CMPIBroker *broker,
                               (CMPIValue *)&count,
                               CMPI_uint64);
 
+        if (!property_requested(properties, "Weight", "Limit", NULL))
+                goto out;
+
         info = infostore_open(dom);
         if (info == NULL) {
                 cu_statusf(broker, &s,
@@ -170,9 +139,9 @@ static CMPIStatus set_proc_rasd_params(const CMPIBroker *broker,
 
         /* Early versions of libvirt only support CPU cgroups for *running* KVM guests */
 #if LIBVIR_VERSION_NUMBER < 9000
-        if (domain_online(dom) && STREQC(virConnectGetType(conn), "QEMU")) {
+        if (domain_online(dom) && STREQC(type_from_conn(conn), "QEMU")) {
 #else
-        if (STREQC(virConnectGetType(conn), "QEMU")) {
+        if (STREQC(type_from_conn(conn), "QEMU")) {
 #endif
                 char *sched;
                 int nparams;
@@ -218,10 +187,42 @@ static CMPIStatus set_proc_rasd_params(const CMPIBroker *broker,
         CMSetProperty(inst, "Limit",
                       (CMPIValue *)&limit, CMPI_uint64);
 
+ out:
+        infostore_close(info);
+
+        return s;
+}
+
+static CMPIStatus set_proc_rasd_params(const CMPIBroker *broker,
+                                       const CMPIObjectPath *ref,
+                                       struct virt_device *dev,
+                                       const char *domain,
+                                       const char **properties,
+                                       CMPIInstance *inst)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        virConnectPtr conn = NULL;
+        virDomainPtr dom = NULL;
+
+        conn = connect_by_classname(broker, CLASSNAME(ref), &s);
+        if (conn == NULL)
+                return s;
+
+        dom = virDomainLookupByName(conn, domain);
+        if (dom == NULL) {
+                virt_set_status(broker, &s,
+                                CMPI_RC_ERR_NOT_FOUND,
+                                conn,
+                                "Domain `%s' not found while getting info",
+                                domain);
+                goto out;
+        }
+
+        s = _set_proc_rasd_params(broker, dom, dev, properties, inst);
+
  out:
         virDomainFree(dom);
         virConnectClose(conn);
-        infostore_close(info);
 
         return s;
 }
@@ -353,6 +354,7 @@ static CMPIStatus set_rasd_device_address(const CMPIBroker *broker,
 static CMPIStatus set_disk_rasd_params(const CMPIBroker *broker,
                                        const CMPIObjectPath *ref,
                                        const struct virt_device *dev,
+                                       const char **properties,
                                        CMPIInstance *inst)
 {
         uint64_t cap = 0;
@@ -365,10 +367,12 @@ static CMPIStatus set_disk_rasd_params(const CMPIBroker *broker,
         const char *pool_name = NULL;
         int ret = -1;
 
-        get_vol_size(broker, ref, dev->dev.disk.source, &cap);
+        if (property_requested(properties, "VirtualQuantity", NULL)) {
+                get_vol_size(broker, ref, dev->dev.disk.source, &cap);
 
-        CMSetProperty(inst, "VirtualQuantity",
-                      (CMPIValue *)&cap, CMPI_uint64);
+                CMSetProperty(inst, "VirtualQuantity",
+                              (CMPIValue *)&cap, CMPI_uint64);
+        }
 
         CMSetProperty(inst, "AllocationUnits",
                       (CMPIValue *)"Bytes", CMPI_chars);
@@ -383,6 +387,10 @@ static CMPIStatus set_disk_rasd_params(const CMPIBroker *broker,
                       (CMPIValue *)dev->dev.disk.source,
                       CMPI_chars);
 
+        /* Finding the pool takes a volume and a pool lookup */
+        if (!property_requested(properties, "PoolID", NULL))
+                goto cont;
+
         conn = connect_by_classname(broker, CLASSNAME(ref), &s);
         if (conn == NULL) {
                 virt_set_status(broker, &s,
@@ -569,6 +577,7 @@ static CMPIStatus set_net_vsi_rasd_params(const CMPIBroker *broker,
 static CMPIStatus set_net_rasd_params(const CMPIBroker *broker,
                                        const CMPIObjectPath *ref,
                                        const struct virt_device *dev,
+                                       const char **properties,
                                        CMPIInstance *inst)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
@@ -591,35 +600,27 @@ static CMPIStatus set_net_rasd_params(const CMPIBroker *broker,
 
 #if LIBVIR_VERSION_NUMBER < 9000
         /* Network QoS support */
-        if ((dev->dev.net.mac != NULL) && (dev->dev.net.source != NULL)) {
-                FILE *pipe = NULL;
-                char *cmd = NULL;
+        if ((dev->dev.net.mac != NULL) && (dev->dev.net.source != NULL) &&
+            property_requested(properties,
+                               "Reservation",
+                               "AllocationUnits",
+                               NULL)) {
                 uint64_t val = 0;
-                int i;
 
                 /* Get tc performance class bandwidth for this MAC addr */
-                i = asprintf(&cmd, QOSCMD_MAC2BANDWIDTH, dev->dev.net.source,
-                                                         dev->dev.net.source,
-                                                         dev->dev.net.mac,
-                                                         dev->dev.net.source);
-                if (i == -1)
-                        goto out;
+                if (tc_mac_rate(dev->dev.net.source,
+                                dev->dev.net.mac,
+                                &val)) {
+                        CU_DEBUG("tc class rate = %" PRIu64, val);
 
-                if ((pipe = popen(cmd, "r")) != NULL) {
-                        if (fscanf(pipe, "%u", (unsigned int *)&val) == 1) {
-                                CU_DEBUG("pipe read. val = %d", val);
-
-                                CMSetProperty(inst,
-                                        "Reservation",
-                                        (CMPIValue *)&val, CMPI_uint64);
-                                CMSetProperty(inst,
-                                        "AllocationUnits",
-                                        (CMPIValue *)"KiloBits per Second",
-                                        CMPI_chars);
-                        }
-                        pclose(pipe);
+                        CMSetProperty(inst,
+                                      "Reservation",
+                                      (CMPIValue *)&val, CMPI_uint64);
+                        CMSetProperty(inst,
+                                      "AllocationUnits",
+                                      (CMPIValue *)"KiloBits per Second",
+                                      CMPI_chars);
                 }
-                free(cmd);
         }
 #else
         if (dev->dev.net.reservation) {
@@ -678,9 +679,6 @@ static CMPIStatus set_net_rasd_params(const CMPIBroker *broker,
                                         &dev->dev.net.address,
                                         inst);
 
-#if LIBVIR_VERSION_NUMBER < 9000
-out:
-#endif
         return s;
 }
 
@@ -963,11 +961,13 @@ static CMPIStatus set_controller_rasd_params(const CMPIBroker *broker,
         return s;
 }
 
-CMPIInstance *rasd_from_vdev(const CMPIBroker *broker,
-                                    struct virt_device *dev,
-                                    const char *host,
-                                    const CMPIObjectPath *ref,
-                                    const char **properties)
+/* dom, if not NULL, is the domain named host and saves a lookup */
+static CMPIInstance *_rasd_from_vdev(const CMPIBroker *broker,
+                                     struct virt_device *dev,
+                                     const char *host,
+                                     virDomainPtr dom,
+                                     const CMPIObjectPath *ref,
+                                     const char **properties)
 {
         CMPIStatus s;
         CMPIInstance *inst;
@@ -1026,9 +1026,9 @@ CMPIInstance *rasd_from_vdev(const CMPIBroker *broker,
                       (CMPIValue *)&type, CMPI_uint16);
 
         if (dev->type == CIM_RES_TYPE_DISK) {
-                s = set_disk_rasd_params(broker, ref, dev, inst);
+                s = set_disk_rasd_params(broker, ref, dev, properties, inst);
         } else if (dev->type == CIM_RES_TYPE_NET) {
-                s = set_net_rasd_params(broker, ref, dev, inst);
+                s = set_net_rasd_params(broker, ref, dev, properties, inst);
                 if ((s.rc == CMPI_RC_OK) &&
                      (dev->dev.net.vsi.vsi_type != NULL))
                         s = set_net_vsi_rasd_params(broker,
@@ -1055,8 +1055,18 @@ CMPIInstance *rasd_from_vdev(const CMPIBroker *broker,
                         CMSetProperty(inst, "dumpCore",
                                       (CMPIValue *)&dumpCore, CMPI_boolean);
                 }
-        } else if (dev->type == CIM_RES_TYPE_PROC) {
-                set_proc_rasd_params(broker, ref, dev, host, inst);
+        } else if ((dev->type == CIM_RES_TYPE_PROC) &&
+                   property_requested(properties,
+                                      "VirtualQuantity",
+                                      "Weight",
+                                      "Limit",
+                                      NULL)) {
+                if (dom != NULL)
+                        _set_proc_rasd_params(broker, dom, dev,
+                                              properties, inst);
+                else
+                        set_proc_rasd_params(broker, ref, dev, host,
+                                             properties, inst);
         } else if (dev->type == CIM_RES_TYPE_GRAPHICS) {
                 s = set_graphics_rasd_params(dev, inst, host, CLASSNAME(ref));
         } else if (dev->type == CIM_RES_TYPE_INPUT) {
@@ -1074,6 +1084,15 @@ CMPIInstance *rasd_from_vdev(const CMPIBroker *broker,
         return inst;
 }
 
+CMPIInstance *rasd_from_vdev(const CMPIBroker *broker,
+                             struct virt_device *dev,
+                             const char *host,
+                             const CMPIObjectPath *ref,
+                             const char **properties)
+{
+        return _rasd_from_vdev(broker, dev, host, NULL, ref, properties);
+}
+
 CMPIStatus get_rasd_by_name(const CMPIBroker *broker,
                             const CMPIObjectPath *reference,
                             const char *name,
@@ -1088,6 +1107,7 @@ CMPIStatus get_rasd_by_name(const CMPIBroker *broker,
         char *devid = NULL;
         virConnectPtr conn = NULL;
         struct virt_device *dev = NULL;
+        struct devlist *devs = NULL;
 
         conn = connect_by_classname(broker, CLASSNAME(reference), &s);
         if (conn == NULL) {
@@ -1106,7 +1126,7 @@ CMPIStatus get_rasd_by_name(const CMPIBroker *broker,
                 goto out;
         }
 
-        dev = find_dev(conn, type, host, devid);
+        dev = find_dev(conn, type, host, devid, &devs);
         if (!dev) {
                 virt_set_status(broker, &s,
                                 CMPI_RC_ERR_NOT_FOUND,
@@ -1124,9 +1144,8 @@ CMPIStatus get_rasd_by_name(const CMPIBroker *broker,
         else
                 *_inst = inst;
 
-        cleanup_virt_devices(&dev, 1);
-
  out:
+        devlist_unref(devs);
         virConnectClose(conn);
         free(host);
         free(devid);
@@ -1271,7 +1290,8 @@ static CMPIStatus _get_rasds(const CMPIBroker *broker,
                              const virDomainPtr dom,
                              const uint16_t type,
                              const char **properties,
-                             struct inst_list *list)
+                             inst_handler_t handler,
+                             void *data)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         int count;
@@ -1318,8 +1338,12 @@ static CMPIStatus _get_rasds(const CMPIBroker *broker,
                                      host,
                                      reference,
                                      properties);
-                if (dev)
-                        inst_list_add(list, dev);
+                if (dev == NULL)
+                        continue;
+
+                s = handler(dev, data);
+                if (s.rc != CMPI_RC_OK)
+                        goto out;
         }
 
  out:
@@ -1327,24 +1351,118 @@ static CMPIStatus _get_rasds(const CMPIBroker *broker,
         return s;
 }
 
+static struct virt_device *dominfo_devices(struct domain *dominfo,
+                                           uint16_t type,
+                                           int *count)
+{
+        switch (type) {
+        case CIM_RES_TYPE_NET:
+                *count = dominfo->dev_net_ct;
+                return dominfo->dev_net;
+        case CIM_RES_TYPE_DISK:
+                *count = dominfo->dev_disk_ct;
+                return dominfo->dev_disk;
+        case CIM_RES_TYPE_MEM:
+                *count = dominfo->dev_mem_ct;
+                return dominfo->dev_mem;
+        case CIM_RES_TYPE_PROC:
+                *count = dominfo->dev_vcpu_ct;
+                return dominfo->dev_vcpu;
+        case CIM_RES_TYPE_GRAPHICS:
+                *count = dominfo->dev_graphics_ct;
+                return dominfo->dev_graphics;
+        case CIM_RES_TYPE_INPUT:
+                *count = dominfo->dev_input_ct;
+                return dominfo->dev_input;
+        case CIM_RES_TYPE_CONSOLE:
+                *count = dominfo->dev_console_ct;
+                return dominfo->dev_console;
+        case CIM_RES_TYPE_CONTROLLER:
+                *count = dominfo->dev_controller_ct;
+                return dominfo->dev_controller;
+        }
+
+        *count = 0;
+        return NULL;
+}
+
+CMPIStatus rasds_from_dominfo(const CMPIBroker *broker,
+                              const CMPIObjectPath *ref,
+                              virDomainPtr dom,
+                              struct domain *dominfo,
+                              const char **properties,
+                              struct inst_list *list)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        struct virt_device *devs;
+        struct virt_device proc;
+        char proc_id[] = "proc";
+        int count;
+        int i;
+        int j;
+
+        for (i = 0; i < CIM_RES_TYPE_COUNT; i++) {
+                devs = dominfo_devices(dominfo, cim_res_types[i], &count);
+                if ((devs == NULL) || (count <= 0))
+                        continue;
+
+                /* Same as _get_rasds(): one RASD for all the processors */
+                if (cim_res_types[i] == CIM_RES_TYPE_PROC) {
+                        memset(&proc, 0, sizeof(proc));
+                        proc.type = CIM_RES_TYPE_PROC;
+                        proc.id = proc_id;
+                        proc.dev.vcpu.quantity =
+                                devs[count - 1].dev.vcpu.quantity;
+
+                        devs = &proc;
+                        count = 1;
+                }
+
+                for (j = 0; j < count; j++) {
+                        CMPIInstance *inst;
+
+                        inst = _rasd_from_vdev(broker,
+                                               &devs[j],
+                                               dominfo->name,
+                                               dom,
+                                               ref,
+                                               properties);
+                        if (inst == NULL) {
+                                CU_DEBUG("Unable to build RASD for `%s'",
+                                         devs[j].id);
+                                continue;
+                        }
+
+                        inst_list_add(list, inst);
+                }
+        }
+
+        return s;
+}
+
 static CMPIStatus _enum_rasds(const CMPIBroker *broker,
                               const CMPIObjectPath *reference,
                               const virDomainPtr dom,
                               const uint16_t type,
                               const char **properties,
-                              struct inst_list *list)
+                              inst_handler_t handler,
+                              void *data)
 {
-        CMPIStatus s;
+        CMPIStatus s = {CMPI_RC_OK, NULL};
         int i;
 
         if (type == CIM_RES_TYPE_ALL) {
-                for (i=0; i<CIM_RES_TYPE_COUNT; i++)
+                for (i = 0; i < CIM_RES_TYPE_COUNT; i++) {
                         s = _get_rasds(broker,
                                        reference,
                                        dom,
                                        cim_res_types[i],
                                        properties,
-                                       list);
+                                       handler,
+                                       data);
+                        if (s.rc != CMPI_RC_OK)
+                                break;
+                }
         }
         else
                 s = _get_rasds(broker,
@@ -1352,17 +1470,19 @@ static CMPIStatus _enum_rasds(const CMPIBroker *broker,
                                dom,
                                type,
                                properties,
-                               list);
+                               handler,
+                               data);
 
         return s;
 }
 
-CMPIStatus enum_rasds(const CMPIBroker *broker,
-                      const CMPIObjectPath *ref,
-                      const char *domain,
-                      const uint16_t type,
-                      const char **properties,
-                      struct inst_list *list)
+CMPIStatus stream_rasds(const CMPIBroker *broker,
+                        const CMPIObjectPath *ref,
+                        const char *domain,
+                        const uint16_t type,
+                        const char **properties,
+                        inst_handler_t handler,
+                        void *data)
 {
         virConnectPtr conn = NULL;
         virDomainPtr *domains = NULL;
@@ -1381,13 +1501,16 @@ CMPIStatus enum_rasds(const CMPIBroker *broker,
         else
                 count = get_domain_list(conn, &domains);
 
+        /* Each domain's RASDs are handed over before the next is read */
         for (i = 0; i < count; i++) {
-                _enum_rasds(broker,
-                            ref,
-                            domains[i],
-                            type,
-                            properties,
-                            list);
+                if (s.rc == CMPI_RC_OK)
+                        s = _enum_rasds(broker,
+                                        ref,
+                                        domains[i],
+                                        type,
+                                        properties,
+                                        handler,
+                                        data);
                 virDomainFree(domains[i]);
         }
 
@@ -1398,38 +1521,35 @@ CMPIStatus enum_rasds(const CMPIBroker *broker,
         return s;
 }
 
+CMPIStatus enum_rasds(const CMPIBroker *broker,
+                      const CMPIObjectPath *ref,
+                      const char *domain,
+                      const uint16_t type,
+                      const char **properties,
+                      struct inst_list *list)
+{
+        return stream_rasds(broker, ref, domain, type, properties,
+                            inst_list_handler, list);
+}
+
 static CMPIStatus return_enum_rasds(const CMPIObjectPath *ref,
                                     const CMPIResult *results,
                                     const char **properties,
                                     const bool names_only)
 {
-        struct inst_list list;
+        struct inst_result res = {_BROKER, results, names_only};
         CMPIStatus s;
         uint16_t type;
 
-        inst_list_init(&list);
-
         if (res_type_from_rasd_classname(CLASSNAME(ref), &type) != CMPI_RC_OK) {
                 cu_statusf(_BROKER, &s,
                            CMPI_RC_ERR_FAILED,
                            "Unable to determine RASD type");
-                goto out;
+                return s;
         }
 
-        s = enum_rasds(_BROKER, ref, NULL,
-                       type, properties, &list);
-        if (s.rc != CMPI_RC_OK)
-                goto out;
-
-        if (names_only)
-                cu_return_instance_names(results, &list);
-        else
-                cu_return_instances(results, &list);
-
- out:
-        inst_list_free(&list);
-
-        return s;
+        return stream_rasds(_BROKER, ref, NULL, type, properties,
+                            inst_result_handler, &res);
 }
 
 static CMPIStatus EnumInstanceNames(CMPIInstanceMI *self,
@@ -1475,10 +1595,10 @@ DEFAULT_DI();
 DEFAULT_INST_CLEANUP();
 DEFAULT_EQ();
 
-STD_InstanceMIStub(,
-                   Virt_RASD,
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_RASD,
+                     _BROKER,
+                     libvirt_cim_init());
 
 /*
  * Local Variables:
@@ -22,6 +22,7 @@
 #define __VIRT_RASD_H
 
 #include "device_parsing.h"
+#include "misc_util.h"
 
 #define VIRT_DISK_TYPE_DISK  0
 #define VIRT_DISK_TYPE_CDROM 1
@@ -48,6 +49,21 @@ CMPIStatus enum_rasds(const CMPIBroker *broker,
                       const char **properties,
                       struct inst_list *_list);
 
+/**
+ * Like enum_rasds(), but hand each RASD to handler as soon as it is
+ * built instead of collecting them
+ *
+ * @param handler Called with each instance and data
+ * @param data Passed to handler
+ */
+CMPIStatus stream_rasds(const CMPIBroker *broker,
+                        const CMPIObjectPath *ref,
+                        const char *domain,
+                        const uint16_t type,
+                        const char **properties,
+                        inst_handler_t handler,
+                        void *data);
+
 CMPIrc res_type_from_rasd_classname(const char *cn, uint16_t *type);
 CMPIrc rasd_classname_from_type(uint16_t type, const char **cn);
 
@@ -76,6 +92,26 @@ CMPIInstance *rasd_from_vdev(const CMPIBroker *broker,
                              const CMPIObjectPath *ref,
                              const char **properties);
 
+/**
+ * Build the RASDs of every device in a parsed domain, in the same
+ * order as enum_rasds() with CIM_RES_TYPE_ALL.  Like enum_rasds(),
+ * devices whose RASD cannot be built are skipped.
+ *
+ * @param broker The current broker
+ * @param ref Defines the class prefix and namespace
+ * @param dom The domain that dominfo was parsed from, used for the
+ *            processor settings
+ * @param dominfo The parsed domain
+ * @param properties The properties to filter for
+ * @param _list The list of instances to populate
+ */
+CMPIStatus rasds_from_dominfo(const CMPIBroker *broker,
+                              const CMPIObjectPath *ref,
+                              virDomainPtr dom,
+                              struct domain *dominfo,
+                              const char **properties,
+                              struct inst_list *_list);
+
 #endif
 
 /*
@@ -265,11 +265,11 @@ static CMPIInstance *make_ref(const CMPIObjectPath *source_ref,
         return ref_inst;
 }
 
-STDA_AssocMIStub(,
-                 Virt_ReferencedProfile,
-                 _BROKER, 
-                 libvirt_cim_init(), 
-                 assoc_handlers);
+STATS_AssocMIStub(,
+                  Virt_ReferencedProfile,
+                  _BROKER, 
+                  libvirt_cim_init(), 
+                  assoc_handlers);
 /*
  * Local Variables:
  * mode: C
@@ -266,11 +266,11 @@ static struct std_assoc *handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(, 
-                 Virt_ResourceAllocationFromPool,
-                 _BROKER,
-                 libvirt_cim_init(),
-                 handlers);
+STATS_AssocMIStub(, 
+                  Virt_ResourceAllocationFromPool,
+                  _BROKER,
+                  libvirt_cim_init(),
+                  handlers);
 
 /*
  * Local Variables:
@@ -30,6 +30,7 @@
 #include <libcmpiutil/std_indication.h>
 #include <misc_util.h>
 #include <cs_util.h>
+#include <ind_queue.h>
 
 static const CMPIBroker *_BROKER;
 
@@ -66,37 +67,28 @@ static struct std_ind_filter *filters[] = {
 };
 
 
+/* Every indication of this provider is delivered with the same context,
+ * so it is set up once rather than per RASD.
+ */
+static struct ind_queue rasd_ind_queue =
+        IND_QUEUE_INITIALIZER("Virt_ResourceAllocationSettingDataIndication");
+
+static struct std_indication_ctx rasd_ind_ctx = {
+        .brkr = NULL,
+        .handler = NULL,
+        .filters = filters,
+        .enabled = 1,
+};
+
 static CMPIStatus raise_indication(const CMPIBroker *broker,
                                    const CMPIContext *ctx,
                                    const CMPIObjectPath *ref,
                                    const CMPIInstance *ind)
 {
-        struct std_indication_ctx *_ctx = NULL;
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        struct ind_args *args = NULL;
+        struct ind_args args;
         CMPIObjectPath *_ref = NULL;
 
-        _ctx = malloc(sizeof(struct std_indication_ctx));
-        if (_ctx == NULL) {
-                cu_statusf(broker, &s,
-                           CMPI_RC_ERR_FAILED,
-                           "Unable to allocate indication context");
-                goto out;
-        }
-
-        _ctx->brkr = broker;
-        _ctx->handler = NULL;
-        _ctx->filters = filters;
-        _ctx->enabled = 1;
-
-        args = malloc(sizeof(struct ind_args));
-        if (args == NULL) {
-                cu_statusf(broker, &s,
-                           CMPI_RC_ERR_FAILED,
-                           "Unable to allocate ind_args");
-                goto out;
-        }
-
         _ref = CMGetObjectPath(ind, &s);
         if (_ref == NULL) {
                 cu_statusf(broker, &s,
@@ -110,32 +102,30 @@ static CMPIStatus raise_indication(const CMPIBroker *broker,
 
 
         CMSetNameSpace(_ref, "root/virt");
-        args->ns = strdup(NAMESPACE(_ref));
-        args->classname = strdup(CLASSNAME(_ref));
-        args->_ctx = _ctx;
+
+        /* The queue copies what it needs of args */
+        rasd_ind_ctx.brkr = broker;
+        args.context = NULL;
+        args.ns = (char *)NAMESPACE(_ref);
+        args.classname = (char *)CLASSNAME(_ref);
+        args._ctx = &rasd_ind_ctx;
 
         /* This is a workaround for Pegasus, it loses its objectpath by
            CMGetObjectPath. So set it back. */
         ind->ft->setObjectPath((CMPIInstance *)ind, _ref);
 
-        s = stdi_deliver(broker, ctx, args, (CMPIInstance *)ind);
+        s = ind_queue_push(&rasd_ind_queue, broker, ctx, &args, ind);
         if (s.rc == CMPI_RC_OK) {
-                CU_DEBUG("Indication delivered");
+                CU_DEBUG("Indication queued");
         } else {
                 if (s.msg == NULL) {
-                        CU_DEBUG("Not delivered: msg is NULL.");
+                        CU_DEBUG("Not queued: msg is NULL.");
                 } else {
-                        CU_DEBUG("Not delivered: %s", CMGetCharPtr(s.msg));
+                        CU_DEBUG("Not queued: %s", CMGetCharPtr(s.msg));
                 }
         }
 
  out:
-        if (args != NULL)
-                stdi_free_ind_args(&args);
-
-        if (_ctx != NULL)
-                free(_ctx);
-
         return s;
 }
 
@@ -148,7 +138,18 @@ static struct std_indication_handler rasdi = {
         .disable_fn = NULL,
 };
 
-DEFAULT_IND_CLEANUP();
+/* Queued indications point at rasd_ind_ctx in this module, so deliver
+ * them and stop the delivery thread before the module is unloaded
+ */
+static CMPIStatus IndicationCleanup(CMPIIndicationMI *self,
+                                    const CMPIContext *context,
+                                    CMPIBoolean terminating)
+{
+        ind_queue_stop(&rasd_ind_queue);
+
+        CMReturn(CMPI_RC_OK);
+}
+
 DEFAULT_AF();
 DEFAULT_MP();
 
@@ -161,10 +161,10 @@ static CMPIStatus GetInstance(CMPIInstanceMI *self,
 }
 
 
-STD_InstanceMIStub(,
-                   Virt_ResourcePoolConfigurationCapabilities,
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_ResourcePoolConfigurationCapabilities,
+                     _BROKER,
+                     libvirt_cim_init());
 
 /*
  * Local Variables:
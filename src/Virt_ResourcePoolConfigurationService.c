@@ -1242,7 +1242,7 @@ static struct method_handler *my_handlers[] = {
         NULL,
 };
 
-STDIM_MethodMIStub(, 
+STATS_MethodMIStub(, 
                    Virt_ResourcePoolConfigurationService,
                    _BROKER, 
                    libvirt_cim_init(),
@@ -1374,10 +1374,10 @@ static CMPIStatus EnumInstances(CMPIInstanceMI *self,
 }
 
 
-STD_InstanceMIStub(,
-                   Virt_ResourcePoolConfigurationService,
-                   _BROKER, 
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_ResourcePoolConfigurationService,
+                     _BROKER, 
+                     libvirt_cim_init());
 
 
 /*
@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <inttypes.h>
 #include <sys/vfs.h>
 #include <errno.h>
 #include <uuid.h>
@@ -41,6 +42,7 @@
 #include <libcmpiutil/std_association.h>
 #include "device_parsing.h"
 #include "pool_parsing.h"
+#include "tc_util.h"
 #include "svpc_types.h"
 
 #include "Virt_SettingsDefineCapabilities.h"
@@ -73,13 +75,6 @@ const static CMPIBroker *_BROKER;
 #define POOL_RASD   1
 #define NEW_VOL_RASD   2
 
-/* QoS Network support */
-#if LIBVIR_VERSION_NUMBER < 9000
-#define QOSCMD_LISTCLASSES "_ROOT=$(tc class show dev %s | awk '($4==\"root\")\
-{print $3}')\n tc class show dev %s | awk -v rr=$_ROOT \
-'($4==\"parent\" && $5==rr){print $3\" \"$13}'\n"
-#endif
-
 static bool system_has_vt(virConnectPtr conn)
 {
         char *caps = NULL;
@@ -388,7 +383,7 @@ static bool get_max_procs(const CMPIObjectPath *ref,
                 goto out;
         }
 
-        max = virConnectGetMaxVcpus(conn, NULL);
+        max = max_vcpus_from_conn(conn);
         if (max == -1) {
                 CU_DEBUG("GetMaxVcpus not supported, assuming 1");
                 *num_procs = 1;
@@ -881,11 +876,11 @@ static CMPIStatus qos_hack(
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         virConnectPtr conn = NULL;
-        FILE *pipe = NULL;
-        char buffer[1024];
+        struct tc_class *classes = NULL;
         char *bridge = NULL;
-        char *cmd = NULL;
         const char *val = NULL;
+        char id[16];
+        int count;
         int i;
 
         conn = connect_by_classname(_BROKER, CLASSNAME(ref), &s);
@@ -909,39 +904,25 @@ static CMPIStatus qos_hack(
         if (bridge == NULL)
                 goto out;
 
-        i = asprintf(&cmd, QOSCMD_LISTCLASSES, bridge, bridge);
-        if (i == -1)
-                goto out;
+        count = tc_leaf_classes(bridge, &classes);
+        CU_DEBUG("qos_hack() %s has %i classes", bridge, count);
 
-        CU_DEBUG("qos_hack() cmd = %s", cmd);
+        for (i = 0; i < count; i++) {
+                char *name = NULL;
 
-        if ((pipe = popen(cmd, "r")) != NULL) {
-                CU_DEBUG("pipe open");
-                while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
-                        char *name = NULL;
-                        char *p = strstr(buffer, "Kbit");
+                tc_handle_str(classes[i].handle, id, sizeof(id));
 
-                        /* trim string */
-                        if (p)
-                                *p = '\0';
+                if (asprintf(&name, "Point/%s %" PRIu64,
+                             id, classes[i].rate) != -1) {
+                        s = set_net_pool_props(ref, name,
+                                NETPOOL_FORWARD_NONE, list);
 
-                        CU_DEBUG("qos hack buffer = %s", buffer);
-
-                        i = asprintf(&name, "Point/%s", buffer);
-                        if (i != -1) {
-                                s = set_net_pool_props(ref, name,
-                                        NETPOOL_FORWARD_NONE, list);
-
-                                free(name);
-                        }
+                        free(name);
                 }
-
-                pclose(pipe);
-                CU_DEBUG("pipe close");
         }
 
  out:
-        free(cmd);
+        free(classes);
         free(bridge);
         virConnectClose(conn);
 
@@ -2455,11 +2436,11 @@ static struct std_assoc *assoc_handlers[] = {
         NULL
 };
 
-STDA_AssocMIStub(,
-                 Virt_SettingsDefineCapabilities,
-                 _BROKER,
-                 libvirt_cim_init(),
-                 assoc_handlers);
+STATS_AssocMIStub(,
+                  Virt_SettingsDefineCapabilities,
+                  _BROKER,
+                  libvirt_cim_init(),
+                  assoc_handlers);
 
 /*
  * Local Variables:
@@ -24,6 +24,9 @@
 #include <string.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <net/if_arp.h>
 
 #include <cmpidt.h>
 #include <cmpift.h>
@@ -33,14 +36,34 @@
 #include <libcmpiutil/std_instance.h>
 
 #include "misc_util.h"
+#include "nl_util.h"
 #include "config.h"
 #include "Virt_HostSystem.h"
 
 #define MAX_LEN 512
-#define CMD "/sbin/ifconfig -a | /bin/grep eth | /bin/awk '{print$1}'"
 
 const static CMPIBroker *_BROKER;
 
+/* lldptool runs with lock dropped, discovering tells the requests
+ * arriving meanwhile to wait on discovered, or to use the previous
+ * answer if there is one.
+ */
+struct vsi_cache {
+        pthread_mutex_t lock;
+        pthread_cond_t discovered;
+        struct nl_watch watch;
+        bool discovering;
+        bool valid;
+        time_t checked;
+        bool vsi;
+        char iface[IFNAMSIZ];
+};
+
+static struct vsi_cache vsi_cache = {PTHREAD_MUTEX_INITIALIZER,
+                                     PTHREAD_COND_INITIALIZER,
+                                     NL_WATCH_INITIALIZER,
+                                     false, false, 0, false, ""};
+
 static CMPIStatus check_vsi_support(char *command)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
@@ -134,71 +157,114 @@ static CMPIStatus check_vsi_support(char *command)
         return s;
 }
 
-static char **run_command(char *func, int *len, CMPIStatus *s) {
+/* lldpad runs on the physical ethernet ports */
+static bool vsi_candidate(const struct nl_link *link)
+{
+        return (link->type == ARPHRD_ETHER) && (link->kind[0] == '\0');
+}
 
-        char buff[MAX_LEN];
-        FILE *stream = NULL;
-        char **arr = NULL;
-        char *string = NULL;
-        int i = 0;
+static CMPIStatus vsi_discover(bool *vsi, char *iface, size_t size)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        struct nl_link *links = NULL;
+        const char *lldptool_query_options = NULL;
+        char cmd[MAX_LEN];
+        int count;
+        int i;
 
-        // run the command.
-        stream = popen(func, "r");
-        if (stream == NULL) {
-                CU_DEBUG("Failed to open pipe to run command");
-                cu_statusf(_BROKER, s,
-                           CMPI_RC_ERR_NOT_FOUND,
-                           "Failed to open pipe");
-                return NULL;
+        *vsi = false;
+        iface[0] = '\0';
+
+        count = nl_link_list(&links);
+        if (count < 0) {
+                CU_DEBUG("Failed to get network interfaces");
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Failed to get network interfaces");
+                return s;
         }
 
-        // read output of command.
-        while (fgets(buff, MAX_LEN, stream) != NULL) {
-                int len = strlen(buff) - 1;
-                char **tmp_list = NULL;
-
-                // dynamically increase size as more interfaces are found.
-                tmp_list = (char **)realloc(arr,
-                                            (i + 1) *
-                                            sizeof(char *));
-                if (tmp_list == NULL) {
-                        CU_DEBUG("Failed to allocate memory");
-                        cu_statusf(_BROKER, s,
-                                   CMPI_RC_ERR_NOT_FOUND,
-                                   "Failed to realloc");
-                        goto err;
-                }
+        CU_DEBUG("Found %d interfaces", count);
+
+        lldptool_query_options = get_lldptool_query_options();
+        if (!lldptool_query_options) {
+                lldptool_query_options = "-t -g ncb -V evbcfg";
+        }
 
-                arr = tmp_list;
+        for (i = 0; i < count; i++) {
+                if (!vsi_candidate(&links[i]))
+                        continue;
 
-                string = strndup(buff, len);
-                if (string == NULL) {
-                        CU_DEBUG("Failed to allocate memory");
-                        cu_statusf(_BROKER, s,
-                                   CMPI_RC_ERR_NOT_FOUND,
-                                   "Failed to calloc");
-                        goto err;
+                snprintf(cmd, sizeof(cmd), "lldptool -i %s %s",
+                         links[i].name, lldptool_query_options);
+                CU_DEBUG("running command [%s]", cmd);
+                if (check_vsi_support(cmd).rc == CMPI_RC_OK) {
+                        *vsi = true;
+                        snprintf(iface, size, "%s", links[i].name);
+                        break;
                 }
-                arr[i] = string;
-                i++;
         }
 
-        pclose(stream);
-        *len = i;
-        return arr;
+        free(links);
+
+        return s;
+}
+
+/* The interfaces and the lldptool answers for them are kept until a link
+ * changes or vsi_cache_ttl seconds pass.
+ */
+static CMPIStatus vsi_lookup(bool *vsi, char *iface, size_t size)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        struct timespec now;
+        bool found = false;
+        char found_iface[IFNAMSIZ] = "";
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        pthread_mutex_lock(&vsi_cache.lock);
+
+        /* Asked before discovering, so changes made meanwhile are seen
+         * on the next call.
+         */
+        if (nl_links_changed(&vsi_cache.watch))
+                vsi_cache.valid = false;
+
+        while (vsi_cache.discovering && !vsi_cache.valid)
+                pthread_cond_wait(&vsi_cache.discovered, &vsi_cache.lock);
+
+        if (vsi_cache.discovering ||
+            (vsi_cache.valid &&
+             (now.tv_sec - vsi_cache.checked < get_vsi_cache_ttl()))) {
+                CU_DEBUG("Using cached VSI support");
+                goto out;
+        }
+
+        vsi_cache.discovering = true;
+        pthread_mutex_unlock(&vsi_cache.lock);
+
+        s = vsi_discover(&found, found_iface, sizeof(found_iface));
+
+        pthread_mutex_lock(&vsi_cache.lock);
+
+        vsi_cache.discovering = false;
+        vsi_cache.valid = (s.rc == CMPI_RC_OK);
+        vsi_cache.checked = now.tv_sec;
+        if (vsi_cache.valid) {
+                vsi_cache.vsi = found;
+                strcpy(vsi_cache.iface, found_iface);
+        }
 
- err:
-        /* undo everything */
-        if (i > 0) {
-                int count;
-                for (count = 0; count < i; count++)
-                        free(arr[count]);
+        pthread_cond_broadcast(&vsi_cache.discovered);
+ out:
+        if (s.rc == CMPI_RC_OK) {
+                *vsi = vsi_cache.vsi;
+                snprintf(iface, size, "%s", vsi_cache.iface);
         }
 
-        free(arr);
-        pclose(stream);
-        return NULL;
+        pthread_mutex_unlock(&vsi_cache.lock);
 
+        return s;
 }
 
 static CMPIStatus set_inst_properties(const CMPIBroker *broker,
@@ -248,11 +314,7 @@ static CMPIStatus get_switchservice(const CMPIObjectPath *reference,
         CMPIInstance *inst = NULL;
         virConnectPtr conn = NULL;
         bool vsi = false;
-        int count = 0;
-        int i;
-        char **if_list;
-        char cmd[MAX_LEN];
-        const char *lldptool_query_options = NULL;
+        char iface[IFNAMSIZ];
 
         *_inst = NULL;
         conn = connect_by_classname(broker, CLASSNAME(reference), &s);
@@ -285,44 +347,16 @@ static CMPIStatus get_switchservice(const CMPIObjectPath *reference,
                 goto out;
         }
 
-        if_list = run_command(CMD, &count, &s);
-        if (if_list == 0) {
-                CU_DEBUG("Failed to get network interfaces");
-                cu_statusf(broker, &s,
-                           CMPI_RC_ERR_FAILED,
-                           "Failed to get network interfaces");
+        s = vsi_lookup(&vsi, iface, sizeof(iface));
+        if (s.rc != CMPI_RC_OK)
                 goto out;
-        }
-
-        CU_DEBUG("Found %d interfaces", count);
-
-        lldptool_query_options = get_lldptool_query_options();
-        if (!lldptool_query_options) {
-                lldptool_query_options = "-t -g ncb -V evbcfg";
-        }
 
-        for (i=0; i<count; i++) {
-                sprintf(cmd, "lldptool -i %s %s",
-                        if_list[i], lldptool_query_options);
-                CU_DEBUG("running command [%s]", cmd);
-                s = check_vsi_support(cmd); 
-                if (s.rc == CMPI_RC_OK) {
-                        vsi = true;
-                        CMSetProperty(inst, "VSIInterface", 
-                                      (CMPIValue *)if_list[i], CMPI_chars);
-                        break;
-                }
-                else
-                        vsi = false;
-        }
+        if (vsi)
+                CMSetProperty(inst, "VSIInterface",
+                              (CMPIValue *)iface, CMPI_chars);
 
         CMSetProperty(inst, "IsVSISupported", (CMPIValue *)&vsi, CMPI_boolean);
-        s.rc = CMPI_RC_OK;
 
-        for (i = 0; i < count; i++)
-                free(if_list[i]);
-
-        free(if_list);
  out:
         virConnectClose(conn);
         *_inst = inst;
@@ -383,12 +417,25 @@ DEFAULT_CI();
 DEFAULT_MI();
 DEFAULT_DI();
 DEFAULT_EQ();
-DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
-                   Virt_SwitchService,
-                   _BROKER,
-                   libvirt_cim_init());
+static CMPIStatus Cleanup(CMPIInstanceMI *self,
+                          const CMPIContext *context,
+                          CMPIBoolean terminating)
+{
+        pthread_mutex_lock(&vsi_cache.lock);
+
+        nl_watch_close(&vsi_cache.watch);
+        vsi_cache.valid = false;
+
+        pthread_mutex_unlock(&vsi_cache.lock);
+
+        CMReturn(CMPI_RC_OK);
+}
+
+STATS_InstanceMIStub(,
+                     Virt_SwitchService,
+                     _BROKER,
+                     libvirt_cim_init());
 
 /*
  * Local Variables:
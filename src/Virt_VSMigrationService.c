@@ -49,13 +49,10 @@
 #include "Virt_VSMigrationSettingData.h"
 #include "svpc_types.h"
 #include "infostore.h"
+#include "job_util.h"
 
 #include "config.h"
 
-#define CIM_JOBSTATE_STARTING 3
-#define CIM_JOBSTATE_RUNNING 4
-#define CIM_JOBSTATE_COMPLETE 7
-
 #define MIGRATE_SHUTDOWN_TIMEOUT 120
 
 #define METHOD_RETURN(r, v) do {                                        \
@@ -315,6 +312,8 @@ static CMPIStatus get_msd_values(const CMPIObjectPath *ref,
                 goto out;
         }
 
+        conn_info_register(*conn);
+
  out:
         free(uri);
         free(dest_params);
@@ -1916,7 +1915,7 @@ static struct method_handler *my_handlers[] = {
         NULL
 };
 
-STDIM_MethodMIStub(, Virt_VSMigrationService, _BROKER,
+STATS_MethodMIStub(, Virt_VSMigrationService, _BROKER,
                    libvirt_cim_init(), my_handlers);
 
 CMPIStatus get_migration_service(const CMPIObjectPath *ref,
@@ -2048,10 +2047,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(, 
-                   Virt_VSMigrationService,
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(, 
+                     Virt_VSMigrationService,
+                     _BROKER,
+                     libvirt_cim_init());
 /*
  * Local Variables:
  * mode: C
@@ -188,8 +188,13 @@ static int instance_from_dom(const CMPIBroker *broker,
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIObjectPath *op;
         struct domain *dominfo = NULL;
+        struct arena *arena;
 
-        ret = get_dominfo(dom, &dominfo);
+        arena = arena_new();
+        if (arena == NULL)
+                return 0;
+
+        ret = get_dominfo_arena(dom, arena, &dominfo);
         if (!ret) {
                 CU_DEBUG("Failed in get_dominfo().");
                 goto out;
@@ -280,7 +285,7 @@ static int instance_from_dom(const CMPIBroker *broker,
                       (CMPIValue *)vsid, CMPI_chars);
 
  out:
-        cleanup_dominfo(&dominfo);
+        arena_free(arena);
         free(pfx);
         free(vsid);
 
@@ -514,10 +519,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
-                   Virt_VSSD,
-                   _BROKER, 
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_VSSD,
+                     _BROKER, 
+                     libvirt_cim_init());
 
 /*
  * Local Variables:
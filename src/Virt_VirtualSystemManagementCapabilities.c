@@ -83,6 +83,23 @@ static CMPIStatus set_inst_properties(const CMPIBroker *broker,
         CMSetProperty(inst, "SynchronousMethodsSupported",
                       (CMPIValue *)&array, CMPI_uint16A);
 
+        /* These can also run as a job, see the Asynchronous parameter */
+        array = CMNewArray(broker, 3, CMPI_uint16, &s);
+        if ((s.rc != CMPI_RC_OK) || CMIsNullObject(array))
+                goto out;
+
+        element = (uint16_t)ADD_RESOURCES;
+        CMSetArrayElementAt(array, 0, &element, CMPI_uint16);
+
+        element = (uint16_t)DEFINE_SYSTEM;
+        CMSetArrayElementAt(array, 1, &element, CMPI_uint16);
+
+        element = (uint16_t)DESTROY_SYSTEM;
+        CMSetArrayElementAt(array, 2, &element, CMPI_uint16);
+
+        CMSetProperty(inst, "AsynchronousMethodsSupported",
+                      (CMPIValue *)&array, CMPI_uint16A);
+
         prefix = class_prefix_name(CLASSNAME(ref));
         if (prefix == NULL) {
                 CU_DEBUG("Prefix of %s was NULL", CLASSNAME(ref));
@@ -207,10 +224,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
-                   Virt_VirtualSystemManagementCapabilities, 
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_VirtualSystemManagementCapabilities, 
+                     _BROKER,
+                     libvirt_cim_init());
 
 /*
  * Local Variables:
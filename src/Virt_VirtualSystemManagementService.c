@@ -45,6 +45,8 @@
 
 #include "misc_util.h"
 #include "infostore.h"
+#include "job_util.h"
+#include "tc_util.h"
 
 #include "Virt_VirtualSystemManagementService.h"
 #include "Virt_ComputerSystem.h"
@@ -69,37 +71,6 @@
 #define RASD_IND_DELETED "ResourceAllocationSettingDataDeletedIndication"
 #define RASD_IND_MODIFIED "ResourceAllocationSettingDataModifiedIndication"
 
-#if LIBVIR_VERSION_NUMBER < 9000
-/* Network QoS support */
-#define QOSCMD_BANDWIDTH2ID "_ROOT=$(tc class show dev %s | awk '($4==\"root\")\
-{print $3}')\n tc class show dev %s | awk -v rr=$_ROOT -v bw=%uKbit \
-'($4==\"parent\" && $5==rr && $13==bw){print $3}'\n"
-
-#define QOSCMD_RMVM "MAC=%s; ME1=$(echo $MAC | awk -F ':' '{ print $1$2$3$4 }'); \
-ME2=$(echo $MAC | awk -F ':' '{ print $5$6 }'); MI1=$(echo $MAC | awk -F ':' \
-'{ print $1$2 }'); MI2=$(echo $MAC | awk -F ':' '{ print $3$4$5$6 }'); \
-HDL=$(tc filter show dev %s | awk 'BEGIN {RS=\"\\nfilter\"} (NR>2)\
-{m1=substr($24,1,2);m2=substr($24,3,2);m3=substr($24,5,2);m4=substr($24,7,2);\
-m5=substr($20,1,2);m6=substr($20,3,2);printf(\"%%s:%%s:%%s:%%s:%%s:%%s %%s\\n\",\
-m1,m2,m3,m4,m5,m6,$9)}' | awk -v mm=%s '($1==mm){print $2}'); \
-U32=\"tc filter del dev %s protocol ip parent 1:0 prio 1 handle $HDL u32\"; \
-$U32 match u16 0x0800 0xFFFF at -2 match u16 0x$ME2 0xFFFF at -4 match u32 \
-0x$ME1 0xFFFFFFFF at -8 flowid %s; U32=\"tc filter del dev %s protocol ip parent \
-ffff: prio 50 u32\"; $U32 match u16 0x0800 0xFFFF at -2 match u32 0x$MI2 \
-0xFFFFFFFF at -12 match u16 0x$MI1 0xFFFF at -14 police rate %uKbit burst 15k \
-drop\n"
-
-#define QOSCMD_ADDVM "MAC=%s; ME1=$(echo $MAC | awk -F ':' '{ print $1$2$3$4 }'); \
-ME2=$(echo $MAC | awk -F ':' '{ print $5$6 }'); MI1=$(echo $MAC | awk -F ':' \
-'{ print $1$2 }'); MI2=$(echo $MAC | awk -F ':' '{ print $3$4$5$6 }'); \
-U32=\"tc filter add dev %s protocol ip parent 1:0 prio 1 u32\"; \
-$U32 match u16 0x0800 0xFFFF at -2 match u16 0x$ME2 0xFFFF at -4 match u32 \
-0x$ME1 0xFFFFFFFF at -8 flowid %s; U32=\"tc filter add dev %s protocol ip parent \
-ffff: prio 50 u32\"; $U32 match u16 0x0800 0xFFFF at -2 match u32 0x$MI2 \
-0xFFFFFFFF at -12 match u16 0x$MI1 0xFFFF at -14 police rate %uKbit burst 15k \
-drop\n"
-#endif
-
 const static CMPIBroker *_BROKER;
 
 enum ResourceAction {
@@ -142,114 +113,34 @@ static CMPIStatus add_qos_for_mac(const uint64_t qos,
                                   const char *bridge)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        char *cmd = NULL;
-        int j;
-        FILE *pipe = NULL;
-        char id[16] = ""; /* should be adequate to hold short tc class ids... */
-
-        /* Find tc performance class id which matches requested qos bandwidth */
-        j = asprintf(&cmd, QOSCMD_BANDWIDTH2ID, bridge,
-                                                bridge,
-                                                (unsigned int)qos);
-        if (j == -1)
-                goto out;
-        CU_DEBUG("add_qos_for_mac(): cmd = %s", cmd);
-
-        if ((pipe = popen(cmd, "r")) != NULL) {
-                if (fgets(id, sizeof(id), pipe) != NULL) {
-                        /* Strip off trailing newline */
-                        char *p = index(id, '\n');
-                        if (p) *p = '\0';
-                 }
-                 pclose(pipe);
-        }
-        free(cmd);
-        CU_DEBUG("qos id = '%s'", id);
-
-        /* Add tc performance class id for this MAC addr */
-        j = asprintf(&cmd, QOSCMD_ADDVM, mac,
-                                         bridge,
-                                         id,
-                                         bridge,
-                                         (unsigned int)qos);
-        if (j == -1)
-                goto out;
-        CU_DEBUG("add_qos_for_mac(): cmd = %s", cmd);
 
-        if (WEXITSTATUS(system(cmd)) != 0)
+        /* Filter this MAC addr into the tc class with the qos bandwidth */
+        if (tc_add_mac(bridge, mac, qos) != 0)
                 CU_DEBUG("add_qos_for_mac(): qos add failed.");
 
- out:
-        free(cmd);
         return s;
 }
 
 /* Network QoS support */
-static CMPIStatus remove_qos_for_mac(const uint64_t qos,
-                                     const char *mac,
+static CMPIStatus remove_qos_for_mac(const char *mac,
                                      const char *bridge)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        char *cmd = NULL;
-        int j;
-        FILE *pipe = NULL;
-        char id[16] = ""; /* should be adequate to hold short tc class ids... */
-
-        /* Find tc performance class id which matches requested qos bandwidth */
-        j = asprintf(&cmd, QOSCMD_BANDWIDTH2ID, bridge,
-                                                bridge,
-                                                (unsigned int)qos);
-        if (j == -1)
-                goto out;
-        CU_DEBUG("remove_qos_for_mac(): cmd = %s", cmd);
-
-        if ((pipe = popen(cmd, "r")) != NULL) {
-                if (fgets(id, sizeof(id), pipe) != NULL) {
-                        /* Strip off trailing newline */
-                        char *p = index(id, '\n');
-                        if (p) *p = '\0';
-                 }
-                 pclose(pipe);
-        }
-        free(cmd);
-        CU_DEBUG("qos id = '%s'", id);
-
-        /* Remove tc perf class id for this MAC; ignore errors when none exists */
-        j = asprintf(&cmd, QOSCMD_RMVM, mac,
-                                        bridge,
-                                        mac,
-                                        bridge,
-                                        id,
-                                        bridge,
-                                        (unsigned int)qos);
-        if (j == -1)
-                goto out;
-        CU_DEBUG("remove_qos_for_mac(): cmd = %s", cmd);
 
-        if (WEXITSTATUS(system(cmd)) != 0)
+        /* Remove tc filters for this MAC; ignore errors when none exists */
+        if (tc_remove_mac(bridge, mac) < 0)
                 CU_DEBUG("remove_qos_for_mac(): qos remove failed; ignoring...");
 
- out:
-        free(cmd);
         return s;
 }
 #endif
 
-static CMPIStatus check_uuid_in_use(const CMPIObjectPath *ref,
+static CMPIStatus check_uuid_in_use(virConnectPtr conn,
                                     struct domain *domain)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        virConnectPtr conn = NULL;
         virDomainPtr dom = NULL;
 
-        conn = connect_by_classname(_BROKER, CLASSNAME(ref), &s);
-        if (conn == NULL) {
-                cu_statusf(_BROKER, &s,
-                           CMPI_RC_ERR_FAILED,
-                           "Error connecting to libvirt");
-                goto out;
-        }
-
         dom = virDomainLookupByUUIDString(conn, domain->uuid);
         if (dom != NULL) {
                 cu_statusf(_BROKER, &s,
@@ -259,9 +150,7 @@ static CMPIStatus check_uuid_in_use(const CMPIObjectPath *ref,
                            domain->uuid);
         }
 
- out:
         virDomainFree(dom);
-        virConnectClose(conn);
 
         return s;
 }
@@ -836,6 +725,8 @@ static const char *_default_network(CMPIInstance *inst,
         return poolid;
 }
 
+static unsigned int mac_seq;
+
 static const char *_net_rand_mac(const CMPIObjectPath *ref)
 {
         int r;
@@ -853,8 +744,11 @@ static const char *_net_rand_mac(const CMPIObjectPath *ref)
         if (ret != 0)
                 goto out;
 
+        /* Guests of a DefineSystems batch are created in parallel, so
+         * the time alone does not tell them apart
+         */
         srand(curr_time.tv_usec);
-        s = curr_time.tv_usec;
+        s = curr_time.tv_usec ^ __sync_add_and_fetch(&mac_seq, 0x9e3779b9);
         r = rand_r(&s);
 
         cn_prefix = class_prefix_name(CLASSNAME(ref));
@@ -2145,8 +2039,7 @@ static const char *classify_resources(CMPIArray *resources,
                             (cu_get_u64_prop(inst, "Reservation", &qos_val) == CMPI_RC_OK) &&
                             (cu_get_str_prop(inst, "AllocationUnits", &qos_unitstr) == CMPI_RC_OK) &&
                             STREQ(qos_unitstr,"KiloBits per Second")) {
-                                remove_qos_for_mac(qos_val,
-                                                   (&dev)->dev.net.mac,
+                                remove_qos_for_mac((&dev)->dev.net.mac,
                                                    (&dev)->dev.net.source);
                                 add_qos_for_mac(qos_val,
                                                 (&dev)->dev.net.mac,
@@ -2208,20 +2101,11 @@ static const char *classify_resources(CMPIArray *resources,
        return NULL;
 }
 
-static CMPIInstance *connect_and_create(char *xml,
-                                        const CMPIObjectPath *ref,
-                                        CMPIStatus *s)
+static virDomainPtr define_domain(virConnectPtr conn,
+                                  const char *xml,
+                                  CMPIStatus *s)
 {
-        virConnectPtr conn;
         virDomainPtr dom;
-        const char *name;
-        CMPIInstance *inst = NULL;
-
-        conn = connect_by_classname(_BROKER, CLASSNAME(ref), s);
-        if (conn == NULL) {
-                CU_DEBUG("libvirt connection failed");
-                return NULL;
-        }
 
         dom = virDomainDefineXML(conn, xml);
         if (dom == NULL) {
@@ -2230,35 +2114,18 @@ static CMPIInstance *connect_and_create(char *xml,
                                 CMPI_RC_ERR_FAILED,
                                 conn,
                                 "Failed to define domain");
-                goto out;
-        }
-
-        name = virDomainGetName(dom);
-
-        *s = get_domain_by_name(_BROKER, ref, name, &inst);
-        if (s->rc != CMPI_RC_OK) {
-                CU_DEBUG("Failed to get new instance");
-                cu_statusf(_BROKER, s,
-                           CMPI_RC_ERR_FAILED,
-                           "Failed to lookup resulting system");
-                goto out;
         }
 
- out:
-        virDomainFree(dom);
-        virConnectClose(conn);
-
-        return inst;
+        return dom;
 }
 
-static CMPIStatus update_dominfo(const struct domain *dominfo,
-                                 const char *refcn)
+static CMPIStatus _update_dominfo(virDomainPtr dom,
+                                  const struct domain *dominfo)
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         struct infostore_ctx *ctx = NULL;
         struct virt_device *dev = dominfo->dev_vcpu;
-        virConnectPtr conn = NULL;
-        virDomainPtr dom = NULL;
+        virConnectPtr conn = virDomainGetConnect(dom);
 
         CU_DEBUG("Enter update_dominfo");
         if (dominfo->dev_vcpu_ct != 1) {
@@ -2267,21 +2134,6 @@ static CMPIStatus update_dominfo(const struct domain *dominfo,
                 return s;
         }
 
-        conn = connect_by_classname(_BROKER, refcn, &s);
-        if (conn == NULL) {
-                CU_DEBUG("Failed to connnect by %s", refcn);
-                return s;
-        }
-
-        dom = virDomainLookupByName(conn, dominfo->name);
-        if (dom == NULL) {
-                virt_set_status(_BROKER, &s,
-                                CMPI_RC_ERR_NOT_FOUND,
-                                conn,
-                                "Unable to lookup domain `%s'", dominfo->name);
-                goto out;
-        }
-
         ctx = infostore_open(dom);
         if (ctx == NULL) {
                 cu_statusf(_BROKER, &s,
@@ -2296,7 +2148,7 @@ static CMPIStatus update_dominfo(const struct domain *dominfo,
         infostore_set_u64(ctx, "weight", dev->dev.vcpu.weight);
 #else
         /* New libvirt versions save cpu cgroup setting in KVM guest config */
-        if (STREQC(virConnectGetType(conn), "QEMU")) {
+        if (STREQC(type_from_conn(conn), "QEMU")) {
                 int ret;
                 virSchedParameter params;
                 strncpy(params.field,
@@ -2326,6 +2178,37 @@ static CMPIStatus update_dominfo(const struct domain *dominfo,
  out:
         infostore_close(ctx);
 
+        return s;
+}
+
+static CMPIStatus update_dominfo(const struct domain *dominfo,
+                                 const char *refcn)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        virConnectPtr conn = NULL;
+        virDomainPtr dom = NULL;
+
+        if (dominfo->dev_vcpu_ct != 1)
+                return s;
+
+        conn = connect_by_classname(_BROKER, refcn, &s);
+        if (conn == NULL) {
+                CU_DEBUG("Failed to connnect by %s", refcn);
+                return s;
+        }
+
+        dom = virDomainLookupByName(conn, dominfo->name);
+        if (dom == NULL) {
+                virt_set_status(_BROKER, &s,
+                                CMPI_RC_ERR_NOT_FOUND,
+                                conn,
+                                "Unable to lookup domain `%s'", dominfo->name);
+                goto out;
+        }
+
+        s = _update_dominfo(dom, dominfo);
+
+ out:
         virDomainFree(dom);
         virConnectClose(conn);
 
@@ -2363,10 +2246,10 @@ static CMPIStatus match_prefixes(const CMPIObjectPath *a,
 }
 
 static CMPIStatus get_reference_domain(struct domain **domain,
+                                       virConnectPtr conn,
                                        const CMPIObjectPath *ref,
                                        const CMPIObjectPath *refconf)
 {
-        virConnectPtr conn = NULL;
         virDomainPtr dom = NULL;
         char *name = NULL;
         const char *iid;
@@ -2374,22 +2257,11 @@ static CMPIStatus get_reference_domain(struct domain **domain,
         CMPIStatus s;
         int ret;
 
+        /* Same prefix, so conn also holds the reference domain */
         s = match_prefixes(ref, refconf);
         if (s.rc != CMPI_RC_OK)
                 return s;
 
-        conn = connect_by_classname(_BROKER, CLASSNAME(refconf), &s);
-        if (conn == NULL) {
-                if (s.rc != CMPI_RC_OK)
-                        return s;
-                else {
-                        cu_statusf(_BROKER, &s,
-                                   CMPI_RC_ERR_FAILED,
-                                   "Unable to connect to libvirt");
-                        return s;
-                }
-        }
-
         if (cu_get_str_path(refconf, "InstanceID", &iid) != CMPI_RC_OK) {
                 CU_DEBUG("Missing InstanceID parameter");
                 cu_statusf(_BROKER, &s,
@@ -2446,12 +2318,90 @@ static CMPIStatus get_reference_domain(struct domain **domain,
 
  out:
         virDomainFree(dom);
-        virConnectClose(conn);
         free(name);
 
         return s;
 }
 
+static CMPIInstance *rasd_indication(const char *base_type,
+                                     CMPIInstance *prev_inst,
+                                     const CMPIObjectPath *ref,
+                                     const struct ind_source *src,
+                                     CMPIInstance *rasd)
+{
+        CMPIInstance *ind;
+
+        ind = get_typed_instance(_BROKER,
+                                 CLASSNAME(ref),
+                                 base_type,
+                                 NAMESPACE(ref),
+                                 false);
+        if (ind == NULL) {
+                CU_DEBUG("Failed to get indication instance");
+                return NULL;
+        }
+
+        /* PreviousInstance is set only for modify case. */
+        if (prev_inst != NULL)
+                CMSetProperty(ind,
+                              "PreviousInstance",
+                              (CMPIValue *)&prev_inst,
+                              CMPI_instance);
+
+        CMSetProperty(ind,
+                      "SourceInstance",
+                      (CMPIValue *)&rasd,
+                      CMPI_instance);
+        set_ind_source(ind, src);
+
+        return ind;
+}
+
+/* Raises one indication carrying every RASD of the list */
+static CMPIStatus raise_rasd_aggregate(const CMPIContext *context,
+                                       const char *base_type,
+                                       const char *type,
+                                       CMPIInstance *prev_inst,
+                                       const CMPIObjectPath *ref,
+                                       const struct ind_source *src,
+                                       struct inst_list *list)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIInstance *ind;
+        CMPIArray *array;
+        int i;
+
+        array = CMNewArray(_BROKER, list->cur, CMPI_instance, &s);
+        if ((array == NULL) || (s.rc != CMPI_RC_OK)) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to allocate SourceInstances array");
+                return s;
+        }
+
+        for (i = 0; i < list->cur; i++)
+                CMSetArrayElementAt(array, i,
+                                    (CMPIValue *)&list->list[i],
+                                    CMPI_instance);
+
+        ind = rasd_indication(base_type, prev_inst, ref, src, list->list[0]);
+        if (ind == NULL) {
+                s.rc = CMPI_RC_ERR_FAILED;
+                return s;
+        }
+
+        CMSetProperty(ind,
+                      "SourceInstances",
+                      (CMPIValue *)&array,
+                      CMPI_instanceA);
+
+        return stdi_raise_indication(_BROKER,
+                                     context,
+                                     type,
+                                     NAMESPACE(ref),
+                                     ind);
+}
+
 static CMPIStatus raise_rasd_indication(const CMPIContext *context,
                                         const char *base_type,
                                         CMPIInstance *prev_inst,
@@ -2460,46 +2410,35 @@ static CMPIStatus raise_rasd_indication(const CMPIContext *context,
 {
         char *type;
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        CMPIInstance *instc = NULL;
         CMPIInstance *ind = NULL;
-        CMPIObjectPath *op = NULL;
+        struct ind_source src;
         int i;
 
-        CU_DEBUG("raise_rasd_indication %s", base_type);
+        CU_DEBUG("raise_rasd_indication %s for %i RASDs",
+                 base_type, list->cur);
+
+        if (list->cur == 0)
+                return s;
 
         type = get_typed_class(CLASSNAME(ref), base_type);
 
+        /* The source properties are the same for the whole list */
+        get_ind_source(_BROKER, context, ref, &src);
+
+        if (get_rasd_indication_aggregate()) {
+                s = raise_rasd_aggregate(context, base_type, type,
+                                         prev_inst, ref, &src, list);
+                goto out;
+        }
+
         for (i = 0; i < list->cur; i++) {
-                ind = get_typed_instance(_BROKER,
-                                         CLASSNAME(ref),
-                                         base_type,
-                                         NAMESPACE(ref),
-                                         false);
+                ind = rasd_indication(base_type, prev_inst, ref,
+                                      &src, list->list[i]);
                 if (ind == NULL)  {
-                        CU_DEBUG("Failed to get indication instance");
                         s.rc = CMPI_RC_ERR_FAILED;
                         goto out;
                 }
 
-                /* PreviousInstance is set only for modify case. */
-                if (prev_inst != NULL)
-                        CMSetProperty(ind,
-                                      "PreviousInstance",
-                                      (CMPIValue *)&prev_inst,
-                                      CMPI_instance);
-
-                instc = list->list[i];
-                op = CMGetObjectPath(instc, NULL);
-                CMPIString *str = CMGetClassName(op, NULL);
-
-                CU_DEBUG("class name is %s\n", CMGetCharsPtr(str, NULL));
-
-                CMSetProperty(ind,
-                              "SourceInstance",
-                              (CMPIValue *)&instc,
-                              CMPI_instance);
-                set_source_inst_props(_BROKER, context, ref, ind);
-
                 s = stdi_raise_indication(_BROKER,
                                           context,
                                           type,
@@ -2513,47 +2452,16 @@ static CMPIStatus raise_rasd_indication(const CMPIContext *context,
 
 }
 
+/* inst_dom is the domain the VSSD was applied to */
 static CMPIStatus set_autostart(CMPIInstance *vssd,
-                                const CMPIObjectPath *ref,
+                                virDomainPtr inst_dom,
                                 virDomainPtr dom)
 {
-        CMPIStatus s;
-        const char *name = NULL;
-        CMPIrc ret;
-        virConnectPtr conn = NULL;
-        virDomainPtr inst_dom = NULL;
+        CMPIStatus s = {CMPI_RC_OK, NULL};
         uint16_t val = 0;
         int i = 0;
 
         CU_DEBUG("Enter set_autostart");
-        ret = cu_get_str_prop(vssd, "VirtualSystemIdentifier", &name);
-        if (ret != CMPI_RC_OK) {
-                CU_DEBUG("Missing VirtualSystemIdentifier");
-                cu_statusf(_BROKER, &s,
-                           ret,
-                           "Missing VirtualSystemIdentifier");
-                goto out;
-        }
-
-        conn = connect_by_classname(_BROKER, CLASSNAME(ref), &s);
-        if (conn == NULL) {
-                CU_DEBUG("Failed to connect");
-                cu_statusf(_BROKER, &s,
-                           CMPI_RC_ERR_FAILED,
-                           "Failed to connect");
-                goto out;
-        }
-
-        inst_dom = virDomainLookupByName(conn, name);
-        if (inst_dom == NULL) {
-                CU_DEBUG("reference domain '%s' does not exist", name);
-                virt_set_status(_BROKER, &s,
-                                CMPI_RC_ERR_NOT_FOUND,
-                                conn,
-                                "Referenced domain `%s' does not exist", name);
-                goto out;
-        }
-
         if (cu_get_u16_prop(vssd, "AutoStart", &val) != CMPI_RC_OK) {
                 if (dom != NULL) {
                         /* Read the current domain's autostart setting.
@@ -2575,13 +2483,11 @@ static CMPIStatus set_autostart(CMPIInstance *vssd,
                            "Failed to set autostart");
         }
 
- out:
-        virDomainFree(inst_dom);
-        virConnectClose(conn);
         return s;
 }
 
 static CMPIInstance *create_system(const CMPIContext *context,
+                                   virConnectPtr conn,
                                    CMPIInstance *vssd,
                                    CMPIArray *resources,
                                    const CMPIObjectPath *ref,
@@ -2594,13 +2500,19 @@ static CMPIInstance *create_system(const CMPIContext *context,
         struct inst_list list;
         const char *props[] = {NULL};
         struct domain *domain = NULL;
+        struct domain *defined = NULL;
         char *error_msg = NULL;
+        virDomainPtr dom = NULL;
 
         inst_list_init(&list);
 
         CU_DEBUG("Enter create_system");
+
+        /* Everything from the UUID check to the indications below is
+         * done on the caller's connection
+         */
         if (refconf != NULL) {
-                *s = get_reference_domain(&domain, ref, refconf);
+                *s = get_reference_domain(&domain, conn, ref, refconf);
                 if (s->rc != CMPI_RC_OK)
                         goto out;
         } else {
@@ -2621,7 +2533,7 @@ static CMPIInstance *create_system(const CMPIContext *context,
                 goto out;
         }
 
-        *s = check_uuid_in_use(ref, domain);
+        *s = check_uuid_in_use(conn, domain);
         if (s->rc != CMPI_RC_OK)
                 goto out;
 
@@ -2646,74 +2558,84 @@ static CMPIInstance *create_system(const CMPIContext *context,
         xml = system_to_xml(domain);
         CU_DEBUG("System XML:\n%s", xml);
 
-        inst = connect_and_create(xml, ref, s);
-        if (inst != NULL) {
-                update_dominfo(domain, CLASSNAME(ref));
-                set_autostart(vssd, ref, NULL);
+        dom = define_domain(conn, xml, s);
+        if (dom == NULL)
+                goto out;
 
-                *s = enum_rasds(_BROKER,
-                                ref,
-                                domain->name,
-                                CIM_RES_TYPE_ALL,
-                                props,
-                                &list);
+        _update_dominfo(dom, domain);
+        set_autostart(vssd, dom, NULL);
 
-                if (s->rc != CMPI_RC_OK) {
-                        CU_DEBUG("Failed to enumerate rasd\n");
-                        goto out;
-                }
+        /* libvirt fills in defaults such as controllers and device
+         * addresses, so the new instances come from the definition it
+         * kept rather than from the one we generated
+         */
+        if (get_dominfo(dom, &defined) == 0) {
+                virt_set_status(_BROKER, s,
+                                CMPI_RC_ERR_FAILED,
+                                conn,
+                                "Failed to lookup resulting system");
+                goto out;
+        }
 
-                raise_rasd_indication(context,
-                                      RASD_IND_CREATED,
-                                      NULL,
-                                      ref,
-                                      &list);
+        *s = instance_from_dominfo(_BROKER,
+                                   NAMESPACE(ref),
+                                   pfx_from_conn(conn),
+                                   defined,
+                                   &inst);
+        if (s->rc != CMPI_RC_OK) {
+                CU_DEBUG("Failed to get new instance");
+                cu_statusf(_BROKER, s,
+                           CMPI_RC_ERR_FAILED,
+                           "Failed to lookup resulting system");
+                goto out;
+        }
+
+        /* A domain that was just defined is not running */
+        set_domain_state(_BROKER, defined->name, VIR_DOMAIN_SHUTOFF, inst);
+
+        *s = rasds_from_dominfo(_BROKER, ref, dom, defined, props, &list);
+        if (s->rc != CMPI_RC_OK) {
+                CU_DEBUG("Failed to enumerate rasd\n");
+                goto out;
         }
 
+        raise_rasd_indication(context,
+                              RASD_IND_CREATED,
+                              NULL,
+                              ref,
+                              &list);
 
  out:
         free(error_msg);
         cleanup_dominfo(&domain);
+        cleanup_dominfo(&defined);
         free(xml);
         inst_list_free(&list);
+        virDomainFree(dom);
 
         return inst;
 }
 
-static CMPIStatus define_system(CMPIMethodMI *self,
-                                const CMPIContext *context,
-                                const CMPIResult *results,
-                                const CMPIObjectPath *reference,
-                                const CMPIArgs *argsin,
-                                CMPIArgs *argsout)
+static CMPIObjectPath *define_one(const CMPIContext *context,
+                                  virConnectPtr conn,
+                                  CMPIInstance *vssd,
+                                  CMPIArray *res,
+                                  const CMPIObjectPath *reference,
+                                  const CMPIObjectPath *refconf,
+                                  CMPIStatus *s)
 {
-        CMPIObjectPath *refconf;
         CMPIObjectPath *result;
-        CMPIInstance *vssd;
         CMPIInstance *sys;
-        CMPIArray *res;
-        CMPIStatus s;
-        uint32_t rc = CIM_SVPC_RETURN_FAILED;
-
-        CU_DEBUG("DefineSystem");
 
-        s = define_system_parse_args(argsin,
-                                     &vssd,
-                                     NAMESPACE(reference),
-                                     &res,
-                                     &refconf);
-        if (s.rc != CMPI_RC_OK)
-                goto out;
-
-        sys = create_system(context, vssd, res, reference, refconf, &s);
+        sys = create_system(context, conn, vssd, res, reference, refconf, s);
         if (sys == NULL)
-                goto out;
+                return NULL;
 
-        result = CMGetObjectPath(sys, &s);
-        if ((result != NULL) && (s.rc == CMPI_RC_OK)) {
-                CMSetNameSpace(result, NAMESPACE(reference));
-                CMAddArg(argsout, "ResultingSystem", &result, CMPI_ref);
-        }
+        result = CMGetObjectPath(sys, s);
+        if ((result == NULL) || (s->rc != CMPI_RC_OK))
+                return NULL;
+
+        CMSetNameSpace(result, NAMESPACE(reference));
 
         /* try trigger indication */
         bool ind_rc = trigger_indication(_BROKER, context,
@@ -2725,124 +2647,1165 @@ static CMPIStatus define_system(CMPIMethodMI *self,
                          "system create, dom is '%s'", dom_name);
         }
 
- out:
-        if (s.rc == CMPI_RC_OK)
-                rc = CIM_SVPC_RETURN_COMPLETED;
-        CMReturnData(results, &rc, CMPI_uint32);
+        return result;
+}
 
-        return s;
+/*
+ * DefineSystem, DestroySystem, AddResourceSettings and the batch
+ * methods run as a VirtualSystemManagementJob when called with
+ * Asynchronous set, so that a slow libvirtd or storage backend does not
+ * hold a CIMOM thread.  The jobs run "batch_workers" at a time.  The
+ * outputs the method would have returned are recorded in properties of
+ * the job of the same name, with references given as object paths.
+ */
+static struct job_queue vsms_queue =
+        JOB_QUEUE_INITIALIZER("VirtualSystemManagement", get_batch_workers);
+
+struct vsms_job {
+        CMPIInstance *vssd;
+        CMPIArray *res;
+        CMPIObjectPath *refconf;
+        char *domain;
+};
+
+static void vsms_job_free(void *data)
+{
+        struct vsms_job *vj = data;
+
+        if (vj->vssd != NULL)
+                CMRelease(vj->vssd);
+        if (vj->res != NULL)
+                CMRelease(vj->res);
+        if (vj->refconf != NULL)
+                CMRelease(vj->refconf);
+
+        free(vj->domain);
+        free(vj);
 }
 
-static CMPIStatus destroy_system(CMPIMethodMI *self,
+static bool async_requested(const CMPIArgs *argsin)
+{
+        CMPIData data;
+        CMPIStatus s;
+
+        data = CMGetArg(argsin, "Asynchronous", &s);
+        if ((s.rc != CMPI_RC_OK) || CMIsNullValue(data) ||
+            (data.type != CMPI_boolean))
+                return false;
+
+        return data.value.boolean;
+}
+
+/* Copies the request objects the job needs past the end of the call */
+static struct vsms_job *vsms_job_new(CMPIInstance *vssd,
+                                     CMPIArray *res,
+                                     const CMPIObjectPath *refconf,
+                                     const char *domain,
+                                     CMPIStatus *s)
+{
+        struct vsms_job *vj;
+
+        vj = calloc(1, sizeof(*vj));
+        if (vj == NULL)
+                goto err;
+
+        if (vssd != NULL) {
+                vj->vssd = CMClone(vssd, s);
+                if (vj->vssd == NULL)
+                        goto err;
+        }
+
+        if (res != NULL) {
+                vj->res = CMClone(res, s);
+                if (vj->res == NULL)
+                        goto err;
+        }
+
+        if (refconf != NULL) {
+                vj->refconf = CMClone(refconf, s);
+                if (vj->refconf == NULL)
+                        goto err;
+        }
+
+        if (domain != NULL) {
+                vj->domain = strdup(domain);
+                if (vj->domain == NULL)
+                        goto err;
+        }
+
+        return vj;
+ err:
+        cu_statusf(_BROKER, s,
+                   CMPI_RC_ERR_FAILED,
+                   "Unable to create job");
+        if (vj != NULL)
+                vsms_job_free(vj);
+
+        return NULL;
+}
+
+/* Queues run(data) and hands the job back to the client; data is
+ * freed with free_data() in any case
+ */
+static CMPIStatus start_vsms_job(const CMPIContext *context,
+                                 const CMPIObjectPath *ref,
+                                 const char *name,
+                                 const char *desc,
+                                 job_run_t run,
+                                 void *data,
+                                 void (*free_data)(void *),
+                                 const CMPIResult *results,
+                                 CMPIArgs *argsout)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIObjectPath *job_op;
+        struct job *job;
+        char *classname;
+        uint32_t rc = CIM_SVPC_RETURN_FAILED;
+
+        classname = get_typed_class(CLASSNAME(ref),
+                                    "VirtualSystemManagementJob");
+        if (classname == NULL) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to create job");
+                free_data(data);
+                goto out;
+        }
+
+        job = job_new(_BROKER, context, ref, classname,
+                      name, desc, &job_op, &s);
+        free(classname);
+        if (job == NULL) {
+                free_data(data);
+                goto out;
+        }
+
+        if (job_queue_push(&vsms_queue, context, job,
+                           run, data, free_data) != 0) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to start job");
+                goto out;
+        }
+
+        CMAddArg(argsout, "Job", (CMPIValue *)&job_op, CMPI_ref);
+        rc = CIM_SVPC_RETURN_JOB_STARTED;
+ out:
+        CMReturnData(results, &rc, CMPI_uint32);
+
+        return s;
+}
+
+/* An array of references as a string array, for job outputs */
+static CMPIArray *ref_strings(CMPIArray *refs)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIArray *strs;
+        CMPICount count;
+        CMPICount i;
+
+        count = CMGetArrayCount(refs, NULL);
+
+        strs = CMNewArray(_BROKER, count, CMPI_string, &s);
+        if ((s.rc != CMPI_RC_OK) || (strs == NULL))
+                return NULL;
+
+        for (i = 0; i < count; i++) {
+                CMPIData d = CMGetArrayElementAt(refs, i, NULL);
+                CMPIString *str;
+
+                if (CMIsNullValue(d) || (d.value.ref == NULL))
+                        continue;
+
+                str = CMObjectPathToString(d.value.ref, NULL);
+                if (str != NULL)
+                        CMSetArrayElementAt(strs, i,
+                                            (CMPIValue *)&str,
+                                            CMPI_string);
+        }
+
+        return strs;
+}
+
+static void vsms_job_set_failed(struct job *job, CMPIStatus *s)
+{
+        const char *msg = NULL;
+
+        if (s->msg != NULL)
+                msg = CMGetCharPtr(s->msg);
+
+        job_set_failed(job,
+                       s->rc != CMPI_RC_OK ? s->rc : CMPI_RC_ERR_FAILED,
+                       msg != NULL ? msg : "Failed");
+}
+
+static void define_system_job(struct job *job,
+                              struct job_worker *worker,
+                              void *data)
+{
+        struct vsms_job *vj = data;
+        CMPIStatus s;
+        CMPIObjectPath *result;
+        virConnectPtr conn;
+
+        conn = job_connect(job, worker, &s);
+        if (conn == NULL) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Error connecting to libvirt");
+                vsms_job_set_failed(job, &s);
+                return;
+        }
+
+        result = define_one(job_context(job),
+                            conn,
+                            vj->vssd,
+                            vj->res,
+                            job_ref(job),
+                            vj->refconf,
+                            &s);
+        if (result == NULL) {
+                vsms_job_set_failed(job, &s);
+                return;
+        }
+
+        job_set_output(job, "ResultingSystem",
+                       (CMPIValue *)REF2STR(result), CMPI_chars);
+        job_set_complete(job, "Completed");
+}
+
+static CMPIStatus define_system(CMPIMethodMI *self,
+                                const CMPIContext *context,
+                                const CMPIResult *results,
+                                const CMPIObjectPath *reference,
+                                const CMPIArgs *argsin,
+                                CMPIArgs *argsout)
+{
+        CMPIObjectPath *refconf;
+        CMPIObjectPath *result;
+        CMPIInstance *vssd;
+        CMPIArray *res;
+        CMPIStatus s;
+        virConnectPtr conn = NULL;
+        uint32_t rc = CIM_SVPC_RETURN_FAILED;
+
+        CU_DEBUG("DefineSystem");
+
+        s = define_system_parse_args(argsin,
+                                     &vssd,
+                                     NAMESPACE(reference),
+                                     &res,
+                                     &refconf);
+        if (s.rc != CMPI_RC_OK)
+                goto out;
+
+        if (async_requested(argsin)) {
+                struct vsms_job *vj;
+                const char *name = NULL;
+                char *desc = NULL;
+
+                vj = vsms_job_new(vssd, res, refconf, NULL, &s);
+                if (vj == NULL)
+                        goto out;
+
+                cu_get_str_prop(vssd, "VirtualSystemIdentifier", &name);
+                if (asprintf(&desc, "Define %s",
+                             name != NULL ? name : "system") == -1)
+                        desc = NULL;
+
+                s = start_vsms_job(context, reference,
+                                   "DefineSystem",
+                                   desc != NULL ? desc : "Define system",
+                                   define_system_job,
+                                   vj, vsms_job_free,
+                                   results, argsout);
+                free(desc);
+
+                return s;
+        }
+
+        conn = connect_by_classname(_BROKER, CLASSNAME(reference), &s);
+        if (conn == NULL) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Error connecting to libvirt");
+                goto out;
+        }
+
+        result = define_one(context, conn, vssd, res, reference, refconf, &s);
+        if (result != NULL)
+                CMAddArg(argsout, "ResultingSystem", &result, CMPI_ref);
+
+ out:
+        virConnectClose(conn);
+
+        if (s.rc == CMPI_RC_OK)
+                rc = CIM_SVPC_RETURN_COMPLETED;
+        CMReturnData(results, &rc, CMPI_uint32);
+
+        return s;
+}
+
+static uint32_t destroy_one(const CMPIContext *context,
+                            virConnectPtr conn,
+                            const CMPIObjectPath *reference,
+                            const char *dom_name,
+                            CMPIStatus *status)
+{
+        uint32_t rc = IM_RC_FAILED;
+        virDomainPtr dom = NULL;
+        struct domain *dominfo = NULL;
+        struct inst_list list;
+        const char *props[] = {NULL};
+
+        inst_list_init(&list);
+
+        dom = virDomainLookupByName(conn, dom_name);
+        if (dom == NULL) {
+                CU_DEBUG("No such domain `%s'", dom_name);
+                rc = IM_RC_SYS_NOT_FOUND;
+                goto error;
+        }
+
+        /* The RASDs for the deleted indications.  They are best
+         * effort: the guest is destroyed even if they cannot be built.
+         */
+        if (get_dominfo(dom, &dominfo) == 0) {
+                CU_DEBUG("Failed to get domain info, "
+                         "no RASDs for the deleted indications");
+        } else {
+                CMPIStatus s;
+
+                s = rasds_from_dominfo(_BROKER,
+                                       reference,
+                                       dom,
+                                       dominfo,
+                                       props,
+                                       &list);
+                if (s.rc != CMPI_RC_OK)
+                        CU_DEBUG("Failed to enumerate rasd, "
+                                 "sending %u of them", list.cur);
+        }
+
+        infostore_delete(type_from_conn(conn), dom_name);
+
+        virDomainDestroy(dom); /* Okay for this to fail */
+
+        virDomainFree(dom);
+
+        dom = virDomainLookupByName(conn, dom_name);
+        if (dom == NULL) {
+                CU_DEBUG("Domain successfully destroyed");
+                rc = IM_RC_OK;
+                goto error;
+        }
+
+        if (virDomainUndefine(dom) == 0) {
+                CU_DEBUG("Domain successfully destroyed and undefined");
+                rc = IM_RC_OK;
+        }
+
+error:
+        if (rc == IM_RC_SYS_NOT_FOUND)
+                virt_set_status(_BROKER,
+                                status,
+                                CMPI_RC_ERR_NOT_FOUND,
+                                conn,
+                                "Referenced domain `%s' does not exist",
+                                dom_name);
+        else if (rc == IM_RC_FAILED)
+                virt_set_status(_BROKER, status,
+                                CMPI_RC_ERR_NOT_FOUND,
+                                conn,
+                                "Unable to retrieve domain name");
+        else if (rc == IM_RC_OK) {
+                *status = (CMPIStatus){CMPI_RC_OK, NULL};
+                raise_rasd_indication(context,
+                                      RASD_IND_DELETED,
+                                      NULL,
+                                      reference,
+                                      &list);
+
+                /* try trigger indication */
+                bool ind_rc = trigger_indication(_BROKER, context,
+                                 "ComputerSystemDeletedIndication", reference);
+                if (!ind_rc) {
+                        CU_DEBUG("Unable to trigger indication for "
+                                 "system delete, dom is '%s'", dom_name);
+                }
+
+        }
+
+        virDomainFree(dom);
+        cleanup_dominfo(&dominfo);
+        inst_list_free(&list);
+
+        return rc;
+}
+
+static void destroy_system_job(struct job *job,
+                               struct job_worker *worker,
+                               void *data)
+{
+        struct vsms_job *vj = data;
+        CMPIStatus s;
+        virConnectPtr conn;
+
+        conn = job_connect(job, worker, &s);
+        if (conn == NULL) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to connect to libvirt");
+                vsms_job_set_failed(job, &s);
+                return;
+        }
+
+        if (destroy_one(job_context(job),
+                        conn,
+                        job_ref(job),
+                        vj->domain,
+                        &s) != IM_RC_OK)
+                vsms_job_set_failed(job, &s);
+        else
+                job_set_complete(job, "Completed");
+}
+
+static CMPIStatus destroy_system(CMPIMethodMI *self,
+                                 const CMPIContext *context,
+                                 const CMPIResult *results,
+                                 const CMPIObjectPath *reference,
+                                 const CMPIArgs *argsin,
+                                 CMPIArgs *argsout)
+{
+        const char *dom_name = NULL;
+        CMPIStatus status;
+        uint32_t rc = IM_RC_FAILED;
+        virConnectPtr conn = NULL;
+
+        if (async_requested(argsin)) {
+                struct vsms_job *vj;
+                char *desc = NULL;
+
+                dom_name = get_key_from_ref_arg(argsin,
+                                                "AffectedSystem",
+                                                "Name");
+                if (dom_name == NULL) {
+                        cu_statusf(_BROKER, &status,
+                                   CMPI_RC_ERR_NOT_FOUND,
+                                   "Unable to retrieve domain name");
+                        goto out;
+                }
+
+                vj = vsms_job_new(NULL, NULL, NULL, dom_name, &status);
+                if (vj == NULL)
+                        goto out;
+
+                if (asprintf(&desc, "Destroy %s", dom_name) == -1)
+                        desc = NULL;
+
+                status = start_vsms_job(context, reference,
+                                        "DestroySystem",
+                                        desc != NULL ? desc : "Destroy system",
+                                        destroy_system_job,
+                                        vj, vsms_job_free,
+                                        results, argsout);
+                free(desc);
+
+                return status;
+        }
+
+        conn = connect_by_classname(_BROKER,
+                                    CLASSNAME(reference),
+                                    &status);
+        if (conn == NULL) {
+                rc = IM_RC_NOT_SUPPORTED;
+                virt_set_status(_BROKER, &status,
+                                CMPI_RC_ERR_NOT_FOUND,
+                                conn,
+                                "Unable to connect to libvirt");
+                goto out;
+        }
+
+        dom_name = get_key_from_ref_arg(argsin, "AffectedSystem", "Name");
+        if (dom_name == NULL) {
+                virt_set_status(_BROKER, &status,
+                                CMPI_RC_ERR_NOT_FOUND,
+                                conn,
+                                "Unable to retrieve domain name");
+                goto out;
+        }
+
+        rc = destroy_one(context, conn, reference, dom_name, &status);
+
+ out:
+        virConnectClose(conn);
+        CMReturnData(results, &rc, CMPI_uint32);
+        return status;
+}
+
+/*
+ * DefineSystems and DestroySystems hand their systems to a few worker
+ * threads, "batch_workers" in libvirt-cim.conf.  Each worker keeps one
+ * connection for all the systems it handles and the results are
+ * collected per system.  An asynchronous batch already runs on one of
+ * the "batch_workers" job threads, so it handles its systems on that
+ * thread alone rather than starting more.
+ */
+struct batch_item {
+        CMPIInstance *vssd;
+        CMPIArray *res;
+        const char *name;
+
+        CMPIObjectPath *result;
+        uint32_t rc;
+        char *error;
+};
+
+struct batch {
+        const CMPIObjectPath *ref;
+        const CMPIObjectPath *refconf;
+        bool destroy;
+
+        struct batch_item *items;
+        unsigned int count;
+        unsigned int next;
+};
+
+struct batch_worker {
+        struct batch *batch;
+        CMPIContext *context;
+        CMPI_THREAD_TYPE id;
+};
+
+static void batch_item_done(struct batch_item *item,
+                            uint32_t rc,
+                            CMPIStatus *s)
+{
+        item->rc = rc;
+
+        if ((rc != CIM_SVPC_RETURN_COMPLETED) && (s->msg != NULL))
+                item->error = strdup(CMGetCharPtr(s->msg));
+}
+
+/* Handles systems until there are none left; a NULL conn fails them
+ * with conn_status
+ */
+static void batch_run(struct batch *batch,
+                      const CMPIContext *context,
+                      virConnectPtr conn,
+                      CMPIStatus *conn_status)
+{
+        CMPIStatus s;
+        unsigned int i;
+
+        while ((i = __sync_fetch_and_add(&batch->next, 1)) < batch->count) {
+                struct batch_item *item = &batch->items[i];
+                uint32_t rc;
+
+                if (conn == NULL) {
+                        batch_item_done(item, CIM_SVPC_RETURN_FAILED,
+                                        conn_status);
+                        continue;
+                }
+
+                s = (CMPIStatus){CMPI_RC_OK, NULL};
+
+                if (batch->destroy) {
+                        rc = destroy_one(context,
+                                         conn,
+                                         batch->ref,
+                                         item->name,
+                                         &s);
+                        if (rc != IM_RC_OK)
+                                rc = CIM_SVPC_RETURN_FAILED;
+                } else {
+                        CMPIObjectPath *result;
+
+                        result = define_one(context,
+                                            conn,
+                                            item->vssd,
+                                            item->res,
+                                            batch->ref,
+                                            batch->refconf,
+                                            &s);
+
+                        /* The path belongs to this thread's context,
+                         * which is gone once a worker detaches
+                         */
+                        if (result != NULL)
+                                item->result = CMClone(result, NULL);
+
+                        if (item->result != NULL)
+                                rc = CIM_SVPC_RETURN_COMPLETED;
+                        else
+                                rc = CIM_SVPC_RETURN_FAILED;
+                }
+
+                batch_item_done(item, rc, &s);
+        }
+}
+
+static void batch_connect_run(struct batch *batch,
+                              const CMPIContext *context)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        virConnectPtr conn;
+
+        conn = connect_by_classname(_BROKER, CLASSNAME(batch->ref), &s);
+        if (conn == NULL)
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Error connecting to libvirt");
+
+        batch_run(batch, context, conn, &s);
+
+        virConnectClose(conn);
+}
+
+static CMPI_THREAD_RETURN batch_thread(void *arg)
+{
+        struct batch_worker *worker = arg;
+
+        CBAttachThread(_BROKER, worker->context);
+        batch_connect_run(worker->batch, worker->context);
+        CBDetachThread(_BROKER, worker->context);
+
+        return NULL;
+}
+
+static void run_batch(const CMPIContext *context, struct batch *batch)
+{
+        struct batch_worker *workers;
+        int max;
+        int started = 0;
+        int i;
+
+        if (batch->count == 0)
+                return;
+
+        max = get_batch_workers();
+        if (max < 1)
+                max = 1;
+        if ((unsigned int)max > batch->count)
+                max = batch->count;
+
+        workers = calloc(max, sizeof(*workers));
+        if (workers == NULL)
+                max = 0;
+
+        for (i = 0; i < max; i++) {
+                workers[i].batch = batch;
+                workers[i].context = CBPrepareAttachThread(_BROKER, context);
+                workers[i].id = _BROKER->xft->newThread(batch_thread,
+                                                        &workers[i],
+                                                        0);
+                if (workers[i].id == 0) {
+                        CU_DEBUG("Failed to start batch worker %i", i);
+                        CMRelease(workers[i].context);
+                        break;
+                }
+                started++;
+        }
+
+        CU_DEBUG("Running %u systems on %i workers", batch->count, started);
+
+        /* Whatever the workers have not picked up is done here */
+        if (started == 0)
+                batch_connect_run(batch, context);
+
+        for (i = 0; i < started; i++)
+                _BROKER->xft->joinThread(workers[i].id, NULL);
+
+        free(workers);
+}
+
+static void batch_free(struct batch *batch)
+{
+        unsigned int i;
+
+        if (batch->items == NULL)
+                return;
+
+        for (i = 0; i < batch->count; i++) {
+                free(batch->items[i].error);
+                if (batch->items[i].result != NULL)
+                        CMRelease(batch->items[i].result);
+        }
+
+        free(batch->items);
+}
+
+/* Builds the Results, Errors and, for DefineSystems, ResultingSystems
+ * outputs.  Returns false if they cannot be built.
+ */
+static bool batch_outputs(struct batch *batch,
+                          CMPIArray **rcs,
+                          CMPIArray **errors,
+                          CMPIArray **systems)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        unsigned int i;
+
+        *rcs = CMNewArray(_BROKER, batch->count, CMPI_uint32, &s);
+        if ((s.rc != CMPI_RC_OK) || (*rcs == NULL))
+                return false;
+
+        *errors = CMNewArray(_BROKER, batch->count, CMPI_string, &s);
+        if ((s.rc != CMPI_RC_OK) || (*errors == NULL))
+                return false;
+
+        *systems = NULL;
+        if (!batch->destroy) {
+                *systems = CMNewArray(_BROKER, batch->count, CMPI_ref, &s);
+                if ((s.rc != CMPI_RC_OK) || (*systems == NULL))
+                        return false;
+        }
+
+        for (i = 0; i < batch->count; i++) {
+                struct batch_item *item = &batch->items[i];
+
+                CMSetArrayElementAt(*rcs, i,
+                                    (CMPIValue *)&item->rc,
+                                    CMPI_uint32);
+
+                if (item->rc != CIM_SVPC_RETURN_COMPLETED) {
+                        const char *error = item->error;
+
+                        if (error == NULL)
+                                error = "Failed";
+
+                        CMSetArrayElementAt(*errors, i,
+                                            (CMPIValue *)error,
+                                            CMPI_chars);
+                }
+
+                if ((*systems != NULL) && (item->result != NULL))
+                        CMSetArrayElementAt(*systems, i,
+                                            (CMPIValue *)&item->result,
+                                            CMPI_ref);
+        }
+
+        return true;
+}
+
+static unsigned int batch_failed(struct batch *batch)
+{
+        unsigned int failed = 0;
+        unsigned int i;
+
+        for (i = 0; i < batch->count; i++) {
+                if (batch->items[i].rc != CIM_SVPC_RETURN_COMPLETED) {
+                        CU_DEBUG("System %u failed: %s", i,
+                                 batch->items[i].error);
+                        failed++;
+                }
+        }
+
+        return failed;
+}
+
+/* Hands back the per-system results, returns true if all succeeded */
+static bool batch_results(struct batch *batch, CMPIArgs *argsout)
+{
+        CMPIArray *rcs;
+        CMPIArray *errors;
+        CMPIArray *systems;
+
+        if (!batch_outputs(batch, &rcs, &errors, &systems))
+                return false;
+
+        CMAddArg(argsout, "Results", (CMPIValue *)&rcs, CMPI_uint32A);
+        CMAddArg(argsout, "Errors", (CMPIValue *)&errors, CMPI_stringA);
+        if (systems != NULL)
+                CMAddArg(argsout, "ResultingSystems",
+                         (CMPIValue *)&systems, CMPI_refA);
+
+        return batch_failed(batch) == 0;
+}
+
+/* Records the per-system results in the job */
+static void batch_job_outputs(struct job *job, struct batch *batch)
+{
+        CMPIArray *rcs;
+        CMPIArray *errors;
+        CMPIArray *systems;
+        CMPIArray *paths;
+
+        if (!batch_outputs(batch, &rcs, &errors, &systems)) {
+                CU_DEBUG("Unable to build the outputs of job %s",
+                         job_id(job));
+                return;
+        }
+
+        job_set_output(job, "Results", (CMPIValue *)&rcs, CMPI_uint32A);
+        job_set_output(job, "Errors", (CMPIValue *)&errors, CMPI_stringA);
+
+        if (systems == NULL)
+                return;
+
+        paths = ref_strings(systems);
+        if (paths != NULL)
+                job_set_output(job, "ResultingSystems",
+                               (CMPIValue *)&paths, CMPI_stringA);
+}
+
+static void batch_job_free(void *data)
+{
+        struct batch *batch = data;
+        unsigned int i;
+
+        for (i = 0; i < batch->count; i++) {
+                if (batch->items[i].vssd != NULL)
+                        CMRelease(batch->items[i].vssd);
+                if (batch->items[i].res != NULL)
+                        CMRelease(batch->items[i].res);
+                free((char *)batch->items[i].name);
+        }
+
+        if (batch->refconf != NULL)
+                CMRelease((CMPIObjectPath *)batch->refconf);
+
+        batch_free(batch);
+        free(batch);
+}
+
+static void batch_job(struct job *job, struct job_worker *worker, void *data)
+{
+        struct batch *batch = data;
+        CMPIStatus s;
+        virConnectPtr conn;
+        unsigned int failed;
+        char *msg = NULL;
+
+        batch->ref = job_ref(job);
+
+        conn = job_connect(job, worker, &s);
+        if (conn == NULL)
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Error connecting to libvirt");
+
+        batch_run(batch, job_context(job), conn, &s);
+
+        batch_job_outputs(job, batch);
+
+        failed = batch_failed(batch);
+        if (failed == 0) {
+                job_set_complete(job, "Completed");
+                return;
+        }
+
+        if (asprintf(&msg, "%u of %u systems failed",
+                     failed, batch->count) == -1)
+                msg = NULL;
+
+        job_set_failed(job, CMPI_RC_ERR_FAILED,
+                       msg != NULL ? msg : "Failed");
+        free(msg);
+}
+
+/* Copies the request objects of a batch and runs it as a job */
+static CMPIStatus start_batch_job(const CMPIContext *context,
+                                  const CMPIObjectPath *reference,
+                                  struct batch *batch,
+                                  const CMPIResult *results,
+                                  CMPIArgs *argsout)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        struct batch *copy;
+        unsigned int i;
+        char *desc = NULL;
+
+        copy = calloc(1, sizeof(*copy));
+        if (copy == NULL)
+                goto err;
+
+        *copy = *batch;
+        copy->items = calloc(batch->count, sizeof(*copy->items));
+        if (copy->items == NULL)
+                goto err;
+
+        copy->refconf = NULL;
+        if (batch->refconf != NULL) {
+                copy->refconf = CMClone(batch->refconf, &s);
+                if (copy->refconf == NULL)
+                        goto err;
+        }
+
+        for (i = 0; i < batch->count; i++) {
+                struct batch_item *from = &batch->items[i];
+                struct batch_item *to = &copy->items[i];
+
+                if (from->vssd != NULL) {
+                        to->vssd = CMClone(from->vssd, &s);
+                        if (to->vssd == NULL)
+                                goto err;
+                }
+
+                if (from->res != NULL) {
+                        to->res = CMClone(from->res, &s);
+                        if (to->res == NULL)
+                                goto err;
+                }
+
+                if (from->name != NULL) {
+                        to->name = strdup(from->name);
+                        if (to->name == NULL)
+                                goto err;
+                }
+        }
+
+        if (asprintf(&desc, "%s %u systems",
+                     batch->destroy ? "Destroy" : "Define",
+                     batch->count) == -1)
+                desc = NULL;
+
+        s = start_vsms_job(context, reference,
+                           batch->destroy ? "DestroySystems" : "DefineSystems",
+                           desc != NULL ? desc : "Batch",
+                           batch_job,
+                           copy, batch_job_free,
+                           results, argsout);
+        free(desc);
+
+        return s;
+ err:
+        if (copy != NULL) {
+                if (copy->items == NULL)
+                        free(copy);
+                else
+                        batch_job_free(copy);
+        }
+
+        cu_statusf(_BROKER, &s,
+                   CMPI_RC_ERR_FAILED,
+                   "Unable to create job");
+
+        return s;
+}
+
+static CMPIStatus define_systems_split(const CMPIArgs *argsin,
+                                       struct batch *batch)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIArray *vssds;
+        CMPIArray *res;
+        CMPIArray *counts;
+        CMPICount total;
+        CMPICount used = 0;
+        unsigned int i;
+
+        if ((cu_get_array_arg(argsin, "SystemSettings", &vssds) !=
+             CMPI_RC_OK) ||
+            (cu_get_array_arg(argsin, "ResourceSettings", &res) !=
+             CMPI_RC_OK) ||
+            (cu_get_array_arg(argsin, "ResourceCounts", &counts) !=
+             CMPI_RC_OK)) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_INVALID_PARAMETER,
+                           "Missing argument `SystemSettings', "
+                           "`ResourceSettings' or `ResourceCounts'");
+                return s;
+        }
+
+        batch->count = CMGetArrayCount(vssds, NULL);
+        if ((batch->count == 0) ||
+            (CMGetArrayCount(counts, NULL) != batch->count)) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_INVALID_PARAMETER,
+                           "ResourceCounts must have one element for "
+                           "each of the SystemSettings");
+                return s;
+        }
+
+        batch->items = calloc(batch->count, sizeof(*batch->items));
+        if (batch->items == NULL) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Failed to allocate memory");
+                return s;
+        }
+
+        total = CMGetArrayCount(res, NULL);
+
+        for (i = 0; i < batch->count; i++) {
+                struct batch_item *item = &batch->items[i];
+                CMPIData vssd = CMGetArrayElementAt(vssds, i, NULL);
+                CMPIData count = CMGetArrayElementAt(counts, i, NULL);
+                CMPICount j;
+
+                if (CMIsNullValue(vssd) || CMIsNullValue(count) ||
+                    (count.value.uint32 > total - used)) {
+                        cu_statusf(_BROKER, &s,
+                                   CMPI_RC_ERR_INVALID_PARAMETER,
+                                   "Invalid SystemSettings[%u] or "
+                                   "ResourceCounts[%u]", i, i);
+                        return s;
+                }
+
+                item->vssd = vssd.value.inst;
+                item->res = CMNewArray(_BROKER,
+                                       count.value.uint32,
+                                       CMPI_instance,
+                                       &s);
+                if ((s.rc != CMPI_RC_OK) || (item->res == NULL))
+                        return s;
+
+                for (j = 0; j < count.value.uint32; j++) {
+                        CMPIData rasd = CMGetArrayElementAt(res, used++, NULL);
+
+                        CMSetArrayElementAt(item->res, j,
+                                            &rasd.value,
+                                            rasd.type);
+                }
+        }
+
+        if (used != total)
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_INVALID_PARAMETER,
+                           "ResourceCounts does not add up to the number "
+                           "of ResourceSettings");
+
+        return s;
+}
+
+static CMPIStatus define_systems(CMPIMethodMI *self,
                                  const CMPIContext *context,
                                  const CMPIResult *results,
                                  const CMPIObjectPath *reference,
                                  const CMPIArgs *argsin,
                                  CMPIArgs *argsout)
 {
-        const char *dom_name = NULL;
-        CMPIStatus status;
-        uint32_t rc = IM_RC_FAILED;
-        CMPIObjectPath *sys;
-        virConnectPtr conn = NULL;
-        virDomainPtr dom = NULL;
-        struct inst_list list;
-        const char *props[] = {NULL};
+        CMPIStatus s;
+        struct batch batch;
+        CMPIObjectPath *refconf = NULL;
+        uint32_t rc = CIM_SVPC_RETURN_FAILED;
 
-        inst_list_init(&list);
-        conn = connect_by_classname(_BROKER,
-                                    CLASSNAME(reference),
-                                    &status);
-        if (conn == NULL) {
-                rc = IM_RC_NOT_SUPPORTED;
-                goto error;
-        }
+        CU_DEBUG("DefineSystems");
 
-        if (cu_get_ref_arg(argsin, "AffectedSystem", &sys) != CMPI_RC_OK)
-                goto error;
+        memset(&batch, 0, sizeof(batch));
+        batch.ref = reference;
 
-        dom_name = get_key_from_ref_arg(argsin, "AffectedSystem", "Name");
-        if (dom_name == NULL)
-                goto error;
+        if (cu_get_ref_arg(argsin, "ReferenceConfiguration", &refconf) !=
+            CMPI_RC_OK)
+                refconf = NULL;
+        batch.refconf = refconf;
+
+        s = define_systems_split(argsin, &batch);
+        if (s.rc != CMPI_RC_OK)
+                goto out;
 
-        status = enum_rasds(_BROKER,
-                            reference,
-                            dom_name,
-                            CIM_RES_TYPE_ALL,
-                            props,
-                            &list);
+        if (async_requested(argsin)) {
+                s = start_batch_job(context, reference, &batch,
+                                    results, argsout);
+                batch_free(&batch);
 
-        if (status.rc != CMPI_RC_OK) {
-                CU_DEBUG("Failed to enumerate rasd");
-                goto error;
+                return s;
         }
 
-        dom = virDomainLookupByName(conn, dom_name);
-        if (dom == NULL) {
-                CU_DEBUG("No such domain `%s'", dom_name);
-                rc = IM_RC_SYS_NOT_FOUND;
-                goto error;
-        }
+        run_batch(context, &batch);
 
-        infostore_delete(virConnectGetType(conn), dom_name);
+        if (batch_results(&batch, argsout))
+                rc = CIM_SVPC_RETURN_COMPLETED;
 
-        virDomainDestroy(dom); /* Okay for this to fail */
+ out:
+        batch_free(&batch);
+        CMReturnData(results, &rc, CMPI_uint32);
 
-        virDomainFree(dom);
+        return s;
+}
 
-        dom = virDomainLookupByName(conn, dom_name);
-        if (dom == NULL) {
-                CU_DEBUG("Domain successfully destroyed");
-                rc = IM_RC_OK;
-                goto error;
+static CMPIStatus destroy_systems(CMPIMethodMI *self,
+                                  const CMPIContext *context,
+                                  const CMPIResult *results,
+                                  const CMPIObjectPath *reference,
+                                  const CMPIArgs *argsin,
+                                  CMPIArgs *argsout)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        struct batch batch;
+        CMPIArray *systems;
+        uint32_t rc = CIM_SVPC_RETURN_FAILED;
+        unsigned int i;
+
+        CU_DEBUG("DestroySystems");
+
+        memset(&batch, 0, sizeof(batch));
+        batch.ref = reference;
+        batch.destroy = true;
+
+        if (cu_get_array_arg(argsin, "AffectedSystems", &systems) !=
+            CMPI_RC_OK) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_INVALID_PARAMETER,
+                           "Missing argument `AffectedSystems'");
+                goto out;
         }
 
-        if (virDomainUndefine(dom) == 0) {
-                CU_DEBUG("Domain successfully destroyed and undefined");
-                rc = IM_RC_OK;
+        batch.count = CMGetArrayCount(systems, NULL);
+        if (batch.count == 0) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_INVALID_PARAMETER,
+                           "AffectedSystems is empty");
+                goto out;
         }
 
-error:
-        if (rc == IM_RC_SYS_NOT_FOUND)
-                virt_set_status(_BROKER,
-                                &status,
-                                CMPI_RC_ERR_NOT_FOUND,
-                                conn,
-                                "Referenced domain `%s' does not exist",
-                                dom_name);
-        else if (rc == IM_RC_NOT_SUPPORTED)
-                virt_set_status(_BROKER, &status,
-                                CMPI_RC_ERR_NOT_FOUND,
-                                conn,
-                                "Unable to connect to libvirt");
-        else if (rc == IM_RC_FAILED)
-                virt_set_status(_BROKER, &status,
-                                CMPI_RC_ERR_NOT_FOUND,
-                                conn,
-                                "Unable to retrieve domain name");
-        else if (rc == IM_RC_OK) {
-                status = (CMPIStatus){CMPI_RC_OK, NULL};
-                raise_rasd_indication(context,
-                                      RASD_IND_DELETED,
-                                      NULL,
-                                      reference,
-                                      &list);
+        batch.items = calloc(batch.count, sizeof(*batch.items));
+        if (batch.items == NULL) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Failed to allocate memory");
+                goto out;
+        }
 
-                /* try trigger indication */
-                bool ind_rc = trigger_indication(_BROKER, context,
-                                 "ComputerSystemDeletedIndication", reference);
-                if (!ind_rc) {
-                        CU_DEBUG("Unable to trigger indication for "
-                                 "system delete, dom is '%s'", dom_name);
+        for (i = 0; i < batch.count; i++) {
+                CMPIData item = CMGetArrayElementAt(systems, i, NULL);
+
+                if (CMIsNullObject(item.value.ref) ||
+                    (cu_get_str_path(item.value.ref,
+                                     "Name",
+                                     &batch.items[i].name) != CMPI_RC_OK)) {
+                        cu_statusf(_BROKER, &s,
+                                   CMPI_RC_ERR_INVALID_PARAMETER,
+                                   "Missing Name property of "
+                                   "AffectedSystems[%u]", i);
+                        goto out;
                 }
+        }
+
+        if (async_requested(argsin)) {
+                s = start_batch_job(context, reference, &batch,
+                                    results, argsout);
+                batch_free(&batch);
 
+                return s;
         }
 
-        virDomainFree(dom);
-        virConnectClose(conn);
+        run_batch(context, &batch);
+
+        if (batch_results(&batch, argsout))
+                rc = CIM_SVPC_RETURN_COMPLETED;
+
+ out:
+        batch_free(&batch);
         CMReturnData(results, &rc, CMPI_uint32);
-        inst_list_free(&list);
-        return status;
+
+        return s;
+}
+
+static bool autostart_changed(CMPIInstance *vssd, virDomainPtr dom)
+{
+        uint16_t val;
+        int cur;
+
+        if (cu_get_u16_prop(vssd, "AutoStart", &val) != CMPI_RC_OK)
+                return false;
+
+        if (virDomainGetAutostart(dom, &cur) != 0)
+                return true;
+
+        return (cur != 0) != (val != 0);
 }
 
 static CMPIStatus update_system_settings(const CMPIContext *context,
@@ -2856,6 +3819,7 @@ static CMPIStatus update_system_settings(const CMPIContext *context,
         virDomainPtr dom = NULL;
         struct domain *dominfo = NULL;
         char *xml = NULL;
+        char *orig_xml = NULL;
         char *uuid = NULL;
 
         CU_DEBUG("Enter update_system_settings");
@@ -2890,6 +3854,7 @@ static CMPIStatus update_system_settings(const CMPIContext *context,
         }
 
         uuid = strdup(dominfo->uuid);
+        orig_xml = system_to_xml(dominfo);
 
         if (!vssd_to_domain(vssd, dominfo)) {
                 cu_statusf(_BROKER, &s,
@@ -2914,13 +3879,24 @@ static CMPIStatus update_system_settings(const CMPIContext *context,
         }
 
         xml = system_to_xml(dominfo);
-        if (xml != NULL) {
+        if ((xml != NULL) && (orig_xml != NULL) && STREQ(xml, orig_xml)) {
+                if (!autostart_changed(vssd, dom)) {
+                        CU_DEBUG("Settings of `%s' unchanged, not redefining",
+                                 name);
+                        cu_statusf(_BROKER, &s, CMPI_RC_OK, "");
+                        goto out;
+                }
+        } else if (xml != NULL) {
+                virDomainPtr new_dom;
+
                 CU_DEBUG("New XML is:\n%s", xml);
-                connect_and_create(xml, ref, &s);
+                new_dom = define_domain(conn, xml, &s);
+                virDomainFree(new_dom);
         }
 
         if (s.rc == CMPI_RC_OK) {
-                set_autostart(vssd, ref, dom);
+                /* Same UUID, so dom still refers to the redefined guest */
+                set_autostart(vssd, dom, dom);
                 /* try trigger indication */
                 bool ind_rc = trigger_indication(_BROKER, context,
                                       "ComputerSystemModifiedIndication", ref);
@@ -2934,6 +3910,7 @@ static CMPIStatus update_system_settings(const CMPIContext *context,
  out:
         free(uuid);
         free(xml);
+        free(orig_xml);
         virDomainFree(dom);
         virConnectClose(conn);
         cleanup_dominfo(&dominfo);
@@ -2977,7 +3954,8 @@ typedef CMPIStatus (*resmod_fn)(struct domain *,
                                 CMPIInstance *,
                                 uint16_t,
                                 const char *,
-                                const char*);
+                                const char *,
+                                bool *);
 
 static struct virt_device **find_list(struct domain *dominfo,
                                       uint16_t type,
@@ -3089,7 +4067,8 @@ static CMPIStatus resource_del(struct domain *dominfo,
                                CMPIInstance *rasd,
                                uint16_t type,
                                const char *devid,
-                               const char *ns)
+                               const char *ns,
+                               bool *changed)
 {
         CMPIStatus s;
         CMPIObjectPath *op;
@@ -3153,7 +4132,8 @@ static CMPIStatus resource_add(struct domain *dominfo,
                                CMPIInstance *rasd,
                                uint16_t type,
                                const char *devid,
-                               const char *ns)
+                               const char *ns,
+                               bool *changed)
 {
         CMPIStatus s;
         CMPIObjectPath *op;
@@ -3245,12 +4225,14 @@ static CMPIStatus resource_mod(struct domain *dominfo,
                                CMPIInstance *rasd,
                                uint16_t type,
                                const char *devid,
-                               const char *ns)
+                               const char *ns,
+                               bool *changed)
 {
         CMPIStatus s;
         CMPIObjectPath *op;
         struct virt_device **_list;
         struct virt_device *list;
+        struct virt_device *prev = NULL;
         int *count;
         int i;
         const char *msg = NULL;
@@ -3286,6 +4268,8 @@ static CMPIStatus resource_mod(struct domain *dominfo,
                 struct virt_device *dev = &list[i];
 
                 if (STREQ(dev->id, devid)) {
+                        prev = virt_device_dup(dev);
+
                         msg = rasd_to_vdev(rasd, dominfo, dev, ns, &error_msg);
                         if (msg != NULL) {
                                 cu_statusf(_BROKER, &s,
@@ -3295,6 +4279,14 @@ static CMPIStatus resource_mod(struct domain *dominfo,
                                 goto out;
                         }
 
+                        /* Nothing to hot-plug or redefine */
+                        if ((prev != NULL) && virt_device_equal(prev, dev)) {
+                                CU_DEBUG("Device `%s' unchanged", devid);
+                                *changed = false;
+                                cu_statusf(_BROKER, &s, CMPI_RC_OK, "");
+                                break;
+                        }
+
                         if ((type == CIM_RES_TYPE_GRAPHICS) ||
                             (type == CIM_RES_TYPE_INPUT)    ||
                             (type == CIM_RES_TYPE_CONSOLE))
@@ -3317,8 +4309,7 @@ static CMPIStatus resource_mod(struct domain *dominfo,
                                     (cu_get_u64_prop(rasd, "Reservation", &qos_val) == CMPI_RC_OK) &&
                                     (cu_get_str_prop(rasd, "AllocationUnits", &qos_unitstr) == CMPI_RC_OK) &&
                                     STREQ(qos_unitstr,"KiloBits per Second")) {
-                                        remove_qos_for_mac(qos_val,
-                                                           dev->dev.net.mac,
+                                        remove_qos_for_mac(dev->dev.net.mac,
                                                            dev->dev.net.source);
                                         s = add_qos_for_mac(qos_val,
                                                             dev->dev.net.mac,
@@ -3332,6 +4323,7 @@ static CMPIStatus resource_mod(struct domain *dominfo,
 
  out:
         free(error_msg);
+        cleanup_virt_devices(&prev, 1);
 
         return s;
 }
@@ -3347,6 +4339,8 @@ static CMPIStatus _update_resources_for(const CMPIContext *context,
         struct domain *dominfo = NULL;
         uint16_t type;
         char *xml = NULL;
+        char *orig_xml = NULL;
+        bool changed = true;
         const char *indication;
         CMPIObjectPath *op;
         struct inst_list list;
@@ -3411,18 +4405,37 @@ static CMPIStatus _update_resources_for(const CMPIContext *context,
                 }
                 rasd = orig_inst;
 
+                orig_xml = system_to_xml(dominfo);
         }
 
-        s = func(dominfo, rasd, type, devid, NAMESPACE(ref));
+        s = func(dominfo, rasd, type, devid, NAMESPACE(ref), &changed);
         if (s.rc != CMPI_RC_OK) {
                 CU_DEBUG("Resource transform function failed");
                 goto out;
         }
 
+        if (!changed) {
+                CU_DEBUG("Resource `%s' unchanged, not redefining", devid);
+                goto out;
+        }
+
         xml = system_to_xml(dominfo);
         if (xml != NULL) {
-                CU_DEBUG("New XML:\n%s", xml);
-                connect_and_create(xml, ref, &s);
+                /* Settings such as the VCPU limit only live in the
+                 * infostore, so the definition itself may be unchanged
+                 */
+                if ((orig_xml != NULL) && STREQ(xml, orig_xml)) {
+                        CU_DEBUG("Definition of `%s' unchanged",
+                                 dominfo->name);
+                } else {
+                        virDomainPtr new_dom;
+
+                        CU_DEBUG("New XML:\n%s", xml);
+                        new_dom = define_domain(virDomainGetConnect(dom),
+                                                xml,
+                                                &s);
+                        virDomainFree(new_dom);
+                }
 
                 if (inst_list_add(&list, rasd) == 0) {
                         CU_DEBUG("Unable to add RASD instance to the list\n");
@@ -3442,6 +4455,7 @@ static CMPIStatus _update_resources_for(const CMPIContext *context,
  out:
         cleanup_dominfo(&dominfo);
         free(xml);
+        free(orig_xml);
         inst_list_free(&list);
 
         return s;
@@ -3471,28 +4485,19 @@ static CMPIStatus get_instanceid(CMPIInstance *rasd,
         return s;
 }
 
-static CMPIStatus _update_resource_settings(const CMPIContext *context,
-                                            const CMPIObjectPath *ref,
-                                            const char *domain,
-                                            CMPIArray *resources,
-                                            const CMPIResult *results,
-                                            resmod_fn func,
-                                            struct inst_list *list)
+static CMPIStatus update_resource_settings(const CMPIContext *context,
+                                           virConnectPtr conn,
+                                           const CMPIObjectPath *ref,
+                                           const char *domain,
+                                           CMPIArray *resources,
+                                           resmod_fn func,
+                                           struct inst_list *list)
 {
         int i;
-        virConnectPtr conn = NULL;
-        CMPIStatus s;
+        CMPIStatus s = {CMPI_RC_OK, NULL};
         int count;
-        uint32_t rc = CIM_SVPC_RETURN_FAILED;
 
-        CU_DEBUG("Enter _update_resource_settings");
-        conn = connect_by_classname(_BROKER, CLASSNAME(ref), &s);
-        if (conn == NULL) {
-                cu_statusf(_BROKER, &s,
-                           CMPI_RC_ERR_FAILED,
-                           "Unable to connect to hypervisor");
-                goto out;
-        }
+        CU_DEBUG("Enter update_resource_settings");
 
         count = CMGetArrayCount(resources, NULL);
 
@@ -3546,6 +4551,32 @@ static CMPIStatus _update_resource_settings(const CMPIContext *context,
 
                 inst_list_add(list, inst);
         }
+
+        return s;
+}
+
+static CMPIStatus _update_resource_settings(const CMPIContext *context,
+                                            const CMPIObjectPath *ref,
+                                            const char *domain,
+                                            CMPIArray *resources,
+                                            const CMPIResult *results,
+                                            resmod_fn func,
+                                            struct inst_list *list)
+{
+        virConnectPtr conn = NULL;
+        CMPIStatus s;
+        uint32_t rc = CIM_SVPC_RETURN_FAILED;
+
+        conn = connect_by_classname(_BROKER, CLASSNAME(ref), &s);
+        if (conn == NULL) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to connect to hypervisor");
+                goto out;
+        }
+
+        s = update_resource_settings(context, conn, ref, domain,
+                                     resources, func, list);
  out:
         if (s.rc == CMPI_RC_OK)
                 rc = CIM_SVPC_RETURN_COMPLETED;
@@ -3660,6 +4691,52 @@ static CMPIArray *set_result_res(struct inst_list *list,
          return res;
 }
 
+static void add_resource_settings_job(struct job *job,
+                                      struct job_worker *worker,
+                                      void *data)
+{
+        struct vsms_job *vj = data;
+        CMPIStatus s;
+        struct inst_list list;
+        virConnectPtr conn;
+
+        inst_list_init(&list);
+
+        conn = job_connect(job, worker, &s);
+        if (conn == NULL) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to connect to hypervisor");
+                vsms_job_set_failed(job, &s);
+                return;
+        }
+
+        s = update_resource_settings(job_context(job),
+                                     conn,
+                                     job_ref(job),
+                                     vj->domain,
+                                     vj->res,
+                                     resource_add,
+                                     &list);
+        if (s.rc != CMPI_RC_OK) {
+                vsms_job_set_failed(job, &s);
+        } else {
+                CMPIArray *res;
+                CMPIArray *paths = NULL;
+
+                res = set_result_res(&list, NAMESPACE(job_ref(job)));
+                if (res != NULL)
+                        paths = ref_strings(res);
+                if (paths != NULL)
+                        job_set_output(job, "ResultingResourceSettings",
+                                       (CMPIValue *)&paths, CMPI_stringA);
+
+                job_set_complete(job, "Completed");
+        }
+
+        inst_list_free(&list);
+}
+
 static CMPIStatus add_resource_settings(CMPIMethodMI *self,
                                         const CMPIContext *context,
                                         const CMPIResult *results,
@@ -3699,6 +4776,31 @@ static CMPIStatus add_resource_settings(CMPIMethodMI *self,
                 return s;
         }
 
+        if (async_requested(argsin)) {
+                struct vsms_job *vj;
+                char *desc = NULL;
+
+                vj = vsms_job_new(NULL, arr, NULL, domain, &s);
+                if (vj != NULL) {
+                        if (asprintf(&desc, "Add resources to %s",
+                                     domain) == -1)
+                                desc = NULL;
+
+                        s = start_vsms_job(context, reference,
+                                           "AddResourceSettings",
+                                           desc != NULL ? desc :
+                                           "Add resources",
+                                           add_resource_settings_job,
+                                           vj, vsms_job_free,
+                                           results, argsout);
+                        free(desc);
+                }
+
+                free(domain);
+
+                return s;
+        }
+
         s = _update_resource_settings(context,
                                       reference,
                                       domain,
@@ -3805,6 +4907,7 @@ static struct method_handler DefineSystem = {
         .args = {{"SystemSettings", CMPI_instance, false},
                  {"ResourceSettings", CMPI_instanceA, false},
                  {"ReferenceConfiguration", CMPI_ref, true},
+                 {"Asynchronous", CMPI_boolean, true},
                  ARG_END
         }
 };
@@ -3813,6 +4916,28 @@ static struct method_handler DestroySystem = {
         .name = "DestroySystem",
         .handler = destroy_system,
         .args = {{"AffectedSystem", CMPI_ref, false},
+                 {"Asynchronous", CMPI_boolean, true},
+                 ARG_END
+        }
+};
+
+static struct method_handler DefineSystems = {
+        .name = "DefineSystems",
+        .handler = define_systems,
+        .args = {{"SystemSettings", CMPI_instanceA, false},
+                 {"ResourceSettings", CMPI_instanceA, false},
+                 {"ResourceCounts", CMPI_uint32A, false},
+                 {"ReferenceConfiguration", CMPI_ref, true},
+                 {"Asynchronous", CMPI_boolean, true},
+                 ARG_END
+        }
+};
+
+static struct method_handler DestroySystems = {
+        .name = "DestroySystems",
+        .handler = destroy_systems,
+        .args = {{"AffectedSystems", CMPI_refA, false},
+                 {"Asynchronous", CMPI_boolean, true},
                  ARG_END
         }
 };
@@ -3822,6 +4947,7 @@ static struct method_handler AddResourceSettings = {
         .handler = add_resource_settings,
         .args = {{"AffectedConfiguration", CMPI_ref, false},
                  {"ResourceSettings", CMPI_instanceA, false},
+                 {"Asynchronous", CMPI_boolean, true},
                  ARG_END
         }
 };
@@ -3853,6 +4979,8 @@ static struct method_handler RemoveResourceSettings = {
 static struct method_handler *my_handlers[] = {
         &DefineSystem,
         &DestroySystem,
+        &DefineSystems,
+        &DestroySystems,
         &AddResourceSettings,
         &ModifyResourceSettings,
         &ModifySystemSettings,
@@ -3860,7 +4988,7 @@ static struct method_handler *my_handlers[] = {
         NULL,
 };
 
-STDIM_MethodMIStub(, Virt_VirtualSystemManagementService,
+STATS_MethodMIStub(, Virt_VirtualSystemManagementService,
                    _BROKER, libvirt_cim_init(), my_handlers);
 
 CMPIStatus get_vsms(const CMPIObjectPath *reference,
@@ -3919,7 +5047,7 @@ CMPIStatus get_vsms(const CMPIObjectPath *reference,
                 goto out;
         }
 
-        hv_type = virConnectGetType(conn);
+        hv_type = type_from_conn(conn);
         if (hv_type == NULL)
                 hv_type = "Unkown";
 
@@ -4065,10 +5193,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
-                   Virt_VirtualSystemManagementService,
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_VirtualSystemManagementService,
+                     _BROKER,
+                     libvirt_cim_init());
 
 
 /*
@@ -23,8 +23,8 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdbool.h>
-
-#include <uuid.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <cmpidt.h>
 #include <cmpift.h>
@@ -35,131 +35,151 @@
 #include <libcmpiutil/std_instance.h>
 
 #include "misc_util.h"
+#include "job_util.h"
 
 #include "Virt_VirtualSystemSnapshotService.h"
 #include "Virt_HostSystem.h"
 #include "Virt_VSSD.h"
 
-#define CIM_JOBSTATE_STARTING 3
-#define CIM_JOBSTATE_RUNNING 4
-#define CIM_JOBSTATE_COMPLETE 7
-
 #define CIM_RETURN_COMPLETED 0
 #define CIM_RETURN_FAILED 2
 
+/* Seconds between samples of the libvirt job stats during a save */
+#define SNAP_PROGRESS_INTERVAL 2
+
 static const CMPIBroker *_BROKER;
 
 struct snap_context {
-        CMPIContext *context;
         char *domain;
-        char uuid[VIR_UUID_STRING_BUFLEN];
         char *save_path;
-        char *ref_ns;
-        char *ref_cn;
 
         bool save;
         bool restore;
 };
 
-static void snap_job_free(struct snap_context *ctx)
+struct snap_save_op {
+        virDomainPtr dom;
+        const char *path;
+        int ret;
+        bool done;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+};
+
+/* Saves are bound by the bandwidth of the disk holding the save images,
+ * so only a few snapshot jobs, "snapshot_workers" in libvirt-cim.conf,
+ * are run at once.  Jobs beyond that stay "Queued" until one of the
+ * workers picks them up.
+ */
+static struct job_queue snap_queue =
+        JOB_QUEUE_INITIALIZER("Snapshot", get_snapshot_workers);
+
+static void snap_context_free(void *data)
 {
+        struct snap_context *ctx = data;
+
         if (ctx == NULL)
                 return;
 
         free(ctx->domain);
         free(ctx->save_path);
-        free(ctx->ref_ns);
-        free(ctx->ref_cn);
         free(ctx);
 }
 
-static void _snap_job_set_status(struct snap_context *ctx,
-                                 uint16_t state,
-                                 const char *status,
-                                 uint16_t errcode,
-                                 const char *errdesc)
+static void *save_thread(void *arg)
 {
-        CMPIInstance *inst;
-        CMPIStatus s;
-        CMPIObjectPath *op;
-        char *desc = NULL;
+        struct snap_save_op *op = arg;
         int ret;
 
-        op = CMNewObjectPath(_BROKER,
-                             ctx->ref_ns,
-                             "CIM_ConcreteJob",
-                             &s);
-        if (s.rc != CMPI_RC_OK) {
-                CU_DEBUG("Failed to create job path for update");
+        ret = virDomainSave(op->dom, op->path);
+
+        pthread_mutex_lock(&op->lock);
+        op->ret = ret;
+        op->done = true;
+        pthread_cond_signal(&op->cond);
+        pthread_mutex_unlock(&op->lock);
+
+        return NULL;
+}
+
+static void sample_save_progress(struct job *job,
+                                 virDomainPtr dom,
+                                 uint16_t *last)
+{
+        virDomainJobInfo info;
+        uint16_t percent;
+
+        if (virDomainGetJobInfo(dom, &info) != 0)
+                return;
+
+        if ((info.type != VIR_DOMAIN_JOB_BOUNDED) || (info.dataTotal == 0))
                 return;
-        }
 
-        CMAddKey(op, "InstanceID", (CMPIValue *)ctx->uuid, CMPI_chars);
+        percent = (uint16_t)((info.dataProcessed * 100) / info.dataTotal);
+        if (percent >= 100)
+                percent = 99;
 
-        inst = CBGetInstance(_BROKER, ctx->context, op, NULL, &s);
-        if ((inst == NULL) || (s.rc != CMPI_RC_OK)) {
-                CU_DEBUG("Failed to get job instance for update of %s",
-                         ctx->uuid);
+        if (percent == *last)
                 return;
-        }
 
-        CMSetProperty(inst, "JobState",
-                      (CMPIValue *)&state, CMPI_uint16);
-        CMSetProperty(inst, "Status",
-                      (CMPIValue *)status, CMPI_chars);
+        job_set_percent(job, percent);
+        *last = percent;
+}
 
-        ret = asprintf(&desc,
-                       "%s of %s (%s)",
-                       ctx->save ? "Snapshot" : "Restore",
-                       ctx->domain,
-                       ctx->save_path);
-        if (ret != -1) {
-                CMSetProperty(inst, "Description",
-                              (CMPIValue *)desc, CMPI_chars);
-                free(desc);
-        }
+/* Run virDomainSave() in a helper thread so that this (CIMOM attached)
+ * thread can copy the libvirt job progress onto the ConcreteJob while
+ * the save is in flight.
+ */
+static int save_with_progress(struct job *job,
+                              struct snap_context *ctx,
+                              virDomainPtr dom)
+{
+        struct snap_save_op op;
+        pthread_t id;
+        uint16_t last = 0;
+        int ret;
 
-        if ((errcode != 0) && (errdesc != NULL)) {
-                CMSetProperty(inst, "ErrorCode",
-                              (CMPIValue *)&errcode, CMPI_uint16);
-                CMSetProperty(inst, "ErrorDescription",
-                              (CMPIValue *)errdesc, CMPI_chars);
+        op.dom = dom;
+        op.path = ctx->save_path;
+        op.ret = -1;
+        op.done = false;
+        pthread_mutex_init(&op.lock, NULL);
+        pthread_cond_init(&op.cond, NULL);
 
-                CU_DEBUG("Set error properties to %i:%s",
-                         errcode,
-                         errdesc);
+        if (pthread_create(&id, NULL, save_thread, &op) != 0) {
+                CU_DEBUG("Unable to start save thread, saving inline");
+                ret = virDomainSave(dom, ctx->save_path);
+                goto out;
         }
 
-        s = CBModifyInstance(_BROKER, ctx->context, op, inst, NULL);
-        if (s.rc != CMPI_RC_OK) {
-                CU_DEBUG("Failed to update job instance %s: %s",
-                         ctx->uuid,
-                         CMGetCharPtr(s.msg));
-                return;
+        pthread_mutex_lock(&op.lock);
+        while (!op.done) {
+                struct timespec ts;
+
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_sec += SNAP_PROGRESS_INTERVAL;
+
+                if (pthread_cond_timedwait(&op.cond, &op.lock, &ts) == 0)
+                        continue;
+
+                pthread_mutex_unlock(&op.lock);
+                sample_save_progress(job, dom, &last);
+                pthread_mutex_lock(&op.lock);
         }
+        pthread_mutex_unlock(&op.lock);
 
-        CU_DEBUG("Set %s status to %i:%s", ctx->uuid, state, status);
-}
+        pthread_join(id, NULL);
+        ret = op.ret;
 
-static void snap_job_set_status(struct snap_context *ctx,
-                                uint16_t state,
-                                const char *status)
-{
-        _snap_job_set_status(ctx, state, status, 0, NULL);
-}
+ out:
+        pthread_cond_destroy(&op.cond);
+        pthread_mutex_destroy(&op.lock);
 
-static void snap_job_set_failed(struct snap_context *ctx,
-                                uint16_t errcode,
-                                const char *errdesc)
-{
-        _snap_job_set_status(ctx,
-                             CIM_JOBSTATE_COMPLETE,
-                             "Failed",
-                             errcode,
-                             errdesc);
+        return ret;
 }
 
-static void do_snapshot(struct snap_context *ctx,
+static void do_snapshot(struct job *job,
+                        struct snap_context *ctx,
                         virConnectPtr conn,
                         virDomainPtr dom)
 {
@@ -168,19 +188,19 @@ static void do_snapshot(struct snap_context *ctx,
         if (ctx->save) {
                 CU_DEBUG("Starting save to %s", ctx->save_path);
 
-                ret = virDomainSave(dom, ctx->save_path);
+                ret = save_with_progress(job, ctx, dom);
                 if (ret == -1) {
                         CU_DEBUG("Save failed");
-                        snap_job_set_failed(ctx,
-                                            VIR_VSSS_ERR_SAVE_FAILED,
-                                            "Save failed");
+                        job_set_failed(job,
+                                       VIR_VSSS_ERR_SAVE_FAILED,
+                                       "Save failed");
                         return;
                 }
 
                 CU_DEBUG("Save completed");
-                snap_job_set_status(ctx,
-                                    CIM_JOBSTATE_RUNNING,
-                                    "Save finished");
+                job_set_status(job,
+                               CIM_JOBSTATE_RUNNING,
+                               "Save finished");
         }
 
         if (ctx->restore) {
@@ -189,16 +209,16 @@ static void do_snapshot(struct snap_context *ctx,
                 ret = virDomainRestore(conn, ctx->save_path);
                 if (ret == -1) {
                         CU_DEBUG("Restore failed");
-                        snap_job_set_failed(ctx,
-                                            VIR_VSSS_ERR_REST_FAILED,
-                                            "Restore failed");
+                        job_set_failed(job,
+                                       VIR_VSSS_ERR_REST_FAILED,
+                                       "Restore failed");
                         return;
                 }
 
                 CU_DEBUG("Restore completed");
-                snap_job_set_status(ctx,
-                                    CIM_JOBSTATE_RUNNING,
-                                    "Restore finished");
+                job_set_status(job,
+                               CIM_JOBSTATE_RUNNING,
+                               "Restore finished");
 
                 if (!ctx->save)
                         vsss_delete_snapshot(virDomainGetName(dom));
@@ -208,111 +228,43 @@ static void do_snapshot(struct snap_context *ctx,
                  ctx->save ? "Save" : "None",
                  ctx->restore ? "Restore" : "None");
 
-        snap_job_set_status(ctx,
-                            CIM_JOBSTATE_COMPLETE,
-                            "Snapshot complete");
+        job_set_complete(job, "Snapshot complete");
 
         return;
 }
 
-static CMPI_THREAD_RETURN snapshot_thread(struct snap_context *ctx)
+static void run_snapshot(struct job *job,
+                         struct job_worker *worker,
+                         void *data)
 {
+        struct snap_context *ctx = data;
         CMPIStatus s;
-        virConnectPtr conn = NULL;
+        virConnectPtr conn;
         virDomainPtr dom = NULL;
 
-        CU_DEBUG("Snapshot thread alive");
-
-        CBAttachThread(_BROKER, ctx->context);
-
-        snap_job_set_status(ctx, CIM_JOBSTATE_RUNNING, "Running");
-
-        conn = connect_by_classname(_BROKER, ctx->ref_cn, &s);
+        conn = job_connect(job, worker, &s);
         if (conn == NULL) {
-                CU_DEBUG("Failed to connect with classname `%s'", ctx->ref_cn);
-                snap_job_set_failed(ctx,
-                                    VIR_VSSS_ERR_CONN_FAILED,
-                                    "Unable to connect to hypervisor");
+                CU_DEBUG("Failed to connect with classname `%s'",
+                         CLASSNAME(job_ref(job)));
+                job_set_failed(job,
+                               VIR_VSSS_ERR_CONN_FAILED,
+                               "Unable to connect to hypervisor");
                 goto out;
         }
 
         dom = virDomainLookupByName(conn, ctx->domain);
         if (dom == NULL) {
                 CU_DEBUG("No such domain `%s'", ctx->domain);
-                snap_job_set_failed(ctx,
-                                    VIR_VSSS_ERR_NO_SUCH_DOMAIN,
-                                    "No such domain");
+                job_set_failed(job,
+                               VIR_VSSS_ERR_NO_SUCH_DOMAIN,
+                               "No such domain");
                 goto out;
         }
 
-        do_snapshot(ctx, conn, dom);
+        do_snapshot(job, ctx, conn, dom);
 
  out:
         virDomainFree(dom);
-        virConnectClose(conn);
-
-        snap_job_free(ctx);
-
-        return NULL;
-}
-
-static CMPIStatus create_job(const CMPIContext *context,
-                             const CMPIObjectPath *ref,
-                             struct snap_context *ctx,
-                             CMPIObjectPath **job)
-{
-        CMPIObjectPath *op;
-        CMPIInstance *inst;
-        CMPIStatus s = {CMPI_RC_OK, NULL};
-
-        op = CMNewObjectPath(_BROKER,
-                             NAMESPACE(ref),
-                             "CIM_ConcreteJob", /*FIXME*/
-                             &s);
-        if ((s.rc != CMPI_RC_OK) || (op == NULL)) {
-                CU_DEBUG("Failed to create job path");
-                goto out;
-        }
-
-        inst = CMNewInstance(_BROKER, op, &s);
-        if ((s.rc != CMPI_RC_OK) || (inst == NULL)) {
-                CU_DEBUG("Failed to create job instance");
-                goto out;
-        }
-
-        CMSetProperty(inst, "InstanceID",
-                      (CMPIValue *)ctx->uuid, CMPI_chars);
-
-        CMSetProperty(inst, "Name",
-                      (CMPIValue *)"Snapshot", CMPI_chars);
-
-        CMSetProperty(inst, "Status",
-                      (CMPIValue *)"Queued", CMPI_chars);
-
-        op = CMGetObjectPath(inst, &s);
-        if ((op == NULL) || (s.rc != CMPI_RC_OK)) {
-                CU_DEBUG("Failed to get path of job instance");
-                goto out;
-        }
-
-        CMSetNameSpace(op, NAMESPACE(ref));
-
-        CU_DEBUG("ref was %s", CMGetCharPtr(CMObjectPathToString(op, NULL)));
-
-        *job = CBCreateInstance(_BROKER, context, op, inst, &s);
-        if ((*job == NULL) || (s.rc != CMPI_RC_OK)) {
-                CU_DEBUG("Failed to create job");
-                goto out;
-        }
-
-        ctx->ref_ns = strdup(NAMESPACE(ref));
-        ctx->ref_cn = strdup(CLASSNAME(ref));
-
-        ctx->context = CBPrepareAttachThread(_BROKER, context);
-
-        _BROKER->xft->newThread((void *)snapshot_thread, ctx, 0);
- out:
-        return s;
 }
 
 char *vsss_get_save_path(const char *domname)
@@ -350,19 +302,18 @@ static struct snap_context *new_context(const char *name,
                                         CMPIStatus *s)
 {
         struct snap_context *ctx;
-        uuid_t uuid;
 
         ctx = calloc(1, sizeof(*ctx));
         if (ctx == NULL) {
                 CU_DEBUG("Failed to alloc snapshot context");
+                cu_statusf(_BROKER, s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to allocate snapshot context");
                 goto out;
         }
 
         ctx->domain = strdup(name);
 
-        uuid_generate(uuid);
-        uuid_unparse(uuid, ctx->uuid);
-
         ctx->save_path = vsss_get_save_path(ctx->domain);
         if (ctx->save_path == NULL) {
                 cu_statusf(_BROKER, s,
@@ -376,7 +327,7 @@ static struct snap_context *new_context(const char *name,
                    "");
  out:
         if (s->rc != CMPI_RC_OK) {
-                snap_job_free(ctx);
+                snap_context_free(ctx);
                 ctx = NULL;
         }
 
@@ -387,13 +338,14 @@ static CMPIStatus start_snapshot_job(const CMPIObjectPath *ref,
                                      const CMPIContext *context,
                                      const char *name,
                                      uint16_t type,
-                                     CMPIArgs *argsout)
+                                     CMPIObjectPath **job_op,
+                                     CMPIObjectPath **vssd)
 {
         struct snap_context *ctx;
+        struct job *job;
         CMPIStatus s = {CMPI_RC_OK, NULL};
-        CMPIObjectPath *job;
-        CMPIObjectPath *vssd;
         CMPIInstance *inst;
+        char *desc = NULL;
 
         ctx = new_context(name, &s);
         if (ctx == NULL) {
@@ -406,7 +358,33 @@ static CMPIStatus start_snapshot_job(const CMPIObjectPath *ref,
         ctx->save = (type != 0);
         ctx->restore = (type != VIR_VSSS_SNAPSHOT_MEMT);
 
-        s = create_job(context, ref, ctx, &job);
+        if (asprintf(&desc,
+                     "%s of %s (%s)",
+                     ctx->save ? "Snapshot" : "Restore",
+                     ctx->domain,
+                     ctx->save_path) == -1) {
+                desc = NULL;
+                snap_context_free(ctx);
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to create snapshot context");
+                goto out;
+        }
+
+        job = job_new(_BROKER, context, ref, NULL,
+                      "Snapshot", desc, job_op, &s);
+        if (job == NULL) {
+                snap_context_free(ctx);
+                goto out;
+        }
+
+        if (job_queue_push(&snap_queue, context, job, run_snapshot,
+                           ctx, snap_context_free) != 0) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to start snapshot job");
+                goto out;
+        }
 
         s = get_vssd_by_name(_BROKER, ref, name, &inst);
         if (s.rc != CMPI_RC_OK) {
@@ -414,14 +392,39 @@ static CMPIStatus start_snapshot_job(const CMPIObjectPath *ref,
                 goto out;
         }
 
-        vssd = CMGetObjectPath(inst, &s);
+        *vssd = CMGetObjectPath(inst, &s);
         if (s.rc != CMPI_RC_OK) {
                 CU_DEBUG("Unable to get VSSD ref from instance");
                 goto out;
         }
 
-        CMAddArg(argsout, "Job", (CMPIValue *)&job, CMPI_ref);
-        CMAddArg(argsout, "ResultingSnapshot", (CMPIValue *)&vssd, CMPI_ref);
+ out:
+        free(desc);
+
+        return s;
+}
+
+static CMPIStatus get_snapshot_type(const CMPIArgs *argsin,
+                                    uint16_t *type)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+
+        if (cu_get_u16_arg(argsin, "SnapshotType", type) != CMPI_RC_OK) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_INVALID_PARAMETER,
+                           "Missing SnapshotType");
+                goto out;
+        }
+
+        if ((*type != VIR_VSSS_SNAPSHOT_MEM) &&
+            (*type != VIR_VSSS_SNAPSHOT_MEMT)) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_NOT_SUPPORTED,
+                           "Only memory(%i,%i) snapshots are supported",
+                           VIR_VSSS_SNAPSHOT_MEM,
+                           VIR_VSSS_SNAPSHOT_MEMT);
+                goto out;
+        }
 
  out:
         return s;
@@ -436,32 +439,82 @@ static CMPIStatus create_snapshot(CMPIMethodMI *self,
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIObjectPath *system;
+        CMPIObjectPath *job = NULL;
+        CMPIObjectPath *vssd = NULL;
         CMPIInstance *sd;
         uint16_t type;
         uint32_t retcode = CIM_RETURN_FAILED;
         const char *name;
 
-        if (cu_get_u16_arg(argsin, "SnapshotType", &type) != CMPI_RC_OK) {
+        s = get_snapshot_type(argsin, &type);
+        if (s.rc != CMPI_RC_OK)
+                goto out;
+
+        if (cu_get_ref_arg(argsin, "AffectedSystem", &system) != CMPI_RC_OK) {
                 cu_statusf(_BROKER, &s,
                            CMPI_RC_ERR_INVALID_PARAMETER,
-                           "Missing SnapshotType");
+                           "Missing AffectedSystem");
                 goto out;
         }
 
-        if ((type != VIR_VSSS_SNAPSHOT_MEM) &&
-            (type != VIR_VSSS_SNAPSHOT_MEMT)) {
+        if (cu_get_inst_arg(argsin, "SnapshotSettings", &sd) != CMPI_RC_OK) {
                 cu_statusf(_BROKER, &s,
-                           CMPI_RC_ERR_NOT_SUPPORTED,
-                           "Only memory(%i,%i) snapshots are supported",
-                           VIR_VSSS_SNAPSHOT_MEM,
-                           VIR_VSSS_SNAPSHOT_MEMT);
+                           CMPI_RC_ERR_INVALID_PARAMETER,
+                           "Missing SnapshotSettings");
                 goto out;
         }
 
-        if (cu_get_ref_arg(argsin, "AffectedSystem", &system) != CMPI_RC_OK) {
+        if (cu_get_str_path(system, "Name", &name) != CMPI_RC_OK) {
                 cu_statusf(_BROKER, &s,
                            CMPI_RC_ERR_INVALID_PARAMETER,
-                           "Missing AffectedSystem");
+                           "Missing Name property of AffectedSystem");
+                goto out;
+        }
+
+        s = start_snapshot_job(reference, context, name, type, &job, &vssd);
+
+        if (job != NULL)
+                CMAddArg(argsout, "Job", (CMPIValue *)&job, CMPI_ref);
+        if (vssd != NULL)
+                CMAddArg(argsout, "ResultingSnapshot",
+                         (CMPIValue *)&vssd, CMPI_ref);
+
+        retcode = CIM_RETURN_COMPLETED;
+ out:
+        CMReturnData(results, (CMPIValue *)&retcode, CMPI_uint32);
+
+        return s;
+}
+
+/* Queue one snapshot job per system so that a group of guests can be
+ * checkpointed together; the jobs run snapshot_workers at a time.
+ */
+static CMPIStatus create_snapshots(CMPIMethodMI *self,
+                                   const CMPIContext *context,
+                                   const CMPIResult *results,
+                                   const CMPIObjectPath *reference,
+                                   const CMPIArgs *argsin,
+                                   CMPIArgs *argsout)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIArray *systems;
+        CMPIArray *jobs = NULL;
+        CMPIArray *vssds = NULL;
+        CMPIInstance *sd;
+        CMPICount count;
+        CMPICount i;
+        uint16_t type;
+        uint32_t retcode = CIM_RETURN_FAILED;
+
+        s = get_snapshot_type(argsin, &type);
+        if (s.rc != CMPI_RC_OK)
+                goto out;
+
+        if (cu_get_array_arg(argsin, "AffectedSystems", &systems) !=
+            CMPI_RC_OK) {
+                cu_statusf(_BROKER, &s,
+                           CMPI_RC_ERR_INVALID_PARAMETER,
+                           "Missing AffectedSystems");
                 goto out;
         }
 
@@ -472,17 +525,69 @@ static CMPIStatus create_snapshot(CMPIMethodMI *self,
                 goto out;
         }
 
-        if (cu_get_str_path(system, "Name", &name) != CMPI_RC_OK) {
+        count = CMGetArrayCount(systems, NULL);
+        if (count == 0) {
                 cu_statusf(_BROKER, &s,
                            CMPI_RC_ERR_INVALID_PARAMETER,
-                           "Missing Name property of AffectedSystem");
+                           "AffectedSystems is empty");
                 goto out;
         }
 
-        s = start_snapshot_job(reference, context, name, type, argsout);
+        jobs = CMNewArray(_BROKER, count, CMPI_ref, &s);
+        if ((s.rc != CMPI_RC_OK) || (jobs == NULL))
+                goto out;
+
+        vssds = CMNewArray(_BROKER, count, CMPI_ref, &s);
+        if ((s.rc != CMPI_RC_OK) || (vssds == NULL))
+                goto out;
+
+        for (i = 0; i < count; i++) {
+                CMPIObjectPath *system;
+                CMPIObjectPath *job = NULL;
+                CMPIObjectPath *vssd = NULL;
+                const char *name;
+                CMPIData item;
+
+                item = CMGetArrayElementAt(systems, i, NULL);
+                if (CMIsNullObject(item.value.ref)) {
+                        cu_statusf(_BROKER, &s,
+                                   CMPI_RC_ERR_INVALID_PARAMETER,
+                                   "AffectedSystems[%u] is null", i);
+                        goto out;
+                }
+
+                system = item.value.ref;
+
+                if (cu_get_str_path(system, "Name", &name) != CMPI_RC_OK) {
+                        cu_statusf(_BROKER, &s,
+                                   CMPI_RC_ERR_INVALID_PARAMETER,
+                                   "Missing Name property of "
+                                   "AffectedSystems[%u]", i);
+                        goto out;
+                }
+
+                s = start_snapshot_job(reference, context, name, type,
+                                       &job, &vssd);
+                if (s.rc != CMPI_RC_OK) {
+                        CU_DEBUG("Failed to start snapshot of `%s'", name);
+                        goto out;
+                }
+
+                CMSetArrayElementAt(jobs, i, (CMPIValue *)&job, CMPI_ref);
+                CMSetArrayElementAt(vssds, i, (CMPIValue *)&vssd, CMPI_ref);
+        }
 
         retcode = CIM_RETURN_COMPLETED;
  out:
+        /* Jobs that were already queued keep running even if a later
+         * system in the batch was rejected, so always hand them back.
+         */
+        if (jobs != NULL)
+                CMAddArg(argsout, "Jobs", (CMPIValue *)&jobs, CMPI_refA);
+        if (vssds != NULL)
+                CMAddArg(argsout, "ResultingSnapshots",
+                         (CMPIValue *)&vssds, CMPI_refA);
+
         CMReturnData(results, (CMPIValue *)&retcode, CMPI_uint32);
 
         return s;
@@ -561,6 +666,8 @@ static CMPIStatus apply_snapshot(CMPIMethodMI *self,
 {
         CMPIStatus s = {CMPI_RC_OK, NULL};
         CMPIObjectPath *snap;
+        CMPIObjectPath *job = NULL;
+        CMPIObjectPath *vssd = NULL;
         char *name = NULL;
         uint32_t retcode = CIM_RETURN_FAILED;
 
@@ -578,7 +685,13 @@ static CMPIStatus apply_snapshot(CMPIMethodMI *self,
                 goto out;
         }
 
-        s = start_snapshot_job(reference, context, name, 0, argsout);
+        s = start_snapshot_job(reference, context, name, 0, &job, &vssd);
+
+        if (job != NULL)
+                CMAddArg(argsout, "Job", (CMPIValue *)&job, CMPI_ref);
+        if (vssd != NULL)
+                CMAddArg(argsout, "ResultingSnapshot",
+                         (CMPIValue *)&vssd, CMPI_ref);
 
         retcode = CIM_RETURN_COMPLETED;
 
@@ -599,6 +712,15 @@ static struct method_handler CreateSnapshot = {
                  ARG_END}
 };
 
+static struct method_handler CreateSnapshots = {
+        .name = "CreateSnapshots",
+        .handler = create_snapshots,
+        .args = {{"AffectedSystems", CMPI_refA, false},
+                 {"SnapshotSettings", CMPI_instance, false},
+                 {"SnapshotType", CMPI_uint16, false},
+                 ARG_END}
+};
+
 static struct method_handler DestroySnapshot = {
         .name = "DestroySnapshot",
         .handler = destroy_snapshot,
@@ -615,12 +737,13 @@ static struct method_handler ApplySnapshot = {
 
 static struct method_handler *handlers[] = {
         &CreateSnapshot,
+        &CreateSnapshots,
         &DestroySnapshot,
         &ApplySnapshot,
         NULL
 };
 
-STDIM_MethodMIStub(, Virt_VirtualSystemSnapshotService,
+STATS_MethodMIStub(, Virt_VirtualSystemSnapshotService,
                    _BROKER, libvirt_cim_init(), handlers);
 
 static CMPIStatus set_inst_properties(const CMPIBroker *broker,
@@ -759,10 +882,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
-                   Virt_VirtualSystemSnapshotService,
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_VirtualSystemSnapshotService,
+                     _BROKER,
+                     libvirt_cim_init());
 
 
 /*
@@ -194,10 +194,10 @@ DEFAULT_DI();
 DEFAULT_EQ();
 DEFAULT_INST_CLEANUP();
 
-STD_InstanceMIStub(,
-                   Virt_VirtualSystemSnapshotServiceCapabilities,
-                   _BROKER,
-                   libvirt_cim_init());
+STATS_InstanceMIStub(,
+                     Virt_VirtualSystemSnapshotServiceCapabilities,
+                     _BROKER,
+                     libvirt_cim_init());
 
 /*
  * Local Variables:
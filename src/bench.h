@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <stdint.h>
+
+#include <cmpidt.h>
+#include <cmpift.h>
+
+/*
+ * Minimal in-process broker for provider_bench.  Every object handed
+ * out to a provider is tracked and only freed by bench_broker_reset(),
+ * so CMRelease() is a no-op, as it is for most CIMOMs within a request.
+ */
+const CMPIBroker *bench_broker(void);
+const CMPIContext *bench_context(void);
+
+/* Returns a result sink that counts instances and references returned */
+CMPIResult *bench_result_new(void);
+unsigned int bench_result_count(const CMPIResult *rslt);
+
+/* Frees all broker objects, returns the number freed */
+unsigned int bench_broker_reset(void);
+
+/*
+ * Counters kept by the malloc() interposer in alloc_count.c and the
+ * libvirt interposer in bench_hooks.c.  lv_calls counts public libvirt API calls made by the
+ * providers, which map to RPCs on a remote connection.
+ */
+struct bench_counters {
+        uint64_t allocs;
+        uint64_t alloc_bytes;
+        uint64_t lv_calls;
+};
+
+/* Redirects every virConnectOpen*() made by the providers to uri */
+void bench_hooks_set_uri(const char *uri);
+void bench_counters_get(struct bench_counters *counters);
+
+#endif
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,1309 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Just enough of a CIMOM for the providers to build and return
+ * instances without a broker process.  Class schema is not available,
+ * so the keys of an instance path are taken from a fixed list of key
+ * property names used by the libvirt-cim classes, and CMClassPathIsA()
+ * only understands "<Prefix>_<Base>" being a "CIM_<Base>".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include <cmpidt.h>
+#include <cmpift.h>
+#include <cmpimacs.h>
+
+#include "bench.h"
+
+struct bench_obj {
+        struct bench_obj *next;
+        uint64_t data[];
+};
+
+static struct bench_obj *objs = NULL;
+static unsigned int obj_count = 0;
+static pthread_mutex_t obj_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *bench_alloc(size_t size)
+{
+        struct bench_obj *obj;
+
+        obj = calloc(1, sizeof(*obj) + size);
+        if (obj == NULL)
+                return NULL;
+
+        pthread_mutex_lock(&obj_lock);
+        obj->next = objs;
+        objs = obj;
+        obj_count++;
+        pthread_mutex_unlock(&obj_lock);
+
+        return obj->data;
+}
+
+unsigned int bench_broker_reset(void)
+{
+        struct bench_obj *obj;
+        unsigned int count;
+
+        pthread_mutex_lock(&obj_lock);
+        obj = objs;
+        count = obj_count;
+        objs = NULL;
+        obj_count = 0;
+        pthread_mutex_unlock(&obj_lock);
+
+        while (obj != NULL) {
+                struct bench_obj *next = obj->next;
+
+                free(obj);
+                obj = next;
+        }
+
+        return count;
+}
+
+static void set_rc(CMPIStatus *rc, CMPIrc code)
+{
+        if (rc != NULL) {
+                rc->rc = code;
+                rc->msg = NULL;
+        }
+}
+
+/*
+ * Strings
+ */
+
+static CMPIStatus string_release(CMPIString *str)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIString *new_string(const char *data);
+
+static CMPIString *string_clone(const CMPIString *str, CMPIStatus *rc)
+{
+        set_rc(rc, CMPI_RC_OK);
+        return new_string(str->hdl);
+}
+
+static CMPIStringFT string_ft = {
+        .ftVersion = CMPICurrentVersion,
+        .release = string_release,
+        .clone = string_clone,
+};
+
+struct bench_string {
+        CMPIString str;
+        char data[];
+};
+
+static CMPIString *new_string(const char *data)
+{
+        struct bench_string *bstr;
+        size_t len;
+
+        if (data == NULL)
+                return NULL;
+
+        len = strlen(data);
+        bstr = bench_alloc(sizeof(*bstr) + len + 1);
+        if (bstr == NULL)
+                return NULL;
+
+        memcpy(bstr->data, data, len + 1);
+        bstr->str.hdl = bstr->data;
+        bstr->str.ft = &string_ft;
+
+        return &bstr->str;
+}
+
+/*
+ * Values and property lists, shared by instances, object paths and
+ * arrays
+ */
+
+struct bench_prop {
+        CMPIString *name;
+        CMPIData data;
+};
+
+struct bench_props {
+        struct bench_prop *list;
+        CMPICount cur;
+        CMPICount max;
+};
+
+static CMPIValue copy_value(const CMPIValue *value, CMPIType type)
+{
+        CMPIValue val;
+
+        memset(&val, 0, sizeof(val));
+
+        if (type & CMPI_ARRAY) {
+                val.array = value->array;
+                return val;
+        }
+
+        switch (type) {
+        case CMPI_boolean:
+                val.boolean = value->boolean;
+                break;
+        case CMPI_char16:
+                val.char16 = value->char16;
+                break;
+        case CMPI_uint8:
+        case CMPI_sint8:
+                val.uint8 = value->uint8;
+                break;
+        case CMPI_uint16:
+        case CMPI_sint16:
+                val.uint16 = value->uint16;
+                break;
+        case CMPI_uint32:
+        case CMPI_sint32:
+        case CMPI_real32:
+                val.uint32 = value->uint32;
+                break;
+        case CMPI_uint64:
+        case CMPI_sint64:
+        case CMPI_real64:
+                val.uint64 = value->uint64;
+                break;
+        case CMPI_instance:
+                val.inst = value->inst;
+                break;
+        case CMPI_ref:
+                val.ref = value->ref;
+                break;
+        case CMPI_args:
+                val.args = value->args;
+                break;
+        case CMPI_enumeration:
+                val.Enum = value->Enum;
+                break;
+        case CMPI_string:
+                val.string = value->string;
+                break;
+        case CMPI_dateTime:
+                val.dateTime = value->dateTime;
+                break;
+        default:
+                memcpy(&val, value, sizeof(void *));
+                break;
+        }
+
+        return val;
+}
+
+static CMPIData make_data(const CMPIValue *value, CMPIType type)
+{
+        CMPIData data;
+
+        memset(&data, 0, sizeof(data));
+        data.type = type;
+
+        if (value == NULL) {
+                data.state = CMPI_nullValue;
+        } else if (type == CMPI_chars) {
+                data.type = CMPI_string;
+                data.value.string = new_string((const char *)value);
+                if (data.value.string == NULL)
+                        data.state = CMPI_nullValue;
+        } else {
+                data.value = copy_value(value, type);
+        }
+
+        return data;
+}
+
+static CMPIData null_data(void)
+{
+        CMPIData data;
+
+        memset(&data, 0, sizeof(data));
+        data.type = CMPI_null;
+        data.state = CMPI_nullValue | CMPI_notFound;
+
+        return data;
+}
+
+static struct bench_prop *props_find(const struct bench_props *props,
+                                     const char *name)
+{
+        CMPICount i;
+
+        for (i = 0; i < props->cur; i++) {
+                if (strcasecmp(CMGetCharPtr(props->list[i].name), name) == 0)
+                        return &props->list[i];
+        }
+
+        return NULL;
+}
+
+static CMPIrc props_set(struct bench_props *props,
+                        const char *name,
+                        CMPIData data)
+{
+        struct bench_prop *prop;
+
+        prop = props_find(props, name);
+        if (prop != NULL) {
+                prop->data = data;
+                return CMPI_RC_OK;
+        }
+
+        if (props->cur == props->max) {
+                struct bench_prop *list;
+                CMPICount max = props->max ? props->max * 2 : 16;
+
+                list = bench_alloc(max * sizeof(*list));
+                if (list == NULL)
+                        return CMPI_RC_ERR_FAILED;
+
+                if (props->cur > 0)
+                        memcpy(list, props->list, props->cur * sizeof(*list));
+                props->list = list;
+                props->max = max;
+        }
+
+        prop = &props->list[props->cur];
+        prop->name = new_string(name);
+        if (prop->name == NULL)
+                return CMPI_RC_ERR_FAILED;
+
+        prop->data = data;
+        props->cur++;
+
+        return CMPI_RC_OK;
+}
+
+static CMPIData props_get(const struct bench_props *props,
+                          const char *name,
+                          CMPIStatus *rc)
+{
+        struct bench_prop *prop;
+
+        prop = props_find(props, name);
+        if (prop == NULL) {
+                set_rc(rc, CMPI_RC_ERR_NO_SUCH_PROPERTY);
+                return null_data();
+        }
+
+        set_rc(rc, CMPI_RC_OK);
+        return prop->data;
+}
+
+static CMPIData props_get_at(const struct bench_props *props,
+                             CMPICount index,
+                             CMPIString **name,
+                             CMPIStatus *rc)
+{
+        if (index >= props->cur) {
+                set_rc(rc, CMPI_RC_ERR_NO_SUCH_PROPERTY);
+                return null_data();
+        }
+
+        if (name != NULL)
+                *name = props->list[index].name;
+
+        set_rc(rc, CMPI_RC_OK);
+        return props->list[index].data;
+}
+
+/*
+ * Object paths
+ */
+
+struct bench_op {
+        CMPIObjectPath op;
+        CMPIString *ns;
+        CMPIString *cn;
+        CMPIString *host;
+        struct bench_props keys;
+};
+
+static CMPIObjectPath *new_op(const char *ns, const char *cn);
+
+static CMPIStatus op_release(CMPIObjectPath *op)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIObjectPath *op_clone(const CMPIObjectPath *op, CMPIStatus *rc)
+{
+        struct bench_op *src = op->hdl;
+        CMPIObjectPath *ret;
+        struct bench_op *dst;
+        CMPICount i;
+
+        ret = new_op(src->ns ? CMGetCharPtr(src->ns) : NULL,
+                     src->cn ? CMGetCharPtr(src->cn) : NULL);
+        if (ret == NULL) {
+                set_rc(rc, CMPI_RC_ERR_FAILED);
+                return NULL;
+        }
+
+        dst = ret->hdl;
+        dst->host = src->host;
+        for (i = 0; i < src->keys.cur; i++)
+                props_set(&dst->keys,
+                          CMGetCharPtr(src->keys.list[i].name),
+                          src->keys.list[i].data);
+
+        set_rc(rc, CMPI_RC_OK);
+        return ret;
+}
+
+static CMPIStatus op_set_ns(CMPIObjectPath *op, const char *ns)
+{
+        struct bench_op *bop = op->hdl;
+
+        bop->ns = new_string(ns);
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIString *op_get_ns(const CMPIObjectPath *op, CMPIStatus *rc)
+{
+        struct bench_op *bop = op->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return bop->ns;
+}
+
+static CMPIStatus op_set_host(CMPIObjectPath *op, const char *hn)
+{
+        struct bench_op *bop = op->hdl;
+
+        bop->host = new_string(hn);
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIString *op_get_host(const CMPIObjectPath *op, CMPIStatus *rc)
+{
+        struct bench_op *bop = op->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return bop->host;
+}
+
+static CMPIStatus op_set_cn(CMPIObjectPath *op, const char *cn)
+{
+        struct bench_op *bop = op->hdl;
+
+        bop->cn = new_string(cn);
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIString *op_get_cn(const CMPIObjectPath *op, CMPIStatus *rc)
+{
+        struct bench_op *bop = op->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return bop->cn;
+}
+
+static CMPIStatus op_add_key(CMPIObjectPath *op,
+                             const char *name,
+                             const CMPIValue *value,
+                             const CMPIType type)
+{
+        struct bench_op *bop = op->hdl;
+
+        CMReturn(props_set(&bop->keys, name, make_data(value, type)));
+}
+
+static CMPIData op_get_key(const CMPIObjectPath *op,
+                           const char *name,
+                           CMPIStatus *rc)
+{
+        struct bench_op *bop = op->hdl;
+
+        return props_get(&bop->keys, name, rc);
+}
+
+static CMPIData op_get_key_at(const CMPIObjectPath *op,
+                              CMPICount index,
+                              CMPIString **name,
+                              CMPIStatus *rc)
+{
+        struct bench_op *bop = op->hdl;
+
+        return props_get_at(&bop->keys, index, name, rc);
+}
+
+static CMPICount op_get_key_count(const CMPIObjectPath *op, CMPIStatus *rc)
+{
+        struct bench_op *bop = op->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return bop->keys.cur;
+}
+
+static CMPIStatus op_set_ns_from_op(CMPIObjectPath *op,
+                                    const CMPIObjectPath *src)
+{
+        struct bench_op *bop = op->hdl;
+        struct bench_op *bsrc = src->hdl;
+
+        bop->ns = bsrc->ns;
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIStatus op_set_host_ns_from_op(CMPIObjectPath *op,
+                                         const CMPIObjectPath *src)
+{
+        struct bench_op *bop = op->hdl;
+        struct bench_op *bsrc = src->hdl;
+
+        bop->ns = bsrc->ns;
+        bop->host = bsrc->host;
+        CMReturn(CMPI_RC_OK);
+}
+
+static void print_data(FILE *out, const CMPIData *data);
+
+static CMPIString *op_to_string(const CMPIObjectPath *op, CMPIStatus *rc)
+{
+        struct bench_op *bop = op->hdl;
+        CMPIString *str;
+        char *buf = NULL;
+        size_t size = 0;
+        FILE *out;
+        CMPICount i;
+
+        out = open_memstream(&buf, &size);
+        if (out == NULL) {
+                set_rc(rc, CMPI_RC_ERR_FAILED);
+                return NULL;
+        }
+
+        fprintf(out, "%s:%s",
+                bop->ns ? CMGetCharPtr(bop->ns) : "",
+                bop->cn ? CMGetCharPtr(bop->cn) : "");
+
+        for (i = 0; i < bop->keys.cur; i++) {
+                fprintf(out, "%c%s=",
+                        i == 0 ? '.' : ',',
+                        CMGetCharPtr(bop->keys.list[i].name));
+                print_data(out, &bop->keys.list[i].data);
+        }
+
+        fclose(out);
+
+        str = new_string(buf);
+        free(buf);
+
+        set_rc(rc, str != NULL ? CMPI_RC_OK : CMPI_RC_ERR_FAILED);
+        return str;
+}
+
+static CMPIObjectPathFT op_ft = {
+        .ftVersion = CMPICurrentVersion,
+        .release = op_release,
+        .clone = op_clone,
+        .setNameSpace = op_set_ns,
+        .getNameSpace = op_get_ns,
+        .setHostname = op_set_host,
+        .getHostname = op_get_host,
+        .setClassName = op_set_cn,
+        .getClassName = op_get_cn,
+        .addKey = op_add_key,
+        .getKey = op_get_key,
+        .getKeyAt = op_get_key_at,
+        .getKeyCount = op_get_key_count,
+        .setNameSpaceFromObjectPath = op_set_ns_from_op,
+        .setHostAndNameSpaceFromObjectPath = op_set_host_ns_from_op,
+        .toString = op_to_string,
+};
+
+static CMPIObjectPath *new_op(const char *ns, const char *cn)
+{
+        struct bench_op *bop;
+
+        bop = bench_alloc(sizeof(*bop));
+        if (bop == NULL)
+                return NULL;
+
+        bop->ns = new_string(ns);
+        bop->cn = new_string(cn);
+        bop->op.hdl = bop;
+        bop->op.ft = &op_ft;
+
+        return &bop->op;
+}
+
+static void print_data(FILE *out, const CMPIData *data)
+{
+        if (data->state & CMPI_nullValue) {
+                fprintf(out, "NULL");
+                return;
+        }
+
+        switch (data->type) {
+        case CMPI_string:
+                fprintf(out, "\"%s\"", CMGetCharPtr(data->value.string));
+                break;
+        case CMPI_ref: {
+                CMPIString *str = op_to_string(data->value.ref, NULL);
+
+                fprintf(out, "\"%s\"", str ? CMGetCharPtr(str) : "");
+                break;
+        }
+        case CMPI_boolean:
+                fprintf(out, "%s", data->value.boolean ? "TRUE" : "FALSE");
+                break;
+        case CMPI_uint8:
+                fprintf(out, "%u", data->value.uint8);
+                break;
+        case CMPI_uint16:
+                fprintf(out, "%u", data->value.uint16);
+                break;
+        case CMPI_uint32:
+                fprintf(out, "%u", data->value.uint32);
+                break;
+        case CMPI_uint64:
+                fprintf(out, "%llu", (unsigned long long)data->value.uint64);
+                break;
+        default:
+                fprintf(out, "?");
+                break;
+        }
+}
+
+/*
+ * Instances
+ */
+
+/* Key properties of the libvirt-cim classes and their associations */
+static const char *key_props[] = {
+        "CreationClassName",
+        "SystemCreationClassName",
+        "SystemName",
+        "Name",
+        "DeviceID",
+        "InstanceID",
+        "GroupComponent",
+        "PartComponent",
+        "Antecedent",
+        "Dependent",
+        "ManagedElement",
+        "SettingData",
+        NULL
+};
+
+struct bench_inst {
+        CMPIInstance inst;
+        CMPIObjectPath *op;
+        struct bench_props props;
+};
+
+static CMPIInstance *new_inst(const CMPIObjectPath *op);
+
+static CMPIStatus inst_release(CMPIInstance *inst)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIInstance *inst_clone(const CMPIInstance *inst, CMPIStatus *rc)
+{
+        struct bench_inst *src = inst->hdl;
+        struct bench_inst *dst;
+        CMPIInstance *ret;
+        CMPICount i;
+
+        ret = new_inst(src->op);
+        if (ret == NULL) {
+                set_rc(rc, CMPI_RC_ERR_FAILED);
+                return NULL;
+        }
+
+        dst = ret->hdl;
+        for (i = 0; i < src->props.cur; i++)
+                props_set(&dst->props,
+                          CMGetCharPtr(src->props.list[i].name),
+                          src->props.list[i].data);
+
+        set_rc(rc, CMPI_RC_OK);
+        return ret;
+}
+
+static CMPIData inst_get_prop(const CMPIInstance *inst,
+                              const char *name,
+                              CMPIStatus *rc)
+{
+        struct bench_inst *binst = inst->hdl;
+
+        return props_get(&binst->props, name, rc);
+}
+
+static CMPIData inst_get_prop_at(const CMPIInstance *inst,
+                                 CMPICount index,
+                                 CMPIString **name,
+                                 CMPIStatus *rc)
+{
+        struct bench_inst *binst = inst->hdl;
+
+        return props_get_at(&binst->props, index, name, rc);
+}
+
+static CMPICount inst_get_prop_count(const CMPIInstance *inst, CMPIStatus *rc)
+{
+        struct bench_inst *binst = inst->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return binst->props.cur;
+}
+
+static CMPIStatus inst_set_prop(const CMPIInstance *inst,
+                                const char *name,
+                                const CMPIValue *value,
+                                CMPIType type)
+{
+        struct bench_inst *binst = inst->hdl;
+
+        CMReturn(props_set(&binst->props, name, make_data(value, type)));
+}
+
+static CMPIObjectPath *inst_get_op(const CMPIInstance *inst, CMPIStatus *rc)
+{
+        struct bench_inst *binst = inst->hdl;
+        struct bench_op *bop;
+        CMPIObjectPath *op;
+        int i;
+
+        op = op_clone(binst->op, rc);
+        if (op == NULL)
+                return NULL;
+
+        bop = op->hdl;
+        for (i = 0; key_props[i] != NULL; i++) {
+                struct bench_prop *prop;
+
+                prop = props_find(&binst->props, key_props[i]);
+                if ((prop == NULL) || (prop->data.state & CMPI_nullValue))
+                        continue;
+
+                if (props_find(&bop->keys, key_props[i]) == NULL)
+                        props_set(&bop->keys, key_props[i], prop->data);
+        }
+
+        return op;
+}
+
+static CMPIStatus inst_set_op(CMPIInstance *inst, const CMPIObjectPath *op)
+{
+        struct bench_inst *binst = inst->hdl;
+
+        binst->op = op_clone(op, NULL);
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIInstanceFT inst_ft = {
+        .ftVersion = CMPICurrentVersion,
+        .release = inst_release,
+        .clone = inst_clone,
+        .getProperty = inst_get_prop,
+        .getPropertyAt = inst_get_prop_at,
+        .getPropertyCount = inst_get_prop_count,
+        .setProperty = inst_set_prop,
+        .getObjectPath = inst_get_op,
+        .setObjectPath = inst_set_op,
+};
+
+static CMPIInstance *new_inst(const CMPIObjectPath *op)
+{
+        struct bench_inst *binst;
+
+        binst = bench_alloc(sizeof(*binst));
+        if (binst == NULL)
+                return NULL;
+
+        binst->op = op_clone(op, NULL);
+        if (binst->op == NULL)
+                return NULL;
+
+        binst->inst.hdl = binst;
+        binst->inst.ft = &inst_ft;
+
+        return &binst->inst;
+}
+
+/*
+ * Arrays
+ */
+
+struct bench_array {
+        CMPIArray array;
+        CMPIType type;
+        CMPICount size;
+        CMPIData *elems;
+};
+
+static CMPIArray *new_array(CMPICount size, CMPIType type);
+
+static CMPIStatus array_release(CMPIArray *array)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIArray *array_clone(const CMPIArray *array, CMPIStatus *rc)
+{
+        struct bench_array *src = array->hdl;
+        struct bench_array *dst;
+        CMPIArray *ret;
+
+        ret = new_array(src->size, src->type);
+        if (ret == NULL) {
+                set_rc(rc, CMPI_RC_ERR_FAILED);
+                return NULL;
+        }
+
+        dst = ret->hdl;
+        memcpy(dst->elems, src->elems, src->size * sizeof(CMPIData));
+
+        set_rc(rc, CMPI_RC_OK);
+        return ret;
+}
+
+static CMPICount array_get_size(const CMPIArray *array, CMPIStatus *rc)
+{
+        struct bench_array *barray = array->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return barray->size;
+}
+
+static CMPIType array_get_type(const CMPIArray *array, CMPIStatus *rc)
+{
+        struct bench_array *barray = array->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return barray->type;
+}
+
+static CMPIData array_get_at(const CMPIArray *array,
+                             CMPICount index,
+                             CMPIStatus *rc)
+{
+        struct bench_array *barray = array->hdl;
+
+        if (index >= barray->size) {
+                set_rc(rc, CMPI_RC_ERR_NO_SUCH_PROPERTY);
+                return null_data();
+        }
+
+        set_rc(rc, CMPI_RC_OK);
+        return barray->elems[index];
+}
+
+static CMPIStatus array_set_at(CMPIArray *array,
+                               CMPICount index,
+                               const CMPIValue *value,
+                               CMPIType type)
+{
+        struct bench_array *barray = array->hdl;
+
+        if (index >= barray->size)
+                CMReturn(CMPI_RC_ERR_NO_SUCH_PROPERTY);
+
+        barray->elems[index] = make_data(value, type);
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIArrayFT array_ft = {
+        .ftVersion = CMPICurrentVersion,
+        .release = array_release,
+        .clone = array_clone,
+        .getSize = array_get_size,
+        .getSimpleType = array_get_type,
+        .getElementAt = array_get_at,
+        .setElementAt = array_set_at,
+};
+
+static CMPIArray *new_array(CMPICount size, CMPIType type)
+{
+        struct bench_array *barray;
+        CMPICount i;
+
+        barray = bench_alloc(sizeof(*barray) + size * sizeof(CMPIData));
+        if (barray == NULL)
+                return NULL;
+
+        if (type == CMPI_chars)
+                type = CMPI_string;
+
+        barray->type = type;
+        barray->size = size;
+        barray->elems = (CMPIData *)(barray + 1);
+        for (i = 0; i < size; i++) {
+                barray->elems[i].type = type;
+                barray->elems[i].state = CMPI_nullValue;
+        }
+
+        barray->array.hdl = barray;
+        barray->array.ft = &array_ft;
+
+        return &barray->array;
+}
+
+/*
+ * Date/time values
+ */
+
+struct bench_datetime {
+        CMPIDateTime dt;
+        CMPIUint64 usecs;
+        CMPIBoolean interval;
+};
+
+static CMPIDateTime *new_datetime(CMPIUint64 usecs, CMPIBoolean interval);
+
+static CMPIStatus datetime_release(CMPIDateTime *dt)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIDateTime *datetime_clone(const CMPIDateTime *dt, CMPIStatus *rc)
+{
+        struct bench_datetime *bdt = dt->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return new_datetime(bdt->usecs, bdt->interval);
+}
+
+static CMPIUint64 datetime_get_binary(const CMPIDateTime *dt, CMPIStatus *rc)
+{
+        struct bench_datetime *bdt = dt->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return bdt->usecs;
+}
+
+static CMPIBoolean datetime_is_interval(const CMPIDateTime *dt,
+                                        CMPIStatus *rc)
+{
+        struct bench_datetime *bdt = dt->hdl;
+
+        set_rc(rc, CMPI_RC_OK);
+        return bdt->interval;
+}
+
+static CMPIDateTimeFT datetime_ft = {
+        .ftVersion = CMPICurrentVersion,
+        .release = datetime_release,
+        .clone = datetime_clone,
+        .getBinaryFormat = datetime_get_binary,
+        .isInterval = datetime_is_interval,
+};
+
+static CMPIDateTime *new_datetime(CMPIUint64 usecs, CMPIBoolean interval)
+{
+        struct bench_datetime *bdt;
+
+        bdt = bench_alloc(sizeof(*bdt));
+        if (bdt == NULL)
+                return NULL;
+
+        bdt->usecs = usecs;
+        bdt->interval = interval;
+        bdt->dt.hdl = bdt;
+        bdt->dt.ft = &datetime_ft;
+
+        return &bdt->dt;
+}
+
+/*
+ * Enumerations, only ever empty: upcalls to other providers are not
+ * supported
+ */
+
+static CMPIStatus enum_release(CMPIEnumeration *en)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIData enum_get_next(const CMPIEnumeration *en, CMPIStatus *rc)
+{
+        set_rc(rc, CMPI_RC_ERR_NOT_FOUND);
+        return null_data();
+}
+
+static CMPIBoolean enum_has_next(const CMPIEnumeration *en, CMPIStatus *rc)
+{
+        set_rc(rc, CMPI_RC_OK);
+        return 0;
+}
+
+static CMPIEnumerationFT enum_ft = {
+        .ftVersion = CMPICurrentVersion,
+        .release = enum_release,
+        .getNext = enum_get_next,
+        .hasNext = enum_has_next,
+};
+
+static CMPIEnumeration *new_enum(void)
+{
+        CMPIEnumeration *en;
+
+        en = bench_alloc(sizeof(*en));
+        if (en == NULL)
+                return NULL;
+
+        en->hdl = en;
+        en->ft = &enum_ft;
+
+        return en;
+}
+
+/*
+ * Results
+ */
+
+struct bench_result {
+        CMPIResult rslt;
+        unsigned int count;
+};
+
+static CMPIStatus result_release(CMPIResult *rslt)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIStatus result_return_data(const CMPIResult *rslt,
+                                     const CMPIValue *value,
+                                     const CMPIType type)
+{
+        struct bench_result *bres = rslt->hdl;
+
+        bres->count++;
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIStatus result_return_inst(const CMPIResult *rslt,
+                                     const CMPIInstance *inst)
+{
+        struct bench_result *bres = rslt->hdl;
+
+        bres->count++;
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIStatus result_return_op(const CMPIResult *rslt,
+                                   const CMPIObjectPath *ref)
+{
+        struct bench_result *bres = rslt->hdl;
+
+        bres->count++;
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIStatus result_return_done(const CMPIResult *rslt)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIResultFT result_ft = {
+        .ftVersion = CMPICurrentVersion,
+        .release = result_release,
+        .returnData = result_return_data,
+        .returnInstance = result_return_inst,
+        .returnObjectPath = result_return_op,
+        .returnDone = result_return_done,
+};
+
+CMPIResult *bench_result_new(void)
+{
+        struct bench_result *bres;
+
+        bres = bench_alloc(sizeof(*bres));
+        if (bres == NULL)
+                return NULL;
+
+        bres->rslt.hdl = bres;
+        bres->rslt.ft = &result_ft;
+
+        return &bres->rslt;
+}
+
+unsigned int bench_result_count(const CMPIResult *rslt)
+{
+        struct bench_result *bres = rslt->hdl;
+
+        return bres->count;
+}
+
+/*
+ * Context
+ */
+
+static CMPIData context_get_entry(const CMPIContext *ctx,
+                                  const char *name,
+                                  CMPIStatus *rc)
+{
+        CMPIData data;
+
+        if (strcasecmp(name, CMPIInvocationFlags) != 0) {
+                set_rc(rc, CMPI_RC_ERR_NO_SUCH_PROPERTY);
+                return null_data();
+        }
+
+        memset(&data, 0, sizeof(data));
+        data.type = CMPI_uint32;
+        data.state = CMPI_goodValue;
+        data.value.uint32 = 0;
+
+        set_rc(rc, CMPI_RC_OK);
+        return data;
+}
+
+static CMPIContextFT context_ft = {
+        .ftVersion = CMPICurrentVersion,
+        .getEntry = context_get_entry,
+};
+
+static CMPIContext context = {
+        .hdl = &context,
+        .ft = &context_ft,
+};
+
+const CMPIContext *bench_context(void)
+{
+        return &context;
+}
+
+/*
+ * Broker
+ */
+
+static CMPIContext *bft_prepare_attach(const CMPIBroker *mb,
+                                       const CMPIContext *ctx)
+{
+        return &context;
+}
+
+static CMPIStatus bft_attach(const CMPIBroker *mb, const CMPIContext *ctx)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIStatus bft_detach(const CMPIBroker *mb, const CMPIContext *ctx)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIStatus bft_deliver(const CMPIBroker *mb,
+                              const CMPIContext *ctx,
+                              const char *ns,
+                              const CMPIInstance *ind)
+{
+        CMReturn(CMPI_RC_OK);
+}
+
+static CMPIEnumeration *bft_enum_names(const CMPIBroker *mb,
+                                       const CMPIContext *ctx,
+                                       const CMPIObjectPath *op,
+                                       CMPIStatus *rc)
+{
+        set_rc(rc, CMPI_RC_OK);
+        return new_enum();
+}
+
+static CMPIInstance *bft_get_inst(const CMPIBroker *mb,
+                                  const CMPIContext *ctx,
+                                  const CMPIObjectPath *op,
+                                  const char **properties,
+                                  CMPIStatus *rc)
+{
+        set_rc(rc, CMPI_RC_ERR_NOT_SUPPORTED);
+        return NULL;
+}
+
+static CMPIEnumeration *bft_enum_insts(const CMPIBroker *mb,
+                                       const CMPIContext *ctx,
+                                       const CMPIObjectPath *op,
+                                       const char **properties,
+                                       CMPIStatus *rc)
+{
+        set_rc(rc, CMPI_RC_OK);
+        return new_enum();
+}
+
+static CMPIBrokerFT bft = {
+        .brokerCapabilities = 0,
+        .brokerVersion = CMPICurrentVersion,
+        .brokerName = "provider_bench",
+        .prepareAttachThread = bft_prepare_attach,
+        .attachThread = bft_attach,
+        .detachThread = bft_detach,
+        .deliverIndication = bft_deliver,
+        .enumerateInstanceNames = bft_enum_names,
+        .getInstance = bft_get_inst,
+        .enumerateInstances = bft_enum_insts,
+};
+
+static CMPIInstance *eft_new_inst(const CMPIBroker *mb,
+                                  const CMPIObjectPath *op,
+                                  CMPIStatus *rc)
+{
+        CMPIInstance *inst = new_inst(op);
+
+        set_rc(rc, inst != NULL ? CMPI_RC_OK : CMPI_RC_ERR_FAILED);
+        return inst;
+}
+
+static CMPIObjectPath *eft_new_op(const CMPIBroker *mb,
+                                  const char *ns,
+                                  const char *cn,
+                                  CMPIStatus *rc)
+{
+        CMPIObjectPath *op = new_op(ns, cn);
+
+        set_rc(rc, op != NULL ? CMPI_RC_OK : CMPI_RC_ERR_FAILED);
+        return op;
+}
+
+static CMPIString *eft_new_string(const CMPIBroker *mb,
+                                  const char *data,
+                                  CMPIStatus *rc)
+{
+        CMPIString *str = new_string(data);
+
+        set_rc(rc, str != NULL ? CMPI_RC_OK : CMPI_RC_ERR_FAILED);
+        return str;
+}
+
+static CMPIArray *eft_new_array(const CMPIBroker *mb,
+                                CMPICount max,
+                                CMPIType type,
+                                CMPIStatus *rc)
+{
+        CMPIArray *array = new_array(max, type);
+
+        set_rc(rc, array != NULL ? CMPI_RC_OK : CMPI_RC_ERR_FAILED);
+        return array;
+}
+
+static CMPIDateTime *eft_new_datetime(const CMPIBroker *mb, CMPIStatus *rc)
+{
+        CMPIDateTime *dt = new_datetime(0, 0);
+
+        set_rc(rc, dt != NULL ? CMPI_RC_OK : CMPI_RC_ERR_FAILED);
+        return dt;
+}
+
+static CMPIDateTime *eft_new_datetime_bin(const CMPIBroker *mb,
+                                          CMPIUint64 binTime,
+                                          CMPIBoolean interval,
+                                          CMPIStatus *rc)
+{
+        CMPIDateTime *dt = new_datetime(binTime, interval);
+
+        set_rc(rc, dt != NULL ? CMPI_RC_OK : CMPI_RC_ERR_FAILED);
+        return dt;
+}
+
+static CMPIBoolean eft_class_path_is_a(const CMPIBroker *mb,
+                                       const CMPIObjectPath *op,
+                                       const char *type,
+                                       CMPIStatus *rc)
+{
+        struct bench_op *bop = op->hdl;
+        const char *cn;
+        const char *base;
+
+        set_rc(rc, CMPI_RC_OK);
+
+        if ((bop->cn == NULL) || (type == NULL))
+                return 0;
+
+        cn = CMGetCharPtr(bop->cn);
+        if (strcasecmp(cn, type) == 0)
+                return 1;
+
+        if (strncasecmp(type, "CIM_", 4) != 0)
+                return 0;
+
+        if (strcasecmp(type, "CIM_ManagedElement") == 0)
+                return 1;
+
+        base = strchr(cn, '_');
+
+        return (base != NULL) && (strcasecmp(base + 1, type + 4) == 0);
+}
+
+static CMPIBrokerEncFT eft = {
+        .ftVersion = CMPICurrentVersion,
+        .newInstance = eft_new_inst,
+        .newObjectPath = eft_new_op,
+        .newString = eft_new_string,
+        .newArray = eft_new_array,
+        .newDateTime = eft_new_datetime,
+        .newDateTimeFromBinary = eft_new_datetime_bin,
+        .classPathIsA = eft_class_path_is_a,
+};
+
+static CMPI_THREAD_TYPE xft_new_thread(CMPI_THREAD_RETURN
+                                       (CMPI_THREAD_CDECL *start)(void *),
+                                       void *parm,
+                                       int detached)
+{
+        pthread_t thread;
+
+        if (pthread_create(&thread, NULL, start, parm) != 0)
+                return (CMPI_THREAD_TYPE)0;
+
+        if (detached)
+                pthread_detach(thread);
+
+        return (CMPI_THREAD_TYPE)thread;
+}
+
+static CMPIBrokerExtFT xft = {
+        .ftVersion = CMPICurrentVersion,
+        .newThread = xft_new_thread,
+};
+
+static CMPIBroker broker = {
+        .hdl = &broker,
+        .bft = &bft,
+        .eft = &eft,
+        .xft = &xft,
+};
+
+const CMPIBroker *bench_broker(void)
+{
+        return &broker;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
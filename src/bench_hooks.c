@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * libvirt call accounting for provider_bench, allocations are counted
+ * by alloc_count.c.
+ *
+ * The functions below are defined in the benchmark executable, so they
+ * take precedence over the libvirt definitions for every call made by
+ * the provider libraries.  libvirt.h is deliberately not included: the
+ * wrappers only forward their arguments, so opaque pointer types are
+ * enough.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <dlfcn.h>
+
+#include "alloc_count.h"
+
+#include "bench.h"
+
+static uint64_t lv_calls;
+
+static const char *bench_uri = NULL;
+
+void bench_hooks_set_uri(const char *uri)
+{
+        bench_uri = uri;
+}
+
+void bench_counters_get(struct bench_counters *counters)
+{
+        alloc_count_get(&counters->allocs, &counters->alloc_bytes);
+        counters->lv_calls = __sync_fetch_and_add(&lv_calls, 0);
+}
+
+static void *lv_symbol(const char *name)
+{
+        return dlsym(RTLD_NEXT, name);
+}
+
+/*
+ * Defines a counting wrapper for a libvirt entry point, which returns
+ * err if the running libvirt does not provide the symbol.
+ */
+#define LV_WRAP(type, err, name, params, args)                          \
+        type name params;                                               \
+        type name params                                                \
+        {                                                               \
+                static type (*real) params = NULL;                      \
+                                                                        \
+                __sync_fetch_and_add(&lv_calls, 1);                     \
+                if (real == NULL)                                       \
+                        real = (type (*) params)lv_symbol(#name);       \
+                if (real == NULL)                                       \
+                        return err;                                     \
+                                                                        \
+                return real args;                                       \
+        }
+
+/* Connections: the URI is replaced by the one under test */
+LV_WRAP(void *, NULL, virConnectOpen,
+        (const char *name),
+        (bench_uri != NULL ? bench_uri : name))
+LV_WRAP(void *, NULL, virConnectOpenReadOnly,
+        (const char *name),
+        (bench_uri != NULL ? bench_uri : name))
+LV_WRAP(int, -1, virConnectClose,
+        (void *conn),
+        (conn))
+LV_WRAP(const char *, NULL, virConnectGetType,
+        (void *conn),
+        (conn))
+LV_WRAP(char *, NULL, virConnectGetURI,
+        (void *conn),
+        (conn))
+LV_WRAP(char *, NULL, virConnectGetCapabilities,
+        (void *conn),
+        (conn))
+LV_WRAP(int, -1, virConnectGetMaxVcpus,
+        (void *conn, const char *type),
+        (conn, type))
+LV_WRAP(int, -1, virNodeGetInfo,
+        (void *conn, void *info),
+        (conn, info))
+
+/* Domains */
+LV_WRAP(int, -1, virConnectListAllDomains,
+        (void *conn, void ***domains, unsigned int flags),
+        (conn, domains, flags))
+LV_WRAP(int, -1, virConnectListDomains,
+        (void *conn, int *ids, int maxids),
+        (conn, ids, maxids))
+LV_WRAP(int, -1, virConnectListDefinedDomains,
+        (void *conn, char **const names, int maxnames),
+        (conn, names, maxnames))
+LV_WRAP(int, -1, virConnectNumOfDomains,
+        (void *conn),
+        (conn))
+LV_WRAP(int, -1, virConnectNumOfDefinedDomains,
+        (void *conn),
+        (conn))
+LV_WRAP(void *, NULL, virDomainLookupByName,
+        (void *conn, const char *name),
+        (conn, name))
+LV_WRAP(void *, NULL, virDomainLookupByID,
+        (void *conn, int id),
+        (conn, id))
+LV_WRAP(void *, NULL, virDomainLookupByUUIDString,
+        (void *conn, const char *uuid),
+        (conn, uuid))
+LV_WRAP(char *, NULL, virDomainGetXMLDesc,
+        (void *dom, unsigned int flags),
+        (dom, flags))
+LV_WRAP(int, -1, virDomainGetInfo,
+        (void *dom, void *info),
+        (dom, info))
+LV_WRAP(int, -1, virDomainGetAutostart,
+        (void *dom, int *autostart),
+        (dom, autostart))
+LV_WRAP(int, -1, virDomainGetVcpus,
+        (void *dom, void *info, int maxinfo,
+         unsigned char *cpumaps, int maplen),
+        (dom, info, maxinfo, cpumaps, maplen))
+LV_WRAP(char *, NULL, virDomainGetSchedulerType,
+        (void *dom, int *nparams),
+        (dom, nparams))
+LV_WRAP(int, -1, virDomainGetSchedulerParameters,
+        (void *dom, void *params, int *nparams),
+        (dom, params, nparams))
+
+/* Storage */
+LV_WRAP(int, -1, virConnectListAllStoragePools,
+        (void *conn, void ***pools, unsigned int flags),
+        (conn, pools, flags))
+LV_WRAP(int, -1, virConnectListStoragePools,
+        (void *conn, char **const names, int maxnames),
+        (conn, names, maxnames))
+LV_WRAP(int, -1, virConnectNumOfStoragePools,
+        (void *conn),
+        (conn))
+LV_WRAP(void *, NULL, virStoragePoolLookupByName,
+        (void *conn, const char *name),
+        (conn, name))
+LV_WRAP(void *, NULL, virStoragePoolLookupByVolume,
+        (void *vol),
+        (vol))
+LV_WRAP(int, -1, virStoragePoolGetInfo,
+        (void *pool, void *info),
+        (pool, info))
+LV_WRAP(char *, NULL, virStoragePoolGetXMLDesc,
+        (void *pool, unsigned int flags),
+        (pool, flags))
+LV_WRAP(int, -1, virStoragePoolGetAutostart,
+        (void *pool, int *autostart),
+        (pool, autostart))
+LV_WRAP(void *, NULL, virStorageVolLookupByPath,
+        (void *conn, const char *path),
+        (conn, path))
+LV_WRAP(int, -1, virStorageVolGetInfo,
+        (void *vol, void *info),
+        (vol, info))
+
+/* Networks and filters */
+LV_WRAP(int, -1, virConnectListAllNetworks,
+        (void *conn, void ***nets, unsigned int flags),
+        (conn, nets, flags))
+LV_WRAP(int, -1, virConnectListNetworks,
+        (void *conn, char **const names, int maxnames),
+        (conn, names, maxnames))
+LV_WRAP(int, -1, virConnectNumOfNetworks,
+        (void *conn),
+        (conn))
+LV_WRAP(void *, NULL, virNetworkLookupByName,
+        (void *conn, const char *name),
+        (conn, name))
+LV_WRAP(char *, NULL, virNetworkGetBridgeName,
+        (void *net),
+        (net))
+LV_WRAP(int, -1, virConnectListNWFilters,
+        (void *conn, char **const names, int maxnames),
+        (conn, names, maxnames))
+LV_WRAP(int, -1, virConnectNumOfNWFilters,
+        (void *conn),
+        (conn))
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,813 @@
+/*
+ * Copyright (C) 2026 libvirt-cim contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * In-process benchmark of the provider entry points used by the hot
+ * CIM operations.  The providers are called directly, against the
+ * fake broker in bench_broker.c, with every libvirt connection they
+ * open redirected to a single URI (by default the libvirt test
+ * driver).  For each case the per-call latency distribution and the
+ * average number of libvirt calls and heap allocations are reported.
+ *
+ * With -d, a test driver node definition holding the requested number
+ * of guests, disks, interfaces and storage pools is generated, so that
+ * the scaling of each operation can be observed.  Note that the test
+ * driver parses that definition on every virConnectOpen().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <libvirt/libvirt.h>
+
+#include <cmpidt.h>
+#include <cmpift.h>
+#include <cmpimacs.h>
+
+#include <libcmpiutil/libcmpiutil.h>
+
+#include "misc_util.h"
+#include "svpc_types.h"
+
+#include "Virt_ComputerSystem.h"
+#include "Virt_Device.h"
+#include "Virt_RASD.h"
+#include "Virt_DevicePool.h"
+
+#include "bench.h"
+
+#define BENCH_NS "root/virt"
+#define BENCH_MAX_KEYS 8
+
+CMPIInstanceMI *Virt_ComputerSystem_Create_InstanceMI(const CMPIBroker *,
+                                                      const CMPIContext *,
+                                                      CMPIStatus *);
+CMPIInstanceMI *Virt_Device_Create_InstanceMI(const CMPIBroker *,
+                                              const CMPIContext *,
+                                              CMPIStatus *);
+CMPIInstanceMI *Virt_RASD_Create_InstanceMI(const CMPIBroker *,
+                                            const CMPIContext *,
+                                            CMPIStatus *);
+CMPIInstanceMI *Virt_DevicePool_Create_InstanceMI(const CMPIBroker *,
+                                                  const CMPIContext *,
+                                                  CMPIStatus *);
+CMPIInstanceMI *Virt_HostSystem_Create_InstanceMI(const CMPIBroker *,
+                                                  const CMPIContext *,
+                                                  CMPIStatus *);
+CMPIInstanceMI *Virt_VSSD_Create_InstanceMI(const CMPIBroker *,
+                                            const CMPIContext *,
+                                            CMPIStatus *);
+CMPIAssociationMI *Virt_SystemDevice_Create_AssociationMI(const CMPIBroker *,
+                                                          const CMPIContext *,
+                                                          CMPIStatus *);
+CMPIAssociationMI *Virt_VSSDComponent_Create_AssociationMI(const CMPIBroker *,
+                                                           const CMPIContext *,
+                                                           CMPIStatus *);
+CMPIAssociationMI *
+Virt_ElementAllocatedFromPool_Create_AssociationMI(const CMPIBroker *,
+                                                   const CMPIContext *,
+                                                   CMPIStatus *);
+CMPIAssociationMI *
+Virt_HostedResourcePool_Create_AssociationMI(const CMPIBroker *,
+                                             const CMPIContext *,
+                                             CMPIStatus *);
+
+/* A reference saved across broker resets */
+struct bench_ref {
+        char *cn;
+        int count;
+        char *keys[BENCH_MAX_KEYS];
+        char *values[BENCH_MAX_KEYS];
+};
+
+struct bench_env {
+        const CMPIBroker *broker;
+        const CMPIContext *context;
+        char *pfx;
+        char *domain;
+        struct bench_ref cs_ref;
+        struct bench_ref vssd_ref;
+        struct bench_ref disk_ref;
+        struct bench_ref pool_ref;
+        CMPIAssociationMI *sd_mi;
+        CMPIAssociationMI *vssdc_mi;
+        CMPIAssociationMI *eafp_mi;
+        CMPIAssociationMI *hrp_mi;
+};
+
+struct bench_case {
+        const char *name;
+        CMPIStatus (*func)(struct bench_env *env, unsigned int *count);
+};
+
+static CMPIObjectPath *bench_op(struct bench_env *env, const char *base)
+{
+        char cn[256];
+
+        snprintf(cn, sizeof(cn), "%s_%s", env->pfx, base);
+
+        return CMNewObjectPath(env->broker, BENCH_NS, cn, NULL);
+}
+
+static void ref_add(struct bench_ref *ref, const char *key, const char *value)
+{
+        if (ref->count >= BENCH_MAX_KEYS)
+                return;
+
+        ref->keys[ref->count] = strdup(key);
+        ref->values[ref->count] = strdup(value);
+        ref->count++;
+}
+
+static void ref_save(struct bench_ref *ref, const CMPIObjectPath *op)
+{
+        CMPICount count;
+        CMPICount i;
+
+        ref->cn = strdup(CLASSNAME(op));
+
+        count = CMGetKeyCount(op, NULL);
+        for (i = 0; i < count; i++) {
+                CMPIString *name = NULL;
+                CMPIData data;
+
+                data = CMGetKeyAt(op, i, &name, NULL);
+                if ((name == NULL) || (data.type != CMPI_string) ||
+                    CMIsNullValue(data))
+                        continue;
+
+                ref_add(ref,
+                        CMGetCharPtr(name),
+                        CMGetCharPtr(data.value.string));
+        }
+}
+
+static void ref_free(struct bench_ref *ref)
+{
+        int i;
+
+        for (i = 0; i < ref->count; i++) {
+                free(ref->keys[i]);
+                free(ref->values[i]);
+        }
+
+        free(ref->cn);
+        memset(ref, 0, sizeof(*ref));
+}
+
+static CMPIObjectPath *ref_make(struct bench_env *env,
+                                const struct bench_ref *ref)
+{
+        CMPIObjectPath *op;
+        int i;
+
+        op = CMNewObjectPath(env->broker, BENCH_NS, ref->cn, NULL);
+        if (op == NULL)
+                return NULL;
+
+        for (i = 0; i < ref->count; i++)
+                CMAddKey(op, ref->keys[i], ref->values[i], CMPI_chars);
+
+        return op;
+}
+
+static CMPIStatus run_enum(CMPIStatus (*func)(struct bench_env *env,
+                                              struct inst_list *list),
+                           struct bench_env *env,
+                           unsigned int *count)
+{
+        CMPIStatus s;
+        struct inst_list list;
+
+        inst_list_init(&list);
+        s = func(env, &list);
+        *count = list.cur;
+        inst_list_free(&list);
+
+        return s;
+}
+
+static CMPIStatus do_enum_domains(struct bench_env *env,
+                                  struct inst_list *list)
+{
+        return enum_domains(env->broker,
+                            bench_op(env, "ComputerSystem"),
+                            list);
+}
+
+static CMPIStatus do_enum_devices(struct bench_env *env,
+                                  struct inst_list *list)
+{
+        return enum_devices(env->broker,
+                            bench_op(env, "LogicalDevice"),
+                            NULL,
+                            CIM_RES_TYPE_ALL,
+                            list);
+}
+
+static CMPIStatus do_enum_rasds(struct bench_env *env,
+                                struct inst_list *list)
+{
+        return enum_rasds(env->broker,
+                          bench_op(env, "ResourceAllocationSettingData"),
+                          NULL,
+                          CIM_RES_TYPE_ALL,
+                          NULL,
+                          list);
+}
+
+static CMPIStatus do_enum_pools(struct bench_env *env,
+                                struct inst_list *list)
+{
+        return enum_pools(env->broker,
+                          bench_op(env, "ResourcePool"),
+                          CIM_RES_TYPE_ALL,
+                          list);
+}
+
+static CMPIStatus case_enum_domains(struct bench_env *env,
+                                    unsigned int *count)
+{
+        return run_enum(do_enum_domains, env, count);
+}
+
+static CMPIStatus case_enum_devices(struct bench_env *env,
+                                    unsigned int *count)
+{
+        return run_enum(do_enum_devices, env, count);
+}
+
+static CMPIStatus case_enum_rasds(struct bench_env *env,
+                                  unsigned int *count)
+{
+        return run_enum(do_enum_rasds, env, count);
+}
+
+static CMPIStatus case_enum_pools(struct bench_env *env,
+                                  unsigned int *count)
+{
+        return run_enum(do_enum_pools, env, count);
+}
+
+static CMPIStatus case_get_domain(struct bench_env *env,
+                                  unsigned int *count)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIInstance *inst = NULL;
+
+        if (env->domain == NULL) {
+                cu_statusf(env->broker, &s,
+                           CMPI_RC_ERR_NOT_FOUND,
+                           "No guest to look up");
+                return s;
+        }
+
+        s = get_domain_by_name(env->broker,
+                               bench_op(env, "ComputerSystem"),
+                               env->domain,
+                               &inst);
+        *count = (inst != NULL);
+
+        return s;
+}
+
+static CMPIStatus case_get_pool(struct bench_env *env,
+                                unsigned int *count)
+{
+        CMPIStatus s;
+        CMPIInstance *inst = NULL;
+
+        s = get_pool_by_name(env->broker,
+                             bench_op(env, "MemoryPool"),
+                             "MemoryPool/0",
+                             &inst);
+        *count = (inst != NULL);
+
+        return s;
+}
+
+static CMPIStatus run_assoc(struct bench_env *env,
+                            CMPIAssociationMI *mi,
+                            const struct bench_ref *ref,
+                            const char *assoc_base,
+                            unsigned int *count)
+{
+        CMPIStatus s = {CMPI_RC_OK, NULL};
+        CMPIObjectPath *op;
+        CMPIResult *rslt;
+        char assoc[256];
+
+        if ((mi == NULL) || (ref->cn == NULL)) {
+                cu_statusf(env->broker, &s,
+                           CMPI_RC_ERR_NOT_FOUND,
+                           "No source instance for %s", assoc_base);
+                return s;
+        }
+
+        snprintf(assoc, sizeof(assoc), "%s_%s", env->pfx, assoc_base);
+
+        op = ref_make(env, ref);
+        rslt = bench_result_new();
+        if ((op == NULL) || (rslt == NULL)) {
+                cu_statusf(env->broker, &s,
+                           CMPI_RC_ERR_FAILED,
+                           "Unable to allocate request");
+                return s;
+        }
+
+        s = mi->ft->associators(mi, env->context, rslt, op,
+                                assoc, NULL, NULL, NULL, NULL);
+        *count = bench_result_count(rslt);
+
+        return s;
+}
+
+static CMPIStatus case_system_device(struct bench_env *env,
+                                     unsigned int *count)
+{
+        return run_assoc(env, env->sd_mi, &env->cs_ref,
+                         "SystemDevice", count);
+}
+
+static CMPIStatus case_vssd_component(struct bench_env *env,
+                                      unsigned int *count)
+{
+        return run_assoc(env, env->vssdc_mi, &env->vssd_ref,
+                         "VSSDComponent", count);
+}
+
+static CMPIStatus case_eafp(struct bench_env *env,
+                            unsigned int *count)
+{
+        return run_assoc(env, env->eafp_mi, &env->disk_ref,
+                         "ElementAllocatedFromPool", count);
+}
+
+static CMPIStatus case_hosted_pool(struct bench_env *env,
+                                   unsigned int *count)
+{
+        return run_assoc(env, env->hrp_mi, &env->pool_ref,
+                         "HostedResourcePool", count);
+}
+
+static const struct bench_case cases[] = {
+        {"enum_domains", case_enum_domains},
+        {"get_domain_by_name", case_get_domain},
+        {"enum_devices", case_enum_devices},
+        {"enum_rasds", case_enum_rasds},
+        {"enum_pools", case_enum_pools},
+        {"get_pool_by_name", case_get_pool},
+        {"assoc_system_device", case_system_device},
+        {"assoc_vssd_component", case_vssd_component},
+        {"assoc_eafp", case_eafp},
+        {"assoc_hosted_pool", case_hosted_pool},
+        {NULL, NULL}
+};
+
+static void setup_refs(struct bench_env *env)
+{
+        CMPIStatus s;
+        struct inst_list list;
+        CMPIInstance *inst = NULL;
+        const char *name;
+        char id[256];
+
+        inst_list_init(&list);
+        s = do_enum_domains(env, &list);
+        if ((s.rc == CMPI_RC_OK) && (list.cur > 0)) {
+                inst = list.list[0];
+                if (cu_get_str_prop(inst, "Name", &name) == CMPI_RC_OK)
+                        env->domain = strdup(name);
+                ref_save(&env->cs_ref, CMGetObjectPath(inst, NULL));
+        }
+        inst_list_free(&list);
+
+        if (env->domain == NULL) {
+                fprintf(stderr, "No guests found, guest cases will fail\n");
+                return;
+        }
+
+        snprintf(id, sizeof(id), "%s_VirtualSystemSettingData", env->pfx);
+        env->vssd_ref.cn = strdup(id);
+        snprintf(id, sizeof(id), "%s:%s", env->pfx, env->domain);
+        ref_add(&env->vssd_ref, "InstanceID", id);
+
+        inst_list_init(&list);
+        s = enum_devices(env->broker,
+                         bench_op(env, "LogicalDisk"),
+                         env->domain,
+                         CIM_RES_TYPE_DISK,
+                         &list);
+        if ((s.rc == CMPI_RC_OK) && (list.cur > 0))
+                ref_save(&env->disk_ref,
+                         CMGetObjectPath(list.list[0], NULL));
+        inst_list_free(&list);
+
+        inst = NULL;
+        s = get_pool_by_name(env->broker,
+                             bench_op(env, "MemoryPool"),
+                             "MemoryPool/0",
+                             &inst);
+        if ((s.rc == CMPI_RC_OK) && (inst != NULL))
+                ref_save(&env->pool_ref, CMGetObjectPath(inst, NULL));
+}
+
+static int setup_env(struct bench_env *env, const char *uri)
+{
+        const CMPIBroker *broker = bench_broker();
+        const CMPIContext *context = bench_context();
+        CMPIStatus s;
+        virConnectPtr conn;
+
+        memset(env, 0, sizeof(*env));
+        env->broker = broker;
+        env->context = context;
+
+        conn = virConnectOpen(uri);
+        if (conn == NULL) {
+                fprintf(stderr, "Unable to connect to %s\n", uri);
+                return -1;
+        }
+
+        conn_info_register(conn);
+        env->pfx = strdup(pfx_from_conn(conn));
+        virConnectClose(conn);
+
+        /* Hand the broker to each provider library */
+        Virt_ComputerSystem_Create_InstanceMI(broker, context, &s);
+        Virt_Device_Create_InstanceMI(broker, context, &s);
+        Virt_RASD_Create_InstanceMI(broker, context, &s);
+        Virt_DevicePool_Create_InstanceMI(broker, context, &s);
+        Virt_HostSystem_Create_InstanceMI(broker, context, &s);
+        Virt_VSSD_Create_InstanceMI(broker, context, &s);
+
+        env->sd_mi = Virt_SystemDevice_Create_AssociationMI(broker,
+                                                            context,
+                                                            &s);
+        env->vssdc_mi = Virt_VSSDComponent_Create_AssociationMI(broker,
+                                                               context,
+                                                               &s);
+        env->eafp_mi =
+                Virt_ElementAllocatedFromPool_Create_AssociationMI(broker,
+                                                                   context,
+                                                                   &s);
+        env->hrp_mi =
+                Virt_HostedResourcePool_Create_AssociationMI(broker,
+                                                             context,
+                                                             &s);
+
+        setup_refs(env);
+        bench_broker_reset();
+
+        return 0;
+}
+
+static void cleanup_env(struct bench_env *env)
+{
+        ref_free(&env->cs_ref);
+        ref_free(&env->vssd_ref);
+        ref_free(&env->disk_ref);
+        ref_free(&env->pool_ref);
+        free(env->domain);
+        free(env->pfx);
+}
+
+static double now_usec(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return (ts.tv_sec * 1000000.0) + (ts.tv_nsec / 1000.0);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+        double da = *(const double *)a;
+        double db = *(const double *)b;
+
+        return (da > db) - (da < db);
+}
+
+static double percentile(const double *sorted, unsigned int n, double p)
+{
+        return sorted[(unsigned int)((n - 1) * p)];
+}
+
+static void run_case(struct bench_env *env,
+                     const struct bench_case *bcase,
+                     unsigned int iters)
+{
+        CMPIStatus s;
+        struct bench_counters before;
+        struct bench_counters after;
+        uint64_t lv_calls = 0;
+        uint64_t allocs = 0;
+        uint64_t alloc_bytes = 0;
+        unsigned int count = 0;
+        double *lat;
+        unsigned int i;
+
+        /* The first call warms the per-connection caches */
+        s = bcase->func(env, &count);
+        if (s.rc != CMPI_RC_OK) {
+                printf("%-24s failed (%d): %s\n",
+                       bcase->name,
+                       s.rc,
+                       s.msg != NULL ? CMGetCharPtr(s.msg) : "");
+                bench_broker_reset();
+                return;
+        }
+        bench_broker_reset();
+
+        lat = calloc(iters, sizeof(*lat));
+        if (lat == NULL) {
+                perror("calloc");
+                return;
+        }
+
+        for (i = 0; i < iters; i++) {
+                double start;
+
+                bench_counters_get(&before);
+                start = now_usec();
+
+                s = bcase->func(env, &count);
+
+                lat[i] = now_usec() - start;
+                bench_counters_get(&after);
+
+                lv_calls += after.lv_calls - before.lv_calls;
+                allocs += after.allocs - before.allocs;
+                alloc_bytes += after.alloc_bytes - before.alloc_bytes;
+
+                bench_broker_reset();
+        }
+
+        qsort(lat, iters, sizeof(*lat), cmp_double);
+
+        printf("%-24s %10.1f %10.1f %10.1f %10.1f %6u %8.1f %9.1f %11.1f\n",
+               bcase->name,
+               percentile(lat, iters, 0.50),
+               percentile(lat, iters, 0.90),
+               percentile(lat, iters, 0.99),
+               lat[iters - 1],
+               count,
+               (double)lv_calls / iters,
+               (double)allocs / iters,
+               (double)alloc_bytes / iters);
+
+        free(lat);
+}
+
+static int write_node(FILE *out,
+                      unsigned int domains,
+                      unsigned int disks,
+                      unsigned int nics,
+                      unsigned int pools)
+{
+        unsigned int i;
+        unsigned int j;
+
+        fprintf(out, "<node>\n");
+
+        fprintf(out,
+                "  <network>\n"
+                "    <name>default</name>\n"
+                "    <bridge name='virbr0'/>\n"
+                "    <forward/>\n"
+                "    <ip address='192.168.122.1' netmask='255.255.255.0'/>\n"
+                "  </network>\n");
+
+        for (i = 0; i < pools; i++) {
+                fprintf(out,
+                        "  <pool type='dir'>\n"
+                        "    <name>bench%u</name>\n"
+                        "    <target><path>/bench/pool%u</path></target>\n",
+                        i, i);
+
+                for (j = 0; j < domains * disks; j++) {
+                        if (j % pools != i)
+                                continue;
+
+                        fprintf(out,
+                                "    <volume>\n"
+                                "      <name>disk%u-%u.img</name>\n"
+                                "      <capacity>1073741824</capacity>\n"
+                                "      <allocation>0</allocation>\n"
+                                "    </volume>\n",
+                                j / disks, j % disks);
+                }
+
+                fprintf(out, "  </pool>\n");
+        }
+
+        for (i = 0; i < domains; i++) {
+                fprintf(out,
+                        "  <domain type='test'>\n"
+                        "    <name>bench%u</name>\n"
+                        "    <memory>262144</memory>\n"
+                        "    <vcpu>1</vcpu>\n"
+                        "    <os><type>hvm</type></os>\n"
+                        "    <devices>\n",
+                        i);
+
+                for (j = 0; j < disks; j++) {
+                        unsigned int k = i * disks + j;
+
+                        fprintf(out,
+                                "      <disk type='file' device='disk'>\n"
+                                "        <source file='/bench/pool%u/"
+                                "disk%u-%u.img'/>\n"
+                                "        <target dev='vd%c' bus='virtio'/>\n"
+                                "      </disk>\n",
+                                pools ? k % pools : 0, i, j, 'a' + j);
+                }
+
+                for (j = 0; j < nics; j++) {
+                        fprintf(out,
+                                "      <interface type='network'>\n"
+                                "        <mac address='52:54:00:%02x:%02x:"
+                                "%02x'/>\n"
+                                "        <source network='default'/>\n"
+                                "      </interface>\n",
+                                (i >> 8) & 0xff, i & 0xff, j & 0xff);
+                }
+
+                fprintf(out,
+                        "    </devices>\n"
+                        "  </domain>\n");
+        }
+
+        fprintf(out, "</node>\n");
+
+        return ferror(out) ? -1 : 0;
+}
+
+static char *make_node(unsigned int domains,
+                       unsigned int disks,
+                       unsigned int nics,
+                       unsigned int pools)
+{
+        char path[] = "/tmp/provider_bench.XXXXXX";
+        FILE *out;
+        int fd;
+        int ret;
+
+        fd = mkstemp(path);
+        if (fd < 0) {
+                perror("mkstemp");
+                return NULL;
+        }
+
+        out = fdopen(fd, "w");
+        if (out == NULL) {
+                perror("fdopen");
+                close(fd);
+                unlink(path);
+                return NULL;
+        }
+
+        ret = write_node(out, domains, disks, nics, pools);
+        if ((fclose(out) != 0) || (ret != 0)) {
+                fprintf(stderr, "Unable to write %s\n", path);
+                unlink(path);
+                return NULL;
+        }
+
+        return strdup(path);
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "Usage: %s [options]\n"
+                "  -u URI   libvirt URI to use (default test:///default)\n"
+                "  -d N     generate a test driver node with N guests\n"
+                "  -k N     disks per generated guest (default 4, max 26)\n"
+                "  -i N     interfaces per generated guest (default 2)\n"
+                "  -p N     storage pools in the generated node "
+                "(default 2)\n"
+                "  -n N     iterations per case (default 100)\n"
+                "  -c NAME  only run cases whose name contains NAME\n",
+                prog);
+}
+
+int main(int argc, char **argv)
+{
+        struct bench_env env;
+        const char *uri = "test:///default";
+        const char *filter = NULL;
+        char *node = NULL;
+        char *node_uri = NULL;
+        int domains = -1;
+        int disks = 4;
+        int nics = 2;
+        int pools = 2;
+        int iters = 100;
+        int ret = 1;
+        int c;
+        int i;
+
+        while ((c = getopt(argc, argv, "u:d:k:i:p:n:c:h")) != -1) {
+                switch (c) {
+                case 'u':
+                        uri = optarg;
+                        break;
+                case 'd':
+                        domains = atoi(optarg);
+                        break;
+                case 'k':
+                        disks = atoi(optarg);
+                        break;
+                case 'i':
+                        nics = atoi(optarg);
+                        break;
+                case 'p':
+                        pools = atoi(optarg);
+                        break;
+                case 'n':
+                        iters = atoi(optarg);
+                        break;
+                case 'c':
+                        filter = optarg;
+                        break;
+                default:
+                        usage(argv[0]);
+                        return c == 'h' ? 0 : 1;
+                }
+        }
+
+        if ((iters <= 0) || (disks < 0) || (disks > 26) ||
+            (nics < 0) || (pools < 0)) {
+                usage(argv[0]);
+                return 1;
+        }
+
+        if (domains >= 0) {
+                node = make_node(domains, disks, nics, pools);
+                if (node == NULL)
+                        return 1;
+
+                if (asprintf(&node_uri, "test://%s", node) == -1)
+                        goto out;
+
+                uri = node_uri;
+        }
+
+        bench_hooks_set_uri(uri);
+
+        if (setup_env(&env, uri) != 0)
+                goto out;
+
+        printf("# uri %s, prefix %s, %d iterations\n",
+               uri, env.pfx, iters);
+        printf("%-24s %10s %10s %10s %10s %6s %8s %9s %11s\n",
+               "case", "p50(us)", "p90(us)", "p99(us)", "max(us)",
+               "objs", "lv/call", "allocs", "bytes");
+
+        for (i = 0; cases[i].name != NULL; i++) {
+                if ((filter != NULL) && (strstr(cases[i].name, filter) == NULL))
+                        continue;
+
+                run_case(&env, &cases[i], iters);
+        }
+
+        cleanup_env(&env);
+        ret = 0;
+
+ out:
+        if (node != NULL)
+                unlink(node);
+        free(node);
+        free(node_uri);
+
+        return ret;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-set-style: "K&R"
+ * tab-width: 8
+ * c-basic-offset: 8
+ * indent-tabs-mode: nil
+ * End:
+ */